@@ -0,0 +1,16 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec3 position;
+
+uniform mat4 u_MVP;
+
+void main() { gl_Position = u_MVP * vec4(position, 1.0); };
+
+#shader fragment
+#version 330 core
+
+out vec4 color;
+
+// color writes are masked off, only the samples passed count
+void main() { color = vec4(1.0); };
@@ -0,0 +1,25 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in float textureIndex;
+
+out vec3 v_TexCoord;
+
+uniform mat4 u_MVP;
+
+void main() {
+  gl_Position = u_MVP * vec4(position, 1.0, 1.0);
+  v_TexCoord = vec3(texCoord, textureIndex);
+};
+
+#shader fragment
+#version 330 core
+
+out vec4 color;
+in vec3 v_TexCoord;  // z = layer
+
+uniform sampler2DArray u_Textures;
+
+void main() { color = texture(u_Textures, v_TexCoord); };
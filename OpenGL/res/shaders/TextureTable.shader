@@ -0,0 +1,36 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in float textureIndex;
+
+out vec2 v_TexCoord;
+flat out int v_TextureIndex;
+
+uniform mat4 u_MVP;
+
+void main() {
+  gl_Position = u_MVP * vec4(position, 1.0, 1.0);
+  v_TexCoord = texCoord;
+  v_TextureIndex = int(textureIndex);
+};
+
+#shader fragment
+#version 330 core
+#extension GL_ARB_bindless_texture : require
+// handles that differ within a draw
+#extension GL_NV_gpu_shader5 : require
+
+out vec4 color;
+in vec2 v_TexCoord;
+flat in int v_TextureIndex;
+
+// TextureTable::kMaxHandles 64 bit handles, two per std140 element
+layout(std140) uniform TextureHandles { uvec4 u_Handles[512]; };
+
+void main() {
+  uvec4 pair = u_Handles[v_TextureIndex >> 1];
+  uvec2 handle = (v_TextureIndex & 1) == 0 ? pair.xy : pair.zw;
+  color = texture(sampler2D(handle), v_TexCoord);
+};
@@ -0,0 +1,49 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texCoord;
+
+out vec2 v_TexCoord;
+
+uniform mat4 u_MVP;
+
+void main() {
+  gl_Position = u_MVP * vec4(position, 1.0, 1.0);
+  v_TexCoord = texCoord;
+};
+
+#shader fragment
+#version 330 core
+
+out vec4 color;
+in vec2 v_TexCoord;
+
+uniform vec4 u_VirtualSize;  // width, height, page size, coarsest level
+uniform vec4 u_CacheParams;  // border, page + border, cache size, lod bias
+// per level mip: slot x, slot y, level of the resident page used
+uniform sampler2D u_Indirection;
+uniform sampler2D u_Cache;
+
+void main() {
+  vec2 uv = clamp(v_TexCoord, 0.0, 1.0);
+  vec2 texel = v_TexCoord * u_VirtualSize.xy;
+  vec2 dx = dFdx(texel), dy = dFdy(texel);
+  float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + u_CacheParams.w;
+  int level = int(clamp(floor(lod), 0.0, u_VirtualSize.w));
+
+  int pageSize = int(u_VirtualSize.z);
+  ivec2 size = max(ivec2(u_VirtualSize.xy) >> level, ivec2(1));
+  ivec2 page = min(ivec2(uv * vec2(size)) / pageSize, (size - 1) / pageSize);
+  ivec3 entry = ivec3(texelFetch(u_Indirection, page, level).rgb * 255.0 + 0.5);
+
+  // where uv falls inside the page that is resident, maybe a coarser one
+  ivec2 mappedSize = max(ivec2(u_VirtualSize.xy) >> entry.z, ivec2(1));
+  vec2 mappedTexel = uv * vec2(mappedSize);
+  ivec2 mappedPage =
+      min(ivec2(mappedTexel) / pageSize, (mappedSize - 1) / pageSize);
+  vec2 inPage = mappedTexel - vec2(mappedPage * pageSize);
+  vec2 cache = (vec2(entry.xy) * u_CacheParams.y + u_CacheParams.x + inPage) /
+               u_CacheParams.z;
+  color = textureLod(u_Cache, cache, 0.0);
+};
@@ -0,0 +1,37 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texCoord;
+
+out vec2 v_TexCoord;
+
+uniform mat4 u_MVP;
+
+void main() {
+  gl_Position = u_MVP * vec4(position, 1.0, 1.0);
+  v_TexCoord = texCoord;
+};
+
+#shader fragment
+#version 330 core
+
+// page x, page y, level, 1 for the page this pixel samples
+layout(location = 0) out uvec4 feedback;
+in vec2 v_TexCoord;
+
+uniform vec4 u_VirtualSize;  // width, height, page size, coarsest level
+uniform vec4 u_CacheParams;  // border, page + border, cache size, lod bias
+
+void main() {
+  vec2 uv = clamp(v_TexCoord, 0.0, 1.0);
+  vec2 texel = v_TexCoord * u_VirtualSize.xy;
+  vec2 dx = dFdx(texel), dy = dFdy(texel);
+  float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + u_CacheParams.w;
+  int level = int(clamp(floor(lod), 0.0, u_VirtualSize.w));
+
+  int pageSize = int(u_VirtualSize.z);
+  ivec2 size = max(ivec2(u_VirtualSize.xy) >> level, ivec2(1));
+  ivec2 page = min(ivec2(uv * vec2(size)) / pageSize, (size - 1) / pageSize);
+  feedback = uvec4(uvec2(page), uint(level), 1u);
+};
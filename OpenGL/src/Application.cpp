@@ -1,21 +1,127 @@
+#include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "AtlasPacker.h"
+#include "Bvh.h"
+#include "CookedMesh.h"
+#include "DeletionQueue.h"
+#include "FrameAllocator.h"
+#include "FrustumCuller.h"
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
+#include "GltfLoader.h"
+#include "GpuMemory.h"
+#include "ImageDecoder.h"
 #include "IndexBuffer.h"
+#include "JobSystem.h"
 #include "Log.h"
+#include "MeshCooker.h"
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "RenderGraph.h"
+#include "RenderSystem.h"
 #include "Renderer.h"
+#include "SceneGraph.h"
+#include "SelfTest.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "TextureAtlas.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "TextureTable.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
+#include "VirtualTexture.h"
 #include "glm/glm.hpp"
 #include "glm/gtx/transform.hpp"
 
-int main(void) {
+namespace {
+
+// switches that can follow the model or texture argument
+bool HasOption(int argc, char** argv, const std::string& option) {
+  for (int i = 1; i < argc; i++)
+    if (argv[i] == option) return true;
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // OpenGL --cook <source.obj|gltf|glb> <destination.mesh>
+  if (argc > 3 && std::string(argv[1]) == "--cook")
+    return MeshCooker::Cook(argv[2], argv[3]) ? 0 : -1;
+  // OpenGL --build-vt <source image> <destination.vtex>
+  if (argc > 3 && std::string(argv[1]) == "--build-vt")
+    return VirtualTexture::Build(argv[2], argv[3]) ? 0 : -1;
+  // OpenGL --build-atlas <destination.atlas> <image> [image...]
+  if (argc > 3 && std::string(argv[1]) == "--build-atlas")
+    return TextureAtlas::Build(std::vector<std::string>(argv + 3, argv + argc),
+                               argv[2])
+               ? 0
+               : -1;
+  // OpenGL --bench-scene / --bench-culling / --bench-bvh / --bench-occlusion /
+  // --bench-ecs / --bench-jobs / --report-rendergraph / --bench-frame-alloc /
+  // --bench-atlas / --bench-decode / --report-textures /
+  // --bench-texture-cache, CPU only
+  if (argc > 1 && std::string(argv[1]) == "--bench-scene") {
+    SceneGraph::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-culling") {
+    FrustumCuller::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-bvh") {
+    Bvh::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-occlusion") {
+    OcclusionCuller::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-ecs") {
+    RenderSystem::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-jobs") {
+    JobSystem::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--report-rendergraph") {
+    RenderGraph::Report();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-frame-alloc") {
+    FrameAllocator::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-atlas") {
+    AtlasPacker::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-decode") {
+    ImageDecoder::Benchmark();
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--report-textures") {
+    Texture::ReportMemory({"res/textures/container.jpg",
+                           "res/textures/desktop.png",
+                           "res/textures/icon.png"});
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "--bench-texture-cache") {
+    TextureCache::Benchmark();
+    return 0;
+  }
+
   GLFWwindow* window;
 
   /* Initialize the library */
@@ -41,15 +147,26 @@ int main(void) {
     std::cerr << "Error: " << glewGetErrorString(err) << '\n';
   }
   std::cout << "Status: Using GLEW " << glewGetString(GLEW_VERSION) << '\n';
+
+  // loaders against malformed files, needs the context for the uploads
+  if (argc > 1 && std::string(argv[1]) == "--self-test") {
+    unsigned int failed = SelfTest::Run();
+    DeletionQueue::Get().Flush();
+    glfwTerminate();
+    return failed ? -1 : 0;
+  }
   {
-    float positions[] = {
+    std::vector<float> positions = {
         -1.5f, -1.5f, 0.0f, 0.0f,  // 0
         1.5f,  -1.5f, 1.0f, 0.0f,  // 1
         1.5f,  1.5f,  1.0f, 1.0f,  // 2
         -1.5f, 1.5f,  0.0f, 1.0f   // 3
     };
 
-    unsigned int indices[] = {0, 1, 2, 2, 3, 0};
+    std::vector<unsigned int> indices = {0, 1, 2, 2, 3, 0};
+
+    // dedup, vertex cache/overdraw/vertex fetch reordering before upload
+    MeshOptimizer::Optimize(positions, indices, 4, 0, 2);
 
     GLCall(glEnable(GL_BLEND));
     // R = r_src * sfactor + r_dest * dfactor
@@ -60,20 +177,68 @@ int main(void) {
 
     Renderer renderer;
 
+    // OpenGL <model.gltf|glb|mesh> draws the model instead of the quad,
+    // OpenGL <texture.vtex> draws the quad with a virtual texture,
+    // OpenGL --texture-table draws quads with different textures in one call
+    // OpenGL --bench-gltf <model> times the loader,
+    // OpenGL --bench-cooked <source> <cooked.mesh> times cooked loading;
+    // OpenGL --ecs draws a grid of quad entities through the RenderSystem;
+    // --recycle-gl-objects reuses deleted buffers and textures of the same
+    // size, --gpu-stats shows GPU memory use in the title bar
+    GltfModel model;
+    std::unique_ptr<CookedMesh> cooked;
+    std::unique_ptr<VirtualTexture> virtualTexture;
+    std::string argument = argc > 1 ? argv[1] : "";
+    if (argc > 2 && argument == "--bench-gltf") {
+      GltfLoader::Benchmark(argv[2]);
+    } else if (argc > 3 && argument == "--bench-cooked") {
+      MeshCooker::Benchmark(argv[2], argv[3]);
+    } else if (argument.size() > 5 &&
+               argument.compare(argument.size() - 5, 5, ".mesh") == 0) {
+      cooked.reset(new CookedMesh(argument));
+    } else if (argument.size() > 5 &&
+               argument.compare(argument.size() - 5, 5, ".vtex") == 0) {
+      virtualTexture.reset(new VirtualTexture(argument));
+      if (!virtualTexture->IsValid()) virtualTexture.reset();
+    } else if (argc > 1 && argument.compare(0, 2, "--") != 0) {
+      GltfLoader::Load(argument, model);
+    }
+    DeletionQueue::Get().SetRecycling(
+        HasOption(argc, argv, "--recycle-gl-objects"));
+
     // vertex array object
     VertexArray va;
     // vertex buffer object
-    VertexBuffer vb(positions, 4 * 4 * sizeof(float));
+    VertexBuffer vb(positions.data(),
+                    (unsigned int)(positions.size() * sizeof(float)));
     // specify layout in vertex buffer
     VertexBufferLayout layout;
     layout.Push<float>(2);
     layout.Push<float>(2);
 
     // index buffer object, specify how I want to draw this layout.
-    IndexBuffer ib(indices, 6);
+    IndexBuffer ib(indices.data(), (unsigned int)indices.size());
 
     va.AddBuffer(vb, ib, layout);
 
+    // LOD index buffers sharing vb
+    MeshLod lod(indices.data(), (unsigned int)indices.size(), positions.data(),
+                (unsigned int)positions.size() / 4, 4 * sizeof(float), 2);
+    unsigned int lodLevel = 0;
+
+    MultiDrawBatch batch;
+    unsigned int lastSubmitted = ~0u;
+
+    // glTF primitives are drawn behind hardware occlusion queries
+    std::unique_ptr<OcclusionQueries> occlusion;
+    unsigned int lastOccluded = ~0u;
+    if (!model.Primitives.empty()) {
+      occlusion.reset(new OcclusionQueries());
+      for (const GltfPrimitive& primitive : model.Primitives)
+        occlusion->Add(primitive.Min, primitive.Max);
+      GLCall(glEnable(GL_DEPTH_TEST));
+    }
+
     // 4 * 3
     glm::mat4 proj = glm::ortho(-2.0f, 2.0f, -1.5f, 1.5f, -1.0f, 1.0f);
 
@@ -81,24 +246,265 @@ int main(void) {
     shader.Bind();
     shader.SetUniformMat4f("u_MVP", proj);
 
+    // one callback for every occluded primitive instead of a std::function
+    // per draw
+    const GltfPrimitive* occludedPrimitive = nullptr;
+    std::function<void()> drawOccluded = [&]() {
+      renderer.Draw(*occludedPrimitive->VAO, *occludedPrimitive->Indices,
+                    shader);
+    };
+
+    // textures picked by a vertex attribute, one draw per texture group
+    std::unique_ptr<TextureTable> textureTable;
+    std::unique_ptr<Shader> tableShader;
+    std::unique_ptr<VertexArray> tableVa;
+    std::unique_ptr<VertexBuffer> tableVb;
+    std::unique_ptr<IndexBuffer> tableIb;
+    struct TableDraw {
+      unsigned int Group, First, Count;
+    };
+    std::vector<TableDraw> tableDraws;
+    if (argument == "--texture-table") {
+      textureTable.reset(new TextureTable());
+      std::vector<TextureTable::TextureIndex> textures;
+      for (const char* path : {"res/textures/icon.png",
+                               "res/textures/container.jpg",
+                               "res/textures/icon.png"}) {
+        TextureTable::TextureIndex texture = textureTable->Add(path);
+        if (texture != ~0u) textures.push_back(texture);
+      }
+      // quads sorted by group, so each group is one index range
+      std::stable_sort(textures.begin(), textures.end(),
+                       [&](TextureTable::TextureIndex a,
+                           TextureTable::TextureIndex b) {
+                         return textureTable->GetGroup(a) <
+                                textureTable->GetGroup(b);
+                       });
+      std::vector<float> vertices;
+      std::vector<unsigned int> quadIndices;
+      for (unsigned int i = 0; i < textures.size(); i++) {
+        float x = -1.8f + 1.2f * i;
+        float index = textureTable->GetShaderIndex(textures[i]);
+        float quad[] = {x,        -0.5f, 0.0f, 0.0f, index,
+                        x + 1.0f, -0.5f, 1.0f, 0.0f, index,
+                        x + 1.0f, 0.5f,  1.0f, 1.0f, index,
+                        x,        0.5f,  0.0f, 1.0f, index};
+        vertices.insert(vertices.end(), quad, quad + 20);
+        for (unsigned int corner : {0u, 1u, 2u, 2u, 3u, 0u})
+          quadIndices.push_back(i * 4 + corner);
+        unsigned int group = textureTable->GetGroup(textures[i]);
+        if (tableDraws.empty() || tableDraws.back().Group != group)
+          tableDraws.push_back(TableDraw{group, i * 6, 0});
+        tableDraws.back().Count += 6;
+      }
+      tableVa.reset(new VertexArray());
+      tableVb.reset(new VertexBuffer(
+          vertices.data(), (unsigned int)(vertices.size() * sizeof(float))));
+      tableIb.reset(new IndexBuffer(quadIndices.data(),
+                                    (unsigned int)quadIndices.size()));
+      VertexBufferLayout tableLayout;
+      tableLayout.Push<float>(2);
+      tableLayout.Push<float>(2);
+      tableLayout.Push<float>(1);
+      tableVa->AddBuffer(*tableVb, *tableIb, tableLayout);
+      tableShader.reset(new Shader(textureTable->GetShaderPath()));
+    }
+
+    // entities sharing the quad's buffers, the ones past the left and right
+    // edges are culled
+    std::unique_ptr<GpuResources> ecsResources;
+    std::unique_ptr<World> ecsWorld;
+    std::vector<DrawItem> ecsItems;
+    size_t lastVisible = ~(size_t)0;
+    if (argument == "--ecs") {
+      ecsResources.reset(new GpuResources());
+      GpuResources& resources = *ecsResources;
+      VertexBufferHandle quadVb = resources.VertexBuffers.Create(
+          positions.data(), (unsigned int)(positions.size() * sizeof(float)));
+      IndexBufferHandle quadIb = resources.IndexBuffers.Create(
+          indices.data(), (unsigned int)indices.size());
+      VertexArrayHandle quadVa = resources.VertexArrays.Create();
+      resources.VertexArrays.Get(quadVa)->AddBuffer(
+          *resources.VertexBuffers.Get(quadVb),
+          *resources.IndexBuffers.Get(quadIb), layout);
+      MeshHandle quad = resources.Meshes.Create(RenderMesh{quadVa, quadIb});
+      ShaderHandle material =
+          resources.Shaders.Create("res/shaders/Basic.shader");
+      resources.Shaders.Get(material)->Bind();
+      resources.Shaders.Get(material)->SetUniform1i("u_Texture", 0);
+
+      ecsWorld.reset(new World());
+      LocalBounds bounds = {glm::vec3(-1.5f, -1.5f, 0.0f),
+                            glm::vec3(1.5f, 1.5f, 0.0f)};
+      for (int y = -3; y <= 3; y++)
+        for (int x = -6; x <= 6; x++)
+          ecsWorld->Create(
+              Transform{glm::scale(
+                  glm::translate(glm::mat4(1.0f),
+                                 glm::vec3(x * 0.4f, y * 0.4f, 0.0f)),
+                  glm::vec3(0.1f))},
+              bounds, WorldBounds(), MeshRef{quad}, MaterialRef{material});
+      // nothing moves, the world bounds hold for every frame
+      RenderSystem::UpdateBounds(*ecsWorld);
+    }
+
+    // the virtual texture's feedback pass and the shader sampling it, both
+    // passes of a frame graph that owns the feedback targets
+    std::unique_ptr<Shader> feedbackShader, virtualShader;
+    std::unique_ptr<RenderGraph> frameGraph;
+    if (virtualTexture) {
+      feedbackShader.reset(
+          new Shader("res/shaders/VirtualTextureFeedback.shader"));
+      virtualShader.reset(new Shader("res/shaders/VirtualTexture.shader"));
+      frameGraph.reset(new RenderGraph());
+    }
+
     // unbind everything
     shader.Unbind();
     va.Unbind();
     vb.Unbind();
     ib.Unbind();
 
+    // transient per frame data, double buffered behind GPU fences
+    FrameAllocator frameAllocator;
+
+    TextureStreamer textures;
+    TextureStreamer::TextureID icon = textures.Add("res/textures/icon.png");
+
+    // evict textures the scene hasn't used lately past 80% of VRAM
+    GpuMemory::Get().SetBudgetFromDevice(0.8f);
+    bool showGpuMemory = HasOption(argc, argv, "--gpu-stats");
+    double lastGpuMemoryUpdate = 0.0;
+
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(window)) {
+      frameAllocator.BeginFrame();
+
       /* Render here */
       renderer.Clear();
 
-      Texture texture("res/textures/icon.png");
-      texture.Bind();
+      int width, height;
+      glfwGetFramebufferSize(window, &width, &height);
+
+      // the quad's texture streams in at the level its screen size needs
+      float quadPixels = TextureStreamer::ProjectedSize(
+          glm::vec3(-1.5f, -1.5f, 0.0f), glm::vec3(1.5f, 1.5f, 0.0f), proj,
+          (float)height);
+      textures.Request(icon, textures.ComputeLevel(icon, quadPixels));
+      textures.Update();
+      textures.Bind(icon);
 
       shader.Bind();
       shader.SetUniform1i("u_Texture", 0);
 
-      renderer.Draw(va, shader, ib.GetCount());
+      lodLevel =
+          lod.SelectLevel(proj, glm::mat4(1.0f), (float)height, lodLevel);
+      if (cooked && cooked->IsValid()) {
+        // cull meshlets, the ortho camera looks down -z from far away
+        Frustum frustum = Frustum::FromMatrix(proj);
+        glm::vec3 camera(0.0f, 0.0f, 1000.0f);
+        MeshletCullStats total = {};
+        batch.Clear();
+        for (unsigned int i = 0; i < cooked->GetSubmeshCount(); i++) {
+          MeshletCullStats stats;
+          cooked->GetMeshlets(i).Cull(frustum, camera, batch, stats);
+          total.Triangles += stats.Triangles;
+          total.SubmittedTriangles += stats.SubmittedTriangles;
+        }
+        renderer.Draw(cooked->GetVertexArray(), cooked->GetIndexBuffer(),
+                      shader, batch);
+        if (total.SubmittedTriangles != lastSubmitted) {
+          std::cout << "[Meshlets] triangles submitted "
+                    << total.SubmittedTriangles << " / " << total.Triangles
+                    << std::endl;
+          lastSubmitted = total.SubmittedTriangles;
+        }
+      } else if (textureTable) {
+        tableShader->Bind();
+        tableShader->SetUniformMat4f("u_MVP", proj);
+        for (const TableDraw& draw : tableDraws) {
+          textureTable->Bind(*tableShader, draw.Group);
+          renderer.Draw(*tableVa, *tableIb, *tableShader, draw.First,
+                        draw.Count);
+        }
+      } else if (virtualTexture) {
+        RenderGraph& graph = *frameGraph;
+        graph.Reset();
+        RenderGraphResource backbuffer = graph.Import(
+            "Backbuffer", 0,
+            RenderGraphTextureDesc{(unsigned int)width, (unsigned int)height,
+                                   GL_RGBA8});
+        unsigned int feedbackWidth = VirtualTexture::GetFeedbackSize(width);
+        unsigned int feedbackHeight = VirtualTexture::GetFeedbackSize(height);
+
+        // pages wanted this frame are read back and loaded next frame
+        graph.AddPass(
+            "Feedback",
+            [&](RenderGraph::Builder& builder) {
+              builder.Create("Feedback", RenderGraphTextureDesc{
+                                             feedbackWidth, feedbackHeight,
+                                             GL_RGBA16UI});
+              builder.Create("FeedbackDepth",
+                             RenderGraphTextureDesc{feedbackWidth,
+                                                    feedbackHeight,
+                                                    GL_DEPTH_COMPONENT24});
+              // nothing reads the target on the GPU, the readback does
+              builder.SideEffect();
+            },
+            [&](const RenderGraphContext&) {
+              virtualTexture->ClearFeedback();
+              feedbackShader->Bind();
+              feedbackShader->SetUniformMat4f("u_MVP", proj);
+              virtualTexture->SetFeedbackUniforms(*feedbackShader);
+              renderer.Draw(va, lod.GetLevel(lodLevel), *feedbackShader);
+              virtualTexture->ReadFeedback(feedbackWidth, feedbackHeight,
+                                           frameAllocator.GetArena());
+              virtualTexture->Update();
+            });
+        graph.AddPass(
+            "Main",
+            [&](RenderGraph::Builder& builder) { builder.Write(backbuffer); },
+            [&](const RenderGraphContext&) {
+              virtualShader->Bind();
+              virtualShader->SetUniformMat4f("u_MVP", proj);
+              virtualTexture->Bind(*virtualShader);
+              renderer.Draw(va, lod.GetLevel(lodLevel), *virtualShader);
+            });
+        graph.Execute();
+      } else if (ecsWorld) {
+        RenderSystem::CollectVisible(*ecsWorld, Frustum::FromMatrix(proj),
+                                     ecsItems);
+        RenderSystem::Draw(renderer, ecsItems, *ecsResources, proj);
+        if (ecsItems.size() != lastVisible) {
+          lastVisible = ecsItems.size();
+          std::cout << "[RenderSystem] entities drawn " << lastVisible
+                    << " / " << ecsWorld->GetEntityCount() << std::endl;
+        }
+      } else if (model.Primitives.empty()) {
+        renderer.Draw(va, lod.GetLevel(lodLevel), shader);
+      } else {
+        GLCall(glClear(GL_DEPTH_BUFFER_BIT));
+        occlusion->Begin(proj, glm::vec3(0.0f, 0.0f, 1000.0f));
+        for (unsigned int i = 0; i < model.Primitives.size(); i++) {
+          occludedPrimitive = &model.Primitives[i];
+          occlusion->Draw(i, drawOccluded);
+        }
+        occlusion->End();
+        if (occlusion->GetStats().Occluded != lastOccluded) {
+          lastOccluded = occlusion->GetStats().Occluded;
+          std::cout << "[Occlusion] primitives occluded " << lastOccluded
+                    << " / " << model.Primitives.size() << std::endl;
+        }
+      }
+
+      frameAllocator.EndFrame();
+      // objects destroyed this frame go once the GPU is past it
+      DeletionQueue::Get().EndFrame();
+      GpuMemory::Get().EndFrame();
+      if (showGpuMemory && glfwGetTime() - lastGpuMemoryUpdate >= 1.0) {
+        glfwSetWindowTitle(window, GpuMemory::Get().GetSummary().c_str());
+        lastGpuMemoryUpdate = glfwGetTime();
+      }
 
       /* Swap front and back buffers */
       glfwSwapBuffers(window);
@@ -107,7 +513,15 @@ int main(void) {
       /* Poll for and process events */
       GLCall(glfwPollEvents());
     }
+    frameAllocator.PrintStats();
+    textures.PrintStats();
+    if (virtualTexture) virtualTexture->PrintStats();
+    if (textureTable) textureTable->PrintStats();
+    GpuMemory::Get().PrintStats();
   }
+  // the wrappers above only queued their objects
+  DeletionQueue::Get().PrintStats();
+  DeletionQueue::Get().Flush();
   glfwTerminate();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+// Prebuilt texture atlas (.atlas), written by TextureAtlas::Build and read
+// by TextureAtlas::Load. Little endian, laid out as
+//
+//   AtlasFileHeader
+//   AtlasFileEntry[EntryCount], the UV lookup table
+//   name block (NameBytes), entry names back to back, not terminated
+//   pixel block (PixelOffset, 16-byte aligned), Levels RGBA8 mip levels
+//   finest first, rows bottom up like GL
+//
+// so every level can go from the mapped file straight into glTexImage2D.
+
+const char kAtlasFileMagic[4] = {'A', 'T', 'L', 'S'};
+const uint32_t kAtlasFileVersion = 1;
+const uint32_t kAtlasFileAlignment = 16;
+
+struct AtlasFileHeader {
+  char Magic[4];
+  uint32_t Version;
+  uint32_t Width;
+  uint32_t Height;
+  uint32_t Levels;  // mips that don't bleed between entries
+  uint32_t Gutter;  // level 0 texels of repeated edge around every entry
+  uint32_t EntryCount;
+  uint32_t NameBytes;
+  uint64_t PixelOffset;
+  uint64_t PixelBytes;
+};
+
+struct AtlasFileEntry {
+  uint32_t NameOffset;  // into the name block
+  uint32_t NameLength;
+  uint32_t X, Y;  // level 0 texels, without the gutter
+  uint32_t Width, Height;
+  float UVMin[2];
+  float UVMax[2];
+};
@@ -0,0 +1,139 @@
+#include "AtlasPacker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+AtlasPacker::AtlasPacker(unsigned int width, unsigned int height)
+    : m_Width(width), m_Height(height), m_UsedArea(0) {
+  Clear();
+}
+
+void AtlasPacker::Clear() {
+  m_Skyline.assign(1, Segment{0, 0, m_Width});
+  m_UsedArea = 0;
+}
+
+float AtlasPacker::GetOccupancy() const {
+  return (float)m_UsedArea / ((float)m_Width * m_Height);
+}
+
+unsigned int AtlasPacker::Fit(unsigned int index, unsigned int width,
+                              unsigned int height) const {
+  // compared as what's left, a width near 2^32 would wrap the sum
+  if (width > m_Width - m_Skyline[index].X) return ~0u;
+  // rests on the highest segment it spans
+  unsigned int y = 0, remaining = width;
+  for (unsigned int i = index; remaining > 0; i++) {
+    y = std::max(y, m_Skyline[i].Y);
+    if (height > m_Height - y) return ~0u;
+    remaining -= std::min(remaining, m_Skyline[i].Width);
+  }
+  return y;
+}
+
+bool AtlasPacker::Insert(unsigned int width, unsigned int height,
+                         unsigned int& x, unsigned int& y) {
+  if (width == 0 || height == 0) return false;
+  unsigned int best = ~0u, bestTop = ~0u, bestWidth = ~0u;
+  for (unsigned int i = 0; i < m_Skyline.size(); i++) {
+    unsigned int fit = Fit(i, width, height);
+    if (fit == ~0u) continue;
+    unsigned int top = fit + height;
+    if (top < bestTop ||
+        (top == bestTop && m_Skyline[i].Width < bestWidth)) {
+      best = i;
+      bestTop = top;
+      bestWidth = m_Skyline[i].Width;
+      y = fit;
+    }
+  }
+  if (best == ~0u) return false;
+  x = m_Skyline[best].X;
+
+  // the new segment replaces what it covers, the last one is cut short
+  m_Skyline.insert(m_Skyline.begin() + best, Segment{x, y + height, width});
+  unsigned int end = x + width;
+  for (unsigned int i = best + 1; i < m_Skyline.size();) {
+    Segment& segment = m_Skyline[i];
+    if (segment.X >= end) break;
+    unsigned int segmentEnd = segment.X + segment.Width;
+    if (segmentEnd <= end) {
+      m_Skyline.erase(m_Skyline.begin() + i);
+      continue;
+    }
+    segment.Width = segmentEnd - end;
+    segment.X = end;
+    break;
+  }
+  // neighbours at the same height become one segment
+  for (unsigned int i = 0; i + 1 < m_Skyline.size();) {
+    if (m_Skyline[i].Y == m_Skyline[i + 1].Y) {
+      m_Skyline[i].Width += m_Skyline[i + 1].Width;
+      m_Skyline.erase(m_Skyline.begin() + i + 1);
+    } else {
+      i++;
+    }
+  }
+  m_UsedArea += (size_t)width * height;
+  return true;
+}
+
+void AtlasPacker::Benchmark() {
+  const unsigned int kSprites = 4000;
+  const unsigned int kPageSize = 1024;
+  struct Size {
+    unsigned int Width, Height;
+  };
+  std::vector<Size> sizes(kSprites);
+  unsigned int seed = 12345;
+  for (Size& size : sizes) {
+    seed = seed * 1664525u + 1013904223u;
+    size.Width = 8 + (seed >> 8) % 57;
+    seed = seed * 1664525u + 1013904223u;
+    size.Height = 8 + (seed >> 8) % 57;
+  }
+
+  auto pack = [&](const std::vector<Size>& order, unsigned int& pages,
+                  float& occupancy) {
+    typedef std::chrono::high_resolution_clock Clock;
+    auto start = Clock::now();
+    AtlasPacker packer(kPageSize, kPageSize);
+    pages = 1;
+    float total = 0.0f;
+    for (const Size& size : order) {
+      unsigned int x, y;
+      if (packer.Insert(size.Width, size.Height, x, y)) continue;
+      total += packer.GetOccupancy();
+      packer.Clear();
+      pages++;
+      packer.Insert(size.Width, size.Height, x, y);
+    }
+    // the last page is partly filled, average over the full ones
+    occupancy = pages > 1 ? total / (pages - 1) : packer.GetOccupancy();
+    return std::chrono::duration<double, std::micro>(Clock::now() - start)
+               .count() /
+           order.size();
+  };
+
+  unsigned int arrivalPages, sortedPages;
+  float arrivalOccupancy, sortedOccupancy;
+  double arrivalUs = pack(sizes, arrivalPages, arrivalOccupancy);
+  std::vector<Size> sorted = sizes;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Size& a, const Size& b) {
+                     return a.Height > b.Height;
+                   });
+  double sortedUs = pack(sorted, sortedPages, sortedOccupancy);
+
+  std::cout << "[AtlasPacker] " << kSprites << " sprites 8-64px into "
+            << kPageSize << "x" << kPageSize << " pages" << std::endl;
+  std::cout << "  runtime order:  " << arrivalPages << " pages, "
+            << arrivalOccupancy * 100.0f << "% full, " << arrivalUs
+            << " us/insert" << std::endl;
+  std::cout << "  tallest first:  " << sortedPages << " pages, "
+            << sortedOccupancy * 100.0f << "% full, " << sortedUs
+            << " us/insert" << std::endl;
+  std::cout << "  texture binds for one pass over all sprites: " << kSprites
+            << " -> " << sortedPages << std::endl;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Skyline bottom-left rectangle packer. The packed area is kept as a list
+// of horizontal segments (the skyline); a rectangle goes where its top
+// ends lowest, ties to the narrowest segment, and raises the skyline
+// under it. Cheap enough to insert one image at a time at runtime, and
+// close to MaxRects on sprite sets when they are inserted tallest first.
+class AtlasPacker {
+ private:
+  struct Segment {
+    unsigned int X, Y, Width;
+  };
+
+  std::vector<Segment> m_Skyline;
+  unsigned int m_Width, m_Height;
+  size_t m_UsedArea;
+
+ public:
+  AtlasPacker(unsigned int width, unsigned int height);
+
+  // false when it doesn't fit anywhere
+  bool Insert(unsigned int width, unsigned int height, unsigned int& x,
+              unsigned int& y);
+  void Clear();
+
+  inline unsigned int GetWidth() const { return m_Width; }
+  inline unsigned int GetHeight() const { return m_Height; }
+  // used area / total area
+  float GetOccupancy() const;
+
+  // pack random sprite sized rectangles, print occupancy and timings
+  static void Benchmark();
+
+ private:
+  // top of a width wide rectangle placed on segment `index`, or ~0u
+  unsigned int Fit(unsigned int index, unsigned int width,
+                   unsigned int height) const;
+};
@@ -0,0 +1,147 @@
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "AtlasFile.h"
+#include "AtlasPacker.h"
+#include "SelfTest.h"
+#include "TextureAtlas.h"
+
+namespace {
+
+struct Rect {
+  unsigned int X, Y, Width, Height;
+};
+
+bool Overlap(const Rect& a, const Rect& b) {
+  return a.X < b.X + b.Width && b.X < a.X + a.Width && a.Y < b.Y + b.Height &&
+         b.Y < a.Y + a.Height;
+}
+
+// a 4x4 atlas without mips holding one entry
+struct TestAtlas {
+  AtlasFileHeader Header;
+  AtlasFileEntry Entry;
+  char Names[4];
+  unsigned char Padding[4];
+  unsigned char Pixels[4 * 4 * 4];
+};
+
+TestAtlas MakeAtlas() {
+  static_assert(offsetof(TestAtlas, Pixels) % kAtlasFileAlignment == 0,
+                "pixel block must be aligned");
+  TestAtlas atlas;
+  memset(&atlas, 0, sizeof(atlas));
+  AtlasFileHeader& header = atlas.Header;
+  memcpy(header.Magic, kAtlasFileMagic, 4);
+  header.Version = kAtlasFileVersion;
+  header.Width = 4;
+  header.Height = 4;
+  header.Levels = 1;
+  header.EntryCount = 1;
+  header.NameBytes = sizeof(atlas.Names);
+  header.PixelOffset = offsetof(TestAtlas, Pixels);
+  header.PixelBytes = sizeof(atlas.Pixels);
+  atlas.Entry = AtlasFileEntry{0, 4, 0, 0, 4, 4, {0, 0}, {1, 1}};
+  memcpy(atlas.Names, "tile", 4);
+  memset(atlas.Pixels, 0xff, sizeof(atlas.Pixels));
+  return atlas;
+}
+
+// write the test atlas after `change` and load it into a one level atlas
+bool Loads(const std::string& name,
+           const std::function<void(TestAtlas&)>& change,
+           size_t size = sizeof(TestAtlas)) {
+  TestAtlas file = MakeAtlas();
+  change(file);
+  TextureAtlas atlas(64, 1);
+  return atlas.Load(SelfTest::WriteFile(name + ".atlas", &file, size)) &&
+         atlas.Find("tile").IsValid();
+}
+
+}  // namespace
+
+void SelfTest::AtlasTests() {
+  // sprite sized rectangles until the page is full: every one inside the
+  // page, none on top of another, the used area adds up
+  {
+    AtlasPacker packer(256, 256);
+    std::vector<Rect> placed;
+    size_t area = 0;
+    unsigned int seed = 12345;
+    for (unsigned int i = 0; i < 400; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      unsigned int width = 4 + (seed >> 8) % 29;
+      seed = seed * 1664525u + 1013904223u;
+      unsigned int height = 4 + (seed >> 8) % 29;
+      Rect rect = {0, 0, width, height};
+      if (!packer.Insert(width, height, rect.X, rect.Y)) continue;
+      placed.push_back(rect);
+      area += (size_t)width * height;
+    }
+    EXPECT(placed.size() > 50 && placed.size() < 400);
+    bool inside = true, disjoint = true;
+    for (size_t i = 0; i < placed.size(); i++) {
+      inside = inside && placed[i].X + placed[i].Width <= 256 &&
+               placed[i].Y + placed[i].Height <= 256;
+      for (size_t j = i + 1; j < placed.size(); j++)
+        disjoint = disjoint && !Overlap(placed[i], placed[j]);
+    }
+    EXPECT(inside);
+    EXPECT(disjoint);
+    EXPECT(packer.GetOccupancy() == (float)area / (256.0f * 256.0f));
+  }
+
+  // what can't fit is turned down, also sizes that would wrap the sums
+  {
+    AtlasPacker packer(256, 256);
+    unsigned int x, y;
+    EXPECT(!packer.Insert(257, 1, x, y));
+    EXPECT(!packer.Insert(1, 257, x, y));
+    EXPECT(!packer.Insert(0, 16, x, y));
+    EXPECT(packer.Insert(16, 16, x, y) && x == 0 && y == 0);
+    EXPECT(packer.Insert(16, 16, x, y) && x == 16 && y == 0);
+    EXPECT(!packer.Insert(0xFFFFFFF0, 1, x, y));
+    EXPECT(!packer.Insert(1, 0xFFFFFFF8, x, y));
+    EXPECT(packer.Insert(224, 256, x, y) && x == 32 && y == 0);
+    EXPECT(packer.Insert(32, 240, x, y) && x == 0 && y == 16);
+    EXPECT(!packer.Insert(1, 1, x, y));
+    EXPECT(packer.GetOccupancy() == 1.0f);
+    packer.Clear();
+    EXPECT(packer.Insert(256, 256, x, y));
+  }
+
+  EXPECT(Loads("good", [](TestAtlas&) {}));
+
+  // not an atlas, or built for other mips
+  EXPECT(!Loads("empty", [](TestAtlas&) {}, 0));
+  EXPECT(!Loads("short_header", [](TestAtlas&) {}, 20));
+  EXPECT(!Loads("magic", [](TestAtlas& a) { a.Header.Magic[0] = 'X'; }));
+  EXPECT(!Loads("version", [](TestAtlas& a) { a.Header.Version = 2; }));
+  EXPECT(!Loads("levels", [](TestAtlas& a) { a.Header.Levels = 2; }));
+
+  // tables and pixels past the end of the file
+  EXPECT(!Loads("truncated", [](TestAtlas&) {}, sizeof(TestAtlas) - 4));
+  EXPECT(!Loads("entry_count",
+                [](TestAtlas& a) { a.Header.EntryCount = 0xFFFFFFFF; }));
+  EXPECT(!Loads("name_bytes",
+                [](TestAtlas& a) { a.Header.NameBytes = 0xFFFFFFFF; }));
+  EXPECT(!Loads("pixel_offset",
+                [](TestAtlas& a) { a.Header.PixelOffset = 1ull << 62; }));
+  EXPECT(!Loads("pixel_bytes",
+                [](TestAtlas& a) { a.Header.PixelBytes = ~0ull - 8; }));
+
+  // a size the pixel block doesn't hold, names outside the name block
+  EXPECT(!Loads("width", [](TestAtlas& a) { a.Header.Width = 8; }));
+  EXPECT(!Loads("no_height", [](TestAtlas& a) { a.Header.Height = 0; }));
+  EXPECT(!Loads("huge_size", [](TestAtlas& a) {
+    a.Header.Width = 0x10000000;
+    a.Header.Height = 0x10000000;
+    a.Header.PixelBytes = 0;
+  }));
+  EXPECT(!Loads("name_offset", [](TestAtlas& a) { a.Entry.NameOffset = 1; }));
+  EXPECT(!Loads("name_length",
+                [](TestAtlas& a) { a.Entry.NameLength = 0xFFFFFFFF; }));
+}
@@ -0,0 +1,172 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "GL/glew.h"
+
+namespace BlockCompression {
+
+namespace {
+
+// one channel of 16 texels, 8 bytes: two endpoints and 3 bit indices into
+// the 8 values between them
+void EncodeBC4(const unsigned char* values, unsigned char* block) {
+  unsigned char low = 255, high = 0;
+  for (unsigned int i = 0; i < 16; i++) {
+    low = std::min(low, values[i]);
+    high = std::max(high, values[i]);
+  }
+  // high > low selects the 8 value mode, index 0 = high, 1 = low, 2..7
+  // step from high to low
+  uint64_t indices = 0;
+  if (high > low) {
+    unsigned int range = high - low;
+    for (unsigned int i = 0; i < 16; i++) {
+      unsigned int t = ((values[i] - low) * 7 + range / 2) / range;
+      uint64_t index = t == 7 ? 0 : t == 0 ? 1 : 8 - t;
+      indices |= index << (3 * i);
+    }
+  }
+  block[0] = high;
+  block[1] = low;
+  for (unsigned int i = 0; i < 6; i++)
+    block[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+inline uint16_t To565(const int* color) {
+  return (uint16_t)(((color[0] * 31 + 127) / 255) << 11 |
+                    ((color[1] * 63 + 127) / 255) << 5 |
+                    ((color[2] * 31 + 127) / 255));
+}
+
+inline void From565(uint16_t packed, int* color) {
+  color[0] = ((packed >> 11) & 31) * 255 / 31;
+  color[1] = ((packed >> 5) & 63) * 255 / 63;
+  color[2] = (packed & 31) * 255 / 31;
+}
+
+// RGB of 16 texels (4 bytes apart), 8 bytes: two 565 endpoints and 2 bit
+// indices into the 4 colours on the line between them
+void EncodeBC1(const unsigned char* texels, unsigned char* block) {
+  int low[3] = {255, 255, 255}, high[3] = {0, 0, 0};
+  for (unsigned int i = 0; i < 16; i++) {
+    for (unsigned int c = 0; c < 3; c++) {
+      low[c] = std::min(low[c], (int)texels[i * 4 + c]);
+      high[c] = std::max(high[c], (int)texels[i * 4 + c]);
+    }
+  }
+  // pulled in a little, the box corners are rarely on the colour line
+  for (unsigned int c = 0; c < 3; c++) {
+    int inset = (high[c] - low[c]) / 16;
+    low[c] += inset;
+    high[c] -= inset;
+  }
+  // the box diagonal the colours lie along: red and blue flip when they
+  // fall as green rises
+  int covarianceRG = 0, covarianceBG = 0;
+  for (unsigned int i = 0; i < 16; i++) {
+    int g = texels[i * 4 + 1] * 2 - (low[1] + high[1]);
+    covarianceRG += (texels[i * 4] * 2 - (low[0] + high[0])) * g;
+    covarianceBG += (texels[i * 4 + 2] * 2 - (low[2] + high[2])) * g;
+  }
+  if (covarianceRG < 0) std::swap(low[0], high[0]);
+  if (covarianceBG < 0) std::swap(low[2], high[2]);
+  // color0 > color1 is the 4 colour mode, equal ones a flat block of
+  // index 0
+  uint16_t color0 = To565(high), color1 = To565(low);
+  if (color0 < color1) std::swap(color0, color1);
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    int end0[3], end1[3], axis[3];
+    From565(color0, end0);
+    From565(color1, end1);
+    int length = 0;
+    for (unsigned int c = 0; c < 3; c++) {
+      axis[c] = end0[c] - end1[c];
+      length += axis[c] * axis[c];
+    }
+    for (unsigned int i = 0; i < 16; i++) {
+      int dot = 0;
+      for (unsigned int c = 0; c < 3; c++)
+        dot += (texels[i * 4 + c] - end1[c]) * axis[c];
+      // 0 at color1 .. 3 at color0, index 2 is 2/3 of the way to color0
+      int t = std::max(0, std::min(3, (dot * 3 + length / 2) / length));
+      static const uint32_t kIndex[4] = {1, 3, 2, 0};
+      indices |= kIndex[t] << (2 * i);
+    }
+  }
+  std::memcpy(block, &color0, 2);
+  std::memcpy(block + 2, &color1, 2);
+  std::memcpy(block + 4, &indices, 4);
+}
+
+}  // namespace
+
+unsigned int GetCompressedFormat(unsigned int internalFormat) {
+  bool s3tc = GLEW_EXT_texture_compression_s3tc != 0;
+  switch (internalFormat) {
+    case GL_R8:
+      return GL_COMPRESSED_RED_RGTC1;
+    case GL_RG8:
+      return GL_COMPRESSED_RG_RGTC2;
+    case GL_RGB8:
+      return s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+    case GL_RGBA8:
+      return s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+    case GL_SRGB8:
+      return s3tc && GLEW_EXT_texture_sRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                                           : 0;
+    case GL_SRGB8_ALPHA8:
+      return s3tc && GLEW_EXT_texture_sRGB
+                 ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                 : 0;
+    default:
+      return 0;
+  }
+}
+
+void Compress(const unsigned char* source, unsigned int width,
+              unsigned int height, unsigned int channels,
+              unsigned int compressedFormat, unsigned char* destination) {
+  for (unsigned int by = 0; by < height; by += 4) {
+    for (unsigned int bx = 0; bx < width; bx += 4) {
+      // the block as RGBA, then split into what the format encodes
+      unsigned char texels[16 * 4];
+      for (unsigned int i = 0; i < 16; i++) {
+        unsigned int x = std::min(bx + i % 4, width - 1);
+        unsigned int y = std::min(by + i / 4, height - 1);
+        const unsigned char* texel =
+            source + ((size_t)y * width + x) * channels;
+        for (unsigned int c = 0; c < 4; c++)
+          texels[i * 4 + c] = c < channels ? texel[c] : 255;
+      }
+      unsigned char channel[16];
+      switch (compressedFormat) {
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_RG_RGTC2:
+          for (unsigned int c = 0; c < channels; c++) {
+            for (unsigned int i = 0; i < 16; i++)
+              channel[i] = texels[i * 4 + c];
+            EncodeBC4(channel, destination);
+            destination += 8;
+          }
+          break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+          for (unsigned int i = 0; i < 16; i++) channel[i] = texels[i * 4 + 3];
+          EncodeBC4(channel, destination);
+          EncodeBC1(texels, destination + 8);
+          destination += 16;
+          break;
+        default:  // BC1
+          EncodeBC1(texels, destination);
+          destination += 8;
+          break;
+      }
+    }
+  }
+}
+
+}  // namespace BlockCompression
@@ -0,0 +1,20 @@
+#pragma once
+
+// BCn encoders for textures compressed ahead of time, e.g. by the
+// TextureCache. Endpoints are the block's bounding box, which is fast and
+// good enough for colour maps; normal maps would want a better fit.
+namespace BlockCompression {
+
+// the compressed format for R8 / RG8 / RGB8 / RGBA8 and their sRGB
+// versions, 0 if there is none or the GL can't sample it: BC4 and BC5
+// (RGTC) are core, BC1 and BC3 need EXT_texture_compression_s3tc
+unsigned int GetCompressedFormat(unsigned int internalFormat);
+
+// width x height texels of `channels` bytes into
+// TextureFormat::GetImageBytes(width, height, compressedFormat) bytes, the
+// last row / column repeats to fill partial blocks
+void Compress(const unsigned char* source, unsigned int width,
+              unsigned int height, unsigned int channels,
+              unsigned int compressedFormat, unsigned char* destination);
+
+}  // namespace BlockCompression
@@ -0,0 +1,649 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "Log.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+
+const int kBins = 16;
+// subtrees larger than this are built as their own job
+const unsigned int kParallelBuildSize = 8192;
+const int kMaxParallelDepth = 3;
+
+float SurfaceArea(const glm::vec3& min, const glm::vec3& max) {
+  glm::vec3 d = max - min;
+  return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool Contains(const BvhNode& node, const glm::vec3& min,
+              const glm::vec3& max) {
+  return glm::all(glm::lessThanEqual(node.Min, min)) &&
+         glm::all(glm::lessThanEqual(max, node.Max));
+}
+
+// inputs of a top down build over a snapshot of object boxes
+struct BuildContext {
+  const std::vector<glm::vec3>* Mins;
+  const std::vector<glm::vec3>* Maxs;
+  const std::vector<unsigned int>* Ids;
+  std::vector<unsigned int> Refs;
+  std::vector<BvhNode>* Nodes;
+  std::atomic<int> Next;
+};
+
+int BuildNode(BuildContext& ctx, unsigned int begin, unsigned int end,
+              int parent, int depth) {
+  int index = ctx.Next.fetch_add(1);
+  const std::vector<glm::vec3>& mins = *ctx.Mins;
+  const std::vector<glm::vec3>& maxs = *ctx.Maxs;
+
+  BvhNode node;
+  node.Parent = parent;
+  node.Object = -1;
+  node.Min = mins[ctx.Refs[begin]];
+  node.Max = maxs[ctx.Refs[begin]];
+  glm::vec3 centroidMin = (node.Min + node.Max) * 0.5f;
+  glm::vec3 centroidMax = centroidMin;
+  for (unsigned int i = begin + 1; i < end; i++) {
+    unsigned int r = ctx.Refs[i];
+    node.Min = glm::min(node.Min, mins[r]);
+    node.Max = glm::max(node.Max, maxs[r]);
+    glm::vec3 c = (mins[r] + maxs[r]) * 0.5f;
+    centroidMin = glm::min(centroidMin, c);
+    centroidMax = glm::max(centroidMax, c);
+  }
+
+  if (end - begin == 1) {
+    node.Object = (int)(*ctx.Ids)[ctx.Refs[begin]];
+    node.Child[0] = node.Child[1] = -1;
+    (*ctx.Nodes)[index] = node;
+    return index;
+  }
+
+  // bin centroids along the widest axis and take the cheapest SAH split
+  glm::vec3 extent = centroidMax - centroidMin;
+  int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                 : (extent.y > extent.z ? 1 : 2);
+  unsigned int mid = (begin + end) / 2;
+
+  if (extent[axis] > 0.0f) {
+    float scale = kBins / extent[axis];
+    unsigned int counts[kBins] = {};
+    glm::vec3 binMin[kBins], binMax[kBins];
+    for (int b = 0; b < kBins; b++) {
+      binMin[b] = glm::vec3(1e30f);
+      binMax[b] = glm::vec3(-1e30f);
+    }
+    auto binOf = [&](unsigned int r) {
+      float c = (mins[r][axis] + maxs[r][axis]) * 0.5f;
+      return std::min(kBins - 1, (int)((c - centroidMin[axis]) * scale));
+    };
+    for (unsigned int i = begin; i < end; i++) {
+      unsigned int r = ctx.Refs[i];
+      int b = binOf(r);
+      counts[b]++;
+      binMin[b] = glm::min(binMin[b], mins[r]);
+      binMax[b] = glm::max(binMax[b], maxs[r]);
+    }
+
+    // sweep from the right to get the cost of every right hand side
+    float rightCost[kBins];
+    glm::vec3 accMin(1e30f), accMax(-1e30f);
+    unsigned int accCount = 0;
+    for (int b = kBins - 1; b > 0; b--) {
+      accMin = glm::min(accMin, binMin[b]);
+      accMax = glm::max(accMax, binMax[b]);
+      accCount += counts[b];
+      rightCost[b] = accCount ? SurfaceArea(accMin, accMax) * accCount : 0.0f;
+    }
+    float bestCost = 1e30f;
+    int bestSplit = -1;
+    accMin = glm::vec3(1e30f);
+    accMax = glm::vec3(-1e30f);
+    accCount = 0;
+    for (int b = 0; b < kBins - 1; b++) {
+      accMin = glm::min(accMin, binMin[b]);
+      accMax = glm::max(accMax, binMax[b]);
+      accCount += counts[b];
+      if (accCount == 0 || accCount == end - begin) continue;
+      float cost = SurfaceArea(accMin, accMax) * accCount + rightCost[b + 1];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestSplit = b;
+      }
+    }
+
+    if (bestSplit >= 0) {
+      auto split = std::partition(
+          ctx.Refs.begin() + begin, ctx.Refs.begin() + end,
+          [&](unsigned int r) { return binOf(r) <= bestSplit; });
+      mid = (unsigned int)(split - ctx.Refs.begin());
+    }
+  }
+  if (mid == begin || mid == end) mid = (begin + end) / 2;
+
+  if (end - begin > kParallelBuildSize && depth < kMaxParallelDepth) {
+    JobSystem& jobs = JobSystem::Get();
+    JobCounter counter;
+    int left = -1;
+    jobs.Run([&]() { left = BuildNode(ctx, begin, mid, index, depth + 1); },
+             &counter);
+    node.Child[1] = BuildNode(ctx, mid, end, index, depth + 1);
+    jobs.Wait(counter);
+    node.Child[0] = left;
+  } else {
+    node.Child[0] = BuildNode(ctx, begin, mid, index, depth + 1);
+    node.Child[1] = BuildNode(ctx, mid, end, index, depth + 1);
+  }
+  (*ctx.Nodes)[index] = node;
+  return index;
+}
+
+bool RayBox(const glm::vec3& origin, const glm::vec3& inverse,
+            const glm::vec3& min, const glm::vec3& max, float maxDistance,
+            float& distance) {
+  glm::vec3 t0 = (min - origin) * inverse;
+  glm::vec3 t1 = (max - origin) * inverse;
+  glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+  float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+  float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+  distance = enter;
+  return enter <= exit;
+}
+
+enum class Containment { Outside, Intersecting, Inside };
+
+Containment Classify(const Frustum& frustum, const glm::vec3& min,
+                     const glm::vec3& max) {
+  glm::vec3 center = (min + max) * 0.5f;
+  glm::vec3 extent = (max - min) * 0.5f;
+  Containment result = Containment::Inside;
+  for (const glm::vec4& plane : frustum.Planes) {
+    float d = glm::dot(glm::vec3(plane), center) + plane.w;
+    float r = glm::dot(glm::abs(glm::vec3(plane)), extent);
+    if (d + r < 0.0f) return Containment::Outside;
+    if (d - r < 0.0f) result = Containment::Intersecting;
+  }
+  return result;
+}
+
+}  // namespace
+
+Bvh::Bvh(float margin)
+    : m_Root(-1),
+      m_FreeNode(-1),
+      m_ObjectCount(0),
+      m_Margin(margin),
+      m_MovedSinceRebuild(0) {}
+
+Bvh::~Bvh() {
+  if (m_Build) JobSystem::Get().Wait(m_Build->Done);
+}
+
+int Bvh::AllocateNode() {
+  if (m_FreeNode < 0) {
+    m_Nodes.push_back(BvhNode());
+    m_Nodes.back().Parent = m_FreeNode;
+    m_FreeNode = (int)m_Nodes.size() - 1;
+  }
+  int node = m_FreeNode;
+  m_FreeNode = m_Nodes[node].Parent;
+  m_Nodes[node].Parent = -1;
+  m_Nodes[node].Object = -1;
+  m_Nodes[node].Child[0] = m_Nodes[node].Child[1] = -1;
+  return node;
+}
+
+void Bvh::FreeNode(int node) {
+  m_Nodes[node].Parent = m_FreeNode;
+  m_Nodes[node].Object = -2;  // marks free nodes for GetNodeCount
+  m_FreeNode = node;
+}
+
+void Bvh::Refit(int node) {
+  // walk up until a box stops changing
+  while (node >= 0) {
+    BvhNode& n = m_Nodes[node];
+    glm::vec3 min = glm::min(m_Nodes[n.Child[0]].Min, m_Nodes[n.Child[1]].Min);
+    glm::vec3 max = glm::max(m_Nodes[n.Child[0]].Max, m_Nodes[n.Child[1]].Max);
+    if (min == n.Min && max == n.Max) break;
+    n.Min = min;
+    n.Max = max;
+    node = n.Parent;
+  }
+}
+
+void Bvh::InsertLeaf(int leaf) {
+  if (m_Root < 0) {
+    m_Root = leaf;
+    m_Nodes[leaf].Parent = -1;
+    return;
+  }
+
+  // descend towards the child whose box grows the least (SAH greedy)
+  glm::vec3 min = m_Nodes[leaf].Min, max = m_Nodes[leaf].Max;
+  int index = m_Root;
+  while (!m_Nodes[index].IsLeaf()) {
+    const BvhNode& node = m_Nodes[index];
+    float area = SurfaceArea(node.Min, node.Max);
+    float combined =
+        SurfaceArea(glm::min(node.Min, min), glm::max(node.Max, max));
+    float cost = 2.0f * combined;
+    float inheritance = 2.0f * (combined - area);
+
+    float childCost[2];
+    for (int c = 0; c < 2; c++) {
+      const BvhNode& child = m_Nodes[node.Child[c]];
+      float grown =
+          SurfaceArea(glm::min(child.Min, min), glm::max(child.Max, max));
+      childCost[c] = (child.IsLeaf() ? grown
+                                     : grown - SurfaceArea(child.Min, child.Max)) +
+                     inheritance;
+    }
+    if (cost < childCost[0] && cost < childCost[1]) break;
+    index = node.Child[childCost[0] < childCost[1] ? 0 : 1];
+  }
+
+  int sibling = index;
+  int oldParent = m_Nodes[sibling].Parent;
+  int parent = AllocateNode();
+  m_Nodes[parent].Parent = oldParent;
+  m_Nodes[parent].Min = glm::min(m_Nodes[sibling].Min, min);
+  m_Nodes[parent].Max = glm::max(m_Nodes[sibling].Max, max);
+  m_Nodes[parent].Child[0] = sibling;
+  m_Nodes[parent].Child[1] = leaf;
+  m_Nodes[sibling].Parent = parent;
+  m_Nodes[leaf].Parent = parent;
+
+  if (oldParent < 0) {
+    m_Root = parent;
+  } else {
+    BvhNode& p = m_Nodes[oldParent];
+    p.Child[p.Child[0] == sibling ? 0 : 1] = parent;
+    Refit(oldParent);
+  }
+}
+
+void Bvh::RemoveLeaf(int leaf) {
+  if (leaf == m_Root) {
+    m_Root = -1;
+    return;
+  }
+  int parent = m_Nodes[leaf].Parent;
+  int grandParent = m_Nodes[parent].Parent;
+  int sibling = m_Nodes[parent].Child[m_Nodes[parent].Child[0] == leaf ? 1 : 0];
+
+  if (grandParent < 0) {
+    m_Root = sibling;
+    m_Nodes[sibling].Parent = -1;
+  } else {
+    BvhNode& g = m_Nodes[grandParent];
+    g.Child[g.Child[0] == parent ? 0 : 1] = sibling;
+    m_Nodes[sibling].Parent = grandParent;
+    Refit(grandParent);
+  }
+  FreeNode(parent);
+}
+
+unsigned int Bvh::Insert(const glm::vec3& min, const glm::vec3& max,
+                         unsigned int userData) {
+  unsigned int id;
+  if (!m_FreeObjects.empty()) {
+    id = m_FreeObjects.back();
+    m_FreeObjects.pop_back();
+  } else {
+    id = (unsigned int)m_Objects.size();
+    m_Objects.push_back(Object());
+  }
+  Object& object = m_Objects[id];
+  object.Min = min;
+  object.Max = max;
+  object.UserData = userData;
+  object.Alive = true;
+
+  int leaf = AllocateNode();
+  m_Nodes[leaf].Min = min - glm::vec3(m_Margin);
+  m_Nodes[leaf].Max = max + glm::vec3(m_Margin);
+  m_Nodes[leaf].Object = (int)id;
+  object.Leaf = leaf;
+  InsertLeaf(leaf);
+
+  m_ObjectCount++;
+  if (m_Build) m_ChangedDuringBuild.push_back(id);
+  return id;
+}
+
+void Bvh::Remove(unsigned int id) {
+  Object& object = m_Objects[id];
+  ASSERT(object.Alive);
+  RemoveLeaf(object.Leaf);
+  FreeNode(object.Leaf);
+  object.Alive = false;
+  object.Leaf = -1;
+  m_ObjectCount--;
+  // ids are only reused after a running build is applied
+  if (m_Build)
+    m_ChangedDuringBuild.push_back(id);
+  else
+    m_FreeObjects.push_back(id);
+}
+
+void Bvh::Move(unsigned int id, const glm::vec3& min, const glm::vec3& max) {
+  Object& object = m_Objects[id];
+  ASSERT(object.Alive);
+  object.Min = min;
+  object.Max = max;
+  if (m_Build) m_ChangedDuringBuild.push_back(id);
+
+  BvhNode& leaf = m_Nodes[object.Leaf];
+  if (Contains(leaf, min, max)) return;
+
+  // refit in place, the tree gets rebuilt once enough of this happened
+  leaf.Min = min - glm::vec3(m_Margin);
+  leaf.Max = max + glm::vec3(m_Margin);
+  if (leaf.Parent >= 0) Refit(leaf.Parent);
+  m_MovedSinceRebuild++;
+}
+
+void Bvh::Snapshot(std::vector<glm::vec3>& mins, std::vector<glm::vec3>& maxs,
+                   std::vector<unsigned int>& ids) const {
+  for (unsigned int id = 0; id < m_Objects.size(); id++) {
+    const Object& object = m_Objects[id];
+    if (!object.Alive) continue;
+    mins.push_back(object.Min - glm::vec3(m_Margin));
+    maxs.push_back(object.Max + glm::vec3(m_Margin));
+    ids.push_back(id);
+  }
+}
+
+void Bvh::RebuildAsync() {
+  if (m_Build) return;
+
+  // snapshot the boxes, the build only touches its own copies
+  auto mins = std::make_shared<std::vector<glm::vec3>>();
+  auto maxs = std::make_shared<std::vector<glm::vec3>>();
+  auto ids = std::make_shared<std::vector<unsigned int>>();
+  Snapshot(*mins, *maxs, *ids);
+  m_ChangedDuringBuild.clear();
+  m_MovedSinceRebuild = 0;
+
+  m_Build.reset(new PendingBuild());
+  BuildResult* output = &m_Build->Result;
+  JobSystem::Get().Run([mins, maxs, ids, output]() {
+    BuildResult& result = *output;
+    result.Root = -1;
+    if (ids->empty()) return;
+
+    BuildContext ctx;
+    ctx.Mins = mins.get();
+    ctx.Maxs = maxs.get();
+    ctx.Ids = ids.get();
+    ctx.Refs.resize(ids->size());
+    for (unsigned int i = 0; i < ids->size(); i++) ctx.Refs[i] = i;
+    result.Nodes.resize(ids->size() * 2 - 1);
+    ctx.Nodes = &result.Nodes;
+    ctx.Next = 0;
+    result.Root = BuildNode(ctx, 0, (unsigned int)ids->size(), -1, 0);
+  }, &m_Build->Done);
+}
+
+void Bvh::ApplyBuild(BuildResult& result) {
+  m_Nodes.swap(result.Nodes);
+  m_Root = result.Root;
+  m_FreeNode = -1;
+
+  std::vector<char> inTree(m_Objects.size(), 0);
+  for (unsigned int i = 0; i < m_Nodes.size(); i++) {
+    if (!m_Nodes[i].IsLeaf()) continue;
+    m_Objects[m_Nodes[i].Object].Leaf = (int)i;
+    inTree[m_Nodes[i].Object] = 1;
+  }
+
+  // replay what changed while the build ran
+  std::sort(m_ChangedDuringBuild.begin(), m_ChangedDuringBuild.end());
+  m_ChangedDuringBuild.erase(
+      std::unique(m_ChangedDuringBuild.begin(), m_ChangedDuringBuild.end()),
+      m_ChangedDuringBuild.end());
+  for (unsigned int id : m_ChangedDuringBuild) {
+    Object& object = m_Objects[id];
+    if (!object.Alive) {
+      if (inTree[id]) {
+        RemoveLeaf(object.Leaf);
+        FreeNode(object.Leaf);
+      }
+      object.Leaf = -1;
+      m_FreeObjects.push_back(id);
+    } else if (!inTree[id]) {
+      int leaf = AllocateNode();
+      m_Nodes[leaf].Min = object.Min - glm::vec3(m_Margin);
+      m_Nodes[leaf].Max = object.Max + glm::vec3(m_Margin);
+      m_Nodes[leaf].Object = (int)id;
+      object.Leaf = leaf;
+      InsertLeaf(leaf);
+    } else if (!Contains(m_Nodes[object.Leaf], object.Min, object.Max)) {
+      BvhNode& leaf = m_Nodes[object.Leaf];
+      leaf.Min = object.Min - glm::vec3(m_Margin);
+      leaf.Max = object.Max + glm::vec3(m_Margin);
+      if (leaf.Parent >= 0) Refit(leaf.Parent);
+    }
+  }
+  m_ChangedDuringBuild.clear();
+}
+
+void Bvh::Update() {
+  if (m_Build) {
+    // without background workers nobody else would ever run it
+    JobSystem& jobs = JobSystem::Get();
+    if (jobs.GetWorkerCount() == 1) jobs.Wait(m_Build->Done);
+    if (m_Build->Done.Value.load(std::memory_order_acquire) > 0) return;
+    std::unique_ptr<PendingBuild> build = std::move(m_Build);
+    ApplyBuild(build->Result);
+    return;
+  }
+  if (m_MovedSinceRebuild > m_ObjectCount / 4 && m_ObjectCount > 0)
+    RebuildAsync();
+}
+
+void Bvh::Rebuild() {
+  RebuildAsync();
+  if (!m_Build) return;
+  JobSystem::Get().Wait(m_Build->Done);
+  std::unique_ptr<PendingBuild> build = std::move(m_Build);
+  ApplyBuild(build->Result);
+}
+
+void Bvh::Cull(const Frustum& frustum,
+               std::vector<unsigned int>& visible) const {
+  if (m_Root < 0) return;
+  std::vector<int> stack;
+  stack.reserve(64);
+  // second stack entry: 1 when the parent was fully inside
+  std::vector<int> inside;
+  inside.reserve(64);
+  stack.push_back(m_Root);
+  inside.push_back(0);
+
+  while (!stack.empty()) {
+    int index = stack.back();
+    int allInside = inside.back();
+    stack.pop_back();
+    inside.pop_back();
+    const BvhNode& node = m_Nodes[index];
+
+    if (!allInside) {
+      Containment c = Classify(frustum, node.Min, node.Max);
+      if (c == Containment::Outside) continue;
+      allInside = c == Containment::Inside;
+    }
+    if (node.IsLeaf()) {
+      const Object& object = m_Objects[node.Object];
+      // the fat box touched the frustum, check the real one
+      if (allInside ||
+          Classify(frustum, object.Min, object.Max) != Containment::Outside)
+        visible.push_back(object.UserData);
+      continue;
+    }
+    stack.push_back(node.Child[0]);
+    inside.push_back(allInside);
+    stack.push_back(node.Child[1]);
+    inside.push_back(allInside);
+  }
+}
+
+bool Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction,
+                  float maxDistance, BvhRayHit& hit) const {
+  if (m_Root < 0) return false;
+  // divisions by zero give infinities, which the slab test handles
+  glm::vec3 inverse = 1.0f / direction;
+  float closest = maxDistance;
+  bool found = false;
+
+  std::vector<int> stack;
+  stack.reserve(64);
+  stack.push_back(m_Root);
+  while (!stack.empty()) {
+    const BvhNode& node = m_Nodes[stack.back()];
+    stack.pop_back();
+    float distance;
+    if (!RayBox(origin, inverse, node.Min, node.Max, closest, distance))
+      continue;
+
+    if (node.IsLeaf()) {
+      const Object& object = m_Objects[node.Object];
+      if (RayBox(origin, inverse, object.Min, object.Max, closest, distance)) {
+        closest = distance;
+        hit.UserData = object.UserData;
+        hit.Distance = distance;
+        found = true;
+      }
+      continue;
+    }
+    // visit the nearer child first so `closest` shrinks early
+    float d0, d1;
+    const BvhNode& c0 = m_Nodes[node.Child[0]];
+    const BvhNode& c1 = m_Nodes[node.Child[1]];
+    bool h0 = RayBox(origin, inverse, c0.Min, c0.Max, closest, d0);
+    bool h1 = RayBox(origin, inverse, c1.Min, c1.Max, closest, d1);
+    if (h0 && h1) {
+      stack.push_back(d0 < d1 ? node.Child[1] : node.Child[0]);
+      stack.push_back(d0 < d1 ? node.Child[0] : node.Child[1]);
+    } else if (h0) {
+      stack.push_back(node.Child[0]);
+    } else if (h1) {
+      stack.push_back(node.Child[1]);
+    }
+  }
+  return found;
+}
+
+unsigned int Bvh::GetNodeCount() const {
+  unsigned int count = 0;
+  for (const BvhNode& node : m_Nodes) count += node.Object != -2;
+  return count;
+}
+
+size_t Bvh::GetMemoryUsage() const {
+  return m_Nodes.capacity() * sizeof(BvhNode) +
+         m_Objects.capacity() * sizeof(Object) +
+         m_FreeObjects.capacity() * sizeof(unsigned int);
+}
+
+float Bvh::GetSahCost() const {
+  if (m_Root < 0) return 0.0f;
+  float root = SurfaceArea(m_Nodes[m_Root].Min, m_Nodes[m_Root].Max);
+  float sum = 0.0f;
+  std::vector<int> stack(1, m_Root);
+  while (!stack.empty()) {
+    const BvhNode& node = m_Nodes[stack.back()];
+    stack.pop_back();
+    sum += SurfaceArea(node.Min, node.Max);
+    if (!node.IsLeaf()) {
+      stack.push_back(node.Child[0]);
+      stack.push_back(node.Child[1]);
+    }
+  }
+  return root > 0.0f ? sum / root : 0.0f;
+}
+
+void Bvh::Benchmark(unsigned int objectCount) {
+  typedef std::chrono::high_resolution_clock Clock;
+  auto ms = [](Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  };
+
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> size(0.5f, 3.0f);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+  Bvh bvh;
+  std::vector<glm::vec3> centers(objectCount);
+  auto start = Clock::now();
+  for (unsigned int i = 0; i < objectCount; i++) {
+    centers[i] = glm::vec3(position(random), position(random), position(random));
+    glm::vec3 extent(size(random));
+    bvh.Insert(centers[i] - extent, centers[i] + extent, i);
+  }
+  double insert = ms(start);
+  float insertCost = bvh.GetSahCost();
+
+  start = Clock::now();
+  bvh.Rebuild();
+  double rebuild = ms(start);
+  std::cout << "[Bvh] " << objectCount << " objects: insert " << insert
+            << " ms (SAH " << insertCost << "), rebuild " << rebuild
+            << " ms (SAH " << bvh.GetSahCost() << "), " << bvh.GetNodeCount()
+            << " nodes, " << sizeof(BvhNode) << " bytes/node, "
+            << bvh.GetMemoryUsage() / 1024 << " KB total" << std::endl;
+
+  // move 10% of the objects by a few units
+  start = Clock::now();
+  for (unsigned int i = 0; i < objectCount / 10; i++) {
+    unsigned int id = random() % objectCount;
+    centers[id] += glm::vec3(unit(random), unit(random), unit(random)) * 5.0f;
+    glm::vec3 extent(1.0f);
+    bvh.Move(id, centers[id] - extent, centers[id] + extent);
+  }
+  std::cout << "[Bvh] moved " << objectCount / 10 << " objects in "
+            << ms(start) << " ms (SAH " << bvh.GetSahCost() << ")"
+            << std::endl;
+
+  const int kFrustumQueries = 100;
+  std::vector<unsigned int> visible;
+  start = Clock::now();
+  for (int q = 0; q < kFrustumQueries; q++) {
+    glm::vec3 eye(position(random), position(random), position(random));
+    glm::mat4 viewProjection =
+        glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 200.0f) *
+        glm::lookAt(eye, eye + glm::vec3(unit(random), unit(random), 1.0f),
+                    glm::vec3(0.0f, 1.0f, 0.0f));
+    visible.clear();
+    bvh.Cull(Frustum::FromMatrix(viewProjection), visible);
+  }
+  double cull = ms(start);
+
+  const int kRays = 100000;
+  unsigned int hits = 0;
+  start = Clock::now();
+  for (int r = 0; r < kRays; r++) {
+    BvhRayHit hit;
+    glm::vec3 origin(position(random), position(random), position(random));
+    hits += bvh.Raycast(origin,
+                        glm::vec3(unit(random), unit(random), unit(random)),
+                        1000.0f, hit);
+  }
+  double rays = ms(start);
+
+  std::cout << "[Bvh] frustum queries: " << kFrustumQueries * 1000.0 / cull
+            << "/s, rays: " << kRays / rays * 1000.0 << "/s (" << hits
+            << " hits)" << std::endl;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "glm/glm.hpp"
+
+struct BvhNode {
+  glm::vec3 Min;
+  int Parent;
+  glm::vec3 Max;
+  int Object;  // -1 for internal nodes
+  int Child[2];
+
+  inline bool IsLeaf() const { return Object >= 0; }
+};
+
+struct BvhRayHit {
+  unsigned int UserData;
+  float Distance;
+};
+
+// Dynamic bounding volume hierarchy over scene objects. Leaves hold
+// enlarged ("fat") boxes, so small moves cost nothing; bigger moves refit
+// the path to the root. Refitting slowly degrades the tree, so after enough
+// moves Update() rebuilds it with binned SAH on JobSystem workers while the
+// old tree keeps answering queries.
+class Bvh {
+ private:
+  struct Object {
+    glm::vec3 Min, Max;  // tight bounds
+    int Leaf;
+    unsigned int UserData;
+    bool Alive;
+  };
+
+  struct BuildResult {
+    std::vector<BvhNode> Nodes;
+    int Root;
+  };
+
+  std::vector<BvhNode> m_Nodes;
+  int m_Root;
+  int m_FreeNode;  // free nodes are chained through Parent
+  std::vector<Object> m_Objects;
+  std::vector<unsigned int> m_FreeObjects;
+  unsigned int m_ObjectCount;
+  float m_Margin;
+  unsigned int m_MovedSinceRebuild;
+
+  // a background rebuild, null when none is running
+  struct PendingBuild {
+    JobCounter Done;
+    BuildResult Result;
+  };
+  std::unique_ptr<PendingBuild> m_Build;
+  std::vector<unsigned int> m_ChangedDuringBuild;
+
+ public:
+  Bvh(float margin = 0.1f);
+  ~Bvh();
+
+  unsigned int Insert(const glm::vec3& min, const glm::vec3& max,
+                      unsigned int userData);
+  void Remove(unsigned int object);
+  void Move(unsigned int object, const glm::vec3& min, const glm::vec3& max);
+
+  // Finish a background rebuild if one is ready, and start one once more
+  // than a quarter of the objects moved since the last.
+  void Update();
+  // blocking rebuild, still spread over the workers
+  void Rebuild();
+  void RebuildAsync();
+
+  // append the user data of objects intersecting the frustum
+  void Cull(const Frustum& frustum, std::vector<unsigned int>& visible) const;
+  // closest object box hit by the ray, direction need not be normalized
+  bool Raycast(const glm::vec3& origin, const glm::vec3& direction,
+               float maxDistance, BvhRayHit& hit) const;
+
+  inline unsigned int GetObjectCount() const { return m_ObjectCount; }
+  unsigned int GetNodeCount() const;
+  size_t GetMemoryUsage() const;
+  // sum of node surface areas relative to the root, lower is better
+  float GetSahCost() const;
+
+  static void Benchmark(unsigned int objectCount = 100000);
+
+ private:
+  int AllocateNode();
+  void FreeNode(int node);
+  void InsertLeaf(int leaf);
+  void RemoveLeaf(int leaf);
+  void Refit(int node);
+  void ApplyBuild(BuildResult& result);
+  void Snapshot(std::vector<glm::vec3>& mins, std::vector<glm::vec3>& maxs,
+                std::vector<unsigned int>& ids) const;
+};
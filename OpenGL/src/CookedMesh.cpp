@@ -0,0 +1,238 @@
+#include "CookedMesh.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "GL/glew.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+namespace {
+
+// 0 for types a cooked vertex can't have
+unsigned int GetComponentSize(unsigned int type) {
+  switch (type) {
+    case GL_FLOAT:
+    case GL_UNSIGNED_INT:
+      return 4;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+      return 2;
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+bool IndicesInRange(const unsigned char* indices, unsigned int count,
+                    unsigned int indexSize, unsigned int vertexCount) {
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int index = 0;
+    if (indexSize == 2) {
+      unsigned short index16;
+      memcpy(&index16, indices + i * 2, 2);
+      index = index16;
+    } else {
+      memcpy(&index, indices + i * 4, 4);
+    }
+    if (index >= vertexCount) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+CookedMesh::CookedMesh(const std::string& path)
+    : m_Path(path), m_Header(), m_FileSize(0), m_Valid(false),
+      m_Evictable(~0u) {
+  MappedFile file(path);
+  if (!file.IsValid()) return;
+
+  const unsigned char* data = file.GetData();
+  size_t size = file.GetSize();
+  m_FileSize = size;
+
+  MeshFileHeader header;
+  if (size < sizeof(header)) {
+    std::cout << "Invalid mesh file " << path << std::endl;
+    return;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.Magic, kMeshFileMagic, 4) != 0 ||
+      header.Version != kMeshFileVersion) {
+    std::cout << "Unsupported mesh file " << path << " (version "
+              << header.Version << ")" << std::endl;
+    return;
+  }
+
+  // 64 bit sums, nothing here can wrap
+  uint64_t tables =
+      sizeof(header) +
+      (uint64_t)header.AttributeCount * sizeof(MeshFileAttribute) +
+      (uint64_t)header.SubmeshCount * sizeof(MeshFileSubmesh) +
+      (uint64_t)header.LodCount * sizeof(MeshFileLod);
+  if (tables > size || header.VertexOffset > size ||
+      header.VertexSize > size - header.VertexOffset ||
+      header.IndexOffset > size ||
+      header.IndexSize > size - header.IndexOffset ||
+      header.VertexSize < (uint64_t)header.VertexCount * header.VertexStride) {
+    std::cout << "Truncated mesh file " << path << std::endl;
+    return;
+  }
+
+  const unsigned char* cursor = data + sizeof(header);
+  std::vector<MeshFileAttribute>& attributes = m_Attributes;
+  attributes.resize(header.AttributeCount);
+  memcpy(attributes.data(), cursor,
+         attributes.size() * sizeof(MeshFileAttribute));
+  cursor += attributes.size() * sizeof(MeshFileAttribute);
+
+  m_Submeshes.resize(header.SubmeshCount);
+  memcpy(m_Submeshes.data(), cursor,
+         m_Submeshes.size() * sizeof(MeshFileSubmesh));
+  cursor += m_Submeshes.size() * sizeof(MeshFileSubmesh);
+
+  m_Lods.resize(header.LodCount);
+  memcpy(m_Lods.data(), cursor, m_Lods.size() * sizeof(MeshFileLod));
+
+  // every range the tables point at has to lie inside the blocks
+  unsigned int indexSize = header.IndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+  unsigned int positionOffset = ~0u;
+  for (const MeshFileAttribute& attribute : attributes)
+    if (attribute.Location == 0) positionOffset = attribute.Offset;
+  bool valid = (header.IndexType == GL_UNSIGNED_SHORT ||
+                header.IndexType == GL_UNSIGNED_INT) &&
+               header.IndexSize == (uint64_t)header.IndexCount * indexSize &&
+               header.SubmeshCount > 0 && header.VertexCount > 0 &&
+               positionOffset != ~0u &&
+               (uint64_t)positionOffset + 3 * sizeof(float) <=
+                   header.VertexStride;
+  for (const MeshFileAttribute& attribute : attributes) {
+    unsigned int typeSize = GetComponentSize(attribute.Type);
+    valid = valid && typeSize > 0 && attribute.Count >= 1 &&
+            attribute.Count <= 4 &&
+            (uint64_t)attribute.Offset + typeSize * attribute.Count <=
+                header.VertexStride;
+  }
+  for (const MeshFileSubmesh& submesh : m_Submeshes)
+    valid = valid && submesh.LodCount > 0 &&
+            (uint64_t)submesh.FirstLod + submesh.LodCount <= header.LodCount;
+  for (const MeshFileLod& lod : m_Lods)
+    valid = valid &&
+            (uint64_t)lod.FirstIndex + lod.IndexCount <= header.IndexCount;
+  if (!valid) {
+    std::cout << "Invalid mesh file " << path << std::endl;
+    m_Submeshes.clear();
+    m_Lods.clear();
+    return;
+  }
+  // the whole index block goes to the GPU, not just the ranges the LODs use
+  if (!IndicesInRange(data + header.IndexOffset, header.IndexCount, indexSize,
+                      header.VertexCount)) {
+    std::cout << "Invalid mesh file " << path << " (index out of range)"
+              << std::endl;
+    m_Submeshes.clear();
+    m_Lods.clear();
+    return;
+  }
+
+  // meshlets of every submesh's full detail level, for cluster culling
+  const float* positions =
+      (const float*)(data + header.VertexOffset + positionOffset);
+  std::vector<unsigned int> indices;
+  std::vector<Meshlet> meshlets;
+  for (unsigned int i = 0; i < m_Submeshes.size(); i++) {
+    const MeshFileLod& lod = GetLod(i, 0);
+    indices.resize(lod.IndexCount);
+    const unsigned char* source =
+        data + header.IndexOffset + size_t(lod.FirstIndex) * indexSize;
+    for (unsigned int j = 0; j < lod.IndexCount; j++) {
+      if (indexSize == 2) {
+        unsigned short index;
+        memcpy(&index, source + j * 2, 2);
+        indices[j] = index;
+      } else {
+        memcpy(&indices[j], source + j * 4, 4);
+      }
+    }
+
+    BuildMeshlets(meshlets, indices.data(), lod.IndexCount, positions,
+                  header.VertexCount, header.VertexStride);
+    // meshlet ranges are relative to the LOD
+    for (Meshlet& meshlet : meshlets) meshlet.FirstIndex += lod.FirstIndex;
+    m_Meshlets.emplace_back(meshlets, indexSize);
+  }
+
+  m_Header = header;
+  Upload(data);
+  m_Valid = true;
+  m_Evictable = GpuMemory::Get().RegisterEvictable(
+      GpuMemoryCategory::VertexBuffer, header.VertexSize + header.IndexSize,
+      [this]() { Unload(); }, [this]() { Reload(); });
+}
+
+CookedMesh::~CookedMesh() {
+  if (m_Evictable != ~0u) GpuMemory::Get().UnregisterEvictable(m_Evictable);
+}
+
+const VertexArray& CookedMesh::GetVertexArray() const {
+  if (m_Evictable != ~0u) GpuMemory::Get().Touch(m_Evictable);
+  return *m_VAO;
+}
+
+const IndexBuffer& CookedMesh::GetIndexBuffer() const {
+  if (m_Evictable != ~0u) GpuMemory::Get().Touch(m_Evictable);
+  return *m_IndexBuffer;
+}
+
+void CookedMesh::Upload(const unsigned char* data) {
+  m_VertexBuffer.reset(
+      new VertexBuffer(data ? data + m_Header.VertexOffset : nullptr,
+                       (unsigned int)m_Header.VertexSize));
+  m_IndexBuffer.reset(
+      new IndexBuffer(data ? data + m_Header.IndexOffset : nullptr,
+                      m_Header.IndexCount, m_Header.IndexType));
+
+  m_VAO.reset(new VertexArray());
+  for (const MeshFileAttribute& attribute : m_Attributes) {
+    VertexBufferLayout layout;
+    layout.Push(attribute.Type, attribute.Count,
+                attribute.Normalized ? GL_TRUE : GL_FALSE, attribute.Offset);
+    layout.SetStride(m_Header.VertexStride);
+    m_VAO->AddBuffer(*m_VertexBuffer, layout, attribute.Location);
+  }
+  m_VAO->SetIndexBuffer(*m_IndexBuffer);
+}
+
+// the file may have changed since it was validated; one that no longer
+// matches gets buffers of the right size without contents
+void CookedMesh::Reload() {
+  MappedFile file(m_Path);
+  bool same = file.IsValid() && file.GetSize() == m_FileSize &&
+              memcmp(file.GetData(), &m_Header, sizeof(m_Header)) == 0 &&
+              IndicesInRange(file.GetData() + m_Header.IndexOffset,
+                             m_Header.IndexCount,
+                             m_Header.IndexType == GL_UNSIGNED_SHORT ? 2 : 4,
+                             m_Header.VertexCount);
+  if (!same)
+    std::cout << "[CookedMesh] " << m_Path << " changed on disk, not reloaded"
+              << std::endl;
+  Upload(same ? file.GetData() : nullptr);
+}
+
+void CookedMesh::Unload() {
+  m_VAO.reset();
+  m_VertexBuffer.reset();
+  m_IndexBuffer.reset();
+}
+
+const MeshFileLod& CookedMesh::GetLod(unsigned int submesh,
+                                      unsigned int level) const {
+  const MeshFileSubmesh& s = m_Submeshes[submesh];
+  ASSERT(s.LodCount > 0);
+  if (level >= s.LodCount) level = s.LodCount - 1;
+  return m_Lods[s.FirstLod + level];
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IndexBuffer.h"
+#include "MeshFile.h"
+#include "Meshlet.h"
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+
+// GPU side of a cooked .mesh file. The file is mapped only for the upload:
+// the vertex and index blocks are passed to glBufferData as they are.
+// Since the file can always be mapped again, the buffers are registered
+// with GpuMemory as evictable; the vertex and index blocks go together,
+// counted as vertex buffer memory.
+class CookedMesh {
+ private:
+  std::string m_Path;
+  MeshFileHeader m_Header;
+  std::vector<MeshFileAttribute> m_Attributes;
+  std::unique_ptr<VertexArray> m_VAO;
+  std::unique_ptr<VertexBuffer> m_VertexBuffer;
+  std::unique_ptr<IndexBuffer> m_IndexBuffer;
+  std::vector<MeshFileSubmesh> m_Submeshes;
+  std::vector<MeshFileLod> m_Lods;
+  std::vector<MeshletSet> m_Meshlets;  // of LOD 0, per submesh
+  size_t m_FileSize;
+  bool m_Valid;
+  unsigned int m_Evictable;  // GpuMemory id, ~0u if not registered
+
+ public:
+  CookedMesh(const std::string& path);
+  ~CookedMesh();
+  // the eviction callbacks point at this object
+  CookedMesh(const CookedMesh&) = delete;
+  CookedMesh& operator=(const CookedMesh&) = delete;
+
+  inline bool IsValid() const { return m_Valid; }
+  // count as a use, and upload the buffers again if they were evicted
+  const VertexArray& GetVertexArray() const;
+  const IndexBuffer& GetIndexBuffer() const;
+  inline size_t GetFileSize() const { return m_FileSize; }
+
+  inline unsigned int GetSubmeshCount() const {
+    return (unsigned int)m_Submeshes.size();
+  }
+  inline const MeshFileSubmesh& GetSubmesh(unsigned int submesh) const {
+    return m_Submeshes[submesh];
+  }
+  inline const MeshletSet& GetMeshlets(unsigned int submesh) const {
+    return m_Meshlets[submesh];
+  }
+  // level is clamped to the coarsest one the submesh has
+  const MeshFileLod& GetLod(unsigned int submesh, unsigned int level) const;
+
+ private:
+  // vertex and index blocks of the mapped file to buffers and a VAO
+  void Upload(const unsigned char* data);
+  void Reload();
+  void Unload();
+};
@@ -0,0 +1,116 @@
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "CookedMesh.h"
+#include "GL/glew.h"
+#include "MeshFile.h"
+#include "SelfTest.h"
+
+namespace {
+
+// one triangle with a second LOD, tables and blocks at the offsets the
+// cooker would pick
+struct TestMesh {
+  MeshFileHeader Header;
+  MeshFileAttribute Position;
+  MeshFileSubmesh Submesh;
+  MeshFileLod Lods[2];
+  unsigned char Padding0[12];
+  float Vertices[9];
+  unsigned char Padding1[12];
+  uint32_t Indices[6];
+};
+
+TestMesh MakeMesh() {
+  static_assert(offsetof(TestMesh, Vertices) % kMeshFileAlignment == 0,
+                "vertex block must be aligned");
+  static_assert(offsetof(TestMesh, Indices) % kMeshFileAlignment == 0,
+                "index block must be aligned");
+  TestMesh mesh;
+  memset(&mesh, 0, sizeof(mesh));
+  MeshFileHeader& header = mesh.Header;
+  memcpy(header.Magic, kMeshFileMagic, 4);
+  header.Version = kMeshFileVersion;
+  header.AttributeCount = 1;
+  header.SubmeshCount = 1;
+  header.LodCount = 2;
+  header.VertexCount = 3;
+  header.VertexStride = 3 * sizeof(float);
+  header.IndexType = GL_UNSIGNED_INT;
+  header.IndexCount = 6;
+  header.VertexOffset = offsetof(TestMesh, Vertices);
+  header.VertexSize = sizeof(mesh.Vertices);
+  header.IndexOffset = offsetof(TestMesh, Indices);
+  header.IndexSize = sizeof(mesh.Indices);
+  mesh.Position = MeshFileAttribute{0, GL_FLOAT, 3, 0, 0};
+  mesh.Submesh.FirstLod = 0;
+  mesh.Submesh.LodCount = 2;
+  mesh.Lods[0] = MeshFileLod{0, 3, 0.0f, 0};
+  mesh.Lods[1] = MeshFileLod{3, 3, 0.5f, 0};
+  float vertices[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  memcpy(mesh.Vertices, vertices, sizeof(vertices));
+  uint32_t indices[6] = {0, 1, 2, 0, 1, 2};
+  memcpy(mesh.Indices, indices, sizeof(indices));
+  return mesh;
+}
+
+// write the test mesh after `change` and load it
+bool Loads(const std::string& name,
+           const std::function<void(TestMesh&)>& change,
+           size_t size = sizeof(TestMesh)) {
+  TestMesh mesh = MakeMesh();
+  change(mesh);
+  CookedMesh cooked(SelfTest::WriteFile(name + ".mesh", &mesh, size));
+  return cooked.IsValid();
+}
+
+}  // namespace
+
+void SelfTest::CookedMeshTests() {
+  EXPECT(Loads("good", [](TestMesh&) {}));
+  {
+    TestMesh mesh = MakeMesh();
+    CookedMesh cooked(WriteFile("lods.mesh", &mesh, sizeof(mesh)));
+    EXPECT(cooked.IsValid() && cooked.GetSubmeshCount() == 1 &&
+           cooked.GetLod(0, 1).FirstIndex == 3);
+  }
+
+  // not a mesh file, or not one of this version
+  EXPECT(!Loads("empty", [](TestMesh&) {}, 0));
+  EXPECT(!Loads("short_header", [](TestMesh&) {}, 40));
+  EXPECT(!Loads("magic", [](TestMesh& m) { m.Header.Magic[0] = 'X'; }));
+  EXPECT(!Loads("version", [](TestMesh& m) { m.Header.Version = 2; }));
+
+  // blocks and tables past the end of the file
+  EXPECT(!Loads("truncated", [](TestMesh&) {}, sizeof(TestMesh) - 4));
+  EXPECT(!Loads("tables",
+                [](TestMesh& m) { m.Header.SubmeshCount = 0x10000000; }));
+  EXPECT(!Loads("index_offset",
+                [](TestMesh& m) { m.Header.IndexOffset = 1ull << 40; }));
+  EXPECT(!Loads("index_size",
+                [](TestMesh& m) { m.Header.IndexSize = ~0ull - 8; }));
+  EXPECT(!Loads("vertex_size", [](TestMesh& m) { m.Header.VertexCount = 4; }));
+  EXPECT(!Loads("index_count", [](TestMesh& m) { m.Header.IndexCount = 7; }));
+  EXPECT(!Loads("index_type",
+                [](TestMesh& m) { m.Header.IndexType = GL_FLOAT; }));
+
+  // tables pointing outside what they index
+  EXPECT(!Loads("lod_range", [](TestMesh& m) { m.Lods[1].IndexCount = 4; }));
+  EXPECT(!Loads("lod_wrap",
+                [](TestMesh& m) { m.Lods[1].FirstIndex = 0xFFFFFFFE; }));
+  EXPECT(!Loads("submesh_lods", [](TestMesh& m) { m.Submesh.LodCount = 3; }));
+  EXPECT(!Loads("no_lods", [](TestMesh& m) { m.Submesh.LodCount = 0; }));
+  EXPECT(!Loads("attribute_offset",
+                [](TestMesh& m) { m.Position.Offset = 4; }));
+  EXPECT(!Loads("attribute_count", [](TestMesh& m) { m.Position.Count = 5; }));
+  EXPECT(!Loads("attribute_type",
+                [](TestMesh& m) { m.Position.Type = GL_RGBA; }));
+  EXPECT(!Loads("no_position", [](TestMesh& m) { m.Position.Location = 1; }));
+
+  // indices past the vertex count, in the level meshlets are built from and
+  // in one only the GPU would read
+  EXPECT(!Loads("lod0_index", [](TestMesh& m) { m.Indices[2] = 3; }));
+  EXPECT(!Loads("lod1_index", [](TestMesh& m) { m.Indices[5] = 3; }));
+}
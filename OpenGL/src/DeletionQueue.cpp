@@ -0,0 +1,213 @@
+#include "DeletionQueue.h"
+
+#include <iostream>
+
+#include "GL/glew.h"
+#include "GpuMemory.h"
+
+const unsigned int DeletionQueue::kRecycleFrames;
+
+DeletionQueue::DeletionQueue()
+    : m_Frame(0), m_Retired(0), m_Recycling(false), m_Stats() {}
+
+DeletionQueue& DeletionQueue::Get() {
+  static DeletionQueue queue;
+  return queue;
+}
+
+void DeletionQueue::Delete(Type type, unsigned int id) {
+  Enqueue(Object{type, id, 0, 0, 0, 0, 0});
+}
+
+void DeletionQueue::DeleteBuffer(unsigned int id, unsigned int size) {
+  Enqueue(Object{Type::Buffer, id, size, 0, 0, 0, 0});
+}
+
+void DeletionQueue::DeleteTexture(unsigned int id, unsigned int width,
+                                  unsigned int height,
+                                  unsigned int internalFormat,
+                                  unsigned int levels) {
+  Enqueue(
+      Object{Type::Texture, id, width, height, internalFormat, levels, 0});
+}
+
+namespace {
+
+// what a recyclable object occupies while it waits
+size_t GetBytes(DeletionQueue::Type type, unsigned int size,
+                unsigned int height, unsigned int format, unsigned int levels) {
+  if (type == DeletionQueue::Type::Buffer) return size;
+  return GpuMemory::GetTextureBytes(size, height, format, levels);
+}
+
+}  // namespace
+
+void DeletionQueue::Enqueue(const Object& object) {
+  if (object.ID == 0) return;
+  Object queued = object;
+  // without a reuse key it is deleted like any other object
+  if (!m_Recycling) queued.Size = 0;
+  if (queued.Size)
+    GpuMemory::Get().Allocate(
+        GpuMemoryCategory::Retired,
+        GetBytes(queued.Kind, queued.Size, queued.Height, queued.Format,
+                 queued.Levels));
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Pending.push_back(queued);
+  m_Pending.back().Frame = m_Frame;
+}
+
+unsigned int DeletionQueue::AcquireBuffer(unsigned int size) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (unsigned int i = 0; i < m_FreeBuffers.size(); i++) {
+    if (m_FreeBuffers[i].Size != size) continue;
+    unsigned int id = m_FreeBuffers[i].ID;
+    GpuMemory::Get().Free(GpuMemoryCategory::Retired, size);
+    m_FreeBuffers[i] = m_FreeBuffers.back();
+    m_FreeBuffers.pop_back();
+    m_Stats.Reused++;
+    return id;
+  }
+  return 0;
+}
+
+unsigned int DeletionQueue::AcquireTexture(unsigned int width,
+                                           unsigned int height,
+                                           unsigned int internalFormat,
+                                           unsigned int levels) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (unsigned int i = 0; i < m_FreeTextures.size(); i++) {
+    const Object& texture = m_FreeTextures[i];
+    if (texture.Size != width || texture.Height != height ||
+        texture.Format != internalFormat || texture.Levels != levels)
+      continue;
+    unsigned int id = texture.ID;
+    GpuMemory::Get().Free(
+        GpuMemoryCategory::Retired,
+        GpuMemory::GetTextureBytes(width, height, internalFormat, levels));
+    m_FreeTextures[i] = m_FreeTextures.back();
+    m_FreeTextures.pop_back();
+    m_Stats.Reused++;
+    return id;
+  }
+  return 0;
+}
+
+void DeletionQueue::Release(const Object& object) {
+  if (object.Size == 0) {
+    Destroy(object);
+    m_Stats.Deleted++;
+    return;
+  }
+  Object parked = object;
+  parked.Frame = m_Frame;
+  if (object.Kind == Type::Buffer)
+    m_FreeBuffers.push_back(parked);
+  else
+    m_FreeTextures.push_back(parked);
+  m_Stats.Recycled++;
+}
+
+void DeletionQueue::EndFrame() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Fences.push_back(
+      FrameFence{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_Frame});
+
+  // poll, never wait: whatever is still running is released next frame
+  while (!m_Fences.empty()) {
+    FrameFence& front = m_Fences.front();
+    if (front.Fence &&
+        glClientWaitSync(front.Fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+      break;
+    if (front.Fence) glDeleteSync(front.Fence);
+    m_Retired = front.Frame + 1;
+    m_Fences.pop_front();
+  }
+
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < m_Pending.size(); i++) {
+    if (m_Pending[i].Frame < m_Retired)
+      Release(m_Pending[i]);
+    else
+      m_Pending[kept++] = m_Pending[i];
+  }
+  m_Pending.resize(kept);
+
+  // nobody wanted these
+  for (std::vector<Object>* pool : {&m_FreeBuffers, &m_FreeTextures}) {
+    kept = 0;
+    for (unsigned int i = 0; i < pool->size(); i++) {
+      if (m_Frame - (*pool)[i].Frame >= kRecycleFrames) {
+        Destroy((*pool)[i]);
+        m_Stats.Deleted++;
+      } else {
+        (*pool)[kept++] = (*pool)[i];
+      }
+    }
+    pool->resize(kept);
+  }
+  m_Frame++;
+}
+
+void DeletionQueue::Flush() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  glFinish();
+  for (const FrameFence& fence : m_Fences)
+    if (fence.Fence) glDeleteSync(fence.Fence);
+  m_Fences.clear();
+  for (std::vector<Object>* list :
+       {&m_Pending, &m_FreeBuffers, &m_FreeTextures}) {
+    for (const Object& object : *list) Destroy(object);
+    m_Stats.Deleted += (unsigned int)list->size();
+    list->clear();
+  }
+  m_Retired = m_Frame;
+}
+
+DeletionQueueStats DeletionQueue::GetStats() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  DeletionQueueStats stats = m_Stats;
+  stats.Pending = (unsigned int)m_Pending.size();
+  stats.FreeBuffers = (unsigned int)m_FreeBuffers.size();
+  stats.FreeTextures = (unsigned int)m_FreeTextures.size();
+  return stats;
+}
+
+void DeletionQueue::PrintStats() {
+  DeletionQueueStats stats = GetStats();
+  std::cout << "[DeletionQueue] deleted " << stats.Deleted << ", recycled "
+            << stats.Recycled << ", reused " << stats.Reused << ", pending "
+            << stats.Pending << ", free buffers " << stats.FreeBuffers
+            << ", free textures " << stats.FreeTextures << std::endl;
+}
+
+void DeletionQueue::Destroy(const Object& object) {
+  if (object.Size)
+    GpuMemory::Get().Free(
+        GpuMemoryCategory::Retired,
+        GetBytes(object.Kind, object.Size, object.Height, object.Format,
+                 object.Levels));
+  switch (object.Kind) {
+    case Type::Buffer:
+      glDeleteBuffers(1, &object.ID);
+      break;
+    case Type::Texture:
+      glDeleteTextures(1, &object.ID);
+      break;
+    case Type::VertexArray:
+      glDeleteVertexArrays(1, &object.ID);
+      break;
+    case Type::Program:
+      glDeleteProgram(object.ID);
+      break;
+    case Type::Framebuffer:
+      glDeleteFramebuffers(1, &object.ID);
+      break;
+    case Type::Renderbuffer:
+      glDeleteRenderbuffers(1, &object.ID);
+      break;
+    case Type::Query:
+      glDeleteQueries(1, &object.ID);
+      break;
+  }
+}
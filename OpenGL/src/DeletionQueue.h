@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+typedef struct __GLsync* GLsync;
+
+struct DeletionQueueStats {
+  unsigned int Pending;       // waiting for their frame's fence
+  unsigned int Deleted;       // handed to glDelete* so far
+  unsigned int Recycled;      // parked for reuse so far
+  unsigned int Reused;        // acquires served from the reuse pool
+  unsigned int FreeBuffers;   // in the reuse pool right now
+  unsigned int FreeTextures;
+};
+
+// GL objects are not deleted when their wrapper dies but when the GPU has
+// finished the frame they were destroyed in: EndFrame() puts a fence
+// behind every frame and objects are released once it has signaled, so a
+// delete never waits on the GPU still reading the object. With recycling
+// on, buffers and textures destroyed with their size go to a reuse pool
+// instead, where constructors of the same size pick them up
+// (glBufferSubData / glTexSubImage2D instead of a new allocation);
+// unclaimed ones are deleted after kRecycleFrames frames.
+class DeletionQueue {
+ public:
+  enum class Type {
+    Buffer,
+    Texture,
+    VertexArray,
+    Program,
+    Framebuffer,
+    Renderbuffer,
+    Query
+  };
+
+  static const unsigned int kRecycleFrames = 4;
+
+ private:
+  struct Object {
+    Type Kind;
+    unsigned int ID;
+    // reuse key, 0 when the object can't be recycled
+    unsigned int Size;  // bytes, or width for textures
+    unsigned int Height;
+    unsigned int Format;
+    unsigned int Levels;
+    uint64_t Frame;  // destroyed in, then parked in
+  };
+
+  struct FrameFence {
+    GLsync Fence;
+    uint64_t Frame;
+  };
+
+  std::mutex m_Mutex;
+  std::vector<Object> m_Pending;
+  std::deque<FrameFence> m_Fences;
+  std::vector<Object> m_FreeBuffers;
+  std::vector<Object> m_FreeTextures;
+  uint64_t m_Frame;
+  uint64_t m_Retired;  // every frame up to here is done on the GPU
+  std::atomic<bool> m_Recycling;
+  DeletionQueueStats m_Stats;
+
+ public:
+  DeletionQueue();
+  DeletionQueue(const DeletionQueue&) = delete;
+  DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+  // objects still queued at exit are left to the context teardown
+  static DeletionQueue& Get();
+
+  // any thread
+  void Delete(Type type, unsigned int id);
+  // recyclable buffer of `size` bytes
+  void DeleteBuffer(unsigned int id, unsigned int size);
+  // recyclable 2D texture with `levels` mips allocated
+  void DeleteTexture(unsigned int id, unsigned int width, unsigned int height,
+                     unsigned int internalFormat, unsigned int levels = 1);
+
+  // off by default; objects destroyed while it is off are just deleted,
+  // ones already parked stay claimable until they age out
+  void SetRecycling(bool enabled) { m_Recycling = enabled; }
+  bool IsRecycling() const { return m_Recycling; }
+
+  // a retired object of the same size, 0 if there is none
+  unsigned int AcquireBuffer(unsigned int size);
+  unsigned int AcquireTexture(unsigned int width, unsigned int height,
+                              unsigned int internalFormat,
+                              unsigned int levels = 1);
+
+  // on the GL thread after the frame's draws: fence it and release what
+  // earlier frames' fences allow
+  void EndFrame();
+  // wait for the GPU and delete everything, before the context goes away
+  void Flush();
+
+  DeletionQueueStats GetStats();
+  void PrintStats();
+
+ private:
+  void Enqueue(const Object& object);
+  void Release(const Object& object);
+  static void Destroy(const Object& object);
+};
@@ -0,0 +1,235 @@
+#include "Ecs.h"
+
+#include <algorithm>
+
+#include "JobSystem.h"
+#include "Log.h"
+
+namespace EcsDetail {
+
+static std::vector<ComponentInfo>& Components() {
+  static std::vector<ComponentInfo> components;
+  return components;
+}
+
+unsigned int RegisterComponent(unsigned int size, unsigned int align) {
+  std::vector<ComponentInfo>& components = Components();
+  ASSERT(components.size() < kMaxComponents);
+  components.push_back({size, align});
+  return (unsigned int)components.size() - 1;
+}
+
+const ComponentInfo& GetComponentInfo(unsigned int id) {
+  return Components()[id];
+}
+
+}  // namespace EcsDetail
+
+const unsigned int World::kChunkSize;
+
+Archetype& World::GetArchetype(ComponentMask mask, unsigned int& index) {
+  auto found = m_ArchetypeIndex.find(mask);
+  if (found != m_ArchetypeIndex.end()) {
+    index = found->second;
+    return *m_Archetypes[index];
+  }
+
+  std::unique_ptr<Archetype> archetype(new Archetype());
+  archetype->Mask = mask;
+  archetype->Count = 0;
+  unsigned int rowSize = sizeof(Entity);
+  for (unsigned int c = 0; c < kMaxComponents; c++)
+    if (mask & (1u << c)) rowSize += EcsDetail::GetComponentInfo(c).Size;
+
+  // entity ids first, then one aligned array per component
+  auto layout = [&](unsigned int capacity) {
+    unsigned int offset = sizeof(Entity) * capacity;
+    for (unsigned int c = 0; c < kMaxComponents; c++) {
+      archetype->Offsets[c] = ~0u;
+      if (!(mask & (1u << c))) continue;
+      const EcsDetail::ComponentInfo& info = EcsDetail::GetComponentInfo(c);
+      offset = (offset + info.Align - 1) / info.Align * info.Align;
+      archetype->Offsets[c] = offset;
+      offset += info.Size * capacity;
+    }
+    return offset;
+  };
+  archetype->Capacity = std::max(1u, kChunkSize / rowSize);
+  // alignment padding can push the last array over the chunk
+  while (layout(archetype->Capacity) > kChunkSize && archetype->Capacity > 1)
+    archetype->Capacity--;
+  archetype->ChunkBytes =
+      std::max(kChunkSize, layout(archetype->Capacity));
+
+  index = (unsigned int)m_Archetypes.size();
+  m_Archetypes.push_back(std::move(archetype));
+  m_ArchetypeIndex[mask] = index;
+  return *m_Archetypes[index];
+}
+
+void World::AllocateRow(Archetype& archetype, unsigned int& chunk,
+                        unsigned int& row) {
+  if (archetype.Chunks.empty() ||
+      archetype.Chunks.back().Count == archetype.Capacity) {
+    Chunk fresh;
+    fresh.Memory.reset(new unsigned char[archetype.ChunkBytes + 63]);
+    fresh.Data = (unsigned char*)(((uintptr_t)fresh.Memory.get() + 63) &
+                                  ~(uintptr_t)63);
+    fresh.Count = 0;
+    archetype.Chunks.push_back(std::move(fresh));
+  }
+  chunk = (unsigned int)archetype.Chunks.size() - 1;
+  row = archetype.Chunks.back().Count++;
+  archetype.Count++;
+}
+
+void World::RemoveRow(Archetype& archetype, unsigned int chunk,
+                      unsigned int row) {
+  Chunk& last = archetype.Chunks.back();
+  unsigned int lastChunk = (unsigned int)archetype.Chunks.size() - 1;
+  unsigned int lastRow = last.Count - 1;
+
+  if (chunk != lastChunk || row != lastRow) {
+    Chunk& hole = archetype.Chunks[chunk];
+    Entity moved = archetype.Entities(last)[lastRow];
+    archetype.Entities(hole)[row] = moved;
+    for (unsigned int c = 0; c < kMaxComponents; c++) {
+      if (!(archetype.Mask & (1u << c))) continue;
+      unsigned int size = EcsDetail::GetComponentInfo(c).Size;
+      std::memcpy(hole.Data + archetype.Offsets[c] + row * size,
+                  last.Data + archetype.Offsets[c] + lastRow * size, size);
+    }
+    m_Records[moved.Index].Chunk = chunk;
+    m_Records[moved.Index].Row = row;
+  }
+
+  if (--last.Count == 0) archetype.Chunks.pop_back();
+  archetype.Count--;
+}
+
+Entity World::Create(ComponentMask mask) {
+  Entity entity;
+  if (!m_FreeRecords.empty()) {
+    entity.Index = m_FreeRecords.back();
+    m_FreeRecords.pop_back();
+  } else {
+    entity.Index = (unsigned int)m_Records.size();
+    m_Records.push_back({0, 0, 0, 0});
+  }
+  Record& record = m_Records[entity.Index];
+  entity.Generation = record.Generation;
+
+  Archetype& archetype = GetArchetype(mask, record.Archetype);
+  AllocateRow(archetype, record.Chunk, record.Row);
+  Chunk& chunk = archetype.Chunks[record.Chunk];
+  archetype.Entities(chunk)[record.Row] = entity;
+  for (unsigned int c = 0; c < kMaxComponents; c++) {
+    if (!(mask & (1u << c))) continue;
+    unsigned int size = EcsDetail::GetComponentInfo(c).Size;
+    std::memset(chunk.Data + archetype.Offsets[c] + record.Row * size, 0,
+                size);
+  }
+  m_EntityCount++;
+  return entity;
+}
+
+void World::Destroy(Entity entity) {
+  ASSERT(IsAlive(entity));
+  Record& record = m_Records[entity.Index];
+  RemoveRow(*m_Archetypes[record.Archetype], record.Chunk, record.Row);
+  record.Generation++;
+  m_FreeRecords.push_back(entity.Index);
+  m_EntityCount--;
+}
+
+bool World::IsAlive(Entity entity) const {
+  return entity.Index < m_Records.size() &&
+         m_Records[entity.Index].Generation == entity.Generation;
+}
+
+ComponentMask World::GetMask(Entity entity) const {
+  return m_Archetypes[m_Records[entity.Index].Archetype]->Mask;
+}
+
+void World::ChangeArchetype(Entity entity, ComponentMask mask) {
+  ASSERT(IsAlive(entity));
+  Record& record = m_Records[entity.Index];
+  if (m_Archetypes[record.Archetype]->Mask == mask) return;
+
+  unsigned int toIndex;
+  Archetype& to = GetArchetype(mask, toIndex);
+  // GetArchetype may have grown m_Archetypes, look `from` up afterwards
+  Archetype& from = *m_Archetypes[record.Archetype];
+  unsigned int chunk, row;
+  AllocateRow(to, chunk, row);
+
+  Chunk& source = from.Chunks[record.Chunk];
+  Chunk& destination = to.Chunks[chunk];
+  to.Entities(destination)[row] = entity;
+  for (unsigned int c = 0; c < kMaxComponents; c++) {
+    if (!(mask & (1u << c))) continue;
+    unsigned int size = EcsDetail::GetComponentInfo(c).Size;
+    unsigned char* target = destination.Data + to.Offsets[c] + row * size;
+    if (from.Mask & (1u << c))
+      std::memcpy(target, source.Data + from.Offsets[c] + record.Row * size,
+                  size);
+    else
+      std::memset(target, 0, size);
+  }
+
+  RemoveRow(from, record.Chunk, record.Row);
+  record.Archetype = toIndex;
+  record.Chunk = chunk;
+  record.Row = row;
+}
+
+unsigned int World::GetChunkCount() const {
+  unsigned int count = 0;
+  for (const auto& archetype : m_Archetypes)
+    count += (unsigned int)archetype->Chunks.size();
+  return count;
+}
+
+void World::CollectChunks(
+    ComponentMask mask,
+    std::vector<std::pair<const Archetype*, const Chunk*>>& chunks) const {
+  for (const auto& archetype : m_Archetypes) {
+    if ((archetype->Mask & mask) != mask) continue;
+    for (const Chunk& chunk : archetype->Chunks)
+      chunks.push_back(std::make_pair(archetype.get(), &chunk));
+  }
+}
+
+void World::RunParallel(
+    unsigned int count, unsigned int threads,
+    const std::function<void(unsigned int, unsigned int)>& range) {
+  if (threads == 1 || count <= 1) {
+    range(0, count);
+    return;
+  }
+  // a chunk is a good job already, let the job system balance them
+  if (threads == 0 || threads >= count) {
+    JobSystem::Get().ParallelFor(count, range, 1);
+    return;
+  }
+  // at most `threads` batches of neighbouring chunks run at once
+  JobSystem::Get().ParallelFor(
+      threads,
+      [&](unsigned int begin, unsigned int end) {
+        for (unsigned int batch = begin; batch < end; batch++)
+          range((unsigned int)((uint64_t)count * batch / threads),
+                (unsigned int)((uint64_t)count * (batch + 1) / threads));
+      },
+      1);
+}
+
+void CommandBuffer::Destroy(Entity entity) {
+  m_Commands.push_back([=](World& world) {
+    if (world.IsAlive(entity)) world.Destroy(entity);
+  });
+}
+
+void CommandBuffer::Playback(World& world) {
+  for (auto& command : m_Commands) command(world);
+  m_Commands.clear();
+}
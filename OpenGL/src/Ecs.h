@@ -0,0 +1,219 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Archetype entity component system. Entities with the same set of
+// components share an archetype, whose rows live in fixed size chunks with
+// one contiguous array per component, so systems walk plain arrays.
+// Components must be trivially copyable; rows are moved with memcpy.
+
+typedef uint32_t ComponentMask;
+const unsigned int kMaxComponents = 32;
+
+struct Entity {
+  unsigned int Index;
+  unsigned int Generation;
+
+  inline bool operator==(const Entity& other) const {
+    return Index == other.Index && Generation == other.Generation;
+  }
+};
+
+namespace EcsDetail {
+
+struct ComponentInfo {
+  unsigned int Size;
+  unsigned int Align;
+};
+
+unsigned int RegisterComponent(unsigned int size, unsigned int align);
+const ComponentInfo& GetComponentInfo(unsigned int id);
+
+}  // namespace EcsDetail
+
+template <typename T>
+unsigned int ComponentId() {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "components are moved with memcpy");
+  static const unsigned int id =
+      EcsDetail::RegisterComponent(sizeof(T), alignof(T));
+  return id;
+}
+
+template <typename... T>
+ComponentMask MaskOf() {
+  ComponentMask mask = 0;
+  int expand[] = {0, (mask |= 1u << ComponentId<T>(), 0)...};
+  (void)expand;
+  return mask;
+}
+
+struct Chunk {
+  std::unique_ptr<unsigned char[]> Memory;
+  unsigned char* Data;  // 64 byte aligned, entity ids first
+  unsigned int Count;
+};
+
+struct Archetype {
+  ComponentMask Mask;
+  unsigned int Capacity;  // rows per chunk
+  unsigned int ChunkBytes;
+  unsigned int Offsets[kMaxComponents];  // of each component array
+  std::vector<Chunk> Chunks;  // all full except the last
+  unsigned int Count;
+
+  inline Entity* Entities(const Chunk& chunk) const {
+    return (Entity*)chunk.Data;
+  }
+  template <typename T>
+  inline T* Components(const Chunk& chunk) const {
+    return (T*)(chunk.Data + Offsets[ComponentId<T>()]);
+  }
+};
+
+class World {
+ private:
+  struct Record {
+    unsigned int Archetype;
+    unsigned int Chunk;
+    unsigned int Row;
+    unsigned int Generation;
+  };
+
+  std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+  std::unordered_map<ComponentMask, unsigned int> m_ArchetypeIndex;
+  std::vector<Record> m_Records;
+  std::vector<unsigned int> m_FreeRecords;
+  unsigned int m_EntityCount;
+
+ public:
+  // bytes per chunk, including the entity ids
+  static const unsigned int kChunkSize = 16 * 1024;
+
+  World() : m_EntityCount(0) {}
+  World(const World&) = delete;
+  World& operator=(const World&) = delete;
+
+  // entity with zeroed components of `mask`
+  Entity Create(ComponentMask mask);
+  template <typename... T>
+  Entity Create(const T&... values) {
+    Entity entity = Create(MaskOf<T...>());
+    int expand[] = {0, (*Get<T>(entity) = values, 0)...};
+    (void)expand;
+    return entity;
+  }
+  void Destroy(Entity entity);
+  bool IsAlive(Entity entity) const;
+
+  template <typename T>
+  void Add(Entity entity, const T& value) {
+    ChangeArchetype(entity, GetMask(entity) | MaskOf<T>());
+    *Get<T>(entity) = value;
+  }
+  template <typename T>
+  void Remove(Entity entity) {
+    ChangeArchetype(entity, GetMask(entity) & ~MaskOf<T>());
+  }
+  template <typename T>
+  bool Has(Entity entity) const {
+    return (GetMask(entity) & MaskOf<T>()) != 0;
+  }
+  // nullptr if the entity lacks T; invalidated by structural changes
+  template <typename T>
+  T* Get(Entity entity) {
+    const Record& record = m_Records[entity.Index];
+    const Archetype& archetype = *m_Archetypes[record.Archetype];
+    if (!(archetype.Mask & MaskOf<T>())) return nullptr;
+    return archetype.Components<T>(archetype.Chunks[record.Chunk]) +
+           record.Row;
+  }
+
+  // f(count, entities, T* arrays...) for every chunk holding all of T.
+  // Structural changes while iterating go through a CommandBuffer.
+  template <typename... T, typename F>
+  void ForEachChunk(F&& f) {
+    ComponentMask mask = MaskOf<T...>();
+    for (auto& archetype : m_Archetypes) {
+      if ((archetype->Mask & mask) != mask) continue;
+      for (const Chunk& chunk : archetype->Chunks)
+        f(chunk.Count, (const Entity*)archetype->Entities(chunk),
+          archetype->template Components<T>(chunk)...);
+    }
+  }
+
+  // Same as ForEachChunk with the chunks spread over the shared JobSystem,
+  // the calling thread takes a share. threads caps how many batches of
+  // chunks there are, and so how many workers take part; 0 means one batch
+  // per chunk and 1 runs inline.
+  template <typename... T, typename F>
+  void ParallelForEachChunk(F&& f, unsigned int threads = 0) {
+    std::vector<std::pair<const Archetype*, const Chunk*>> chunks;
+    CollectChunks(MaskOf<T...>(), chunks);
+    RunParallel((unsigned int)chunks.size(), threads,
+                [&](unsigned int begin, unsigned int end) {
+                  for (unsigned int i = begin; i < end; i++) {
+                    const Archetype& archetype = *chunks[i].first;
+                    const Chunk& chunk = *chunks[i].second;
+                    f(chunk.Count, (const Entity*)archetype.Entities(chunk),
+                      archetype.template Components<T>(chunk)...);
+                  }
+                });
+  }
+
+  inline unsigned int GetEntityCount() const { return m_EntityCount; }
+  inline unsigned int GetArchetypeCount() const {
+    return (unsigned int)m_Archetypes.size();
+  }
+  unsigned int GetChunkCount() const;
+
+ private:
+  ComponentMask GetMask(Entity entity) const;
+  Archetype& GetArchetype(ComponentMask mask, unsigned int& index);
+  // append a row to `archetype`, returns its record fields
+  void AllocateRow(Archetype& archetype, unsigned int& chunk,
+                   unsigned int& row);
+  // swap the archetype's last row into the hole
+  void RemoveRow(Archetype& archetype, unsigned int chunk, unsigned int row);
+  void ChangeArchetype(Entity entity, ComponentMask mask);
+  void CollectChunks(
+      ComponentMask mask,
+      std::vector<std::pair<const Archetype*, const Chunk*>>& chunks) const;
+  static void RunParallel(
+      unsigned int count, unsigned int threads,
+      const std::function<void(unsigned int, unsigned int)>& range);
+};
+
+// Structural changes recorded while systems iterate (one buffer per
+// thread), applied in order by Playback on the owning thread.
+class CommandBuffer {
+ private:
+  std::vector<std::function<void(World&)>> m_Commands;
+
+ public:
+  template <typename... T>
+  void Create(const T&... values) {
+    m_Commands.push_back([=](World& world) { world.Create(values...); });
+  }
+  void Destroy(Entity entity);
+  template <typename T>
+  void Add(Entity entity, const T& value) {
+    m_Commands.push_back([=](World& world) {
+      if (world.IsAlive(entity)) world.Add(entity, value);
+    });
+  }
+  template <typename T>
+  void Remove(Entity entity) {
+    m_Commands.push_back([=](World& world) {
+      if (world.IsAlive(entity)) world.template Remove<T>(entity);
+    });
+  }
+
+  void Playback(World& world);
+  inline bool IsEmpty() const { return m_Commands.empty(); }
+};
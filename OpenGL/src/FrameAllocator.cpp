@@ -0,0 +1,259 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "GL/glew.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+const size_t FrameArena::kPageSize;
+const unsigned int FrameAllocator::kMaxFrames;
+
+namespace {
+
+unsigned char* AlignUp(unsigned char* pointer, size_t align) {
+  return (unsigned char*)(((uintptr_t)pointer + align - 1) & ~(align - 1));
+}
+
+inline size_t AlignUp(size_t offset, size_t align) {
+  return (offset + align - 1) & ~(align - 1);
+}
+
+}  // namespace
+
+FrameArena::FrameArena(size_t capacity, JobSystem* jobs)
+    : m_Memory(new unsigned char[capacity + 64]),
+      m_Capacity(capacity),
+      m_Offset(0),
+      m_Jobs(jobs),
+      m_OverflowBytes(0),
+      m_HighWater(0),
+      m_Grows(0) {
+  m_Data = AlignUp(m_Memory.get(), 64);
+  if (m_Jobs) {
+    m_Pages.reset(new Page[m_Jobs->GetWorkerCount()]);
+    for (unsigned int i = 0; i < m_Jobs->GetWorkerCount(); i++)
+      m_Pages[i].Offset = m_Pages[i].End = 0;
+  }
+}
+
+void* FrameArena::Allocate(size_t size, size_t align) {
+  ASSERT(align <= 64 && (align & (align - 1)) == 0);
+  if (size == 0) size = 1;
+  int worker = m_Jobs ? m_Jobs->GetWorkerIndex() : -1;
+  // big blocks would waste most of a page
+  if (worker < 0 || size > kPageSize / 4) return AllocateShared(size, align);
+
+  Page& page = m_Pages[worker];
+  size_t offset = AlignUp(page.Offset, align);
+  if (offset + size > page.End) {
+    // once the block is gone every worker goes straight to the heap
+    if (m_Offset.load(std::memory_order_relaxed) >= m_Capacity)
+      return AllocateOverflow(size, align);
+    size_t begin = m_Offset.fetch_add(kPageSize, std::memory_order_relaxed);
+    if (begin + kPageSize > m_Capacity) {
+      page.Offset = page.End = 0;
+      return AllocateOverflow(size, align);
+    }
+    page.End = begin + kPageSize;
+    offset = begin;
+  }
+  page.Offset = offset + size;
+  return m_Data + offset;
+}
+
+void* FrameArena::AllocateShared(size_t size, size_t align) {
+  size_t padded = size + align - 1;
+  size_t begin = m_Offset.fetch_add(padded, std::memory_order_relaxed);
+  if (begin + padded > m_Capacity) return AllocateOverflow(size, align);
+  return m_Data + AlignUp(begin, align);
+}
+
+void* FrameArena::AllocateOverflow(size_t size, size_t align) {
+  std::lock_guard<std::mutex> lock(m_OverflowMutex);
+  m_Overflow.emplace_back(new unsigned char[size + align]);
+  m_OverflowBytes += size;
+  return AlignUp(m_Overflow.back().get(), align);
+}
+
+size_t FrameArena::GetUsed() const {
+  return std::min(m_Offset.load(std::memory_order_relaxed), m_Capacity) +
+         m_OverflowBytes;
+}
+
+void FrameArena::Reset() {
+  size_t used = GetUsed();
+  m_HighWater = std::max(m_HighWater, used);
+  if (used > m_Capacity) {
+    // room for the worst frame so far plus half again
+    m_Capacity = AlignUp(m_HighWater + m_HighWater / 2, kPageSize);
+    m_Memory.reset(new unsigned char[m_Capacity + 64]);
+    m_Data = AlignUp(m_Memory.get(), 64);
+    m_Grows++;
+  }
+  m_Overflow.clear();
+  m_OverflowBytes = 0;
+  m_Offset.store(0, std::memory_order_relaxed);
+  if (m_Jobs)
+    for (unsigned int i = 0; i < m_Jobs->GetWorkerCount(); i++)
+      m_Pages[i].Offset = m_Pages[i].End = 0;
+}
+
+FrameAllocator::FrameAllocator(size_t capacity, unsigned int frames,
+                               bool useFences)
+    : m_UseFences(useFences) {
+  frames = std::max(1u, std::min(frames, kMaxFrames));
+  for (unsigned int i = 0; i < frames; i++)
+    m_Arenas.emplace_back(new FrameArena(capacity, &JobSystem::Get()));
+  m_Fences.assign(frames, nullptr);
+  m_Current = 0;
+}
+
+FrameAllocator::~FrameAllocator() {
+  for (GLsync fence : m_Fences)
+    if (fence) glDeleteSync(fence);
+}
+
+void FrameAllocator::BeginFrame() {
+  m_Current = (m_Current + 1) % (unsigned int)m_Arenas.size();
+  GLsync& fence = m_Fences[m_Current];
+  if (fence) {
+    // normally long signaled, N frames have passed since
+    GLenum result;
+    do {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    } while (result == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  m_Arenas[m_Current]->Reset();
+}
+
+void FrameAllocator::EndFrame() {
+  if (m_UseFences)
+    m_Fences[m_Current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void FrameAllocator::PrintStats() const {
+  const double kb = 1.0 / 1024.0;
+  for (unsigned int i = 0; i < m_Arenas.size(); i++) {
+    const FrameArena& arena = *m_Arenas[i];
+    std::cout << "[FrameAllocator] frame " << i << ": used "
+              << arena.GetUsed() * kb << " / " << arena.GetCapacity() * kb
+              << " KB, high water " << arena.GetHighWater() * kb
+              << " KB, grown " << arena.GetGrowCount() << "x"
+              << (arena.HasOverflowed() ? ", overflowed" : "") << std::endl;
+  }
+}
+
+namespace {
+
+struct DrawCommand {
+  uint64_t Key;
+  unsigned int Mesh;
+  unsigned int Material;
+  float Depth;
+};
+
+struct Payload {
+  float Data[16];
+};
+
+}  // namespace
+
+void FrameAllocator::Benchmark() {
+  const unsigned int kFrames = 200;
+  const unsigned int kObjects = 100000;
+  std::vector<float> depths(kObjects);
+  unsigned int seed = 12345;
+  for (float& depth : depths) {
+    seed = seed * 1664525u + 1013904223u;
+    depth = (seed >> 8) / 16777216.0f;
+  }
+  unsigned int checksum = 0;
+
+  // heap: vectors grow through operator new, payloads are new'd and deleted
+  double heapMs;
+  {
+    typedef std::chrono::high_resolution_clock Clock;
+    auto start = Clock::now();
+    for (unsigned int frame = 0; frame < kFrames; frame++) {
+      std::vector<DrawCommand> draws;
+      for (unsigned int i = 0; i < 20000; i++)
+        draws.push_back(DrawCommand{(uint64_t)(i * 2654435761u), i % 97,
+                                    i % 13, depths[i]});
+      std::vector<Payload*> payloads(5000);
+      for (unsigned int i = 0; i < 5000; i++) {
+        payloads[i] = new Payload();
+        payloads[i]->Data[0] = (float)i;
+      }
+      std::atomic<unsigned int> visible(0);
+      JobSystem::Get().ParallelFor(
+          kObjects, [&](unsigned int begin, unsigned int end) {
+            std::vector<unsigned int> local;
+            for (unsigned int i = begin; i < end; i++)
+              if (depths[i] < 0.5f) local.push_back(i);
+            visible.fetch_add((unsigned int)local.size());
+          });
+      checksum += (unsigned int)draws.size() + visible.load() +
+                  (unsigned int)payloads[4999]->Data[0];
+      for (Payload* payload : payloads) delete payload;
+    }
+    heapMs = std::chrono::duration<double, std::milli>(Clock::now() - start)
+                 .count() /
+             kFrames;
+  }
+
+  // frame memory, starting small so the arenas have to grow first
+  FrameAllocator frames(64 * 1024, 2, false);
+  double arenaMs;
+  unsigned int overflowFrames = 0;
+  {
+    typedef std::chrono::high_resolution_clock Clock;
+    auto start = Clock::now();
+    for (unsigned int frame = 0; frame < kFrames; frame++) {
+      frames.BeginFrame();
+      FrameArena& arena = frames.GetArena();
+      FrameVector<DrawCommand> draws{FrameStlAllocator<DrawCommand>(arena)};
+      for (unsigned int i = 0; i < 20000; i++)
+        draws.push_back(DrawCommand{(uint64_t)(i * 2654435761u), i % 97,
+                                    i % 13, depths[i]});
+      FrameVector<Payload*> payloads(5000, nullptr,
+                                     FrameStlAllocator<Payload*>(arena));
+      for (unsigned int i = 0; i < 5000; i++) {
+        payloads[i] = arena.New<Payload>();
+        payloads[i]->Data[0] = (float)i;
+      }
+      std::atomic<unsigned int> visible(0);
+      JobSystem::Get().ParallelFor(
+          kObjects, [&](unsigned int begin, unsigned int end) {
+            FrameVector<unsigned int> local{
+                FrameStlAllocator<unsigned int>(arena)};
+            for (unsigned int i = begin; i < end; i++)
+              if (depths[i] < 0.5f) local.push_back(i);
+            visible.fetch_add((unsigned int)local.size());
+          });
+      checksum += (unsigned int)draws.size() + visible.load() +
+                  (unsigned int)payloads[4999]->Data[0];
+      // only the frames after the arenas settled count
+      if (frame >= kFrames / 2 && arena.HasOverflowed()) overflowFrames++;
+      frames.EndFrame();
+    }
+    arenaMs = std::chrono::duration<double, std::milli>(Clock::now() - start)
+                  .count() /
+              kFrames;
+  }
+
+  std::cout << "[FrameAllocator] " << JobSystem::Get().GetWorkerCount()
+            << " workers, heap " << heapMs << " ms/frame, frame arena "
+            << arenaMs << " ms/frame (x" << heapMs / arenaMs << ")"
+            << std::endl;
+  std::cout << "[FrameAllocator] steady state frames falling back to the "
+               "heap: "
+            << overflowFrames << " / " << kFrames / 2 << " (checksum "
+            << checksum << ")" << std::endl;
+  frames.PrintStats();
+}
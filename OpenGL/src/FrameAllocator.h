@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+typedef struct __GLsync* GLsync;
+
+// Linear allocator for data that lives for one frame. Allocating bumps a
+// pointer, nothing is freed on its own and Reset() drops everything at
+// once. Workers of the JobSystem it was created with carve private pages
+// out of the block, so they neither contend nor share cache lines; other
+// threads bump the shared offset atomically. Running out spills into
+// heap blocks, and the next Reset() grows the block past the high water
+// mark, so a frame that repeats itself stops touching the heap.
+class FrameArena {
+ private:
+  static const size_t kPageSize = 16 * 1024;
+
+  // padded to a cache line so workers don't write to each other's
+  struct Page {
+    size_t Offset;
+    size_t End;
+    unsigned char Padding[64 - 2 * sizeof(size_t)];
+  };
+
+  std::unique_ptr<unsigned char[]> m_Memory;
+  unsigned char* m_Data;  // 64 byte aligned
+  size_t m_Capacity;
+  std::atomic<size_t> m_Offset;
+  JobSystem* m_Jobs;
+  std::unique_ptr<Page[]> m_Pages;  // one per worker of m_Jobs
+
+  std::mutex m_OverflowMutex;
+  std::vector<std::unique_ptr<unsigned char[]>> m_Overflow;
+  size_t m_OverflowBytes;
+
+  size_t m_HighWater;
+  unsigned int m_Grows;
+
+ public:
+  // jobs = nullptr: every thread uses the shared offset
+  explicit FrameArena(size_t capacity, JobSystem* jobs = nullptr);
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  void* Allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+  // destructors never run, so only types that don't need them
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "frame memory is dropped without running destructors");
+    return new (Allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+  // default initialized, like new T[count]
+  template <typename T>
+  T* NewArray(size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "frame memory is dropped without running destructors");
+    return new (Allocate(sizeof(T) * count, alignof(T))) T[count];
+  }
+
+  // not thread safe, nothing may be allocating
+  void Reset();
+
+  // bytes handed out this frame, including partly used worker pages and
+  // what spilled to the heap
+  size_t GetUsed() const;
+  inline size_t GetCapacity() const { return m_Capacity; }
+  inline size_t GetHighWater() const { return m_HighWater; }
+  // times Reset() had to reallocate the block
+  inline unsigned int GetGrowCount() const { return m_Grows; }
+  inline bool HasOverflowed() const { return m_OverflowBytes > 0; }
+
+ private:
+  void* AllocateShared(size_t size, size_t align);
+  void* AllocateOverflow(size_t size, size_t align);
+};
+
+// N frame arenas in rotation. BeginFrame() moves to the next one and
+// resets it once the GPU has passed the fence EndFrame() put behind the
+// last frame that used it, so data the GPU may still be reading (mapped
+// uniform payloads, draw lists a render thread lags behind on) stays put.
+class FrameAllocator {
+ private:
+  std::vector<std::unique_ptr<FrameArena>> m_Arenas;
+  std::vector<GLsync> m_Fences;
+  unsigned int m_Current;
+  bool m_UseFences;
+
+ public:
+  static const unsigned int kMaxFrames = 4;
+
+  // useFences = false for CPU only use, without a GL context
+  FrameAllocator(size_t capacity = 4 * 1024 * 1024, unsigned int frames = 2,
+                 bool useFences = true);
+  ~FrameAllocator();
+  FrameAllocator(const FrameAllocator&) = delete;
+  FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+  void BeginFrame();
+  void EndFrame();
+
+  // arena of the frame being recorded
+  inline FrameArena& GetArena() { return *m_Arenas[m_Current]; }
+
+  // used / capacity / high water of every arena
+  void PrintStats() const;
+
+  // frame lists and payloads built with the arena against std::vector and
+  // new, single threaded and spread over the JobSystem
+  static void Benchmark();
+};
+
+// std allocator over a FrameArena, deallocate is a no-op. Containers using
+// it must not outlive the frame.
+template <typename T>
+class FrameStlAllocator {
+ public:
+  typedef T value_type;
+
+  FrameArena* Arena;
+
+  FrameStlAllocator(FrameArena& arena) : Arena(&arena) {}
+  template <typename U>
+  FrameStlAllocator(const FrameStlAllocator<U>& other) : Arena(other.Arena) {}
+
+  T* allocate(size_t count) {
+    return (T*)Arena->Allocate(sizeof(T) * count, alignof(T));
+  }
+  void deallocate(T*, size_t) {}
+
+  template <typename U>
+  bool operator==(const FrameStlAllocator<U>& other) const {
+    return Arena == other.Arena;
+  }
+  template <typename U>
+  bool operator!=(const FrameStlAllocator<U>& other) const {
+    return Arena != other.Arena;
+  }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
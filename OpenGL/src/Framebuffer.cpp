@@ -0,0 +1,164 @@
+#include "Framebuffer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "DeletionQueue.h"
+#include "GL/glew.h"
+#include "Log.h"
+#include "TextureFormat.h"
+
+Framebuffer::Framebuffer(const FramebufferSpec& spec, RenderTargetPool* pool)
+    : m_RendererID(0), m_Spec(spec), m_DepthAttachment(0), m_Pool(pool) {
+  if (!m_Pool) {
+    m_OwnPool.reset(new RenderTargetPool());
+    m_Pool = m_OwnPool.get();
+  }
+  Invalidate();
+}
+
+Framebuffer::~Framebuffer() { Release(); }
+
+RenderTargetDesc Framebuffer::GetColorDesc(unsigned int index) const {
+  return RenderTargetDesc{m_Spec.Width, m_Spec.Height,
+                          m_Spec.ColorFormats[index], m_Spec.Samples, false};
+}
+
+RenderTargetDesc Framebuffer::GetDepthDesc() const {
+  return RenderTargetDesc{m_Spec.Width, m_Spec.Height, m_Spec.DepthFormat,
+                          m_Spec.Samples, !m_Spec.DepthTexture};
+}
+
+void Framebuffer::Release() {
+  for (unsigned int i = 0; i < m_ColorAttachments.size(); i++)
+    m_Pool->Release(m_ColorAttachments[i], GetColorDesc(i));
+  m_ColorAttachments.clear();
+  if (m_DepthAttachment) {
+    m_Pool->Release(m_DepthAttachment, GetDepthDesc());
+    m_DepthAttachment = 0;
+  }
+  // nobody else will reuse them
+  if (m_OwnPool) m_OwnPool->Trim();
+  DeletionQueue::Get().Delete(DeletionQueue::Type::Framebuffer, m_RendererID);
+  m_RendererID = 0;
+}
+
+void Framebuffer::Invalidate() {
+  Release();
+  GLCall(glGenFramebuffers(1, &m_RendererID));
+  GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_RendererID));
+
+  // multisampled targets are always renderbuffers
+  bool multisampled = m_Spec.Samples > 1;
+  std::vector<GLenum> drawBuffers;
+  for (unsigned int i = 0; i < m_Spec.ColorFormats.size(); i++) {
+    GLenum attachment = GL_COLOR_ATTACHMENT0 + i;
+    unsigned int id = m_Pool->Acquire(GetColorDesc(i));
+    if (multisampled) {
+      GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment,
+                                       GL_RENDERBUFFER, id));
+    } else {
+      GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+                                    id, 0));
+    }
+    m_ColorAttachments.push_back(id);
+    drawBuffers.push_back(attachment);
+  }
+
+  if (m_Spec.DepthFormat) {
+    GLenum attachment = TextureFormat::HasStencil(m_Spec.DepthFormat)
+                            ? GL_DEPTH_STENCIL_ATTACHMENT
+                            : GL_DEPTH_ATTACHMENT;
+    m_DepthAttachment = m_Pool->Acquire(GetDepthDesc());
+    if (m_Spec.DepthTexture && !multisampled) {
+      GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+                                    m_DepthAttachment, 0));
+    } else {
+      GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment,
+                                       GL_RENDERBUFFER, m_DepthAttachment));
+    }
+  }
+
+  if (drawBuffers.empty()) {
+    // depth only, e.g. a shadow map
+    GLCall(glDrawBuffer(GL_NONE));
+    GLCall(glReadBuffer(GL_NONE));
+  } else {
+    GLCall(glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data()));
+  }
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "[Framebuffer] incomplete: 0x" << std::hex << status
+              << std::dec << std::endl;
+  GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+void Framebuffer::Bind() const {
+  GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_RendererID));
+  GLCall(glViewport(0, 0, m_Spec.Width, m_Spec.Height));
+}
+
+void Framebuffer::Unbind() const {
+  GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+void Framebuffer::Resize(unsigned int width, unsigned int height) {
+  if (width == 0 || height == 0 ||
+      (width == m_Spec.Width && height == m_Spec.Height))
+    return;
+  // the pool finds the attachments by their description, so they go back
+  // while the spec still has the size they were acquired with
+  Release();
+  m_Spec.Width = width;
+  m_Spec.Height = height;
+  Invalidate();
+}
+
+void Framebuffer::Resolve(const Framebuffer* target, unsigned int width,
+                          unsigned int height) const {
+  GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, m_RendererID));
+  if (!target) {
+    // MSAA resolve has to be 1:1, scaling only works single sampled
+    GLenum filter = m_Spec.Samples > 1 ? GL_NEAREST : GL_LINEAR;
+    GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0));
+    GLCall(glReadBuffer(GL_COLOR_ATTACHMENT0));
+    GLCall(glBlitFramebuffer(0, 0, m_Spec.Width, m_Spec.Height, 0, 0,
+                             width ? width : m_Spec.Width,
+                             height ? height : m_Spec.Height,
+                             GL_COLOR_BUFFER_BIT, filter));
+    GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    return;
+  }
+
+  const FramebufferSpec& to = target->GetSpec();
+  GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->GetRendererID()));
+  // blit one attachment at a time, glBlitFramebuffer reads one buffer
+  unsigned int colors = (unsigned int)std::min(m_ColorAttachments.size(),
+                                               to.ColorFormats.size());
+  for (unsigned int i = 0; i < colors; i++) {
+    GLenum attachment = GL_COLOR_ATTACHMENT0 + i;
+    GLCall(glReadBuffer(attachment));
+    GLCall(glDrawBuffers(1, &attachment));
+    GLCall(glBlitFramebuffer(0, 0, m_Spec.Width, m_Spec.Height, 0, 0,
+                             to.Width, to.Height, GL_COLOR_BUFFER_BIT,
+                             GL_NEAREST));
+  }
+  if (m_Spec.DepthFormat && to.DepthFormat) {
+    GLbitfield mask = GL_DEPTH_BUFFER_BIT;
+    if (TextureFormat::HasStencil(m_Spec.DepthFormat) &&
+        TextureFormat::HasStencil(to.DepthFormat))
+      mask |= GL_STENCIL_BUFFER_BIT;
+    GLCall(glBlitFramebuffer(0, 0, m_Spec.Width, m_Spec.Height, 0, 0, to.Width,
+                             to.Height, mask, GL_NEAREST));
+  }
+
+  // put the target's draw buffers back
+  std::vector<GLenum> drawBuffers;
+  for (unsigned int i = 0; i < to.ColorFormats.size(); i++)
+    drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+  if (!drawBuffers.empty()) {
+    GLCall(glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data()));
+  }
+  GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+struct FramebufferSpec {
+  unsigned int Width;
+  unsigned int Height;
+  unsigned int Samples;  // 1 = no MSAA
+  std::vector<unsigned int> ColorFormats;  // one per color attachment (MRT)
+  unsigned int DepthFormat;  // 0 = none, GL_DEPTH24_STENCIL8...
+  // sample depth later; otherwise it is a renderbuffer
+  bool DepthTexture;
+
+  FramebufferSpec()
+      : Width(0), Height(0), Samples(1), DepthFormat(0), DepthTexture(false) {}
+};
+
+// Offscreen render target. Single sampled color attachments are textures
+// that can be sampled afterwards; multisampled attachments are
+// renderbuffers and have to be resolved into a single sampled framebuffer
+// with Resolve() (glBlitFramebuffer). Attachments come from a
+// RenderTargetPool, so framebuffers created per frame or resized reuse
+// the same GL textures.
+class Framebuffer {
+ private:
+  unsigned int m_RendererID;
+  FramebufferSpec m_Spec;
+  std::vector<unsigned int> m_ColorAttachments;
+  unsigned int m_DepthAttachment;
+  RenderTargetPool* m_Pool;
+  std::unique_ptr<RenderTargetPool> m_OwnPool;  // when none is shared
+
+ public:
+  Framebuffer(const FramebufferSpec& spec, RenderTargetPool* pool = nullptr);
+  ~Framebuffer();
+  Framebuffer(const Framebuffer&) = delete;
+  Framebuffer& operator=(const Framebuffer&) = delete;
+
+  // bind for drawing and set the viewport to its size
+  void Bind() const;
+  void Unbind() const;
+  // reallocates the attachments
+  void Resize(unsigned int width, unsigned int height);
+
+  // Resolve (or copy) every color attachment into the one with the same
+  // index in `target`, and depth when both have it. target = nullptr blits
+  // attachment 0 to the default framebuffer, scaled to width x height.
+  void Resolve(const Framebuffer* target, unsigned int width = 0,
+               unsigned int height = 0) const;
+
+  // texture, or renderbuffer when multisampled
+  inline unsigned int GetColorAttachment(unsigned int index = 0) const {
+    return m_ColorAttachments[index];
+  }
+  inline unsigned int GetDepthAttachment() const { return m_DepthAttachment; }
+  inline const FramebufferSpec& GetSpec() const { return m_Spec; }
+  inline unsigned int GetRendererID() const { return m_RendererID; }
+
+ private:
+  RenderTargetDesc GetColorDesc(unsigned int index) const;
+  RenderTargetDesc GetDepthDesc() const;
+  void Invalidate();
+  void Release();
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include "glm/glm.hpp"
+
+// Six clip planes of a (view) projection matrix in the space the matrix
+// transforms from. Normals point inwards and are normalized, so plane
+// distances are in world units.
+struct Frustum {
+  enum { Left, Right, Bottom, Top, Near, Far, Count };
+  glm::vec4 Planes[Count];
+
+  static Frustum FromMatrix(const glm::mat4& m) {
+    // glm is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.Planes[Left] = row3 + row0;
+    frustum.Planes[Right] = row3 - row0;
+    frustum.Planes[Bottom] = row3 + row1;
+    frustum.Planes[Top] = row3 - row1;
+    frustum.Planes[Near] = row3 + row2;
+    frustum.Planes[Far] = row3 - row2;
+    for (glm::vec4& plane : frustum.Planes)
+      plane /= glm::length(glm::vec3(plane));
+    return frustum;
+  }
+
+  bool IntersectsSphere(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : Planes)
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+    return true;
+  }
+};
@@ -0,0 +1,267 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "JobSystem.h"
+#include "Log.h"
+#include "Simd.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+
+const unsigned int kLanes = 8;
+// below this, threads cost more than they save
+const unsigned int kMinObjectsPerThread = 16384;
+
+#if SIMD_AVX2
+// a * b + c, fused only when the build enables FMA
+inline __m256 MulAdd(__m256 a, __m256 b, __m256 c) {
+#if SIMD_FMA
+  return _mm256_fmadd_ps(a, b, c);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+}  // namespace
+
+void FrustumCuller::Reserve(unsigned int count) {
+  size_t padded = (count + kLanes - 1) / kLanes * kLanes;
+  for (std::vector<float>* v : {&m_CenterX, &m_CenterY, &m_CenterZ,
+                                &m_ExtentX, &m_ExtentY, &m_ExtentZ, &m_Radius})
+    v->reserve(padded);
+}
+
+void FrustumCuller::Grow() {
+  // keep the arrays a multiple of kLanes long, the padding has a negative
+  // radius so it is always culled
+  if (m_Count < m_CenterX.size()) return;
+  for (std::vector<float>* v : {&m_CenterX, &m_CenterY, &m_CenterZ,
+                                &m_ExtentX, &m_ExtentY, &m_ExtentZ})
+    v->resize(v->size() + kLanes, 0.0f);
+  m_Radius.resize(m_Radius.size() + kLanes, -1e30f);
+}
+
+unsigned int FrustumCuller::AddBox(const glm::vec3& min, const glm::vec3& max) {
+  Grow();
+  SetBox(m_Count, min, max);
+  return m_Count++;
+}
+
+unsigned int FrustumCuller::AddSphere(const glm::vec3& center, float radius) {
+  Grow();
+  SetSphere(m_Count, center, radius);
+  return m_Count++;
+}
+
+void FrustumCuller::SetBox(unsigned int object, const glm::vec3& min,
+                           const glm::vec3& max) {
+  glm::vec3 center = (min + max) * 0.5f;
+  glm::vec3 extent = (max - min) * 0.5f;
+  m_CenterX[object] = center.x;
+  m_CenterY[object] = center.y;
+  m_CenterZ[object] = center.z;
+  m_ExtentX[object] = extent.x;
+  m_ExtentY[object] = extent.y;
+  m_ExtentZ[object] = extent.z;
+  m_Radius[object] = glm::length(extent);
+}
+
+void FrustumCuller::SetSphere(unsigned int object, const glm::vec3& center,
+                              float radius) {
+  m_CenterX[object] = center.x;
+  m_CenterY[object] = center.y;
+  m_CenterZ[object] = center.z;
+  m_ExtentX[object] = radius;
+  m_ExtentY[object] = radius;
+  m_ExtentZ[object] = radius;
+  m_Radius[object] = radius;
+}
+
+void FrustumCuller::Clear() {
+  m_Count = 0;
+  for (std::vector<float>* v : {&m_CenterX, &m_CenterY, &m_CenterZ,
+                                &m_ExtentX, &m_ExtentY, &m_ExtentZ, &m_Radius})
+    v->clear();
+}
+
+void FrustumCuller::CullRange(const Frustum& frustum, unsigned int begin,
+                              unsigned int end,
+                              std::vector<unsigned int>& visible) const {
+  // begin is a multiple of kLanes, end may be anywhere up to the padding
+#if SIMD_AVX2
+  __m256 px[Frustum::Count], py[Frustum::Count], pz[Frustum::Count],
+      pw[Frustum::Count], ax[Frustum::Count], ay[Frustum::Count],
+      az[Frustum::Count];
+  for (int p = 0; p < Frustum::Count; p++) {
+    const glm::vec4& plane = frustum.Planes[p];
+    px[p] = _mm256_set1_ps(plane.x);
+    py[p] = _mm256_set1_ps(plane.y);
+    pz[p] = _mm256_set1_ps(plane.z);
+    pw[p] = _mm256_set1_ps(plane.w);
+    ax[p] = _mm256_set1_ps(std::fabs(plane.x));
+    ay[p] = _mm256_set1_ps(std::fabs(plane.y));
+    az[p] = _mm256_set1_ps(std::fabs(plane.z));
+  }
+  for (unsigned int base = begin; base < end; base += 8) {
+    __m256 cx = _mm256_loadu_ps(&m_CenterX[base]);
+    __m256 cy = _mm256_loadu_ps(&m_CenterY[base]);
+    __m256 cz = _mm256_loadu_ps(&m_CenterZ[base]);
+    __m256 ex = _mm256_loadu_ps(&m_ExtentX[base]);
+    __m256 ey = _mm256_loadu_ps(&m_ExtentY[base]);
+    __m256 ez = _mm256_loadu_ps(&m_ExtentZ[base]);
+    __m256 radius = _mm256_loadu_ps(&m_Radius[base]);
+    __m256 out = _mm256_cmp_ps(radius, _mm256_setzero_ps(), _CMP_LT_OQ);
+    for (int p = 0; p < Frustum::Count; p++) {
+      __m256 d = MulAdd(cx, px[p],
+                        MulAdd(cy, py[p], MulAdd(cz, pz[p], pw[p])));
+      // projected box radius on the plane normal
+      __m256 r =
+          MulAdd(ex, ax[p], MulAdd(ey, ay[p], _mm256_mul_ps(ez, az[p])));
+      r = _mm256_min_ps(r, radius);
+      out = _mm256_or_ps(out, _mm256_cmp_ps(_mm256_add_ps(d, r),
+                                            _mm256_setzero_ps(), _CMP_LT_OQ));
+    }
+    unsigned int mask = ~(unsigned int)_mm256_movemask_ps(out) & 0xFF;
+    while (mask) {
+      unsigned int lane = 0;
+      while (!(mask & (1u << lane))) lane++;
+      mask &= mask - 1;
+      if (base + lane < end) visible.push_back(base + lane);
+    }
+  }
+#elif SIMD_SSE
+  __m128 px[Frustum::Count], py[Frustum::Count], pz[Frustum::Count],
+      pw[Frustum::Count], ax[Frustum::Count], ay[Frustum::Count],
+      az[Frustum::Count];
+  for (int p = 0; p < Frustum::Count; p++) {
+    const glm::vec4& plane = frustum.Planes[p];
+    px[p] = _mm_set1_ps(plane.x);
+    py[p] = _mm_set1_ps(plane.y);
+    pz[p] = _mm_set1_ps(plane.z);
+    pw[p] = _mm_set1_ps(plane.w);
+    ax[p] = _mm_set1_ps(std::fabs(plane.x));
+    ay[p] = _mm_set1_ps(std::fabs(plane.y));
+    az[p] = _mm_set1_ps(std::fabs(plane.z));
+  }
+  for (unsigned int base = begin; base < end; base += 4) {
+    __m128 cx = _mm_loadu_ps(&m_CenterX[base]);
+    __m128 cy = _mm_loadu_ps(&m_CenterY[base]);
+    __m128 cz = _mm_loadu_ps(&m_CenterZ[base]);
+    __m128 ex = _mm_loadu_ps(&m_ExtentX[base]);
+    __m128 ey = _mm_loadu_ps(&m_ExtentY[base]);
+    __m128 ez = _mm_loadu_ps(&m_ExtentZ[base]);
+    __m128 radius = _mm_loadu_ps(&m_Radius[base]);
+    __m128 out = _mm_cmplt_ps(radius, _mm_setzero_ps());
+    for (int p = 0; p < Frustum::Count; p++) {
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, px[p]),
+                                       _mm_mul_ps(cy, py[p])),
+                            _mm_add_ps(_mm_mul_ps(cz, pz[p]), pw[p]));
+      // projected box radius on the plane normal
+      __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ax[p]),
+                                       _mm_mul_ps(ey, ay[p])),
+                            _mm_mul_ps(ez, az[p]));
+      r = _mm_min_ps(r, radius);
+      out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+    }
+    unsigned int mask = ~(unsigned int)_mm_movemask_ps(out) & 0xF;
+    for (unsigned int lane = 0; mask; lane++, mask >>= 1)
+      if ((mask & 1) && base + lane < end) visible.push_back(base + lane);
+  }
+#else
+  for (unsigned int i = begin; i < end; i++) {
+    bool inside = m_Radius[i] >= 0.0f;
+    for (int p = 0; p < Frustum::Count && inside; p++) {
+      const glm::vec4& plane = frustum.Planes[p];
+      float d = plane.x * m_CenterX[i] + plane.y * m_CenterY[i] +
+                plane.z * m_CenterZ[i] + plane.w;
+      float r = std::fabs(plane.x) * m_ExtentX[i] +
+                std::fabs(plane.y) * m_ExtentY[i] +
+                std::fabs(plane.z) * m_ExtentZ[i];
+      inside = d + std::min(r, m_Radius[i]) >= 0.0f;
+    }
+    if (inside) visible.push_back(i);
+  }
+#endif
+}
+
+unsigned int FrustumCuller::Cull(const Frustum& frustum,
+                                 std::vector<unsigned int>& visible,
+                                 unsigned int threads) const {
+  visible.clear();
+  JobSystem& jobs = JobSystem::Get();
+  if (threads == 0) threads = jobs.GetWorkerCount();
+  threads = std::min(threads, std::max(1u, m_Count / kMinObjectsPerThread));
+
+  if (threads <= 1) {
+    CullRange(frustum, 0, m_Count, visible);
+    return (unsigned int)visible.size();
+  }
+
+  // contiguous chunks as jobs, each compacts into its own list
+  unsigned int chunk = (m_Count + threads - 1) / threads;
+  chunk = (chunk + kLanes - 1) / kLanes * kLanes;
+  std::vector<std::vector<unsigned int>> partial(threads);
+  JobCounter counter;
+  for (unsigned int t = 1; t < threads; t++) {
+    unsigned int begin = std::min(m_Count, t * chunk);
+    unsigned int end = std::min(m_Count, begin + chunk);
+    jobs.Run(
+        [this, &frustum, &partial, t, begin, end]() {
+          CullRange(frustum, begin, end, partial[t]);
+        },
+        &counter);
+  }
+  CullRange(frustum, 0, std::min(m_Count, chunk), visible);
+  jobs.Wait(counter);
+
+  for (unsigned int t = 1; t < threads; t++)
+    visible.insert(visible.end(), partial[t].begin(), partial[t].end());
+  return (unsigned int)visible.size();
+}
+
+void FrustumCuller::Benchmark(unsigned int objectCount) {
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+  FrustumCuller culler;
+  culler.Reserve(objectCount);
+  for (unsigned int i = 0; i < objectCount; i++) {
+    glm::vec3 center(position(random), position(random), position(random));
+    if (i & 1) {
+      culler.AddSphere(center, size(random));
+    } else {
+      glm::vec3 extent(size(random), size(random), size(random));
+      culler.AddBox(center - extent, center + extent);
+    }
+  }
+
+  glm::mat4 viewProjection =
+      glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 150.0f) *
+      glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+                  glm::vec3(0.0f, 1.0f, 0.0f));
+  Frustum frustum = Frustum::FromMatrix(viewProjection);
+
+  unsigned int hardware = JobSystem::Get().GetWorkerCount();
+  std::vector<unsigned int> visible;
+  for (unsigned int threads : {1u, hardware}) {
+    const int kRuns = 10;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int run = 0; run < kRuns; run++) culler.Cull(frustum, visible, threads);
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::high_resolution_clock::now() - start)
+                    .count() /
+                kRuns;
+    std::cout << "[FrustumCuller] " << objectCount << " objects, " << threads
+              << " threads: " << ns / 1e6 << " ms, " << visible.size()
+              << " visible, " << objectCount / ns / threads
+              << " objects/ns/core" << std::endl;
+    if (hardware == 1) break;
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+
+#include "Frustum.h"
+#include "glm/glm.hpp"
+
+// Bounds of many objects in structure of arrays form, tested 4 (SSE) or 8
+// (AVX2) at a time against a frustum. Every object has both a box and a
+// sphere; an object is culled if either is fully outside one plane.
+class FrustumCuller {
+ private:
+  // padded to a multiple of 8 with objects that are always culled
+  std::vector<float> m_CenterX, m_CenterY, m_CenterZ;
+  std::vector<float> m_ExtentX, m_ExtentY, m_ExtentZ;
+  std::vector<float> m_Radius;
+  unsigned int m_Count;
+
+ public:
+  FrustumCuller() : m_Count(0) {}
+
+  void Reserve(unsigned int count);
+  // returns the object's index, which is what Cull reports
+  unsigned int AddBox(const glm::vec3& min, const glm::vec3& max);
+  unsigned int AddSphere(const glm::vec3& center, float radius);
+  void SetBox(unsigned int object, const glm::vec3& min, const glm::vec3& max);
+  void SetSphere(unsigned int object, const glm::vec3& center, float radius);
+  void Clear();
+
+  // Replace `visible` with the indices of the objects intersecting the
+  // frustum, in increasing order. Large sets are split into `threads` jobs
+  // on the shared JobSystem (0 = one per worker).
+  unsigned int Cull(const Frustum& frustum, std::vector<unsigned int>& visible,
+                    unsigned int threads = 0) const;
+
+  inline unsigned int GetCount() const { return m_Count; }
+
+  // objects per ns per core, single and multi threaded
+  static void Benchmark(unsigned int objectCount = 1000000);
+
+ private:
+  void CullRange(const Frustum& frustum, unsigned int begin, unsigned int end,
+                 std::vector<unsigned int>& visible) const;
+  void Grow();
+};
@@ -0,0 +1,475 @@
+#include "GltfLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+#include "GL/glew.h"
+#include "Json.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+namespace {
+
+const unsigned int kGlbMagic = 0x46546C67;      // "glTF"
+const unsigned int kGlbChunkJson = 0x4E4F534A;  // "JSON"
+const unsigned int kGlbChunkBin = 0x004E4942;   // "BIN\0"
+const int kModeTriangles = 4;
+
+struct BufferData {
+  const unsigned char* Data;
+  size_t Size;
+};
+
+struct Accessor {
+  const unsigned char* Data;  // first element
+  int BufferView;
+  unsigned int ViewOffset;    // byte offset of the bufferView in its buffer
+  unsigned int ViewLength;
+  unsigned int ByteOffset;    // offset of the first element in the view
+  unsigned int Stride;        // bytes between elements
+  unsigned int ComponentType;  // same values as the GL enums
+  unsigned int Components;
+  unsigned int Count;
+  bool Normalized;
+};
+
+int AttributeLocation(const JsonDocument& doc, int key) {
+  if (doc.Equals(key, "POSITION")) return 0;
+  if (doc.Equals(key, "TEXCOORD_0")) return 1;
+  if (doc.Equals(key, "NORMAL")) return 2;
+  if (doc.Equals(key, "COLOR_0")) return 3;
+  if (doc.Equals(key, "TANGENT")) return 4;
+  return -1;
+}
+
+unsigned int ComponentCount(const JsonDocument& doc, int type) {
+  if (doc.Equals(type, "SCALAR")) return 1;
+  if (doc.Equals(type, "VEC2")) return 2;
+  if (doc.Equals(type, "VEC3")) return 3;
+  if (doc.Equals(type, "VEC4")) return 4;
+  return 0;
+}
+
+// member `name` of `object`, `fallback` when it is missing; false when it is
+// there but not a non-negative int
+bool ReadUnsigned(const JsonDocument& doc, int object, const char* name,
+                  unsigned int fallback, unsigned int& value) {
+  int node = doc.Find(object, name);
+  if (node < 0) {
+    value = fallback;
+    return true;
+  }
+  int number = doc.GetInt(node, -1);
+  value = (unsigned int)number;
+  return number >= 0;
+}
+
+// resolve and bounds check accessor `index`
+bool ReadAccessor(const JsonDocument& doc, const std::vector<BufferData>& buffers,
+                  int index, Accessor& accessor) {
+  int node = doc.At(doc.Find(doc.Root(), "accessors"), index);
+  int view = doc.At(doc.Find(doc.Root(), "bufferViews"),
+                    doc.GetInt(doc.Find(node, "bufferView"), -1));
+  if (node < 0 || view < 0) return false;
+
+  unsigned int buffer;
+  if (!ReadUnsigned(doc, view, "buffer", 0, buffer) ||
+      buffer >= buffers.size())
+    return false;
+
+  accessor.BufferView = doc.GetInt(doc.Find(node, "bufferView"));
+  if (!ReadUnsigned(doc, view, "byteOffset", 0, accessor.ViewOffset) ||
+      !ReadUnsigned(doc, view, "byteLength", 0, accessor.ViewLength) ||
+      !ReadUnsigned(doc, node, "byteOffset", 0, accessor.ByteOffset) ||
+      !ReadUnsigned(doc, node, "componentType", 0, accessor.ComponentType) ||
+      !ReadUnsigned(doc, node, "count", 0, accessor.Count) ||
+      !ReadUnsigned(doc, view, "byteStride", 0, accessor.Stride))
+    return false;
+  accessor.Components = ComponentCount(doc, doc.Find(node, "type"));
+  accessor.Normalized = doc.GetNumber(doc.Find(node, "normalized")) != 0.0;
+  switch (accessor.ComponentType) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+      break;
+    default:
+      std::cout << "Unsupported accessor component type "
+                << accessor.ComponentType << std::endl;
+      return false;
+  }
+
+  unsigned int elementSize =
+      VertexBufferElement::GetSizeOfType(accessor.ComponentType) *
+      accessor.Components;
+  if (accessor.Stride == 0) accessor.Stride = elementSize;
+  if (elementSize == 0 || accessor.Count == 0) return false;
+
+  // 64 bit, size_t is 32 on Win32 and a malformed file could wrap it
+  uint64_t end = (uint64_t)accessor.ByteOffset +
+                 (uint64_t)accessor.Stride * (accessor.Count - 1) +
+                 elementSize;
+  if (end > accessor.ViewLength ||
+      (uint64_t)accessor.ViewOffset + accessor.ViewLength >
+          buffers[buffer].Size)
+    return false;
+
+  accessor.Data =
+      buffers[buffer].Data + accessor.ViewOffset + accessor.ByteOffset;
+  return true;
+}
+
+// index `e` of an unsigned index accessor
+inline unsigned int ReadIndex(const Accessor& indices, unsigned int e) {
+  const unsigned char* p = indices.Data + (size_t)e * indices.Stride;
+  if (indices.ComponentType == GL_UNSIGNED_INT) {
+    unsigned int index;
+    memcpy(&index, p, 4);
+    return index;
+  }
+  if (indices.ComponentType == GL_UNSIGNED_SHORT) return p[0] | (p[1] << 8);
+  return p[0];
+}
+
+// every index has to name one of the vertexCount vertices, or the GPU (or
+// the mesh optimizer) reads past the vertex data
+bool IndicesInRange(const Accessor& indices, unsigned int vertexCount) {
+  for (unsigned int e = 0; e < indices.Count; e++)
+    if (ReadIndex(indices, e) >= vertexCount) return false;
+  return true;
+}
+
+std::string Directory(const std::string& path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// split a .glb into its JSON and BIN chunks; a plain .gltf is all JSON
+bool SplitContainer(const unsigned char* data, size_t size, const char*& json,
+                    size_t& jsonSize, BufferData& bin) {
+  bin = {nullptr, 0};
+  unsigned int header[3] = {0, 0, 0};
+  if (size >= 12) memcpy(header, data, 12);
+  if (header[0] != kGlbMagic) {
+    json = (const char*)data;
+    jsonSize = size;
+    return true;
+  }
+  if (header[1] != 2 || header[2] > size) {
+    std::cout << "Unsupported GLB version " << header[1] << std::endl;
+    return false;
+  }
+
+  json = nullptr;
+  size_t offset = 12;
+  while (offset + 8 <= header[2]) {
+    unsigned int chunk[2];
+    memcpy(chunk, data + offset, 8);
+    offset += 8;
+    if (offset + chunk[0] > header[2]) return false;
+    if (chunk[1] == kGlbChunkJson) {
+      json = (const char*)data + offset;
+      jsonSize = chunk[0];
+    } else if (chunk[1] == kGlbChunkBin) {
+      bin = {data + offset, chunk[0]};
+    }
+    offset += chunk[0];
+  }
+  return json != nullptr;
+}
+
+typedef std::function<bool(const JsonDocument& doc,
+                           const std::vector<BufferData>& buffers,
+                           int primitive)>
+    PrimitiveVisitor;
+
+bool BuildMapped(const JsonDocument& doc, const std::vector<BufferData>& buffers,
+                 int primitive, GltfModel& model,
+                 std::vector<int>& viewBuffers) {
+  GltfPrimitive result;
+  result.VAO.reset(new VertexArray());
+  result.VertexCount = 0;
+  result.Min = result.Max = glm::vec3(0.0f);
+
+  int attributes = doc.Find(primitive, "attributes");
+  // object members are key, value pairs, the next key follows the value
+  int key = attributes + 1;
+  for (unsigned int i = 0; i < doc.Size(attributes);
+       i++, key = doc.GetNode(key + 1).End) {
+    int location = AttributeLocation(doc, key);
+    if (location < 0) continue;
+
+    Accessor accessor;
+    if (!ReadAccessor(doc, buffers, doc.GetInt(key + 1, -1), accessor))
+      return false;
+
+    // upload every bufferView once, attributes interleaved in it share it
+    if (viewBuffers.size() <= (size_t)accessor.BufferView)
+      viewBuffers.resize(accessor.BufferView + 1, -1);
+    if (viewBuffers[accessor.BufferView] < 0) {
+      viewBuffers[accessor.BufferView] = (int)model.Buffers.size();
+      model.Buffers.emplace_back(new VertexBuffer(
+          accessor.Data - accessor.ByteOffset, accessor.ViewLength));
+    }
+
+    VertexBufferLayout layout;
+    layout.Push(accessor.ComponentType, accessor.Components,
+                accessor.Normalized ? GL_TRUE : GL_FALSE, accessor.ByteOffset);
+    layout.SetStride(accessor.Stride);
+    result.VAO->AddBuffer(*model.Buffers[viewBuffers[accessor.BufferView]],
+                          layout, location);
+
+    if (location == 0) {
+      int node = doc.At(doc.Find(doc.Root(), "accessors"),
+                        doc.GetInt(key + 1, -1));
+      int min = doc.Find(node, "min"), max = doc.Find(node, "max");
+      for (unsigned int c = 0; c < 3 && c < accessor.Components; c++) {
+        result.Min[c] = (float)doc.GetNumber(doc.At(min, c));
+        result.Max[c] = (float)doc.GetNumber(doc.At(max, c));
+      }
+      result.VertexCount = accessor.Count;
+    }
+  }
+
+  Accessor indices;
+  if (!ReadAccessor(doc, buffers, doc.GetInt(doc.Find(primitive, "indices"), -1),
+                    indices) ||
+      indices.Components != 1 || indices.ComponentType == GL_BYTE ||
+      indices.ComponentType == GL_SHORT ||
+      indices.ComponentType == GL_FLOAT ||
+      indices.Stride !=
+          VertexBufferElement::GetSizeOfType(indices.ComponentType) ||
+      !IndicesInRange(indices, result.VertexCount))
+    return false;
+  result.Indices.reset(
+      new IndexBuffer(indices.Data, indices.Count, indices.ComponentType));
+  result.VAO->SetIndexBuffer(*result.Indices);
+
+  model.Primitives.push_back(std::move(result));
+  return true;
+}
+
+bool BuildCopying(const JsonDocument& doc,
+                  const std::vector<BufferData>& buffers, int primitive,
+                  GltfModel& model) {
+  GltfPrimitive result;
+  result.VAO.reset(new VertexArray());
+  result.VertexCount = 0;
+  result.Min = result.Max = glm::vec3(0.0f);
+
+  int attributes = doc.Find(primitive, "attributes");
+  int key = attributes + 1;
+  for (unsigned int i = 0; i < doc.Size(attributes);
+       i++, key = doc.GetNode(key + 1).End) {
+    int location = AttributeLocation(doc, key);
+    if (location < 0) continue;
+
+    Accessor accessor;
+    if (!ReadAccessor(doc, buffers, doc.GetInt(key + 1, -1), accessor))
+      return false;
+    if (accessor.ComponentType != GL_FLOAT) continue;
+
+    // de-interleave into a packed float array
+    std::vector<float> data(accessor.Count * accessor.Components);
+    for (unsigned int e = 0; e < accessor.Count; e++)
+      memcpy(&data[e * accessor.Components], accessor.Data + e * accessor.Stride,
+             accessor.Components * sizeof(float));
+
+    model.Buffers.emplace_back(new VertexBuffer(
+        data.data(), (unsigned int)(data.size() * sizeof(float))));
+    VertexBufferLayout layout;
+    layout.Push(GL_FLOAT, accessor.Components, GL_FALSE, 0);
+    result.VAO->AddBuffer(*model.Buffers.back(), layout, location);
+
+    if (location == 0) result.VertexCount = accessor.Count;
+  }
+
+  Accessor indices;
+  if (!ReadAccessor(doc, buffers, doc.GetInt(doc.Find(primitive, "indices"), -1),
+                    indices) ||
+      indices.Components != 1 ||
+      !IndicesInRange(indices, result.VertexCount))
+    return false;
+  std::vector<unsigned int> data(indices.Count);
+  for (unsigned int e = 0; e < indices.Count; e++)
+    data[e] = ReadIndex(indices, e);
+  result.Indices.reset(new IndexBuffer(data.data(), indices.Count));
+  result.VAO->SetIndexBuffer(*result.Indices);
+
+  model.Primitives.push_back(std::move(result));
+  return true;
+}
+
+// read a CPU copy as position, texcoord, normal floats
+bool ReadPrimitive(const JsonDocument& doc,
+                   const std::vector<BufferData>& buffers, int primitive,
+                   GltfMeshData& mesh) {
+  const unsigned int kFloats = GltfMeshData::kFloatsPerVertex;
+  const unsigned int offsets[3] = {0, 3, 5};  // POSITION, TEXCOORD_0, NORMAL
+
+  int attributes = doc.Find(primitive, "attributes");
+  int key = attributes + 1;
+  for (unsigned int i = 0; i < doc.Size(attributes);
+       i++, key = doc.GetNode(key + 1).End) {
+    int location = AttributeLocation(doc, key);
+    if (location < 0 || location > 2) continue;
+
+    Accessor accessor;
+    if (!ReadAccessor(doc, buffers, doc.GetInt(key + 1, -1), accessor))
+      return false;
+    if (accessor.ComponentType != GL_FLOAT) continue;
+
+    if (mesh.Vertices.empty())
+      mesh.Vertices.resize((size_t)accessor.Count * kFloats, 0.0f);
+    if (mesh.Vertices.size() != (size_t)accessor.Count * kFloats) return false;
+
+    unsigned int components =
+        std::min(accessor.Components, location == 1 ? 2u : 3u);
+    for (unsigned int e = 0; e < accessor.Count; e++)
+      memcpy(&mesh.Vertices[(size_t)e * kFloats + offsets[location]],
+             accessor.Data + (size_t)e * accessor.Stride,
+             components * sizeof(float));
+  }
+
+  Accessor indices;
+  if (!ReadAccessor(doc, buffers, doc.GetInt(doc.Find(primitive, "indices"), -1),
+                    indices) ||
+      indices.Components != 1 ||
+      !IndicesInRange(indices,
+                      (unsigned int)(mesh.Vertices.size() / kFloats)))
+    return false;
+  mesh.Indices.resize(indices.Count);
+  for (unsigned int e = 0; e < indices.Count; e++)
+    mesh.Indices[e] = ReadIndex(indices, e);
+  return true;
+}
+
+bool VisitPrimitives(const std::string& path, const unsigned char* data,
+                     size_t size, const PrimitiveVisitor& visit) {
+  const char* jsonText;
+  size_t jsonSize;
+  BufferData bin;
+  if (!SplitContainer(data, size, jsonText, jsonSize, bin)) {
+    std::cout << "Failed to read " << path << std::endl;
+    return false;
+  }
+
+  JsonDocument doc;
+  if (!doc.Parse(jsonText, jsonSize)) return false;
+
+  // buffer 0 without a uri is the GLB binary chunk, others are external files
+  // that stay mapped while the primitives are built
+  std::vector<BufferData> buffers;
+  std::vector<std::unique_ptr<MappedFile>> external;
+  int bufferList = doc.Find(doc.Root(), "buffers");
+  for (unsigned int i = 0; i < doc.Size(bufferList); i++) {
+    int uri = doc.Find(doc.At(bufferList, i), "uri");
+    if (uri < 0) {
+      buffers.push_back(bin);
+      continue;
+    }
+    std::string name = doc.GetString(uri);
+    if (name.compare(0, 5, "data:") == 0) {
+      std::cout << "Embedded data URIs are not supported: " << path
+                << std::endl;
+      return false;
+    }
+    external.emplace_back(new MappedFile(Directory(path) + name));
+    buffers.push_back({external.back()->GetData(), external.back()->GetSize()});
+  }
+
+  int meshes = doc.Find(doc.Root(), "meshes");
+  for (unsigned int m = 0; m < doc.Size(meshes); m++) {
+    int primitives = doc.Find(doc.At(meshes, m), "primitives");
+    for (unsigned int p = 0; p < doc.Size(primitives); p++) {
+      int primitive = doc.At(primitives, p);
+      if (doc.GetInt(doc.Find(primitive, "mode"), kModeTriangles) !=
+              kModeTriangles ||
+          doc.Find(primitive, "indices") < 0) {
+        std::cout << "Skipping non indexed-triangle primitive in " << path
+                  << std::endl;
+        continue;
+      }
+      if (!visit(doc, buffers, primitive)) {
+        std::cout << "Invalid accessor in " << path << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool GltfLoader::Load(const std::string& path, GltfModel& model) {
+  MappedFile file(path);
+  if (!file.IsValid()) return false;
+  model.FileSize = file.GetSize();
+  std::vector<int> viewBuffers;
+  return VisitPrimitives(
+      path, file.GetData(), file.GetSize(),
+      [&](const JsonDocument& doc, const std::vector<BufferData>& buffers,
+          int primitive) {
+        return BuildMapped(doc, buffers, primitive, model, viewBuffers);
+      });
+}
+
+bool GltfLoader::LoadCopying(const std::string& path, GltfModel& model) {
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) {
+    std::cout << "Failed to open " << path << std::endl;
+    return false;
+  }
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(stream)),
+                                  std::istreambuf_iterator<char>());
+  model.FileSize = data.size();
+  return VisitPrimitives(
+      path, data.data(), data.size(),
+      [&](const JsonDocument& doc, const std::vector<BufferData>& buffers,
+          int primitive) {
+        return BuildCopying(doc, buffers, primitive, model);
+      });
+}
+
+bool GltfLoader::ReadMeshes(const std::string& path,
+                            std::vector<GltfMeshData>& meshes) {
+  MappedFile file(path);
+  if (!file.IsValid()) return false;
+  return VisitPrimitives(
+      path, file.GetData(), file.GetSize(),
+      [&](const JsonDocument& doc, const std::vector<BufferData>& buffers,
+          int primitive) {
+        meshes.emplace_back();
+        return ReadPrimitive(doc, buffers, primitive, meshes.back());
+      });
+}
+
+void GltfLoader::Benchmark(const std::string& path, unsigned int iterations) {
+  typedef bool (*LoadFunction)(const std::string&, GltfModel&);
+  const char* names[] = {"mapped", "copying"};
+  LoadFunction functions[] = {Load, LoadCopying};
+
+  for (unsigned int f = 0; f < 2; f++) {
+    double total = 0.0;
+    size_t size = 0;
+    for (unsigned int i = 0; i < iterations; i++) {
+      GltfModel model;
+      auto start = std::chrono::high_resolution_clock::now();
+      if (!functions[f](path, model)) return;
+      // include the upload itself, not just the queued commands
+      GLCall(glFinish());
+      auto end = std::chrono::high_resolution_clock::now();
+      total += std::chrono::duration<double, std::milli>(end - start).count();
+      size = model.FileSize;
+    }
+    double ms = total / iterations;
+    std::cout << "[GltfLoader] " << names[f] << ": " << ms << " ms, "
+              << ms / (size / (1024.0 * 1024.0)) << " ms/MB" << std::endl;
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IndexBuffer.h"
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+#include "glm/glm.hpp"
+
+struct GltfPrimitive {
+  std::unique_ptr<VertexArray> VAO;
+  std::unique_ptr<IndexBuffer> Indices;
+  unsigned int VertexCount;
+  glm::vec3 Min, Max;  // POSITION accessor bounds
+};
+
+struct GltfModel {
+  // one vertex buffer per glTF bufferView, shared by the primitives using it
+  std::vector<std::unique_ptr<VertexBuffer>> Buffers;
+  std::vector<GltfPrimitive> Primitives;
+  size_t FileSize;
+};
+
+// CPU copy of one primitive, for offline tools
+struct GltfMeshData {
+  // position xyz, texcoord uv, normal xyz; missing attributes are zero
+  static const unsigned int kFloatsPerVertex = 8;
+  std::vector<float> Vertices;
+  std::vector<unsigned int> Indices;
+};
+
+// glTF 2.0 loader. Attributes are bound to fixed shader locations:
+// POSITION 0, TEXCOORD_0 1, NORMAL 2, COLOR_0 3, TANGENT 4.
+// Only indexed triangle primitives are loaded.
+namespace GltfLoader {
+
+// Memory map a .glb (or a .gltf and its external .bin) and hand bufferView
+// byte ranges directly to VertexBuffer / IndexBuffer, with the vertex layout
+// taken from the accessors.
+bool Load(const std::string& path, GltfModel& model);
+
+// Reference path: read the file into memory, then copy every accessor into
+// tightly packed float / uint arrays before uploading.
+bool LoadCopying(const std::string& path, GltfModel& model);
+
+// Read every indexed triangle primitive into GltfMeshData.
+bool ReadMeshes(const std::string& path, std::vector<GltfMeshData>& meshes);
+
+// Time both paths over `iterations` loads and print ms and ms per MB.
+void Benchmark(const std::string& path, unsigned int iterations = 10);
+
+}  // namespace GltfLoader
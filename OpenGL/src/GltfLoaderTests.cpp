@@ -0,0 +1,137 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "GltfLoader.h"
+#include "SelfTest.h"
+
+namespace {
+
+// one triangle: three float3 positions, then three 16 bit indices
+struct Triangle {
+  float Positions[9];
+  unsigned short Indices[3];
+  unsigned short Padding;
+};
+
+std::string MakeJson(const std::string& uri, const std::string& indexCount,
+                     const std::string& positionOffset) {
+  std::string buffer = "{\"byteLength\": " +
+                       std::to_string(sizeof(Triangle)) +
+                       (uri.empty() ? "" : ", \"uri\": \"" + uri + "\"") + "}";
+  return "{\"asset\": {\"version\": \"2.0\"}, \"buffers\": [" + buffer +
+         "], \"bufferViews\": ["
+         "{\"buffer\": 0, \"byteOffset\": " + positionOffset +
+         ", \"byteLength\": 36},"
+         "{\"buffer\": 0, \"byteOffset\": 36, \"byteLength\": 6}],"
+         "\"accessors\": ["
+         "{\"bufferView\": 0, \"componentType\": 5126, \"count\": 3, "
+         "\"type\": \"VEC3\", \"min\": [0, 0, 0], \"max\": [1, 1, 0]},"
+         "{\"bufferView\": 1, \"componentType\": 5123, \"count\": " +
+         indexCount + ", \"type\": \"SCALAR\"}],"
+         "\"meshes\": [{\"primitives\": [{\"attributes\": {\"POSITION\": 0}, "
+         "\"indices\": 1}]}]}";
+}
+
+Triangle MakeTriangle(unsigned short lastIndex) {
+  Triangle triangle = {{0, 0, 0, 1, 0, 0, 0, 1, 0}, {0, 1, lastIndex}, 0};
+  return triangle;
+}
+
+// a .gltf and its .bin, `binSize` bytes of the buffer written
+std::string WriteGltf(const std::string& name, unsigned short lastIndex,
+                      const std::string& indexCount = "3",
+                      const std::string& positionOffset = "0",
+                      size_t binSize = sizeof(Triangle)) {
+  Triangle triangle = MakeTriangle(lastIndex);
+  SelfTest::WriteFile(name + ".bin", &triangle, binSize);
+  return SelfTest::WriteFile(
+      name + ".gltf", MakeJson(name + ".bin", indexCount, positionOffset));
+}
+
+// header, JSON chunk padded to 4 bytes, BIN chunk
+std::vector<unsigned char> MakeGlb() {
+  std::string json = MakeJson("", "3", "0");
+  json.resize((json.size() + 3) & ~(size_t)3, ' ');
+  Triangle triangle = MakeTriangle(2);
+  unsigned int header[3] = {0x46546C67, 2,
+                            (unsigned int)(12 + 8 + json.size() + 8 +
+                                           sizeof(triangle))};
+  unsigned int jsonChunk[2] = {(unsigned int)json.size(), 0x4E4F534A};
+  unsigned int binChunk[2] = {(unsigned int)sizeof(triangle), 0x004E4942};
+  std::vector<unsigned char> glb;
+  auto append = [&glb](const void* data, size_t size) {
+    glb.insert(glb.end(), (const unsigned char*)data,
+               (const unsigned char*)data + size);
+  };
+  append(header, sizeof(header));
+  append(jsonChunk, sizeof(jsonChunk));
+  append(json.data(), json.size());
+  append(binChunk, sizeof(binChunk));
+  append(&triangle, sizeof(triangle));
+  return glb;
+}
+
+bool LoadsMapped(const std::string& path) {
+  GltfModel model;
+  return GltfLoader::Load(path, model) && model.Primitives.size() == 1;
+}
+
+bool LoadsCopying(const std::string& path) {
+  GltfModel model;
+  return GltfLoader::LoadCopying(path, model) && model.Primitives.size() == 1;
+}
+
+bool ReadsMeshes(const std::string& path) {
+  std::vector<GltfMeshData> meshes;
+  return GltfLoader::ReadMeshes(path, meshes) && meshes.size() == 1 &&
+         meshes[0].Indices.size() == 3;
+}
+
+// every path has to turn the file down
+bool Rejected(const std::string& path) {
+  return !LoadsMapped(path) && !LoadsCopying(path) && !ReadsMeshes(path);
+}
+
+}  // namespace
+
+void SelfTest::GltfLoaderTests() {
+  std::string good = WriteGltf("good", 2);
+  EXPECT(LoadsMapped(good));
+  EXPECT(LoadsCopying(good));
+  EXPECT(ReadsMeshes(good));
+
+  // an index past the three positions
+  EXPECT(Rejected(WriteGltf("bad_index", 3)));
+  // counts and offsets that would overflow 32 bit arithmetic
+  EXPECT(Rejected(WriteGltf("huge_count", 2, "1e300")));
+  EXPECT(Rejected(WriteGltf("negative_count", 2, "-3")));
+  EXPECT(Rejected(WriteGltf("wrapping_offset", 2, "3", "4294967290")));
+  // the buffer is shorter than its byteLength
+  EXPECT(Rejected(WriteGltf("short_bin", 2, "3", "0", 20)));
+  // the .bin isn't there at all
+  EXPECT(Rejected(
+      WriteFile("missing_bin.gltf", MakeJson("missing.bin", "3", "0"))));
+  EXPECT(Rejected(WriteFile("truncated.gltf",
+                            MakeJson("good.bin", "3", "0").substr(0, 100))));
+
+  std::vector<unsigned char> glb = MakeGlb();
+  std::string glbPath = WriteFile("good.glb", glb.data(), glb.size());
+  EXPECT(LoadsMapped(glbPath));
+  EXPECT(LoadsCopying(glbPath));
+  EXPECT(ReadsMeshes(glbPath));
+
+  // the header claims more than the file holds
+  EXPECT(Rejected(WriteFile("truncated.glb", glb.data(), glb.size() - 8)));
+  // a chunk running past the end
+  std::vector<unsigned char> longChunk = glb;
+  unsigned int length = 0x7FFFFFF0;
+  memcpy(longChunk.data() + 12, &length, 4);
+  EXPECT(Rejected(
+      WriteFile("long_chunk.glb", longChunk.data(), longChunk.size())));
+  // GLB version 1
+  std::vector<unsigned char> version1 = glb;
+  version1[4] = 1;
+  EXPECT(Rejected(
+      WriteFile("version1.glb", version1.data(), version1.size())));
+}
@@ -0,0 +1,242 @@
+#include "GpuMemory.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "GL/glew.h"
+#include "TextureFormat.h"
+
+GpuMemory::GpuMemory()
+    : m_Budget(0), m_Frame(0), m_Evictions(0), m_Reloads(0) {
+  for (std::atomic<size_t>& bytes : m_Bytes) bytes.store(0);
+  for (std::atomic<size_t>& budget : m_CategoryBudgets) budget.store(0);
+}
+
+GpuMemory& GpuMemory::Get() {
+  static GpuMemory memory;
+  return memory;
+}
+
+void GpuMemory::Allocate(GpuMemoryCategory category, size_t bytes) {
+  m_Bytes[(int)category].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void GpuMemory::Free(GpuMemoryCategory category, size_t bytes) {
+  m_Bytes[(int)category].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t GpuMemory::GetTotal() const {
+  size_t total = 0;
+  for (const std::atomic<size_t>& bytes : m_Bytes)
+    total += bytes.load(std::memory_order_relaxed);
+  return total;
+}
+
+bool GpuMemory::SetBudgetFromDevice(float fraction) {
+  size_t total, available;
+  QueryDevice(total, available);
+  if (total == 0) return false;
+  m_Budget = (size_t)(total * fraction);
+  return true;
+}
+
+GpuMemory::EvictableID GpuMemory::RegisterEvictable(
+    GpuMemoryCategory category, size_t bytes, std::function<void()> evict,
+    std::function<void()> reload) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Evictable evictable{category, bytes, std::move(evict), std::move(reload),
+                      m_Frame, true, true};
+  if (!m_FreeEvictables.empty()) {
+    EvictableID id = m_FreeEvictables.back();
+    m_FreeEvictables.pop_back();
+    m_Evictables[id] = std::move(evictable);
+    return id;
+  }
+  m_Evictables.push_back(std::move(evictable));
+  return (EvictableID)m_Evictables.size() - 1;
+}
+
+void GpuMemory::UpdateEvictable(EvictableID id, std::function<void()> evict,
+                                std::function<void()> reload) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Evictables[id].Evict = std::move(evict);
+  m_Evictables[id].Reload = std::move(reload);
+}
+
+void GpuMemory::UnregisterEvictable(EvictableID id) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Evictable& evictable = m_Evictables[id];
+  evictable.Alive = false;
+  evictable.Evict = nullptr;
+  evictable.Reload = nullptr;
+  m_FreeEvictables.push_back(id);
+}
+
+void GpuMemory::Touch(EvictableID id) {
+  std::function<void()> reload;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Evictable& evictable = m_Evictables[id];
+    evictable.LastUsed = m_Frame;
+    if (evictable.Resident) return;
+    evictable.Resident = true;
+    reload = evictable.Reload;
+    m_Reloads++;
+  }
+  // outside the lock, reloading allocates and may register others
+  reload();
+}
+
+size_t GpuMemory::SelectVictims(GpuMemoryCategory category, size_t used,
+                                size_t budget,
+                                std::vector<std::function<void()>>& evict) {
+  if (budget == 0 || used <= budget) return 0;
+  // oldest first; only happens over budget, so sorting is fine
+  std::vector<EvictableID> candidates;
+  for (EvictableID id = 0; id < m_Evictables.size(); id++) {
+    const Evictable& evictable = m_Evictables[id];
+    if (evictable.Alive && evictable.Resident &&
+        evictable.LastUsed < m_Frame &&
+        (category == GpuMemoryCategory::Count ||
+         evictable.Category == category))
+      candidates.push_back(id);
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [this](EvictableID a, EvictableID b) {
+              return m_Evictables[a].LastUsed < m_Evictables[b].LastUsed;
+            });
+  size_t freed = 0;
+  for (EvictableID id : candidates) {
+    if (used <= budget + freed) break;
+    Evictable& evictable = m_Evictables[id];
+    evictable.Resident = false;
+    evict.push_back(evictable.Evict);
+    freed += evictable.Bytes;
+    m_Evictions++;
+  }
+  return freed;
+}
+
+void GpuMemory::EndFrame() {
+  std::vector<std::function<void()>> evict;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    size_t freed = 0;
+    for (int i = 0; i < (int)GpuMemoryCategory::Count; i++)
+      freed += SelectVictims((GpuMemoryCategory)i,
+                             GetBytes((GpuMemoryCategory)i),
+                             m_CategoryBudgets[i], evict);
+    // retired objects drain by themselves within a few frames; counting
+    // them would evict again for what was just evicted
+    size_t total = GetTotal() - GetBytes(GpuMemoryCategory::Retired);
+    SelectVictims(GpuMemoryCategory::Count, total - std::min(total, freed),
+                  m_Budget, evict);
+    m_Frame++;
+  }
+  for (const std::function<void()>& f : evict) f();
+}
+
+GpuMemoryStats GpuMemory::GetStats() {
+  GpuMemoryStats stats = {};
+  for (int i = 0; i < (int)GpuMemoryCategory::Count; i++)
+    stats.Bytes[i] = m_Bytes[i].load(std::memory_order_relaxed);
+  stats.Total = GetTotal();
+  stats.Budget = m_Budget;
+  QueryDevice(stats.DeviceTotal, stats.DeviceAvailable);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (const Evictable& evictable : m_Evictables) {
+    if (!evictable.Alive) continue;
+    stats.Evictables++;
+    stats.Evicted += !evictable.Resident;
+  }
+  stats.Evictions = m_Evictions;
+  stats.Reloads = m_Reloads;
+  return stats;
+}
+
+void GpuMemory::PrintStats() {
+  const double mb = 1.0 / (1024.0 * 1024.0);
+  GpuMemoryStats stats = GetStats();
+  std::cout << "[GpuMemory] " << stats.Total * mb << " MB";
+  if (stats.Budget) std::cout << " of " << stats.Budget * mb << " MB budget";
+  std::cout << " (";
+  for (int i = 0; i < (int)GpuMemoryCategory::Count; i++)
+    std::cout << (i ? ", " : "") << GetCategoryName((GpuMemoryCategory)i)
+              << " " << stats.Bytes[i] * mb;
+  std::cout << ")" << std::endl;
+  if (stats.DeviceTotal)
+    std::cout << "[GpuMemory] device " << stats.DeviceAvailable * mb
+              << " MB free of " << stats.DeviceTotal * mb << " MB"
+              << std::endl;
+  std::cout << "[GpuMemory] evictable " << stats.Evictables << ", evicted "
+            << stats.Evicted << ", evictions " << stats.Evictions
+            << ", reloads " << stats.Reloads << std::endl;
+}
+
+std::string GpuMemory::GetSummary() {
+  const double mb = 1.0 / (1024.0 * 1024.0);
+  GpuMemoryStats stats = GetStats();
+  std::ostringstream summary;
+  summary << std::fixed << std::setprecision(1) << stats.Total * mb;
+  if (stats.Budget) summary << "/" << stats.Budget * mb;
+  summary << " MB:";
+  for (int i = 0; i < (int)GpuMemoryCategory::Count; i++)
+    summary << (i ? ", " : " ") << GetCategoryName((GpuMemoryCategory)i) << " "
+            << stats.Bytes[i] * mb;
+  summary << " | evicted " << stats.Evicted << "/" << stats.Evictables
+          << ", evictions " << stats.Evictions << ", reloads "
+          << stats.Reloads;
+  return summary.str();
+}
+
+size_t GpuMemory::GetTextureBytes(unsigned int width, unsigned int height,
+                                  unsigned int internalFormat,
+                                  unsigned int levels) {
+  size_t bytes = 0;
+  for (unsigned int level = 0; levels == 0 || level < levels; level++) {
+    bytes += TextureFormat::GetImageBytes(width, height, internalFormat);
+    if (width == 1 && height == 1) break;
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+  return bytes;
+}
+
+const char* GpuMemory::GetCategoryName(GpuMemoryCategory category) {
+  switch (category) {
+    case GpuMemoryCategory::VertexBuffer:
+      return "vertex buffers";
+    case GpuMemoryCategory::IndexBuffer:
+      return "index buffers";
+    case GpuMemoryCategory::Texture:
+      return "textures";
+    case GpuMemoryCategory::RenderTarget:
+      return "render targets";
+    case GpuMemoryCategory::Retired:
+      return "retired";
+    default:
+      return "?";
+  }
+}
+
+void GpuMemory::QueryDevice(size_t& total, size_t& available) {
+  total = available = 0;
+  // both report KB
+  if (GLEW_NVX_gpu_memory_info) {
+    GLint dedicated = 0, free = 0;
+    glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated);
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &free);
+    total = (size_t)dedicated * 1024;
+    available = (size_t)free * 1024;
+  } else if (GLEW_ATI_meminfo) {
+    // total free, largest free block, auxiliary total, auxiliary largest
+    GLint free[4] = {};
+    glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free);
+    available = (size_t)free[0] * 1024;
+    // ATI has no total, what we use plus what is free will do
+    total = available + Get().GetTotal();
+  }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class GpuMemoryCategory {
+  VertexBuffer,
+  IndexBuffer,
+  Texture,
+  RenderTarget,
+  Retired,  // waiting in the DeletionQueue
+  Count
+};
+
+struct GpuMemoryStats {
+  size_t Bytes[(int)GpuMemoryCategory::Count];
+  size_t Total;
+  size_t Budget;  // 0 = unlimited
+  // from GL_NVX_gpu_memory_info / GL_ATI_meminfo, 0 when neither exists
+  size_t DeviceTotal;
+  size_t DeviceAvailable;
+  unsigned int Evictables;
+  unsigned int Evicted;     // evictables currently out of memory
+  unsigned int Evictions;   // so far
+  unsigned int Reloads;     // so far
+};
+
+// Counts the bytes every buffer and texture allocates, by category, and
+// keeps the scene under a budget: objects registered as evictable that
+// went unused longest are evicted (their GL storage freed) when EndFrame()
+// finds the total over budget, and Touch() reloads them the next time
+// they are needed.
+class GpuMemory {
+ public:
+  typedef unsigned int EvictableID;
+
+ private:
+  struct Evictable {
+    GpuMemoryCategory Category;
+    size_t Bytes;
+    std::function<void()> Evict;
+    std::function<void()> Reload;
+    unsigned int LastUsed;  // frame
+    bool Resident;
+    bool Alive;
+  };
+
+  std::atomic<size_t> m_Bytes[(int)GpuMemoryCategory::Count];
+  std::atomic<size_t> m_Budget;
+  std::atomic<size_t> m_CategoryBudgets[(int)GpuMemoryCategory::Count];
+
+  std::mutex m_Mutex;
+  std::vector<Evictable> m_Evictables;
+  std::vector<EvictableID> m_FreeEvictables;
+  unsigned int m_Frame;
+  unsigned int m_Evictions;
+  unsigned int m_Reloads;
+
+ public:
+  GpuMemory();
+  GpuMemory(const GpuMemory&) = delete;
+  GpuMemory& operator=(const GpuMemory&) = delete;
+
+  static GpuMemory& Get();
+
+  // any thread
+  void Allocate(GpuMemoryCategory category, size_t bytes);
+  void Free(GpuMemoryCategory category, size_t bytes);
+
+  inline size_t GetBytes(GpuMemoryCategory category) const {
+    return m_Bytes[(int)category].load(std::memory_order_relaxed);
+  }
+  size_t GetTotal() const;
+
+  // bytes = 0 turns the budget off. The total budget leaves out Retired,
+  // which the DeletionQueue empties by itself.
+  inline void SetBudget(size_t bytes) { m_Budget = bytes; }
+  inline void SetBudget(GpuMemoryCategory category, size_t bytes) {
+    m_CategoryBudgets[(int)category] = bytes;
+  }
+  // fraction of the dedicated video memory the driver reports, false and
+  // unchanged when it reports none
+  bool SetBudgetFromDevice(float fraction);
+
+  // Evict frees the object's GL storage (and Free()s it), Reload brings it
+  // back (and Allocate()s). Both run on the GL thread.
+  EvictableID RegisterEvictable(GpuMemoryCategory category, size_t bytes,
+                                std::function<void()> evict,
+                                std::function<void()> reload);
+  // the owner moved, swap in callbacks bound to the new one
+  void UpdateEvictable(EvictableID id, std::function<void()> evict,
+                       std::function<void()> reload);
+  void UnregisterEvictable(EvictableID id);
+  // used this frame, reloaded first if it was evicted
+  void Touch(EvictableID id);
+  inline bool IsResident(EvictableID id) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Evictables[id].Resident;
+  }
+
+  // on the GL thread once per frame: evict least recently used objects not
+  // touched this frame until every category and the total fit their budget
+  void EndFrame();
+
+  GpuMemoryStats GetStats();
+  void PrintStats();
+  // the same on one line, in MB, for the window title while running
+  std::string GetSummary();
+
+  // bytes of a 2D texture with `levels` mips, all levels when 0
+  static size_t GetTextureBytes(unsigned int width, unsigned int height,
+                                unsigned int internalFormat,
+                                unsigned int levels = 1);
+  static const char* GetCategoryName(GpuMemoryCategory category);
+
+ private:
+  // pick victims from `category` (Count = any) until `used` fits, returns
+  // the bytes they will free
+  size_t SelectVictims(GpuMemoryCategory category, size_t used,
+                       size_t budget,
+                       std::vector<std::function<void()>>& evict);
+  static void QueryDevice(size_t& total, size_t& available);
+};
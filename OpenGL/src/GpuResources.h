@@ -0,0 +1,32 @@
+#pragma once
+#include "HandlePool.h"
+#include "IndexBuffer.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+
+typedef Handle<VertexBuffer> VertexBufferHandle;
+typedef Handle<IndexBuffer> IndexBufferHandle;
+typedef Handle<VertexArray> VertexArrayHandle;
+typedef Handle<Shader> ShaderHandle;
+typedef Handle<Texture> TextureHandle;
+
+// a drawable: vertex layout plus the indices to draw with it
+struct RenderMesh {
+  VertexArrayHandle VAO;
+  IndexBufferHandle Indices;
+};
+typedef Handle<RenderMesh> MeshHandle;
+
+// Owns the GL objects of a scene. Draw commands and components keep the
+// 4 byte handles instead of pointers, and a handle to something already
+// destroyed resolves to nullptr.
+struct GpuResources {
+  HandlePool<VertexBuffer> VertexBuffers;
+  HandlePool<IndexBuffer> IndexBuffers;
+  HandlePool<VertexArray> VertexArrays;
+  HandlePool<Shader> Shaders;
+  HandlePool<Texture> Textures;
+  HandlePool<RenderMesh> Meshes;
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Log.h"
+
+// 32 bit reference to an object in a HandlePool<T>: slot index in the low
+// 20 bits, generation in the high 12. The generation changes every time a
+// slot is freed, so a handle to a destroyed object stops resolving instead
+// of aliasing whatever took its slot. 0 is never handed out.
+template <typename T>
+struct Handle {
+  static const uint32_t kIndexBits = 20;
+  static const uint32_t kIndexMask = (1u << kIndexBits) - 1;
+  static const uint32_t kGenerationMask = (1u << (32 - kIndexBits)) - 1;
+
+  uint32_t Value;
+
+  Handle() : Value(0) {}
+  Handle(uint32_t index, uint32_t generation)
+      : Value((generation << kIndexBits) | index) {}
+  // back from Value, e.g. when it was packed into a sort key
+  static Handle FromValue(uint32_t value) {
+    Handle handle;
+    handle.Value = value;
+    return handle;
+  }
+
+  inline uint32_t GetIndex() const { return Value & kIndexMask; }
+  inline uint32_t GetGeneration() const { return Value >> kIndexBits; }
+  inline bool IsNull() const { return Value == 0; }
+
+  inline bool operator==(const Handle& other) const {
+    return Value == other.Value;
+  }
+  inline bool operator!=(const Handle& other) const {
+    return Value != other.Value;
+  }
+};
+
+// Objects packed densely in one vector, addressed through generational
+// handles. Lookup is two array reads, iterating walks the objects in
+// memory order, and Destroy moves the last object into the hole, so T only
+// has to be movable; the GL wrappers are move-only for exactly this.
+template <typename T>
+class HandlePool {
+ private:
+  struct Slot {
+    uint32_t Dense;  // position in m_Items, or the next free slot
+    uint32_t Generation;
+  };
+
+  static const uint32_t kNone = ~0u;
+
+  std::vector<T> m_Items;
+  std::vector<uint32_t> m_ItemSlots;  // slot of every item
+  std::vector<Slot> m_Slots;
+  uint32_t m_FreeSlot;
+
+ public:
+  HandlePool() : m_FreeSlot(kNone) {}
+  HandlePool(const HandlePool&) = delete;
+  HandlePool& operator=(const HandlePool&) = delete;
+
+  template <typename... Args>
+  Handle<T> Create(Args&&... args) {
+    uint32_t slot = m_FreeSlot;
+    if (slot != kNone) {
+      m_FreeSlot = m_Slots[slot].Dense;
+    } else {
+      slot = (uint32_t)m_Slots.size();
+      ASSERT(slot <= Handle<T>::kIndexMask);
+      m_Slots.push_back(Slot{kNone, 1});
+    }
+    m_Items.emplace_back(std::forward<Args>(args)...);
+    m_ItemSlots.push_back(slot);
+    m_Slots[slot].Dense = (uint32_t)m_Items.size() - 1;
+    return Handle<T>(slot, m_Slots[slot].Generation);
+  }
+
+  // false for stale or null handles
+  bool Destroy(Handle<T> handle) {
+    if (!IsValid(handle)) return false;
+    uint32_t slot = handle.GetIndex();
+    uint32_t dense = m_Slots[slot].Dense;
+    uint32_t last = (uint32_t)m_Items.size() - 1;
+    if (dense != last) {
+      // the move assignments swap, pop_back then destroys the old object
+      m_Items[dense] = std::move(m_Items[last]);
+      m_ItemSlots[dense] = m_ItemSlots[last];
+      m_Slots[m_ItemSlots[dense]].Dense = dense;
+    }
+    m_Items.pop_back();
+    m_ItemSlots.pop_back();
+
+    // generation 0 would let a handle become the null handle
+    uint32_t generation =
+        (m_Slots[slot].Generation + 1) & Handle<T>::kGenerationMask;
+    m_Slots[slot].Generation = generation ? generation : 1;
+    m_Slots[slot].Dense = m_FreeSlot;
+    m_FreeSlot = slot;
+    return true;
+  }
+
+  inline bool IsValid(Handle<T> handle) const {
+    uint32_t slot = handle.GetIndex();
+    return !handle.IsNull() && slot < m_Slots.size() &&
+           m_Slots[slot].Generation == handle.GetGeneration();
+  }
+  // nullptr for stale handles; invalidated by Create and Destroy
+  inline T* Get(Handle<T> handle) {
+    return IsValid(handle) ? &m_Items[m_Slots[handle.GetIndex()].Dense]
+                           : nullptr;
+  }
+  inline const T* Get(Handle<T> handle) const {
+    return IsValid(handle) ? &m_Items[m_Slots[handle.GetIndex()].Dense]
+                           : nullptr;
+  }
+
+  // dense iteration, in no particular order
+  inline unsigned int GetCount() const {
+    return (unsigned int)m_Items.size();
+  }
+  inline T& operator[](unsigned int dense) { return m_Items[dense]; }
+  inline const T& operator[](unsigned int dense) const {
+    return m_Items[dense];
+  }
+  inline Handle<T> GetHandle(unsigned int dense) const {
+    uint32_t slot = m_ItemSlots[dense];
+    return Handle<T>(slot, m_Slots[slot].Generation);
+  }
+  typename std::vector<T>::iterator begin() { return m_Items.begin(); }
+  typename std::vector<T>::iterator end() { return m_Items.end(); }
+  typename std::vector<T>::const_iterator begin() const {
+    return m_Items.begin();
+  }
+  typename std::vector<T>::const_iterator end() const {
+    return m_Items.end();
+  }
+
+  void Reserve(unsigned int count) {
+    m_Items.reserve(count);
+    m_ItemSlots.reserve(count);
+    m_Slots.reserve(count);
+  }
+  // destroys everything; outstanding handles go stale
+  void Clear() {
+    while (!m_Items.empty()) Destroy(GetHandle(GetCount() - 1));
+  }
+};
@@ -0,0 +1,266 @@
+#include "ImageDecoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "MappedFile.h"
+#include "stb_image/stb_image.h"
+
+#ifdef IMAGE_DECODER_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+namespace {
+
+// takes anything stb_image reads; it allocates its own output, so this is
+// the one backend that copies
+class StbImageBackend : public ImageDecoderBackend {
+ public:
+  const char* GetName() const override { return "stb_image"; }
+
+  bool CanDecode(const unsigned char* data, size_t size) const override {
+    int w, h, channels;
+    return stbi_info_from_memory(data, (int)size, &w, &h, &channels) != 0;
+  }
+
+  bool GetInfo(const unsigned char* data, size_t size,
+               ImageInfo& info) const override {
+    int w, h, channels;
+    if (!stbi_info_from_memory(data, (int)size, &w, &h, &channels))
+      return false;
+    info = ImageInfo{(unsigned int)w, (unsigned int)h,
+                     (unsigned int)channels};
+    return true;
+  }
+
+  bool Decode(const unsigned char* data, size_t size, unsigned int channels,
+              unsigned char* destination) const override {
+    stbi_set_flip_vertically_on_load_thread(1);
+    int w, h, fileChannels;
+    unsigned char* pixels = stbi_load_from_memory(data, (int)size, &w, &h,
+                                                  &fileChannels, channels);
+    if (!pixels) return false;
+    std::memcpy(destination, pixels,
+                (size_t)w * h * (channels ? channels : fileChannels));
+    stbi_image_free(pixels);
+    return true;
+  }
+};
+
+#ifdef IMAGE_DECODER_TURBOJPEG
+// SIMD baseline/progressive JPEG straight into the destination
+class TurboJpegBackend : public ImageDecoderBackend {
+ public:
+  const char* GetName() const override { return "libjpeg-turbo"; }
+
+  bool CanDecode(const unsigned char* data, size_t size) const override {
+    return size > 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+  }
+
+  bool GetInfo(const unsigned char* data, size_t size,
+               ImageInfo& info) const override {
+    int w, h, subsampling, colorspace;
+    if (tjDecompressHeader3(GetHandle(), data, (unsigned long)size, &w, &h,
+                            &subsampling, &colorspace) != 0)
+      return false;
+    info = ImageInfo{(unsigned int)w, (unsigned int)h,
+                     colorspace == TJCS_GRAY ? 1u : 3u};
+    return true;
+  }
+
+  bool Decode(const unsigned char* data, size_t size, unsigned int channels,
+              unsigned char* destination) const override {
+    ImageInfo info;
+    if (!GetInfo(data, size, info)) return false;
+    // grey + alpha has no pixel format, stb_image gets those
+    int format;
+    switch (channels ? channels : info.Channels) {
+      case 1:
+        format = TJPF_GRAY;
+        break;
+      case 3:
+        format = TJPF_RGB;
+        break;
+      case 4:
+        format = TJPF_RGBA;
+        break;
+      default:
+        return false;
+    }
+    return tjDecompress2(GetHandle(), data, (unsigned long)size, destination,
+                         info.Width, 0, info.Height, format,
+                         TJFLAG_BOTTOMUP) == 0;
+  }
+
+ private:
+  // a decompressor per thread, they aren't thread safe
+  static tjhandle GetHandle() {
+    struct Handle {
+      tjhandle Value;
+      Handle() : Value(tjInitDecompress()) {}
+      ~Handle() { tjDestroy(Value); }
+    };
+    thread_local Handle handle;
+    return handle.Value;
+  }
+};
+#endif
+
+}  // namespace
+
+ImageDecoder::ImageDecoder() {
+  AddBackend(std::unique_ptr<ImageDecoderBackend>(new StbImageBackend()));
+#ifdef IMAGE_DECODER_TURBOJPEG
+  AddBackend(std::unique_ptr<ImageDecoderBackend>(new TurboJpegBackend()));
+#endif
+}
+
+ImageDecoder& ImageDecoder::Get() {
+  static ImageDecoder decoder;
+  return decoder;
+}
+
+void ImageDecoder::AddBackend(std::unique_ptr<ImageDecoderBackend> backend) {
+  m_Backends.insert(m_Backends.begin(), std::move(backend));
+}
+
+const ImageDecoderBackend* ImageDecoder::Find(const unsigned char* data,
+                                              size_t size) const {
+  for (const std::unique_ptr<ImageDecoderBackend>& backend : m_Backends)
+    if (backend->CanDecode(data, size)) return backend.get();
+  return nullptr;
+}
+
+bool ImageDecoder::ReadInfo(const std::string& path, ImageInfo& info) const {
+  MappedFile file(path);
+  if (!file.IsValid()) return false;
+  const ImageDecoderBackend* backend = Find(file.GetData(), file.GetSize());
+  return backend && backend->GetInfo(file.GetData(), file.GetSize(), info);
+}
+
+bool ImageDecoder::Decode(ImageDecodeRequest& request,
+                          const ImageDecoderBackend* backend) const {
+  request.Succeeded = false;
+  MappedFile file(request.Path);
+  if (!file.IsValid()) {
+    std::cout << "[ImageDecoder] can't open " << request.Path << std::endl;
+    return false;
+  }
+  const unsigned char* data = file.GetData();
+  size_t size = file.GetSize();
+
+  // the first backend that takes it, the next one if it fails after all
+  for (const std::unique_ptr<ImageDecoderBackend>& candidate : m_Backends) {
+    if (backend && candidate.get() != backend) continue;
+    ImageInfo info;
+    if (!candidate->CanDecode(data, size) ||
+        !candidate->GetInfo(data, size, info))
+      continue;
+    size_t bytes = (size_t)info.Width * info.Height *
+                   (request.Channels ? request.Channels : info.Channels);
+    unsigned char* destination = request.Destination;
+    if (destination && request.Capacity < bytes) {
+      std::cout << "[ImageDecoder] " << request.Path << " needs " << bytes
+                << " bytes, the destination has " << request.Capacity
+                << std::endl;
+      return false;
+    }
+    if (!destination) {
+      request.Pixels.resize(bytes);
+      destination = request.Pixels.data();
+    }
+    if (candidate->Decode(data, size, request.Channels, destination)) {
+      request.Info = info;
+      request.Backend = candidate->GetName();
+      request.Succeeded = true;
+      return true;
+    }
+  }
+  std::cout << "[ImageDecoder] failed to decode " << request.Path
+            << std::endl;
+  return false;
+}
+
+void ImageDecoder::Decode(std::vector<ImageDecodeRequest>& requests,
+                          JobSystem& jobs,
+                          const ImageDecoderBackend* backend) const {
+  jobs.ParallelFor(
+      (unsigned int)requests.size(),
+      [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+          Decode(requests[i], backend);
+      },
+      1);
+}
+
+void ImageDecoder::DecodeAsync(ImageDecodeRequest& request,
+                               JobCounter& counter, JobSystem& jobs) const {
+  jobs.Run([this, &request]() { Decode(request); }, &counter);
+}
+
+void ImageDecoder::Benchmark() {
+  typedef std::chrono::high_resolution_clock Clock;
+  // concurrent copies of one image, within this much decoded memory
+  const size_t kMaxBytes = (size_t)1 << 30;
+  const char* files[] = {"res/textures/container.jpg",
+                         "res/textures/desktop.png", "res/textures/icon.png"};
+
+  unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned int> counts;
+  for (unsigned int workers = 1; workers < hardware; workers *= 2)
+    counts.push_back(workers);
+  counts.push_back(hardware);
+
+  ImageDecoder& decoder = Get();
+  for (const char* path : files) {
+    ImageInfo info;
+    if (!decoder.ReadInfo(path, info)) {
+      std::cout << "[ImageDecoder] can't read " << path << std::endl;
+      continue;
+    }
+    // decoded into memory allocated up front, as into a mapped PBO
+    size_t bytes = (size_t)info.Width * info.Height * info.Channels;
+    unsigned int maxCopies = (unsigned int)std::max(
+        (size_t)2, std::min((size_t)4 * hardware, kMaxBytes / bytes));
+    std::vector<std::vector<unsigned char>> destinations(
+        maxCopies, std::vector<unsigned char>(bytes));
+    std::cout << "[ImageDecoder] " << path << " " << info.Width << "x"
+              << info.Height << "x" << info.Channels << std::endl;
+
+    for (unsigned int b = 0; b < decoder.GetBackendCount(); b++) {
+      const ImageDecoderBackend& backend = decoder.GetBackend(b);
+      double single = 0.0;
+      for (unsigned int workers : counts) {
+        JobSystem jobs(workers);
+        unsigned int copies = std::min(maxCopies, 4 * workers);
+        std::vector<ImageDecodeRequest> requests;
+        for (unsigned int i = 0; i < copies; i++)
+          requests.emplace_back(path, 0, destinations[i].data(), bytes);
+
+        auto start = Clock::now();
+        decoder.Decode(requests, jobs, &backend);
+        double ms =
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+                .count();
+        unsigned int decoded = 0;
+        for (const ImageDecodeRequest& request : requests)
+          decoded += request.Succeeded;
+        // e.g. a JPEG decoder given a PNG
+        if (decoded == 0) {
+          std::cout << "  " << backend.GetName() << ": not supported"
+                    << std::endl;
+          break;
+        }
+        double perImage = ms / decoded;
+        if (workers == 1) single = perImage;
+        std::cout << "  " << backend.GetName() << " " << workers
+                  << " workers: " << perImage << " ms/image, "
+                  << bytes * decoded / (ms * 1000.0) << " MB/s (x"
+                  << single / perImage << ")" << std::endl;
+      }
+    }
+  }
+}
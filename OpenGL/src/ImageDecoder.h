@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+
+struct ImageInfo {
+  unsigned int Width;
+  unsigned int Height;
+  unsigned int Channels;  // in the file, 1 grey .. 4 RGBA
+};
+
+// A decoding library. Backends decode from memory into memory the caller
+// owns, rows bottom up like GL, so the destination can be a mapped pixel
+// unpack buffer. Decode runs on many threads at once and must not keep
+// per-call state outside the call.
+class ImageDecoderBackend {
+ public:
+  virtual ~ImageDecoderBackend() {}
+
+  virtual const char* GetName() const = 0;
+  // from the first bytes of the file
+  virtual bool CanDecode(const unsigned char* data, size_t size) const = 0;
+  virtual bool GetInfo(const unsigned char* data, size_t size,
+                       ImageInfo& info) const = 0;
+  // `channels` per pixel (0 = the file's), Width * Height * channels bytes
+  // at `destination`
+  virtual bool Decode(const unsigned char* data, size_t size,
+                      unsigned int channels,
+                      unsigned char* destination) const = 0;
+};
+
+// one image of a batch, filled in by ImageDecoder
+struct ImageDecodeRequest {
+  std::string Path;
+  unsigned int Channels;       // wanted per pixel, 0 = the file's
+  unsigned char* Destination;  // nullptr = decode into Pixels
+  size_t Capacity;             // bytes at Destination
+  ImageInfo Info;
+  std::vector<unsigned char> Pixels;
+  const char* Backend;  // which one decoded it
+  bool Succeeded;
+
+  ImageDecodeRequest(const std::string& path = "", unsigned int channels = 0,
+                     unsigned char* destination = nullptr,
+                     size_t capacity = 0)
+      : Path(path),
+        Channels(channels),
+        Destination(destination),
+        Capacity(capacity),
+        Info(),
+        Backend(nullptr),
+        Succeeded(false) {}
+};
+
+// Decodes image files on the JobSystem, one job per image. Files are
+// memory mapped and handed to the first registered backend that
+// recognises them; stb_image comes last and takes anything. Faster
+// decoders (e.g. the libjpeg-turbo backend built with
+// IMAGE_DECODER_TURBOJPEG) are added with AddBackend.
+class ImageDecoder {
+ private:
+  std::vector<std::unique_ptr<ImageDecoderBackend>> m_Backends;
+
+ public:
+  ImageDecoder();
+  ImageDecoder(const ImageDecoder&) = delete;
+  ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+  static ImageDecoder& Get();
+
+  // tried before the ones already registered; not while decoding
+  void AddBackend(std::unique_ptr<ImageDecoderBackend> backend);
+  inline unsigned int GetBackendCount() const {
+    return (unsigned int)m_Backends.size();
+  }
+  inline const ImageDecoderBackend& GetBackend(unsigned int index) const {
+    return *m_Backends[index];
+  }
+
+  // header only, to size the destination before decoding
+  bool ReadInfo(const std::string& path, ImageInfo& info) const;
+  // on the calling thread, `backend` forces one of GetBackend()
+  bool Decode(ImageDecodeRequest& request,
+              const ImageDecoderBackend* backend = nullptr) const;
+
+  // every request on `jobs`, returns when all are done
+  void Decode(std::vector<ImageDecodeRequest>& requests,
+              JobSystem& jobs = JobSystem::Get(),
+              const ImageDecoderBackend* backend = nullptr) const;
+  // the request has to outlive the counter reaching zero
+  void DecodeAsync(ImageDecodeRequest& request, JobCounter& counter,
+                   JobSystem& jobs = JobSystem::Get()) const;
+
+  // MB/s and ms per image of the res/textures images for every backend
+  // and worker count
+  static void Benchmark();
+
+ private:
+  const ImageDecoderBackend* Find(const unsigned char* data,
+                                  size_t size) const;
+};
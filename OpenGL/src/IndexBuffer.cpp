@@ -1,17 +1,64 @@
 #include "IndexBuffer.h"
 
+#include <utility>
+
+#include "DeletionQueue.h"
 #include "Log.h"
 #include "GL/glew.h"
+#include "GpuMemory.h"
+
+namespace {
+
+unsigned int GetIndexSize(unsigned int type) {
+  return type == GL_UNSIGNED_INT     ? sizeof(unsigned int)
+         : type == GL_UNSIGNED_SHORT ? sizeof(unsigned short)
+                                     : sizeof(unsigned char);
+}
+
+}  // namespace
 
 IndexBuffer::IndexBuffer(const unsigned int* data, unsigned int count)
-    : m_Count(count) {
+    : IndexBuffer(data, count, GL_UNSIGNED_INT) {}
+
+IndexBuffer::IndexBuffer(const void* data, unsigned int count,
+                         unsigned int type)
+    : m_Count(count), m_Type(type) {
+  unsigned int size = count * GetIndexSize(type);
+  GpuMemory::Get().Allocate(GpuMemoryCategory::IndexBuffer, size);
+  m_RendererID = DeletionQueue::Get().AcquireBuffer(size);
+  if (m_RendererID) {
+    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
+    if (data) {
+      GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, data));
+    }
+    return;
+  }
   GLCall(glGenBuffers(1, &m_RendererID));
   GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
-  GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int),
-                      data, GL_STATIC_DRAW));
+  GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW));
 }
 
-IndexBuffer::~IndexBuffer() { GLCall(glDeleteBuffers(1, &m_RendererID)); }
+IndexBuffer::~IndexBuffer() {
+  unsigned int size = m_Count * GetIndexSize(m_Type);
+  if (m_RendererID)
+    GpuMemory::Get().Free(GpuMemoryCategory::IndexBuffer, size);
+  DeletionQueue::Get().DeleteBuffer(m_RendererID, size);
+}
+
+IndexBuffer::IndexBuffer(IndexBuffer&& other) noexcept
+    : m_RendererID(other.m_RendererID),
+      m_Count(other.m_Count),
+      m_Type(other.m_Type) {
+  other.m_RendererID = 0;
+  other.m_Count = 0;
+}
+
+IndexBuffer& IndexBuffer::operator=(IndexBuffer&& other) noexcept {
+  std::swap(m_RendererID, other.m_RendererID);
+  std::swap(m_Count, other.m_Count);
+  std::swap(m_Type, other.m_Type);
+  return *this;
+}
 
 void IndexBuffer::Bind() const {
   GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID));
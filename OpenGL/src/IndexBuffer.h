@@ -4,14 +4,23 @@ class IndexBuffer {
  private:
   unsigned int m_RendererID;
   unsigned int m_Count;
+  unsigned int m_Type;  // GL_UNSIGNED_INT, GL_UNSIGNED_SHORT or GL_UNSIGNED_BYTE
 
  public:
   IndexBuffer(const unsigned int* data, unsigned int count);
+  // indices of any GL index type, uploaded as is
+  IndexBuffer(const void* data, unsigned int count, unsigned int type);
 
   ~IndexBuffer();
+  IndexBuffer(const IndexBuffer&) = delete;
+  IndexBuffer& operator=(const IndexBuffer&) = delete;
+  IndexBuffer(IndexBuffer&& other) noexcept;
+  IndexBuffer& operator=(IndexBuffer&& other) noexcept;
 
   void Bind() const;
   void Unbind() const;
 
-  inline unsigned int GetCount() { return m_Count; }
+  inline unsigned int GetCount() const { return m_Count; }
+  inline unsigned int GetType() const { return m_Type; }
+  inline unsigned int GetRendererID() const { return m_RendererID; }
 };
\ No newline at end of file
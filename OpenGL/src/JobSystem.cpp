@@ -0,0 +1,355 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "Log.h"
+
+namespace {
+
+// which JobSystem and deque the current thread belongs to
+thread_local JobSystem* t_System = nullptr;
+thread_local int t_Worker = -1;
+
+// spins before an idle worker goes to sleep
+const int kIdleSpins = 64;
+
+}  // namespace
+
+bool WorkDeque::Push(Job* job) {
+  int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+  int64_t top = m_Top.load(std::memory_order_acquire);
+  if (bottom - top >= kCapacity) return false;
+  m_Jobs[bottom & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+  return true;
+}
+
+Job* WorkDeque::Pop() {
+  int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+  m_Bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = m_Top.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Job* job = m_Jobs[bottom & (kCapacity - 1)].load(std::memory_order_relaxed);
+  if (top == bottom) {
+    // last job, race the thieves for it
+    if (!m_Top.compare_exchange_strong(top, top + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+      job = nullptr;
+    m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+Job* WorkDeque::Steal() {
+  int64_t top = m_Top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+  if (top >= bottom) return nullptr;
+
+  Job* job = m_Jobs[top & (kCapacity - 1)].load(std::memory_order_relaxed);
+  if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+    return nullptr;
+  return job;
+}
+
+bool WorkDeque::IsEmpty() const {
+  return m_Bottom.load(std::memory_order_relaxed) <=
+         m_Top.load(std::memory_order_relaxed);
+}
+
+JobSystem::JobSystem(unsigned int workers)
+    : m_Queued(0), m_Sleeping(0), m_Quit(false) {
+  if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned int i = 0; i < workers; i++)
+    m_Deques.emplace_back(new WorkDeque());
+
+  m_OuterSystem = t_System;
+  m_OuterWorker = t_Worker;
+  t_System = this;
+  t_Worker = 0;
+  for (unsigned int i = 1; i < workers; i++)
+    m_Threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(m_SleepMutex);
+    m_Quit = true;
+  }
+  m_Wake.notify_all();
+  for (std::thread& thread : m_Threads) thread.join();
+  if (t_System == this) {
+    t_System = m_OuterSystem;
+    t_Worker = m_OuterWorker;
+  }
+}
+
+JobSystem& JobSystem::Get() {
+  static JobSystem system;
+  return system;
+}
+
+int JobSystem::GetWorkerIndex() const {
+  return t_System == this ? t_Worker : -1;
+}
+
+void JobSystem::Run(std::function<void()> work, JobCounter* counter) {
+  Job* job = new Job{std::move(work), counter};
+  if (counter) counter->Value.fetch_add(1, std::memory_order_relaxed);
+
+  int worker = GetWorkerIndex();
+  if (worker < 0 || !m_Deques[worker]->Push(job)) {
+    if (worker >= 0) {
+      // deque full, run it inline instead of growing it
+      Execute(job);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_InjectedMutex);
+    m_Injected.push_back(job);
+  }
+
+  m_Queued.fetch_add(1);
+  if (m_Sleeping.load() > 0) {
+    std::lock_guard<std::mutex> lock(m_SleepMutex);
+    m_Wake.notify_one();
+  }
+}
+
+Job* JobSystem::FindJob(int worker) {
+  Job* job = nullptr;
+  if (worker >= 0) job = m_Deques[worker]->Pop();
+
+  if (!job) {
+    std::lock_guard<std::mutex> lock(m_InjectedMutex);
+    if (!m_Injected.empty()) {
+      job = m_Injected.front();
+      m_Injected.pop_front();
+    }
+  }
+
+  if (!job) {
+    // start at a different victim on every worker
+    unsigned int count = (unsigned int)m_Deques.size();
+    unsigned int start = worker >= 0 ? worker + 1 : 0;
+    for (unsigned int i = 0; i < count && !job; i++) {
+      unsigned int victim = (start + i) % count;
+      if ((int)victim != worker) job = m_Deques[victim]->Steal();
+    }
+  }
+
+  if (job) m_Queued.fetch_sub(1);
+  return job;
+}
+
+void JobSystem::Execute(Job* job) {
+  job->Work();
+  if (job->Counter) job->Counter->Value.fetch_sub(1, std::memory_order_release);
+  delete job;
+}
+
+void JobSystem::WorkerLoop(unsigned int index) {
+  t_System = this;
+  t_Worker = (int)index;
+
+  int idle = 0;
+  while (!m_Quit.load(std::memory_order_relaxed)) {
+    Job* job = FindJob((int)index);
+    if (job) {
+      Execute(job);
+      idle = 0;
+      continue;
+    }
+    if (++idle < kIdleSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_SleepMutex);
+    m_Sleeping.fetch_add(1);
+    m_Wake.wait(lock, [this]() {
+      return m_Queued.load() > 0 || m_Quit.load();
+    });
+    m_Sleeping.fetch_sub(1);
+    idle = 0;
+  }
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+  int worker = GetWorkerIndex();
+  while (counter.Value.load(std::memory_order_acquire) > 0) {
+    Job* job = FindJob(worker);
+    if (job)
+      Execute(job);
+    else
+      std::this_thread::yield();
+  }
+}
+
+void JobSystem::SplitRange(
+    unsigned int begin, unsigned int end, unsigned int grain,
+    const std::function<void(unsigned int, unsigned int)>& f,
+    JobCounter& counter) {
+  int worker = GetWorkerIndex();
+  while (begin < end) {
+    // hand out the upper half while nobody has anything to steal from us
+    if (end - begin >= 2 * grain &&
+        (worker < 0 || m_Deques[worker]->IsEmpty())) {
+      unsigned int mid = begin + (end - begin) / 2;
+      Run([this, mid, end, grain, &f, &counter]() {
+            SplitRange(mid, end, grain, f, counter);
+          },
+          &counter);
+      end = mid;
+      continue;
+    }
+    unsigned int stop = std::min(end, begin + grain);
+    f(begin, stop);
+    begin = stop;
+  }
+}
+
+void JobSystem::ParallelFor(
+    unsigned int count,
+    const std::function<void(unsigned int, unsigned int)>& f,
+    unsigned int minGrain) {
+  if (count == 0) return;
+  if (minGrain == 0) minGrain = std::max(1u, count / (GetWorkerCount() * 64));
+  if (GetWorkerCount() == 1 || count <= minGrain) {
+    f(0, count);
+    return;
+  }
+
+  JobCounter counter;
+  SplitRange(0, count, minGrain, f, counter);
+  Wait(counter);
+}
+
+unsigned int TaskGraph::Add(std::function<void()> work) {
+  m_Tasks.push_back(Task{std::move(work), {}, 0});
+  return (unsigned int)m_Tasks.size() - 1;
+}
+
+void TaskGraph::Precede(unsigned int before, unsigned int after) {
+  ASSERT(before != after);
+  m_Tasks[before].Successors.push_back(after);
+  m_Tasks[after].Predecessors++;
+}
+
+bool TaskGraph::HasCycle() const {
+  // Kahn's algorithm: whatever can't be peeled off from the roots is on or
+  // behind a cycle
+  unsigned int count = (unsigned int)m_Tasks.size();
+  std::vector<unsigned int> pending(count);
+  std::vector<unsigned int> ready;
+  for (unsigned int i = 0; i < count; i++) {
+    pending[i] = m_Tasks[i].Predecessors;
+    if (pending[i] == 0) ready.push_back(i);
+  }
+  unsigned int visited = 0;
+  while (!ready.empty()) {
+    unsigned int task = ready.back();
+    ready.pop_back();
+    visited++;
+    for (unsigned int next : m_Tasks[task].Successors)
+      if (--pending[next] == 0) ready.push_back(next);
+  }
+  return visited != count;
+}
+
+bool TaskGraph::Run(JobSystem& jobs) {
+  // a task on a cycle would never start and Wait would never return
+  if (HasCycle()) {
+    std::cout << "[TaskGraph] dependency cycle, nothing was run"
+              << std::endl;
+    return false;
+  }
+  unsigned int count = (unsigned int)m_Tasks.size();
+  std::unique_ptr<std::atomic<unsigned int>[]> pending(
+      new std::atomic<unsigned int>[count]);
+  for (unsigned int i = 0; i < count; i++)
+    pending[i].store(m_Tasks[i].Predecessors, std::memory_order_relaxed);
+
+  JobCounter counter;
+  std::function<void(unsigned int)> launch = [&](unsigned int task) {
+    jobs.Run(
+        [&, task]() {
+          m_Tasks[task].Work();
+          for (unsigned int next : m_Tasks[task].Successors)
+            if (pending[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+              launch(next);
+        },
+        &counter);
+  };
+
+  for (unsigned int i = 0; i < count; i++)
+    if (m_Tasks[i].Predecessors == 0) launch(i);
+  jobs.Wait(counter);
+  return true;
+}
+
+void JobSystem::Benchmark() {
+  typedef std::chrono::high_resolution_clock Clock;
+  const unsigned int kCount = 1 << 22;
+  std::vector<float> data(kCount);
+  for (unsigned int i = 0; i < kCount; i++) data[i] = (float)i;
+
+  unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned int> counts;
+  for (unsigned int workers = 1; workers < hardware; workers *= 2)
+    counts.push_back(workers);
+  counts.push_back(hardware);
+
+  double single = 0.0;
+  for (unsigned int workers : counts) {
+    JobSystem jobs(workers);
+
+    // parallel-for: a few flops per element
+    const int kRuns = 10;
+    auto start = Clock::now();
+    for (int run = 0; run < kRuns; run++)
+      jobs.ParallelFor(kCount, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++)
+          data[i] = std::sqrt(data[i] * 1.0001f + 1.0f);
+      });
+    double parallelFor =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() /
+        kRuns;
+    if (workers == 1) single = parallelFor;
+
+    // task graph: 64 independent chains of 16 small tasks
+    TaskGraph graph;
+    std::atomic<unsigned int> executed(0);
+    for (unsigned int chain = 0; chain < 64; chain++) {
+      unsigned int previous = ~0u;
+      for (unsigned int link = 0; link < 16; link++) {
+        unsigned int task = graph.Add([&]() { executed.fetch_add(1); });
+        if (previous != ~0u) graph.Precede(previous, task);
+        previous = task;
+      }
+    }
+    start = Clock::now();
+    for (int run = 0; run < kRuns; run++) graph.Run(jobs);
+    double graphMs =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() /
+        kRuns;
+
+    std::cout << "[JobSystem] " << workers << " workers: parallel-for "
+              << parallelFor << " ms (x" << single / parallelFor
+              << "), task graph " << graph.GetTaskCount() << " tasks "
+              << graphMs * 1000.0 / graph.GetTaskCount() << " us/task"
+              << std::endl;
+  }
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts unfinished jobs, JobSystem::Wait helps out until it reaches zero.
+struct JobCounter {
+  std::atomic<int> Value;
+
+  JobCounter() : Value(0) {}
+};
+
+struct Job {
+  std::function<void()> Work;
+  JobCounter* Counter;
+};
+
+// Chase-Lev work stealing deque: the owner pushes and pops at the bottom,
+// other workers steal from the top. Fixed capacity, Push fails when full.
+class WorkDeque {
+ private:
+  static const int64_t kCapacity = 4096;  // power of two
+
+  std::atomic<int64_t> m_Top;
+  std::atomic<int64_t> m_Bottom;
+  std::atomic<Job*> m_Jobs[kCapacity];
+
+ public:
+  WorkDeque() : m_Top(0), m_Bottom(0) {}
+
+  bool Push(Job* job);
+  Job* Pop();
+  Job* Steal();
+  bool IsEmpty() const;
+};
+
+// Work stealing thread pool. The thread that creates it is worker 0 and
+// runs jobs while it waits, the others are background threads. Jobs pushed
+// from a worker go to its own deque; jobs from any other thread go through
+// a locked queue.
+class JobSystem {
+ private:
+  std::vector<std::unique_ptr<WorkDeque>> m_Deques;
+  std::vector<std::thread> m_Threads;
+  std::deque<Job*> m_Injected;
+  std::mutex m_InjectedMutex;
+
+  // idle workers sleep here once spinning found nothing
+  std::mutex m_SleepMutex;
+  std::condition_variable m_Wake;
+  std::atomic<int> m_Queued;
+  std::atomic<int> m_Sleeping;
+  std::atomic<bool> m_Quit;
+
+  // the system the creating thread belonged to before, restored on exit
+  JobSystem* m_OuterSystem;
+  int m_OuterWorker;
+
+ public:
+  // workers = 0 uses every hardware thread, counting the calling one
+  explicit JobSystem(unsigned int workers = 0);
+  ~JobSystem();
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // shared instance, created on first use by the thread calling it
+  static JobSystem& Get();
+
+  void Run(std::function<void()> work, JobCounter* counter = nullptr);
+  // run other jobs until the counter drops to zero
+  void Wait(JobCounter& counter);
+
+  // f(begin, end) over [0, count) in ranges of at least minGrain. Ranges
+  // are split in halves only while the local deque is empty, i.e. when
+  // thieves took the previous half, so the grain adapts to the load.
+  // minGrain = 0 picks count / (workers * 64).
+  void ParallelFor(unsigned int count,
+                   const std::function<void(unsigned int, unsigned int)>& f,
+                   unsigned int minGrain = 0);
+
+  inline unsigned int GetWorkerCount() const {
+    return (unsigned int)m_Deques.size();
+  }
+  // index of the calling worker, -1 for other threads
+  int GetWorkerIndex() const;
+
+  // parallel-for and task graph throughput from 1 worker to all cores
+  static void Benchmark();
+
+ private:
+  void WorkerLoop(unsigned int index);
+  Job* FindJob(int worker);
+  void Execute(Job* job);
+  void SplitRange(unsigned int begin, unsigned int end, unsigned int grain,
+                  const std::function<void(unsigned int, unsigned int)>& f,
+                  JobCounter& counter);
+};
+
+// Tasks with explicit dependencies. Every task keeps a counter of
+// unfinished predecessors and is queued the moment it drops to zero.
+class TaskGraph {
+ private:
+  struct Task {
+    std::function<void()> Work;
+    std::vector<unsigned int> Successors;
+    unsigned int Predecessors;
+  };
+
+  std::vector<Task> m_Tasks;
+
+ public:
+  unsigned int Add(std::function<void()> work);
+  // `after` starts once `before` has finished
+  void Precede(unsigned int before, unsigned int after);
+  // run every task once and return when all finished, the calling thread
+  // helps; the graph can be run again. False, running nothing, when the
+  // dependencies have a cycle
+  bool Run(JobSystem& jobs);
+  bool HasCycle() const;
+
+  inline unsigned int GetTaskCount() const {
+    return (unsigned int)m_Tasks.size();
+  }
+};
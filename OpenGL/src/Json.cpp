@@ -0,0 +1,282 @@
+#include "Json.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const unsigned int kMaxDepth = 256;
+
+// 4 hex digits of a \u escape, -1 if they aren't
+int ParseHex4(const char* text, const char* end) {
+  if (end - text < 4) return -1;
+  int value = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = text[i];
+    int digit = c >= '0' && c <= '9'   ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                       : -1;
+    if (digit < 0) return -1;
+    value = value * 16 + digit;
+  }
+  return value;
+}
+
+void AppendUtf8(std::string& out, unsigned int code) {
+  if (code < 0x80) {
+    out += (char)code;
+  } else if (code < 0x800) {
+    out += (char)(0xC0 | (code >> 6));
+    out += (char)(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    out += (char)(0xE0 | (code >> 12));
+    out += (char)(0x80 | ((code >> 6) & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  } else {
+    out += (char)(0xF0 | (code >> 18));
+    out += (char)(0x80 | ((code >> 12) & 0x3F));
+    out += (char)(0x80 | ((code >> 6) & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  }
+}
+
+}  // namespace
+
+bool JsonDocument::Parse(const char* text, size_t size) {
+  m_Nodes.clear();
+  // glTF documents average around 40 bytes per node
+  m_Nodes.reserve(size / 32 + 16);
+  m_Cursor = text;
+  m_End = text + size;
+
+  // one value, then nothing but the whitespace GLB pads its chunk with
+  bool valid = ParseValue(0);
+  if (valid) {
+    SkipWhitespace();
+    valid = m_Cursor == m_End;
+  }
+  if (!valid) {
+    std::cout << "JSON parse error at offset " << (m_Cursor - text)
+              << std::endl;
+    m_Nodes.clear();
+    return false;
+  }
+  return true;
+}
+
+void JsonDocument::SkipWhitespace() {
+  while (m_Cursor < m_End && (*m_Cursor == ' ' || *m_Cursor == '\n' ||
+                              *m_Cursor == '\r' || *m_Cursor == '\t'))
+    m_Cursor++;
+}
+
+bool JsonDocument::ParseString(const char*& begin, unsigned int& length) {
+  // m_Cursor is on the opening quote
+  begin = ++m_Cursor;
+  while (m_Cursor < m_End && *m_Cursor != '"') {
+    if (*m_Cursor == '\\') m_Cursor++;
+    m_Cursor++;
+  }
+  if (m_Cursor >= m_End) return false;
+  length = (unsigned int)(m_Cursor - begin);
+  m_Cursor++;
+  return true;
+}
+
+bool JsonDocument::ParseValue(unsigned int depth) {
+  if (depth > kMaxDepth) return false;
+  SkipWhitespace();
+  if (m_Cursor >= m_End) return false;
+
+  unsigned int index = (unsigned int)m_Nodes.size();
+  m_Nodes.push_back({JsonType::Null, 0, 0, m_Cursor, 0, 0.0});
+
+  char c = *m_Cursor;
+  if (c == '{' || c == '[') {
+    bool object = c == '{';
+    char close = object ? '}' : ']';
+    m_Nodes[index].Type = object ? JsonType::Object : JsonType::Array;
+    m_Cursor++;
+    SkipWhitespace();
+
+    unsigned int count = 0;
+    if (m_Cursor < m_End && *m_Cursor == close) {
+      m_Cursor++;
+    } else {
+      while (true) {
+        if (object) {
+          SkipWhitespace();
+          if (m_Cursor >= m_End || *m_Cursor != '"') return false;
+          const char* key;
+          unsigned int length;
+          if (!ParseString(key, length)) return false;
+          m_Nodes.push_back({JsonType::String, 0,
+                             (unsigned int)m_Nodes.size() + 1, key, length,
+                             0.0});
+          SkipWhitespace();
+          if (m_Cursor >= m_End || *m_Cursor != ':') return false;
+          m_Cursor++;
+        }
+        if (!ParseValue(depth + 1)) return false;
+        count++;
+
+        SkipWhitespace();
+        if (m_Cursor >= m_End) return false;
+        if (*m_Cursor == ',') {
+          m_Cursor++;
+        } else if (*m_Cursor == close) {
+          m_Cursor++;
+          break;
+        } else {
+          return false;
+        }
+      }
+    }
+    // m_Nodes may have grown, don't hold references across ParseValue
+    m_Nodes[index].Count = count;
+  } else if (c == '"') {
+    const char* begin;
+    unsigned int length;
+    if (!ParseString(begin, length)) return false;
+    m_Nodes[index].Type = JsonType::String;
+    m_Nodes[index].Text = begin;
+    m_Nodes[index].Length = length;
+  } else if (c == 't' && m_End - m_Cursor >= 4 && !memcmp(m_Cursor, "true", 4)) {
+    m_Nodes[index].Type = JsonType::Bool;
+    m_Nodes[index].Number = 1.0;
+    m_Cursor += 4;
+  } else if (c == 'f' && m_End - m_Cursor >= 5 &&
+             !memcmp(m_Cursor, "false", 5)) {
+    m_Nodes[index].Type = JsonType::Bool;
+    m_Cursor += 5;
+  } else if (c == 'n' && m_End - m_Cursor >= 4 && !memcmp(m_Cursor, "null", 4)) {
+    m_Cursor += 4;
+  } else {
+    // strtod needs a terminated string and the source may be a mapped file,
+    // so copy the (short) number text out first
+    const char* begin = m_Cursor;
+    while (m_Cursor < m_End &&
+           ((*m_Cursor && strchr("+-.eE", *m_Cursor)) ||
+            (*m_Cursor >= '0' && *m_Cursor <= '9')))
+      m_Cursor++;
+    unsigned int length = (unsigned int)(m_Cursor - begin);
+    if (length == 0 || length > 63) return false;
+    char number[64];
+    memcpy(number, begin, length);
+    number[length] = '\0';
+    m_Nodes[index].Type = JsonType::Number;
+    m_Nodes[index].Length = length;
+    m_Nodes[index].Number = strtod(number, nullptr);
+  }
+
+  m_Nodes[index].End = (unsigned int)m_Nodes.size();
+  return true;
+}
+
+int JsonDocument::Find(int object, const char* key) const {
+  if (object < 0 || m_Nodes[object].Type != JsonType::Object) return -1;
+  unsigned int child = object + 1;
+  for (unsigned int i = 0; i < m_Nodes[object].Count; i++) {
+    if (Equals(child, key)) return child + 1;
+    child = m_Nodes[child + 1].End;
+  }
+  return -1;
+}
+
+int JsonDocument::At(int array, unsigned int index) const {
+  if (array < 0 || m_Nodes[array].Type != JsonType::Array ||
+      index >= m_Nodes[array].Count)
+    return -1;
+  unsigned int child = array + 1;
+  for (unsigned int i = 0; i < index; i++) child = m_Nodes[child].End;
+  return child;
+}
+
+unsigned int JsonDocument::Size(int node) const {
+  return node < 0 ? 0 : m_Nodes[node].Count;
+}
+
+double JsonDocument::GetNumber(int node, double fallback) const {
+  if (node < 0 || (m_Nodes[node].Type != JsonType::Number &&
+                   m_Nodes[node].Type != JsonType::Bool))
+    return fallback;
+  return m_Nodes[node].Number;
+}
+
+int JsonDocument::GetInt(int node, int fallback) const {
+  double number = GetNumber(node, fallback);
+  // NaN fails both comparisons; converting it or anything out of range
+  // would be undefined
+  if (!(number >= (double)INT_MIN && number <= (double)INT_MAX))
+    return fallback;
+  return (int)number;
+}
+
+std::string JsonDocument::GetString(int node) const {
+  if (node < 0 || m_Nodes[node].Type != JsonType::String) return std::string();
+  const char* text = m_Nodes[node].Text;
+  const char* end = text + m_Nodes[node].Length;
+  std::string out;
+  out.reserve(m_Nodes[node].Length);
+  while (text < end) {
+    if (*text != '\\' || text + 1 == end) {
+      out += *text++;
+      continue;
+    }
+    char escape = text[1];
+    text += 2;
+    switch (escape) {
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        int code = ParseHex4(text, end);
+        if (code < 0) {
+          out += "\\u";
+          break;
+        }
+        text += 4;
+        // a high surrogate pairs with the \uXXXX after it
+        if (code >= 0xD800 && code < 0xDC00 && end - text >= 6 &&
+            text[0] == '\\' && text[1] == 'u') {
+          int low = ParseHex4(text + 2, end);
+          if (low >= 0xDC00 && low < 0xE000) {
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            text += 6;
+          }
+        }
+        AppendUtf8(out, (unsigned int)code);
+        break;
+      }
+      default:  // \" \\ \/
+        out += escape;
+        break;
+    }
+  }
+  return out;
+}
+
+bool JsonDocument::Equals(int node, const char* text) const {
+  if (node < 0 || m_Nodes[node].Type != JsonType::String) return false;
+  // rare, keys and names are plain ASCII in practice
+  if (memchr(m_Nodes[node].Text, '\\', m_Nodes[node].Length))
+    return GetString(node) == text;
+  size_t length = strlen(text);
+  return length == m_Nodes[node].Length &&
+         memcmp(m_Nodes[node].Text, text, length) == 0;
+}
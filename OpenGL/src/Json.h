@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <vector>
+
+enum class JsonType : unsigned char {
+  Null,
+  Bool,
+  Number,
+  String,
+  Array,
+  Object
+};
+
+// Node of a parsed document. Nodes are stored depth-first in one flat array;
+// a container's children follow it directly and `End` is the index one past
+// its subtree, so siblings are reached by jumping to their End. Object
+// members are stored as a String key node followed by the value.
+struct JsonNode {
+  JsonType Type;
+  unsigned int Count;  // number of children (members for objects)
+  unsigned int End;
+  const char* Text;    // raw string contents (escapes kept) or number text
+  unsigned int Length;
+  double Number;       // numbers and bools
+};
+
+// Single pass JSON parser that never copies strings: string nodes point into
+// the source text, which must outlive the document.
+class JsonDocument {
+ private:
+  std::vector<JsonNode> m_Nodes;
+  const char* m_Cursor;
+  const char* m_End;
+
+ public:
+  bool Parse(const char* text, size_t size);
+
+  // index of the root node, -1 lookups propagate so chains like
+  // Find(At(Find(root, "meshes"), 0), "name") are safe
+  inline int Root() const { return m_Nodes.empty() ? -1 : 0; }
+
+  int Find(int object, const char* key) const;
+  int At(int array, unsigned int index) const;
+  unsigned int Size(int node) const;
+
+  double GetNumber(int node, double fallback = 0.0) const;
+  // fallback as well when the number doesn't fit an int
+  int GetInt(int node, int fallback = 0) const;
+  // with escapes resolved, \uXXXX as UTF-8
+  std::string GetString(int node) const;
+  bool Equals(int node, const char* text) const;
+
+  inline const JsonNode& GetNode(int node) const { return m_Nodes[node]; }
+
+ private:
+  bool ParseValue(unsigned int depth);
+  bool ParseString(const char*& begin, unsigned int& length);
+  void SkipWhitespace();
+};
@@ -0,0 +1,60 @@
+#include <cstring>
+#include <string>
+
+#include "Json.h"
+#include "SelfTest.h"
+
+namespace {
+
+bool Parses(const char* text) {
+  JsonDocument document;
+  return document.Parse(text, strlen(text));
+}
+
+}  // namespace
+
+void SelfTest::JsonTests() {
+  EXPECT(Parses("{\"a\": [1, 2.5, -3e2], \"b\": {\"c\": null}}"));
+  EXPECT(Parses("\"\\u00e9\\ud83d\\ude00\""));
+
+  // truncated or malformed documents
+  EXPECT(!Parses(""));
+  EXPECT(!Parses("{"));
+  EXPECT(!Parses("{\"a\": 1"));
+  EXPECT(!Parses("[1, 2"));
+  EXPECT(!Parses("\"unterminated"));
+  EXPECT(!Parses("{\"a\" 1}"));
+  EXPECT(!Parses("{1: 2}"));
+  EXPECT(!Parses("[1 2]"));
+  EXPECT(!Parses("[1,]"));
+  EXPECT(!Parses("NaN"));
+  EXPECT(!Parses("[1] 2"));
+
+  // nesting past the depth limit fails instead of overflowing the stack
+  std::string deep(100000, '[');
+  deep += std::string(100000, ']');
+  EXPECT(!Parses(deep.c_str()));
+
+  // the text isn't terminated where the size says it ends
+  const char* cut = "{\"a\": 12345}";
+  JsonDocument truncated;
+  EXPECT(!truncated.Parse(cut, 8));
+
+  // lookups on what isn't there fall back instead of indexing past the end
+  const char* text =
+      "{\"small\": 7, \"huge\": 1e300, \"negative\": -1e300, "
+      "\"string\": \"7\", \"list\": [1, 2]}";
+  JsonDocument document;
+  EXPECT(document.Parse(text, strlen(text)));
+  int root = document.Root();
+  EXPECT(document.GetInt(document.Find(root, "small"), -1) == 7);
+  EXPECT(document.GetInt(document.Find(root, "huge"), -1) == -1);
+  EXPECT(document.GetInt(document.Find(root, "negative"), -1) == -1);
+  EXPECT(document.GetInt(document.Find(root, "string"), -1) == -1);
+  EXPECT(document.GetInt(document.Find(root, "missing"), -1) == -1);
+  EXPECT(document.At(document.Find(root, "list"), 2) == -1);
+  EXPECT(document.At(document.Find(root, "missing"), 0) == -1);
+  EXPECT(document.Find(document.At(root, 0), "small") == -1);
+  EXPECT(document.Size(document.Find(root, "missing")) == 0);
+  EXPECT(document.GetString(document.Find(root, "small")).empty());
+}
@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path)
+    : m_Data(nullptr), m_Size(0), m_File(nullptr), m_Mapping(nullptr) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    std::cout << "Failed to open " << path << std::endl;
+    return;
+  }
+  m_File = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return;
+  m_Size = (size_t)size.QuadPart;
+
+  m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_Mapping) return;
+  m_Data = (const unsigned char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0,
+                                               0);
+  if (!m_Data) std::cout << "Failed to map " << path << std::endl;
+}
+
+MappedFile::~MappedFile() {
+  if (m_Data) UnmapViewOfFile(m_Data);
+  if (m_Mapping) CloseHandle(m_Mapping);
+  if (m_File) CloseHandle(m_File);
+}
+#else
+MappedFile::MappedFile(const std::string& path)
+    : m_Data(nullptr), m_Size(0), m_File(-1) {
+  m_File = open(path.c_str(), O_RDONLY);
+  if (m_File < 0) {
+    std::cout << "Failed to open " << path << std::endl;
+    return;
+  }
+
+  struct stat info;
+  if (fstat(m_File, &info) != 0 || info.st_size == 0) return;
+  m_Size = (size_t)info.st_size;
+
+  void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+  if (data == MAP_FAILED) {
+    std::cout << "Failed to map " << path << std::endl;
+    return;
+  }
+  m_Data = (const unsigned char*)data;
+}
+
+MappedFile::~MappedFile() {
+  if (m_Data) munmap((void*)m_Data, m_Size);
+  if (m_File >= 0) close(m_File);
+}
+#endif
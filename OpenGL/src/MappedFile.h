@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the
+// object, so pointers into Data() can be handed straight to glBufferData.
+class MappedFile {
+ private:
+  const unsigned char* m_Data;
+  size_t m_Size;
+#ifdef _WIN32
+  void* m_File;
+  void* m_Mapping;
+#else
+  int m_File;
+#endif
+
+ public:
+  MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  inline bool IsValid() const { return m_Data != nullptr; }
+  inline const unsigned char* GetData() const { return m_Data; }
+  inline size_t GetSize() const { return m_Size; }
+};
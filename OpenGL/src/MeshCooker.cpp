@@ -0,0 +1,307 @@
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+#include "CookedMesh.h"
+#include "GL/glew.h"
+#include "IndexBuffer.h"
+#include "Log.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "VertexBuffer.h"
+
+namespace {
+
+const unsigned int kFloats = GltfMeshData::kFloatsPerVertex;
+
+bool HasExtension(const std::string& path, const char* extension) {
+  size_t length = strlen(extension);
+  if (path.size() < length) return false;
+  for (size_t i = 0; i < length; i++)
+    if (tolower(path[path.size() - length + i]) != extension[i]) return false;
+  return true;
+}
+
+bool ReadSource(const std::string& path, std::vector<GltfMeshData>& meshes) {
+  if (HasExtension(path, ".obj")) {
+    meshes.resize(1);
+    return MeshCooker::ReadObj(path, meshes[0]);
+  }
+  return GltfLoader::ReadMeshes(path, meshes);
+}
+
+// OBJ indices are 1 based, negative ones count back from the end
+int ResolveIndex(int index, size_t count) {
+  return index < 0 ? (int)count + index : index - 1;
+}
+
+void Align(std::ofstream& stream, uint64_t& offset) {
+  static const char zeros[kMeshFileAlignment] = {};
+  uint64_t padding = (kMeshFileAlignment - offset % kMeshFileAlignment) %
+                     kMeshFileAlignment;
+  stream.write(zeros, padding);
+  offset += padding;
+}
+
+}  // namespace
+
+bool MeshCooker::ReadObj(const std::string& path, GltfMeshData& mesh) {
+  std::ifstream stream(path);
+  if (!stream) {
+    std::cout << "Failed to open " << path << std::endl;
+    return false;
+  }
+
+  std::vector<float> positions, texcoords, normals;
+  std::map<std::tuple<int, int, int>, unsigned int> vertices;
+  std::vector<unsigned int> face;
+  std::string line;
+
+  while (getline(stream, line)) {
+    const char* c = line.c_str();
+    char* end;
+    if (c[0] == 'v' && c[1] == ' ') {
+      c += 2;
+      for (int i = 0; i < 3; i++, c = end)
+        positions.push_back(strtof(c, &end));
+    } else if (c[0] == 'v' && c[1] == 't') {
+      c += 2;
+      for (int i = 0; i < 2; i++, c = end)
+        texcoords.push_back(strtof(c, &end));
+    } else if (c[0] == 'v' && c[1] == 'n') {
+      c += 2;
+      for (int i = 0; i < 3; i++, c = end) normals.push_back(strtof(c, &end));
+    } else if (c[0] == 'f' && c[1] == ' ') {
+      c += 2;
+      face.clear();
+      while (true) {
+        // v, v/vt, v//vn or v/vt/vn
+        int v = (int)strtol(c, &end, 10);
+        if (end == c) break;
+        c = end;
+        int vt = 0, vn = 0;
+        if (*c == '/') {
+          c++;
+          if (*c != '/') {
+            vt = (int)strtol(c, &end, 10);
+            c = end;
+          }
+          if (*c == '/') {
+            vn = (int)strtol(c + 1, &end, 10);
+            c = end;
+          }
+        }
+
+        std::tuple<int, int, int> key(
+            ResolveIndex(v, positions.size() / 3),
+            vt ? ResolveIndex(vt, texcoords.size() / 2) : -1,
+            vn ? ResolveIndex(vn, normals.size() / 3) : -1);
+        auto it = vertices.find(key);
+        if (it == vertices.end()) {
+          unsigned int index = (unsigned int)(mesh.Vertices.size() / kFloats);
+          float vertex[kFloats] = {};
+          int p = std::get<0>(key), t = std::get<1>(key), n = std::get<2>(key);
+          if (p < 0 || (size_t)p * 3 >= positions.size()) return false;
+          memcpy(vertex, &positions[p * 3], 3 * sizeof(float));
+          if (t >= 0 && (size_t)t * 2 < texcoords.size())
+            memcpy(vertex + 3, &texcoords[t * 2], 2 * sizeof(float));
+          if (n >= 0 && (size_t)n * 3 < normals.size())
+            memcpy(vertex + 5, &normals[n * 3], 3 * sizeof(float));
+          mesh.Vertices.insert(mesh.Vertices.end(), vertex, vertex + kFloats);
+          it = vertices.emplace(key, index).first;
+        }
+        face.push_back(it->second);
+      }
+
+      // triangle fan
+      for (size_t i = 2; i < face.size(); i++) {
+        mesh.Indices.push_back(face[0]);
+        mesh.Indices.push_back(face[i - 1]);
+        mesh.Indices.push_back(face[i]);
+      }
+    }
+  }
+  return !mesh.Indices.empty();
+}
+
+bool MeshCooker::Cook(const std::string& source,
+                      const std::string& destination, unsigned int maxLods) {
+  std::vector<GltfMeshData> meshes;
+  if (!ReadSource(source, meshes) || meshes.empty()) {
+    std::cout << "Failed to read " << source << std::endl;
+    return false;
+  }
+
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+  std::vector<MeshFileSubmesh> submeshes;
+  std::vector<MeshFileLod> lods;
+
+  for (GltfMeshData& mesh : meshes) {
+    // nothing to draw or to take bounds from
+    if (mesh.Indices.empty() || mesh.Vertices.size() < kFloats) continue;
+    MeshOptimizeStats stats =
+        MeshOptimizer::Optimize(mesh.Vertices, mesh.Indices, kFloats);
+    std::cout << "[MeshCooker] vertices " << stats.VerticesBefore << " -> "
+              << stats.VerticesAfter << ", ACMR " << stats.Before.ACMR
+              << " -> " << stats.After.ACMR << ", ATVR " << stats.Before.ATVR
+              << " -> " << stats.After.ATVR << std::endl;
+    unsigned int vertexCount = (unsigned int)(mesh.Vertices.size() / kFloats);
+    unsigned int baseVertex = (unsigned int)(vertices.size() / kFloats);
+
+    std::vector<std::vector<unsigned int>> levels;
+    std::vector<float> errors;
+    MeshOptimizer::GenerateLodChain(
+        levels, errors, mesh.Indices.data(), (unsigned int)mesh.Indices.size(),
+        mesh.Vertices.data(), vertexCount, kFloats * sizeof(float), 3,
+        maxLods);
+    if (levels.empty()) continue;
+
+    MeshFileSubmesh submesh = {};
+    submesh.FirstLod = (unsigned int)lods.size();
+    submesh.LodCount = (unsigned int)levels.size();
+    for (unsigned int c = 0; c < 3; c++) {
+      submesh.BoundsMin[c] = submesh.BoundsMax[c] = mesh.Vertices[c];
+      for (unsigned int v = 0; v < vertexCount; v++) {
+        float x = mesh.Vertices[v * kFloats + c];
+        submesh.BoundsMin[c] = std::min(submesh.BoundsMin[c], x);
+        submesh.BoundsMax[c] = std::max(submesh.BoundsMax[c], x);
+      }
+    }
+    submeshes.push_back(submesh);
+
+    for (unsigned int l = 0; l < levels.size(); l++) {
+      std::vector<unsigned int>& level = levels[l];
+      // simplified levels need their own vertex cache order
+      if (l > 0)
+        MeshOptimizer::OptimizeVertexCache(level.data(), level.data(),
+                                           (unsigned int)level.size(),
+                                           vertexCount);
+      lods.push_back({(unsigned int)indices.size(),
+                      (unsigned int)level.size(), errors[l], 0});
+      for (unsigned int index : level) indices.push_back(baseVertex + index);
+    }
+    vertices.insert(vertices.end(), mesh.Vertices.begin(), mesh.Vertices.end());
+  }
+
+  if (submeshes.empty()) {
+    std::cout << "No triangles to cook in " << source << std::endl;
+    return false;
+  }
+
+  unsigned int vertexCount = (unsigned int)(vertices.size() / kFloats);
+  bool shortIndices = vertexCount <= 0xFFFF;
+
+  MeshFileAttribute attributes[3] = {
+      {0, GL_FLOAT, 3, 0, 0},                  // position
+      {1, GL_FLOAT, 2, 0, 3 * sizeof(float)},  // texcoord
+      {2, GL_FLOAT, 3, 0, 5 * sizeof(float)},  // normal
+  };
+
+  MeshFileHeader header = {};
+  memcpy(header.Magic, kMeshFileMagic, 4);
+  header.Version = kMeshFileVersion;
+  header.AttributeCount = 3;
+  header.SubmeshCount = (unsigned int)submeshes.size();
+  header.LodCount = (unsigned int)lods.size();
+  header.VertexCount = vertexCount;
+  header.VertexStride = kFloats * sizeof(float);
+  header.IndexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  header.IndexCount = (unsigned int)indices.size();
+  for (unsigned int c = 0; c < 3; c++) {
+    header.BoundsMin[c] = submeshes[0].BoundsMin[c];
+    header.BoundsMax[c] = submeshes[0].BoundsMax[c];
+    for (const MeshFileSubmesh& submesh : submeshes) {
+      header.BoundsMin[c] = std::min(header.BoundsMin[c], submesh.BoundsMin[c]);
+      header.BoundsMax[c] = std::max(header.BoundsMax[c], submesh.BoundsMax[c]);
+    }
+  }
+
+  uint64_t offset = sizeof(header) + sizeof(attributes) +
+                    submeshes.size() * sizeof(MeshFileSubmesh) +
+                    lods.size() * sizeof(MeshFileLod);
+  header.VertexOffset = (offset + kMeshFileAlignment - 1) /
+                        kMeshFileAlignment * kMeshFileAlignment;
+  header.VertexSize = vertices.size() * sizeof(float);
+  header.IndexOffset = (header.VertexOffset + header.VertexSize +
+                        kMeshFileAlignment - 1) /
+                       kMeshFileAlignment * kMeshFileAlignment;
+  header.IndexSize = indices.size() * (shortIndices ? 2 : 4);
+
+  std::ofstream stream(destination, std::ios::binary);
+  if (!stream) {
+    std::cout << "Failed to create " << destination << std::endl;
+    return false;
+  }
+  stream.write((const char*)&header, sizeof(header));
+  stream.write((const char*)attributes, sizeof(attributes));
+  stream.write((const char*)submeshes.data(),
+               submeshes.size() * sizeof(MeshFileSubmesh));
+  stream.write((const char*)lods.data(), lods.size() * sizeof(MeshFileLod));
+
+  Align(stream, offset);
+  stream.write((const char*)vertices.data(), header.VertexSize);
+  offset += header.VertexSize;
+  Align(stream, offset);
+  if (shortIndices) {
+    std::vector<unsigned short> shorts(indices.begin(), indices.end());
+    stream.write((const char*)shorts.data(), header.IndexSize);
+  } else {
+    stream.write((const char*)indices.data(), header.IndexSize);
+  }
+
+  std::cout << "[MeshCooker] " << source << " -> " << destination << ": "
+            << submeshes.size() << " submeshes, " << lods.size() << " LODs, "
+            << vertexCount << " vertices, " << indices.size() / 3
+            << " triangles" << std::endl;
+  return stream.good();
+}
+
+void MeshCooker::Benchmark(const std::string& source,
+                           const std::string& cooked,
+                           unsigned int iterations) {
+  double sourceTotal = 0.0, cookedTotal = 0.0;
+  size_t cookedSize = 0;
+
+  for (unsigned int i = 0; i < iterations; i++) {
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      std::vector<GltfMeshData> meshes;
+      if (!ReadSource(source, meshes)) return;
+      std::vector<std::unique_ptr<VertexBuffer>> vbs;
+      std::vector<std::unique_ptr<IndexBuffer>> ibs;
+      for (const GltfMeshData& mesh : meshes) {
+        vbs.emplace_back(new VertexBuffer(
+            mesh.Vertices.data(),
+            (unsigned int)(mesh.Vertices.size() * sizeof(float))));
+        ibs.emplace_back(new IndexBuffer(mesh.Indices.data(),
+                                         (unsigned int)mesh.Indices.size()));
+      }
+      GLCall(glFinish());
+      auto end = std::chrono::high_resolution_clock::now();
+      sourceTotal +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      CookedMesh mesh(cooked);
+      if (!mesh.IsValid()) return;
+      GLCall(glFinish());
+      auto end = std::chrono::high_resolution_clock::now();
+      cookedTotal +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+      cookedSize = mesh.GetFileSize();
+    }
+  }
+
+  std::cout << "[MeshCooker] " << source << ": " << sourceTotal / iterations
+            << " ms, " << cooked << ": " << cookedTotal / iterations << " ms ("
+            << cookedSize / 1024 << " KB)" << std::endl;
+}
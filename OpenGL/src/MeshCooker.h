@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+#include "GltfLoader.h"
+
+// Offline conversion of OBJ / glTF sources into cooked .mesh files (see
+// MeshFile.h). Cooking runs MeshOptimizer and bakes a LOD chain per submesh,
+// so nothing but the upload is left for load time.
+namespace MeshCooker {
+
+// Triangulated OBJ as position, texcoord, normal floats.
+bool ReadObj(const std::string& path, GltfMeshData& mesh);
+
+bool Cook(const std::string& source, const std::string& destination,
+          unsigned int maxLods = 4);
+
+// Compare loading `source` (parse + upload) with loading the cooked file.
+void Benchmark(const std::string& source, const std::string& cooked,
+               unsigned int iterations = 10);
+
+}  // namespace MeshCooker
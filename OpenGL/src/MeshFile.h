@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+
+// Cooked mesh container (.mesh), written by MeshCooker and read by
+// CookedMesh. Little endian, laid out as
+//
+//   MeshFileHeader
+//   MeshFileAttribute[AttributeCount]
+//   MeshFileSubmesh[SubmeshCount]
+//   MeshFileLod[LodCount]
+//   vertex block (VertexOffset, 16-byte aligned), VertexBufferLayout ready
+//   index block (IndexOffset, 16-byte aligned), IndexType indices of every
+//   LOD of every submesh back to back
+//
+// so both blocks can go from the mapped file straight into glBufferData.
+
+const char kMeshFileMagic[4] = {'M', 'E', 'S', 'H'};
+const uint32_t kMeshFileVersion = 1;
+const uint32_t kMeshFileAlignment = 16;
+
+struct MeshFileHeader {
+  char Magic[4];
+  uint32_t Version;
+  uint32_t AttributeCount;
+  uint32_t SubmeshCount;
+  uint32_t LodCount;
+  uint32_t VertexCount;
+  uint32_t VertexStride;
+  uint32_t IndexType;  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  uint32_t IndexCount;
+  float BoundsMin[3];
+  float BoundsMax[3];
+  uint32_t Reserved;
+  uint64_t VertexOffset;
+  uint64_t VertexSize;
+  uint64_t IndexOffset;
+  uint64_t IndexSize;
+};
+
+struct MeshFileAttribute {
+  uint32_t Location;
+  uint32_t Type;  // GL component type
+  uint32_t Count;
+  uint32_t Normalized;
+  uint32_t Offset;
+};
+
+struct MeshFileSubmesh {
+  uint32_t FirstLod;  // into the LOD table, level 0 is the full mesh
+  uint32_t LodCount;
+  float BoundsMin[3];
+  float BoundsMax[3];
+};
+
+struct MeshFileLod {
+  uint32_t FirstIndex;  // into the index block
+  uint32_t IndexCount;
+  float Error;  // object space
+  uint32_t Reserved;
+};
+
+static_assert(sizeof(MeshFileHeader) == 96, "MeshFileHeader layout changed");
@@ -0,0 +1,67 @@
+#include "MeshLod.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Log.h"
+#include "MeshOptimizer.h"
+
+MeshLod::MeshLod(const unsigned int* indices, unsigned int indexCount,
+                 const float* positions, unsigned int vertexCount,
+                 unsigned int stride, unsigned int components,
+                 unsigned int maxLevels, float reduction)
+    : m_Center(0.0f) {
+  glm::vec3 minimum(0.0f), maximum(0.0f);
+  for (unsigned int v = 0; v < vertexCount; v++) {
+    const float* p = (const float*)((const unsigned char*)positions +
+                                    size_t(v) * stride);
+    glm::vec3 position(p[0], p[1], components > 2 ? p[2] : 0.0f);
+    minimum = v == 0 ? position : glm::min(minimum, position);
+    maximum = v == 0 ? position : glm::max(maximum, position);
+  }
+  m_Center = (minimum + maximum) * 0.5f;
+
+  std::vector<std::vector<unsigned int>> levels;
+  std::vector<float> errors;
+  MeshOptimizer::GenerateLodChain(levels, errors, indices, indexCount,
+                                  positions, vertexCount, stride, components,
+                                  maxLevels, reduction);
+
+  for (unsigned int i = 0; i < levels.size(); i++) {
+    unsigned int count = (unsigned int)levels[i].size();
+    m_Levels.push_back(
+        {std::unique_ptr<IndexBuffer>(new IndexBuffer(levels[i].data(), count)),
+         count, errors[i]});
+  }
+
+  std::cout << "[MeshLod] " << m_Levels.size() << " levels, triangles:";
+  for (const LodLevel& level : m_Levels)
+    std::cout << " " << level.IndexCount / 3;
+  std::cout << std::endl;
+}
+
+unsigned int MeshLod::SelectLevel(const glm::mat4& proj,
+                                  const glm::mat4& modelView,
+                                  float viewportHeight, unsigned int current,
+                                  float pixelThreshold,
+                                  float hysteresis) const {
+  // w of the clip space center: view depth for perspective, 1 for ortho
+  glm::vec4 clip = proj * modelView * glm::vec4(m_Center, 1.0f);
+  float w = std::max(clip.w, 1e-4f);
+  // largest scale of the model view, errors are in object space
+  float scale = std::max(glm::length(glm::vec3(modelView[0])),
+                         std::max(glm::length(glm::vec3(modelView[1])),
+                                  glm::length(glm::vec3(modelView[2]))));
+  float pixelsPerUnit = proj[1][1] * viewportHeight * 0.5f * scale / w;
+
+  unsigned int selected = 0;
+  for (unsigned int level = (unsigned int)m_Levels.size(); level-- > 0;) {
+    float threshold = pixelThreshold;
+    if (level > current) threshold *= 1.0f - hysteresis;
+    if (m_Levels[level].Error * pixelsPerUnit <= threshold) {
+      selected = level;
+      break;
+    }
+  }
+  return selected;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "IndexBuffer.h"
+#include "glm/glm.hpp"
+
+struct LodLevel {
+  std::unique_ptr<IndexBuffer> Indices;
+  unsigned int IndexCount;
+  float Error;  // object space geometric error of this level
+};
+
+// Chain of LOD index buffers generated with MeshOptimizer::Simplify, all
+// indexing the same vertex buffer. Level 0 is the source mesh.
+class MeshLod {
+ private:
+  std::vector<LodLevel> m_Levels;
+  glm::vec3 m_Center;
+
+ public:
+  // positions points to the first float of the position of vertex 0, stride
+  // is in bytes. Every level targets `reduction` times the triangles of the
+  // previous one.
+  MeshLod(const unsigned int* indices, unsigned int indexCount,
+          const float* positions, unsigned int vertexCount,
+          unsigned int stride, unsigned int components,
+          unsigned int maxLevels = 5, float reduction = 0.5f);
+
+  // Pick the coarsest level whose error projects to at most pixelThreshold
+  // pixels. Switching to a coarser level than `current` needs the error to
+  // drop below (1 - hysteresis) of the threshold, so objects sitting at a
+  // boundary don't flicker between levels.
+  unsigned int SelectLevel(const glm::mat4& proj, const glm::mat4& modelView,
+                           float viewportHeight, unsigned int current,
+                           float pixelThreshold = 1.0f,
+                           float hysteresis = 0.25f) const;
+
+  inline unsigned int GetLevelCount() const {
+    return (unsigned int)m_Levels.size();
+  }
+  inline const IndexBuffer& GetLevel(unsigned int level) const {
+    return *m_Levels[level].Indices;
+  }
+  inline const LodLevel& GetLevelInfo(unsigned int level) const {
+    return m_Levels[level];
+  }
+};
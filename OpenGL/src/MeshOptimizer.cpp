@@ -0,0 +1,777 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Log.h"
+
+namespace {
+
+// hash/compare vertices by their bytes, keyed by vertex index
+struct VertexHasher {
+  const unsigned char* vertices;
+  unsigned int vertexSize;
+
+  size_t operator()(unsigned int index) const {
+    // FNV-1a
+    const unsigned char* data = vertices + size_t(index) * vertexSize;
+    unsigned int hash = 2166136261u;
+    for (unsigned int i = 0; i < vertexSize; i++) {
+      hash ^= data[i];
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+};
+
+struct VertexEqual {
+  const unsigned char* vertices;
+  unsigned int vertexSize;
+
+  bool operator()(unsigned int lhs, unsigned int rhs) const {
+    return memcmp(vertices + size_t(lhs) * vertexSize,
+                  vertices + size_t(rhs) * vertexSize, vertexSize) == 0;
+  }
+};
+
+// Forsyth's scoring, see "Linear-Speed Vertex Cache Optimisation"
+const int kCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+
+float VertexScore(int cachePosition, unsigned int remainingValence) {
+  if (remainingValence == 0) return -1.0f;
+
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // the last triangle's vertices get a fixed score so that the next
+      // triangle does not just reuse them in the same order
+      score = kLastTriScore;
+    } else {
+      float scaler = 1.0f / (kCacheSize - 3);
+      score = 1.0f - (cachePosition - 3) * scaler;
+      score = std::pow(score, kCacheDecayPower);
+    }
+  }
+  // bonus for vertices with few triangles left, so that lone triangles are
+  // not left behind
+  score +=
+      kValenceBoostScale * std::pow(float(remainingValence), -kValenceBoostPower);
+  return score;
+}
+
+struct Vec3 {
+  float x, y, z;
+};
+
+Vec3 ReadPosition(const float* positions, unsigned int stride,
+                  unsigned int components, unsigned int index) {
+  const float* p = (const float*)((const unsigned char*)positions +
+                                  size_t(index) * stride);
+  return {p[0], p[1], components > 2 ? p[2] : 0.0f};
+}
+
+// symmetric 4x4 plane quadric, stored as its upper triangle
+struct Quadric {
+  double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+  double w;
+};
+
+void QuadricAdd(Quadric& q, const Quadric& r) {
+  q.a2 += r.a2;
+  q.b2 += r.b2;
+  q.c2 += r.c2;
+  q.ab += r.ab;
+  q.ac += r.ac;
+  q.bc += r.bc;
+  q.ad += r.ad;
+  q.bd += r.bd;
+  q.cd += r.cd;
+  q.d2 += r.d2;
+  q.w += r.w;
+}
+
+// plane n.p + d = 0 with unit n, weighted by w
+void QuadricAddPlane(Quadric& q, double a, double b, double c, double d,
+                     double w) {
+  q.a2 += a * a * w;
+  q.b2 += b * b * w;
+  q.c2 += c * c * w;
+  q.ab += a * b * w;
+  q.ac += a * c * w;
+  q.bc += b * c * w;
+  q.ad += a * d * w;
+  q.bd += b * d * w;
+  q.cd += c * d * w;
+  q.d2 += d * d * w;
+  q.w += w;
+}
+
+// weighted squared distance of p to the planes of q
+double QuadricError(const Quadric& q, const Vec3& p) {
+  double x = p.x, y = p.y, z = p.z;
+  double r = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z +
+             2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z) +
+             2.0 * (q.ad * x + q.bd * y + q.cd * z) + q.d2;
+  return r > 0.0 ? r : 0.0;
+}
+
+Vec3 Sub(const Vec3& a, const Vec3& b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+Vec3 Cross(const Vec3& a, const Vec3& b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+
+float Dot(const Vec3& a, const Vec3& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+unsigned long long EdgeKey(unsigned int a, unsigned int b) {
+  return ((unsigned long long)a << 32) | b;
+}
+
+enum class VertexKind { Manifold, Border, Locked };
+
+struct Collapse {
+  unsigned int from, to;
+  float cost;
+};
+
+}  // namespace
+
+unsigned int MeshOptimizer::GenerateVertexRemap(
+    std::vector<unsigned int>& remap, const unsigned int* indices,
+    unsigned int indexCount, const void* vertices, unsigned int vertexCount,
+    unsigned int vertexSize) {
+  const unsigned int kUnused = ~0u;
+  remap.assign(vertexCount, kUnused);
+
+  const unsigned char* data = (const unsigned char*)vertices;
+  std::unordered_map<unsigned int, unsigned int, VertexHasher, VertexEqual>
+      table(vertexCount, VertexHasher{data, vertexSize},
+            VertexEqual{data, vertexSize});
+
+  unsigned int next = 0;
+  for (unsigned int i = 0; i < indexCount; i++) {
+    unsigned int index = indices[i];
+    ASSERT(index < vertexCount);
+    if (remap[index] != kUnused) continue;
+
+    auto it = table.find(index);
+    if (it != table.end()) {
+      remap[index] = remap[it->second];
+    } else {
+      table.emplace(index, index);
+      remap[index] = next++;
+    }
+  }
+  return next;
+}
+
+void MeshOptimizer::RemapIndexBuffer(unsigned int* destination,
+                                     const unsigned int* indices,
+                                     unsigned int indexCount,
+                                     const std::vector<unsigned int>& remap) {
+  for (unsigned int i = 0; i < indexCount; i++)
+    destination[i] = remap[indices[i]];
+}
+
+void MeshOptimizer::RemapVertexBuffer(void* destination, const void* vertices,
+                                      unsigned int vertexCount,
+                                      unsigned int vertexSize,
+                                      const std::vector<unsigned int>& remap) {
+  const unsigned char* src = (const unsigned char*)vertices;
+  unsigned char* dst = (unsigned char*)destination;
+  for (unsigned int i = 0; i < vertexCount; i++) {
+    if (remap[i] == ~0u) continue;  // unreferenced
+    memcpy(dst + size_t(remap[i]) * vertexSize, src + size_t(i) * vertexSize,
+           vertexSize);
+  }
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* destination,
+                                        const unsigned int* indices,
+                                        unsigned int indexCount,
+                                        unsigned int vertexCount) {
+  ASSERT(indexCount % 3 == 0);
+  unsigned int triangleCount = indexCount / 3;
+  if (triangleCount == 0) return;
+
+  // destination may alias indices
+  std::vector<unsigned int> input(indices, indices + indexCount);
+
+  // vertex -> triangles adjacency, stored as one flat array
+  std::vector<unsigned int> valence(vertexCount, 0);
+  for (unsigned int i = 0; i < indexCount; i++) valence[input[i]]++;
+
+  std::vector<unsigned int> offsets(vertexCount + 1, 0);
+  for (unsigned int v = 0; v < vertexCount; v++)
+    offsets[v + 1] = offsets[v] + valence[v];
+
+  std::vector<unsigned int> adjacency(indexCount);
+  std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (unsigned int t = 0; t < triangleCount; t++)
+    for (unsigned int k = 0; k < 3; k++)
+      adjacency[fill[input[t * 3 + k]]++] = t;
+
+  // valence is reused as the count of not yet emitted triangles per vertex
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> vertexScore(vertexCount);
+  for (unsigned int v = 0; v < vertexCount; v++)
+    vertexScore[v] = VertexScore(-1, valence[v]);
+
+  std::vector<char> emitted(triangleCount, 0);
+
+  unsigned int cache[kCacheSize + 3];
+  unsigned int cacheCount = 0;
+  unsigned int newCache[kCacheSize + 3];
+
+  int bestTriangle = -1;
+  unsigned int scanCursor = 0;
+  unsigned int output = 0;
+
+  for (unsigned int emittedCount = 0; emittedCount < triangleCount;
+       emittedCount++) {
+    if (bestTriangle < 0) {
+      // nothing adjacent to the cache, fall back to the next unemitted one
+      while (emitted[scanCursor]) scanCursor++;
+      bestTriangle = scanCursor;
+    }
+
+    unsigned int t = bestTriangle;
+    const unsigned int* tri = &input[t * 3];
+    destination[output++] = tri[0];
+    destination[output++] = tri[1];
+    destination[output++] = tri[2];
+    emitted[t] = 1;
+
+    // remove the triangle from its vertices' adjacency lists
+    for (unsigned int k = 0; k < 3; k++) {
+      unsigned int v = tri[k];
+      unsigned int* begin = &adjacency[offsets[v]];
+      unsigned int* end = begin + valence[v];
+      unsigned int* it = std::find(begin, end, t);
+      ASSERT(it != end);
+      *it = *(end - 1);
+      valence[v]--;
+    }
+
+    // push the triangle's vertices to the front of the LRU cache
+    unsigned int newCount = 0;
+    newCache[newCount++] = tri[0];
+    newCache[newCount++] = tri[1];
+    newCache[newCount++] = tri[2];
+    for (unsigned int i = 0; i < cacheCount; i++) {
+      unsigned int v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+    }
+
+    // vertices that fell out of the cache lose their cache score
+    for (unsigned int i = kCacheSize; i < newCount; i++) {
+      cachePosition[newCache[i]] = -1;
+      vertexScore[newCache[i]] = VertexScore(-1, valence[newCache[i]]);
+    }
+    cacheCount = std::min(newCount, (unsigned int)kCacheSize);
+    memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+    for (unsigned int i = 0; i < cacheCount; i++) {
+      cachePosition[cache[i]] = i;
+      vertexScore[cache[i]] = VertexScore(i, valence[cache[i]]);
+    }
+
+    // rescore the triangles touching the cache and pick the best one
+    bestTriangle = -1;
+    float bestScore = 0.0f;
+    for (unsigned int i = 0; i < cacheCount; i++) {
+      unsigned int v = cache[i];
+      for (unsigned int j = 0; j < valence[v]; j++) {
+        unsigned int at = adjacency[offsets[v] + j];
+        const unsigned int* a = &input[at * 3];
+        float score =
+            vertexScore[a[0]] + vertexScore[a[1]] + vertexScore[a[2]];
+        if (score > bestScore) {
+          bestScore = score;
+          bestTriangle = at;
+        }
+      }
+    }
+  }
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* destination,
+                                     const unsigned int* indices,
+                                     unsigned int indexCount,
+                                     const float* positions,
+                                     unsigned int vertexCount,
+                                     unsigned int stride,
+                                     unsigned int components,
+                                     float threshold) {
+  ASSERT(indexCount % 3 == 0);
+  unsigned int triangleCount = indexCount / 3;
+  if (triangleCount == 0) return;
+
+  std::vector<unsigned int> input(indices, indices + indexCount);
+
+  // split into clusters at "cold" triangles, where the cache has nothing to
+  // offer, so moving clusters around barely changes the miss count
+  const unsigned int kClusterCacheSize = 16;
+  std::vector<unsigned int> clusterStart;
+  {
+    std::vector<unsigned int> timestamp(vertexCount, 0);
+    unsigned int time = kClusterCacheSize + 1;
+    for (unsigned int t = 0; t < triangleCount; t++) {
+      unsigned int misses = 0;
+      for (unsigned int k = 0; k < 3; k++) {
+        unsigned int v = input[t * 3 + k];
+        if (time - timestamp[v] > kClusterCacheSize) {
+          timestamp[v] = time++;
+          misses++;
+        }
+      }
+      if (t == 0 || misses == 3) clusterStart.push_back(t);
+    }
+  }
+  unsigned int clusterCount = (unsigned int)clusterStart.size();
+  clusterStart.push_back(triangleCount);
+
+  // area weighted centroid and normal of every cluster and of the mesh
+  std::vector<Vec3> clusterCentroid(clusterCount), clusterNormal(clusterCount);
+  Vec3 meshCentroid = {0.0f, 0.0f, 0.0f};
+  float meshArea = 0.0f;
+  for (unsigned int c = 0; c < clusterCount; c++) {
+    Vec3 centroid = {0.0f, 0.0f, 0.0f};
+    Vec3 normal = {0.0f, 0.0f, 0.0f};
+    float area = 0.0f;
+    for (unsigned int t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+      Vec3 p0 = ReadPosition(positions, stride, components, input[t * 3 + 0]);
+      Vec3 p1 = ReadPosition(positions, stride, components, input[t * 3 + 1]);
+      Vec3 p2 = ReadPosition(positions, stride, components, input[t * 3 + 2]);
+      Vec3 e1 = {p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+      Vec3 e2 = {p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+      Vec3 n = {e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z,
+                e1.x * e2.y - e1.y * e2.x};
+      float a = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+
+      centroid.x += (p0.x + p1.x + p2.x) / 3.0f * a;
+      centroid.y += (p0.y + p1.y + p2.y) / 3.0f * a;
+      centroid.z += (p0.z + p1.z + p2.z) / 3.0f * a;
+      normal.x += n.x;
+      normal.y += n.y;
+      normal.z += n.z;
+      area += a;
+    }
+    meshCentroid.x += centroid.x;
+    meshCentroid.y += centroid.y;
+    meshCentroid.z += centroid.z;
+    meshArea += area;
+
+    float inv = area > 0.0f ? 1.0f / area : 0.0f;
+    clusterCentroid[c] = {centroid.x * inv, centroid.y * inv,
+                          centroid.z * inv};
+    float length = std::sqrt(normal.x * normal.x + normal.y * normal.y +
+                             normal.z * normal.z);
+    float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+    clusterNormal[c] = {normal.x * invLength, normal.y * invLength,
+                        normal.z * invLength};
+  }
+  if (meshArea > 0.0f) {
+    meshCentroid.x /= meshArea;
+    meshCentroid.y /= meshArea;
+    meshCentroid.z /= meshArea;
+  }
+
+  // clusters that face away from the center are likely in front of the
+  // others from most view directions, so draw them first
+  std::vector<float> sortKey(clusterCount);
+  for (unsigned int c = 0; c < clusterCount; c++) {
+    Vec3 d = {clusterCentroid[c].x - meshCentroid.x,
+              clusterCentroid[c].y - meshCentroid.y,
+              clusterCentroid[c].z - meshCentroid.z};
+    sortKey[c] = d.x * clusterNormal[c].x + d.y * clusterNormal[c].y +
+                 d.z * clusterNormal[c].z;
+  }
+
+  std::vector<unsigned int> order(clusterCount);
+  for (unsigned int c = 0; c < clusterCount; c++) order[c] = c;
+  std::stable_sort(order.begin(), order.end(),
+                   [&](unsigned int lhs, unsigned int rhs) {
+                     return sortKey[lhs] > sortKey[rhs];
+                   });
+
+  std::vector<unsigned int> result;
+  result.reserve(indexCount);
+  for (unsigned int c : order)
+    result.insert(result.end(), input.begin() + clusterStart[c] * 3,
+                  input.begin() + clusterStart[c + 1] * 3);
+
+  // keep the input if the reorder costs too much vertex cache efficiency
+  VertexCacheStats before =
+      AnalyzeVertexCache(input.data(), indexCount, vertexCount);
+  VertexCacheStats after =
+      AnalyzeVertexCache(result.data(), indexCount, vertexCount);
+  const std::vector<unsigned int>& chosen =
+      after.ACMR <= before.ACMR * threshold ? result : input;
+  std::copy(chosen.begin(), chosen.end(), destination);
+}
+
+unsigned int MeshOptimizer::OptimizeVertexFetch(void* destination,
+                                                unsigned int* indices,
+                                                unsigned int indexCount,
+                                                const void* vertices,
+                                                unsigned int vertexCount,
+                                                unsigned int vertexSize) {
+  ASSERT(destination != vertices);
+  const unsigned int kUnused = ~0u;
+  std::vector<unsigned int> remap(vertexCount, kUnused);
+
+  const unsigned char* src = (const unsigned char*)vertices;
+  unsigned char* dst = (unsigned char*)destination;
+
+  unsigned int next = 0;
+  for (unsigned int i = 0; i < indexCount; i++) {
+    unsigned int index = indices[i];
+    ASSERT(index < vertexCount);
+    if (remap[index] == kUnused) {
+      memcpy(dst + size_t(next) * vertexSize, src + size_t(index) * vertexSize,
+             vertexSize);
+      remap[index] = next++;
+    }
+    indices[i] = remap[index];
+  }
+  return next;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices,
+                                                   unsigned int indexCount,
+                                                   unsigned int vertexCount,
+                                                   unsigned int cacheSize) {
+  VertexCacheStats stats = {0.0f, 0.0f};
+  if (indexCount == 0) return stats;
+
+  // FIFO cache: a vertex is resident while fewer than cacheSize misses
+  // happened since it was loaded
+  std::vector<unsigned int> timestamp(vertexCount, 0);
+  std::vector<char> referenced(vertexCount, 0);
+  unsigned int time = cacheSize + 1;
+  unsigned int misses = 0;
+  unsigned int unique = 0;
+
+  for (unsigned int i = 0; i < indexCount; i++) {
+    unsigned int v = indices[i];
+    if (time - timestamp[v] > cacheSize) {
+      timestamp[v] = time++;
+      misses++;
+    }
+    if (!referenced[v]) {
+      referenced[v] = 1;
+      unique++;
+    }
+  }
+
+  stats.ACMR = float(misses) / float(indexCount / 3);
+  stats.ATVR = float(misses) / float(unique);
+  return stats;
+}
+
+unsigned int MeshOptimizer::Simplify(unsigned int* destination,
+                                     const unsigned int* indices,
+                                     unsigned int indexCount,
+                                     const float* positions,
+                                     unsigned int vertexCount,
+                                     unsigned int stride,
+                                     unsigned int components,
+                                     unsigned int targetIndexCount,
+                                     float targetError, float* resultError) {
+  ASSERT(indexCount % 3 == 0);
+  std::vector<unsigned int> result(indices, indices + indexCount);
+  if (resultError) *resultError = 0.0f;
+  if (indexCount <= targetIndexCount || vertexCount == 0) {
+    std::copy(result.begin(), result.end(), destination);
+    return indexCount;
+  }
+
+  // work in a unit cube so that errors are relative to the mesh extent
+  std::vector<Vec3> position(vertexCount);
+  Vec3 minimum = ReadPosition(positions, stride, components, 0);
+  Vec3 maximum = minimum;
+  for (unsigned int v = 0; v < vertexCount; v++) {
+    position[v] = ReadPosition(positions, stride, components, v);
+    minimum = {std::min(minimum.x, position[v].x),
+               std::min(minimum.y, position[v].y),
+               std::min(minimum.z, position[v].z)};
+    maximum = {std::max(maximum.x, position[v].x),
+               std::max(maximum.y, position[v].y),
+               std::max(maximum.z, position[v].z)};
+  }
+  float extent = std::max(maximum.x - minimum.x,
+                          std::max(maximum.y - minimum.y,
+                                   maximum.z - minimum.z));
+  float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+  for (Vec3& p : position)
+    p = {(p.x - minimum.x) * scale, (p.y - minimum.y) * scale,
+         (p.z - minimum.z) * scale};
+
+  // vertices sharing a position with another vertex sit on an attribute
+  // seam, moving them would tear the mesh apart
+  std::vector<VertexKind> kind(vertexCount, VertexKind::Manifold);
+  {
+    // positions compared by their bytes, a matching hash alone isn't enough
+    const unsigned char* data = (const unsigned char*)position.data();
+    std::unordered_set<unsigned int, VertexHasher, VertexEqual> first(
+        vertexCount, VertexHasher{data, sizeof(Vec3)},
+        VertexEqual{data, sizeof(Vec3)});
+    for (unsigned int v = 0; v < vertexCount; v++) {
+      auto inserted = first.insert(v);
+      if (!inserted.second) {
+        kind[v] = VertexKind::Locked;
+        kind[*inserted.first] = VertexKind::Locked;
+      }
+    }
+  }
+
+  std::unordered_set<unsigned long long> directed;
+  for (unsigned int i = 0; i < indexCount; i += 3)
+    for (unsigned int k = 0; k < 3; k++)
+      directed.insert(EdgeKey(result[i + k], result[i + (k + 1) % 3]));
+
+  // plane quadrics weighted by area, plus perpendicular planes on border
+  // edges to keep the outline in place
+  std::vector<Quadric> quadric(vertexCount, Quadric());
+  for (unsigned int i = 0; i < indexCount; i += 3) {
+    const Vec3& p0 = position[result[i + 0]];
+    const Vec3& p1 = position[result[i + 1]];
+    const Vec3& p2 = position[result[i + 2]];
+    Vec3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+    float length = std::sqrt(Dot(n, n));
+    if (length == 0.0f) continue;
+    n = {n.x / length, n.y / length, n.z / length};
+    double area = length * 0.5;
+
+    Quadric q = Quadric();
+    QuadricAddPlane(q, n.x, n.y, n.z, -Dot(n, p0), area);
+    for (unsigned int k = 0; k < 3; k++) QuadricAdd(quadric[result[i + k]], q);
+
+    for (unsigned int k = 0; k < 3; k++) {
+      unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+      if (directed.count(EdgeKey(b, a))) continue;
+      if (kind[a] == VertexKind::Manifold) kind[a] = VertexKind::Border;
+      if (kind[b] == VertexKind::Manifold) kind[b] = VertexKind::Border;
+
+      Vec3 edge = Sub(position[b], position[a]);
+      double edgeLength2 = Dot(edge, edge);
+      Vec3 m = Cross(edge, n);
+      float mLength = std::sqrt(Dot(m, m));
+      if (mLength == 0.0f) continue;
+      m = {m.x / mLength, m.y / mLength, m.z / mLength};
+
+      Quadric border = Quadric();
+      QuadricAddPlane(border, m.x, m.y, m.z, -Dot(m, position[a]),
+                      edgeLength2 * 10.0);
+      QuadricAdd(quadric[a], border);
+      QuadricAdd(quadric[b], border);
+    }
+  }
+
+  double maxError2 = double(targetError) * targetError;
+  double achieved = 0.0;
+  unsigned int count = indexCount;
+
+  std::vector<unsigned int> offsets(vertexCount + 1);
+  std::vector<unsigned int> adjacency;
+  std::vector<char> locked(vertexCount);
+  std::vector<Collapse> collapses;
+
+  while (count > targetIndexCount) {
+    // vertex -> triangle adjacency of the current triangles
+    std::fill(offsets.begin(), offsets.end(), 0);
+    for (unsigned int i = 0; i < count; i++) offsets[result[i] + 1]++;
+    for (unsigned int v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+    adjacency.resize(count);
+    {
+      std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+      for (unsigned int i = 0; i < count; i++)
+        adjacency[fill[result[i]]++] = i / 3;
+    }
+
+    // candidate collapses of every edge, in both directions when allowed
+    collapses.clear();
+    for (unsigned int i = 0; i < count; i += 3) {
+      for (unsigned int k = 0; k < 3; k++) {
+        unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+        bool border = !directed.count(EdgeKey(b, a));
+        // interior edges are seen from both triangles, visit them once
+        if (!border && a > b) continue;
+
+        unsigned int ends[2][2] = {{a, b}, {b, a}};
+        for (unsigned int e = 0; e < 2; e++) {
+          unsigned int from = ends[e][0], to = ends[e][1];
+          if (kind[from] == VertexKind::Locked) continue;
+          if (kind[from] == VertexKind::Border && !border) continue;
+
+          Quadric q = quadric[from];
+          QuadricAdd(q, quadric[to]);
+          double cost = QuadricError(q, position[to]) / std::max(q.w, 1e-12);
+          collapses.push_back({from, to, float(cost)});
+        }
+      }
+    }
+    if (collapses.empty()) break;
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& lhs, const Collapse& rhs) {
+                return lhs.cost < rhs.cost;
+              });
+
+    // each collapse removes about two triangles
+    unsigned int budget = (count - targetIndexCount) / 6 + 1;
+    unsigned int applied = 0;
+    std::fill(locked.begin(), locked.end(), 0);
+
+    for (const Collapse& c : collapses) {
+      if (applied >= budget || c.cost > maxError2) break;
+      if (locked[c.from] || locked[c.to]) continue;
+
+      // reject collapses that flip a triangle around `from`
+      bool flip = false;
+      for (unsigned int j = offsets[c.from]; j < offsets[c.from + 1]; j++) {
+        const unsigned int* tri = &result[adjacency[j] * 3];
+        if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) continue;
+        Vec3 p[3], q[3];
+        for (unsigned int k = 0; k < 3; k++) {
+          p[k] = position[tri[k]];
+          q[k] = tri[k] == c.from ? position[c.to] : p[k];
+        }
+        Vec3 n0 = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+        Vec3 n1 = Cross(Sub(q[1], q[0]), Sub(q[2], q[0]));
+        if (Dot(n0, n1) <= 0.25f * std::sqrt(Dot(n0, n0) * Dot(n1, n1))) {
+          flip = true;
+          break;
+        }
+      }
+      if (flip) continue;
+
+      for (unsigned int j = offsets[c.from]; j < offsets[c.from + 1]; j++) {
+        unsigned int* tri = &result[adjacency[j] * 3];
+        for (unsigned int k = 0; k < 3; k++)
+          if (tri[k] == c.from) tri[k] = c.to;
+      }
+      QuadricAdd(quadric[c.to], quadric[c.from]);
+      locked[c.from] = 1;
+      locked[c.to] = 1;
+      achieved = std::max(achieved, double(c.cost));
+      applied++;
+    }
+    if (applied == 0) break;
+
+    // drop the triangles that became degenerate
+    unsigned int write = 0;
+    for (unsigned int i = 0; i < count; i += 3) {
+      unsigned int a = result[i], b = result[i + 1], c = result[i + 2];
+      if (a == b || b == c || c == a) continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    count = write;
+
+    directed.clear();
+    for (unsigned int i = 0; i < count; i += 3)
+      for (unsigned int k = 0; k < 3; k++)
+        directed.insert(EdgeKey(result[i + k], result[i + (k + 1) % 3]));
+  }
+
+  std::copy(result.begin(), result.begin() + count, destination);
+  if (resultError) *resultError = float(std::sqrt(achieved));
+  return count;
+}
+
+void MeshOptimizer::GenerateLodChain(
+    std::vector<std::vector<unsigned int>>& levels, std::vector<float>& errors,
+    const unsigned int* indices, unsigned int indexCount,
+    const float* positions, unsigned int vertexCount, unsigned int stride,
+    unsigned int components, unsigned int maxLevels, float reduction) {
+  levels.assign(1, std::vector<unsigned int>(indices, indices + indexCount));
+  errors.assign(1, 0.0f);
+  if (vertexCount == 0) return;
+
+  // extent, to turn the relative simplifier error into object space
+  Vec3 minimum = ReadPosition(positions, stride, components, 0);
+  Vec3 maximum = minimum;
+  for (unsigned int v = 1; v < vertexCount; v++) {
+    Vec3 p = ReadPosition(positions, stride, components, v);
+    minimum = {std::min(minimum.x, p.x), std::min(minimum.y, p.y),
+               std::min(minimum.z, p.z)};
+    maximum = {std::max(maximum.x, p.x), std::max(maximum.y, p.y),
+               std::max(maximum.z, p.z)};
+  }
+  float extent = std::max(maximum.x - minimum.x,
+                          std::max(maximum.y - minimum.y,
+                                   maximum.z - minimum.z));
+
+  std::vector<unsigned int> lod(indexCount);
+  while (levels.size() < maxLevels) {
+    const std::vector<unsigned int>& source = levels.back();
+    unsigned int sourceCount = (unsigned int)source.size();
+    unsigned int target = (unsigned int)(sourceCount * reduction) / 3 * 3;
+    float levelError = 0.0f;
+    unsigned int count =
+        Simplify(lod.data(), source.data(), sourceCount, positions,
+                 vertexCount, stride, components, target, 1.0f, &levelError);
+
+    // stop once the simplifier can't make meaningful progress
+    if (count == 0 || count > sourceCount * 0.9f) break;
+
+    errors.push_back(errors.back() + levelError * extent);
+    levels.emplace_back(lod.begin(), lod.begin() + count);
+  }
+}
+
+MeshOptimizeStats MeshOptimizer::Optimize(std::vector<float>& vertices,
+                                          std::vector<unsigned int>& indices,
+                                          unsigned int floatsPerVertex,
+                                          unsigned int positionOffset,
+                                          unsigned int positionComponents) {
+  unsigned int vertexSize = floatsPerVertex * sizeof(float);
+  unsigned int vertexCount = (unsigned int)vertices.size() / floatsPerVertex;
+  unsigned int indexCount = (unsigned int)indices.size();
+  MeshOptimizeStats stats = {vertexCount, vertexCount, {}, {}};
+  if (indexCount == 0 || vertexCount == 0) return stats;
+
+  stats.Before = AnalyzeVertexCache(indices.data(), indexCount, vertexCount);
+
+  // 1. deduplicate vertices
+  std::vector<unsigned int> remap;
+  unsigned int uniqueCount =
+      GenerateVertexRemap(remap, indices.data(), indexCount, vertices.data(),
+                          vertexCount, vertexSize);
+  std::vector<float> unique(size_t(uniqueCount) * floatsPerVertex);
+  RemapVertexBuffer(unique.data(), vertices.data(), vertexCount, vertexSize,
+                    remap);
+  RemapIndexBuffer(indices.data(), indices.data(), indexCount, remap);
+
+  // 2. vertex cache, 3. overdraw
+  OptimizeVertexCache(indices.data(), indices.data(), indexCount, uniqueCount);
+  OptimizeOverdraw(indices.data(), indices.data(), indexCount,
+                   unique.data() + positionOffset, uniqueCount, vertexSize,
+                   positionComponents);
+
+  // 4. vertex fetch
+  vertices.resize(size_t(uniqueCount) * floatsPerVertex);
+  unsigned int finalCount =
+      OptimizeVertexFetch(vertices.data(), indices.data(), indexCount,
+                          unique.data(), uniqueCount, vertexSize);
+  vertices.resize(size_t(finalCount) * floatsPerVertex);
+
+  stats.VerticesAfter = finalCount;
+  stats.After = AnalyzeVertexCache(indices.data(), indexCount, finalCount);
+  return stats;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+
+// post-transform vertex cache statistics of an index buffer
+struct VertexCacheStats {
+  float ACMR;  // average cache miss ratio, misses per triangle (0.5 ~ 3.0)
+  float ATVR;  // average transformed vertex ratio, misses per vertex (>= 1.0)
+};
+
+// what Optimize did to a mesh
+struct MeshOptimizeStats {
+  unsigned int VerticesBefore, VerticesAfter;
+  VertexCacheStats Before, After;
+};
+
+// Mesh optimization stage run on index/vertex data before it is uploaded to
+// IndexBuffer / VertexBuffer. All functions work on triangle lists with
+// 32-bit indices, and vertices are opaque blobs of `vertexSize` bytes.
+namespace MeshOptimizer {
+
+// Build a remap table that collapses binary identical vertices, returns the
+// number of unique vertices. remap[old] = new.
+unsigned int GenerateVertexRemap(std::vector<unsigned int>& remap,
+                                 const unsigned int* indices,
+                                 unsigned int indexCount, const void* vertices,
+                                 unsigned int vertexCount,
+                                 unsigned int vertexSize);
+
+void RemapIndexBuffer(unsigned int* destination, const unsigned int* indices,
+                      unsigned int indexCount,
+                      const std::vector<unsigned int>& remap);
+
+void RemapVertexBuffer(void* destination, const void* vertices,
+                       unsigned int vertexCount, unsigned int vertexSize,
+                       const std::vector<unsigned int>& remap);
+
+// Reorder triangles for the post-transform vertex cache (Forsyth's linear
+// speed algorithm). destination can alias indices.
+void OptimizeVertexCache(unsigned int* destination, const unsigned int* indices,
+                         unsigned int indexCount, unsigned int vertexCount);
+
+// Reorder clusters of the vertex cache optimized output so that triangles
+// facing outwards are drawn first (view independent, Tipsify style). The
+// result keeps the ACMR within `threshold` times the input's.
+// positions points to the first float of the position of vertex 0, stride is
+// in bytes and components is 2 or 3. destination can alias indices.
+void OptimizeOverdraw(unsigned int* destination, const unsigned int* indices,
+                      unsigned int indexCount, const float* positions,
+                      unsigned int vertexCount, unsigned int stride,
+                      unsigned int components = 3, float threshold = 1.05f);
+
+// Reorder vertices in the order they are first referenced by the index
+// buffer and rewrite the indices, returns the number of vertices kept.
+// destination must not alias vertices.
+unsigned int OptimizeVertexFetch(void* destination, unsigned int* indices,
+                                 unsigned int indexCount, const void* vertices,
+                                 unsigned int vertexCount,
+                                 unsigned int vertexSize);
+
+// Simulate a FIFO post-transform cache of `cacheSize` entries.
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices,
+                                    unsigned int indexCount,
+                                    unsigned int vertexCount,
+                                    unsigned int cacheSize = 16);
+
+// Quadric error metric simplifier: collapses edges onto existing vertices
+// (so the vertex buffer can be shared between LODs) until the index count
+// reaches targetIndexCount or the error would exceed targetError. Errors are
+// relative to the mesh extent; the achieved error is written to resultError.
+// Vertices on attribute seams are never moved. Returns the new index count.
+unsigned int Simplify(unsigned int* destination, const unsigned int* indices,
+                      unsigned int indexCount, const float* positions,
+                      unsigned int vertexCount, unsigned int stride,
+                      unsigned int components, unsigned int targetIndexCount,
+                      float targetError, float* resultError = nullptr);
+
+// Build a LOD chain by simplifying each level from the previous one, every
+// level targeting `reduction` times its triangles. levels[0] is a copy of
+// the input; errors are in object space and accumulate along the chain.
+// Stops early once a level can't be reduced by at least 10%.
+void GenerateLodChain(std::vector<std::vector<unsigned int>>& levels,
+                      std::vector<float>& errors, const unsigned int* indices,
+                      unsigned int indexCount, const float* positions,
+                      unsigned int vertexCount, unsigned int stride,
+                      unsigned int components, unsigned int maxLevels = 5,
+                      float reduction = 0.5f);
+
+// Run the whole pipeline in place on an interleaved float vertex buffer:
+// dedup -> vertex cache -> overdraw -> vertex fetch. The position is expected
+// at `positionOffset` floats into each vertex (2 or 3 components, z = 0 for
+// 2D). Returns the vertex count and ACMR/ATVR before and after.
+MeshOptimizeStats Optimize(std::vector<float>& vertices,
+                           std::vector<unsigned int>& indices,
+                           unsigned int floatsPerVertex,
+                           unsigned int positionOffset = 0,
+                           unsigned int positionComponents = 3);
+
+}  // namespace MeshOptimizer
@@ -0,0 +1,239 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Log.h"
+#include "Simd.h"
+
+namespace {
+
+glm::vec3 ReadPosition(const float* positions, unsigned int stride,
+                       unsigned int index) {
+  const float* p = (const float*)((const unsigned char*)positions +
+                                  size_t(index) * stride);
+  return glm::vec3(p[0], p[1], p[2]);
+}
+
+void ComputeBounds(Meshlet& meshlet, const unsigned int* indices,
+                   const float* positions, unsigned int stride) {
+  const unsigned int* tris = indices + meshlet.FirstIndex;
+  unsigned int triangleCount = meshlet.IndexCount / 3;
+
+  // sphere around the AABB center, good enough for clusters this small
+  glm::vec3 minimum = ReadPosition(positions, stride, tris[0]);
+  glm::vec3 maximum = minimum;
+  for (unsigned int i = 1; i < meshlet.IndexCount; i++) {
+    glm::vec3 p = ReadPosition(positions, stride, tris[i]);
+    minimum = glm::min(minimum, p);
+    maximum = glm::max(maximum, p);
+  }
+  meshlet.Center = (minimum + maximum) * 0.5f;
+  meshlet.Radius = 0.0f;
+  for (unsigned int i = 0; i < meshlet.IndexCount; i++)
+    meshlet.Radius = std::max(
+        meshlet.Radius,
+        glm::length(ReadPosition(positions, stride, tris[i]) - meshlet.Center));
+
+  // cone around the average normal
+  std::vector<glm::vec3> normals(triangleCount);
+  glm::vec3 axis(0.0f);
+  for (unsigned int t = 0; t < triangleCount; t++) {
+    glm::vec3 p0 = ReadPosition(positions, stride, tris[t * 3 + 0]);
+    glm::vec3 p1 = ReadPosition(positions, stride, tris[t * 3 + 1]);
+    glm::vec3 p2 = ReadPosition(positions, stride, tris[t * 3 + 2]);
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(n);
+    normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+    axis += normals[t];
+  }
+  float axisLength = glm::length(axis);
+  meshlet.ConeAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f);
+  meshlet.ConeApex = meshlet.Center;
+  meshlet.ConeCutoff = 1.0f;  // never culled
+
+  float minDot = 1.0f;
+  for (const glm::vec3& n : normals)
+    minDot = std::min(minDot, glm::dot(n, meshlet.ConeAxis));
+  // the cone gets too wide to ever cull anything past ~85 degrees
+  if (axisLength == 0.0f || minDot <= 0.1f) return;
+
+  // move the apex back along the axis until every triangle's plane is in
+  // front of it, so the test is conservative for all of the cluster
+  float maxT = 0.0f;
+  for (unsigned int t = 0; t < triangleCount; t++) {
+    glm::vec3 p0 = ReadPosition(positions, stride, tris[t * 3 + 0]);
+    float dc = glm::dot(meshlet.ConeAxis, normals[t]);
+    if (dc <= 0.0f) continue;
+    maxT = std::max(maxT, glm::dot(meshlet.Center - p0, normals[t]) / dc);
+  }
+  meshlet.ConeApex = meshlet.Center - meshlet.ConeAxis * maxT;
+  meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+}  // namespace
+
+void BuildMeshlets(std::vector<Meshlet>& meshlets, const unsigned int* indices,
+                   unsigned int indexCount, const float* positions,
+                   unsigned int vertexCount, unsigned int stride) {
+  meshlets.clear();
+  // last meshlet each vertex was added to, to count unique vertices
+  std::vector<unsigned int> owner(vertexCount, ~0u);
+
+  Meshlet current = {};
+  for (unsigned int i = 0; i < indexCount; i += 3) {
+    unsigned int fresh = 0;
+    for (unsigned int k = 0; k < 3; k++)
+      fresh += owner[indices[i + k]] != meshlets.size();
+    // a repeated vertex inside the triangle is counted twice, which only
+    // makes the limit slightly conservative
+
+    if (current.VertexCount + fresh > Meshlet::kMaxVertices ||
+        current.IndexCount / 3 + 1 > Meshlet::kMaxTriangles) {
+      meshlets.push_back(current);
+      current = {};
+      current.FirstIndex = i;
+      fresh = 3;
+    }
+    for (unsigned int k = 0; k < 3; k++)
+      owner[indices[i + k]] = (unsigned int)meshlets.size();
+    current.VertexCount += fresh;
+    current.IndexCount += 3;
+  }
+  if (current.IndexCount > 0) meshlets.push_back(current);
+
+  for (Meshlet& meshlet : meshlets)
+    ComputeBounds(meshlet, indices, positions, stride);
+}
+
+MeshletSet::MeshletSet(const std::vector<Meshlet>& meshlets,
+                       unsigned int indexSize)
+    : m_Count((unsigned int)meshlets.size()), m_IndexSize(indexSize) {
+  size_t padded = (meshlets.size() + 3) & ~size_t(3);
+  // padding: an empty sphere far outside any frustum
+  m_CenterX.assign(padded, 0.0f);
+  m_CenterY.assign(padded, 0.0f);
+  m_CenterZ.assign(padded, 0.0f);
+  m_Radius.assign(padded, -1e30f);
+  m_ApexX.assign(padded, 0.0f);
+  m_ApexY.assign(padded, 0.0f);
+  m_ApexZ.assign(padded, 0.0f);
+  m_AxisX.assign(padded, 0.0f);
+  m_AxisY.assign(padded, 0.0f);
+  m_AxisZ.assign(padded, 0.0f);
+  m_Cutoff.assign(padded, 1.0f);
+  m_FirstIndex.assign(padded, 0);
+  m_IndexCount.assign(padded, 0);
+
+  for (size_t i = 0; i < meshlets.size(); i++) {
+    const Meshlet& m = meshlets[i];
+    m_CenterX[i] = m.Center.x;
+    m_CenterY[i] = m.Center.y;
+    m_CenterZ[i] = m.Center.z;
+    m_Radius[i] = m.Radius;
+    m_ApexX[i] = m.ConeApex.x;
+    m_ApexY[i] = m.ConeApex.y;
+    m_ApexZ[i] = m.ConeApex.z;
+    m_AxisX[i] = m.ConeAxis.x;
+    m_AxisY[i] = m.ConeAxis.y;
+    m_AxisZ[i] = m.ConeAxis.z;
+    m_Cutoff[i] = m.ConeCutoff;
+    m_FirstIndex[i] = m.FirstIndex;
+    m_IndexCount[i] = m.IndexCount;
+  }
+}
+
+void MeshletSet::Cull(const Frustum& frustum, const glm::vec3& cameraPosition,
+                      MultiDrawBatch& batch, MeshletCullStats& stats) const {
+  stats = {};
+  stats.Meshlets = m_Count;
+
+  // merge touching ranges, in indices
+  unsigned int runFirst = 0, runCount = 0;
+  auto flush = [&]() {
+    if (runCount == 0) return;
+    batch.Counts.push_back((int)runCount);
+    batch.Offsets.push_back((const void*)(size_t(runFirst) * m_IndexSize));
+    stats.SubmittedTriangles += runCount / 3;
+    runCount = 0;
+  };
+
+  for (unsigned int base = 0; base < m_Count; base += 4) {
+    unsigned int outside, backfacing;
+#if SIMD_SSE
+    __m128 cx = _mm_loadu_ps(&m_CenterX[base]);
+    __m128 cy = _mm_loadu_ps(&m_CenterY[base]);
+    __m128 cz = _mm_loadu_ps(&m_CenterZ[base]);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_Radius[base]));
+
+    __m128 out = _mm_setzero_ps();
+    for (const glm::vec4& plane : frustum.Planes) {
+      __m128 d = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)),
+                     _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+          _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)),
+                     _mm_set1_ps(plane.w)));
+      out = _mm_or_ps(out, _mm_cmplt_ps(d, negRadius));
+    }
+    outside = (unsigned int)_mm_movemask_ps(out);
+
+    // dot(apex - camera, axis) >= cutoff * |apex - camera|
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_ApexX[base]),
+                           _mm_set1_ps(cameraPosition.x));
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_ApexY[base]),
+                           _mm_set1_ps(cameraPosition.y));
+    __m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_ApexZ[base]),
+                           _mm_set1_ps(cameraPosition.z));
+    __m128 dot = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&m_AxisX[base])),
+                   _mm_mul_ps(dy, _mm_loadu_ps(&m_AxisY[base]))),
+        _mm_mul_ps(dz, _mm_loadu_ps(&m_AxisZ[base])));
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+        _mm_mul_ps(dz, dz)));
+    __m128 cutoff = _mm_loadu_ps(&m_Cutoff[base]);
+    // a cutoff of 1 marks clusters without a usable cone
+    __m128 back = _mm_and_ps(_mm_cmpge_ps(dot, _mm_mul_ps(cutoff, length)),
+                             _mm_cmplt_ps(cutoff, _mm_set1_ps(1.0f)));
+    backfacing = (unsigned int)_mm_movemask_ps(back) & ~outside;
+#else
+    outside = 0;
+    backfacing = 0;
+    for (unsigned int lane = 0; lane < 4; lane++) {
+      unsigned int i = base + lane;
+      glm::vec3 center(m_CenterX[i], m_CenterY[i], m_CenterZ[i]);
+      if (!frustum.IntersectsSphere(center, m_Radius[i])) {
+        outside |= 1u << lane;
+        continue;
+      }
+      glm::vec3 d =
+          glm::vec3(m_ApexX[i], m_ApexY[i], m_ApexZ[i]) - cameraPosition;
+      glm::vec3 axis(m_AxisX[i], m_AxisY[i], m_AxisZ[i]);
+      if (m_Cutoff[i] < 1.0f &&
+          glm::dot(d, axis) >= m_Cutoff[i] * glm::length(d))
+        backfacing |= 1u << lane;
+    }
+#endif
+
+    for (unsigned int lane = 0; lane < 4 && base + lane < m_Count; lane++) {
+      unsigned int i = base + lane;
+      stats.Triangles += m_IndexCount[i] / 3;
+      if (outside & (1u << lane)) {
+        stats.FrustumCulled++;
+        continue;
+      }
+      if (backfacing & (1u << lane)) {
+        stats.BackfaceCulled++;
+        continue;
+      }
+      if (runCount > 0 && runFirst + runCount == m_FirstIndex[i]) {
+        runCount += m_IndexCount[i];
+      } else {
+        flush();
+        runFirst = m_FirstIndex[i];
+        runCount = m_IndexCount[i];
+      }
+    }
+  }
+  flush();
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+
+#include "Frustum.h"
+#include "Renderer.h"
+#include "glm/glm.hpp"
+
+// A cluster of up to kMaxVertices unique vertices / kMaxTriangles triangles
+// that is a contiguous range of the mesh's index buffer, with bounds for
+// culling.
+struct Meshlet {
+  static const unsigned int kMaxVertices = 64;
+  static const unsigned int kMaxTriangles = 124;
+
+  unsigned int FirstIndex;
+  unsigned int IndexCount;
+  unsigned int VertexCount;
+  glm::vec3 Center;  // bounding sphere
+  float Radius;
+  // normal cone: the cluster is back facing from every position p with
+  // dot(normalize(ConeApex - p), ConeAxis) >= ConeCutoff
+  glm::vec3 ConeApex;
+  glm::vec3 ConeAxis;
+  float ConeCutoff;
+};
+
+struct MeshletCullStats {
+  unsigned int Meshlets;
+  unsigned int FrustumCulled;
+  unsigned int BackfaceCulled;
+  unsigned int Triangles;           // in the whole mesh
+  unsigned int SubmittedTriangles;  // after culling
+};
+
+// Split the triangle list into meshlets in index buffer order, so no
+// reordering is needed; run it on vertex cache optimized indices for tight
+// clusters. positions point to the xyz of vertex 0, stride is in bytes.
+void BuildMeshlets(std::vector<Meshlet>& meshlets, const unsigned int* indices,
+                   unsigned int indexCount, const float* positions,
+                   unsigned int vertexCount, unsigned int stride);
+
+// Meshlet bounds in structure of arrays form, culled four at a time.
+class MeshletSet {
+ private:
+  // padded to a multiple of 4 with meshlets that are always culled
+  std::vector<float> m_CenterX, m_CenterY, m_CenterZ, m_Radius;
+  std::vector<float> m_ApexX, m_ApexY, m_ApexZ;
+  std::vector<float> m_AxisX, m_AxisY, m_AxisZ, m_Cutoff;
+  std::vector<unsigned int> m_FirstIndex, m_IndexCount;
+  unsigned int m_Count;
+  unsigned int m_IndexSize;  // bytes per index of the target index buffer
+
+ public:
+  MeshletSet(const std::vector<Meshlet>& meshlets, unsigned int indexSize);
+
+  // Drop meshlets outside `frustum` or facing away from cameraPosition (both
+  // in the meshlets' space) and append the remaining index ranges to batch,
+  // merging ranges that touch.
+  void Cull(const Frustum& frustum, const glm::vec3& cameraPosition,
+            MultiDrawBatch& batch, MeshletCullStats& stats) const;
+
+  inline unsigned int GetCount() const { return m_Count; }
+};
@@ -0,0 +1,74 @@
+#include "MipChain.h"
+
+#include <algorithm>
+
+#include "GL/glew.h"
+
+namespace MipChain {
+
+namespace {
+
+template <typename T>
+T Average(T a, T b, T c, T d) {
+  return (T)(((unsigned int)a + b + c + d + 2) / 4);
+}
+
+template <>
+float Average(float a, float b, float c, float d) {
+  return (a + b + c + d) * 0.25f;
+}
+
+template <typename T>
+void DownsampleImage(const T* source, unsigned int width, unsigned int height,
+                     unsigned int channels, T* destination) {
+  unsigned int w = std::max(1u, width / 2), h = std::max(1u, height / 2);
+  for (unsigned int y = 0; y < h; y++) {
+    unsigned int y0 = std::min(y * 2, height - 1);
+    unsigned int y1 = std::min(y * 2 + 1, height - 1);
+    for (unsigned int x = 0; x < w; x++) {
+      unsigned int x0 = std::min(x * 2, width - 1);
+      unsigned int x1 = std::min(x * 2 + 1, width - 1);
+      for (unsigned int c = 0; c < channels; c++) {
+        destination[(y * w + x) * channels + c] =
+            Average(source[(y0 * width + x0) * channels + c],
+                    source[(y0 * width + x1) * channels + c],
+                    source[(y1 * width + x0) * channels + c],
+                    source[(y1 * width + x1) * channels + c]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+unsigned int CountLevels(unsigned int width, unsigned int height) {
+  unsigned int levels = 1;
+  for (unsigned int size = std::max(width, height); size > 1; size /= 2)
+    levels++;
+  return levels;
+}
+
+void Downsample(const unsigned char* source, unsigned int width,
+                unsigned int height, unsigned char* destination) {
+  DownsampleImage(source, width, height, 4, destination);
+}
+
+void Downsample(const void* source, unsigned int width, unsigned int height,
+                unsigned int channels, unsigned int type, void* destination) {
+  switch (type) {
+    case GL_UNSIGNED_SHORT:
+      DownsampleImage((const unsigned short*)source, width, height, channels,
+                      (unsigned short*)destination);
+      break;
+    case GL_FLOAT:
+      DownsampleImage((const float*)source, width, height, channels,
+                      (float*)destination);
+      break;
+    default:
+      DownsampleImage((const unsigned char*)source, width, height, channels,
+                      (unsigned char*)destination);
+      break;
+  }
+}
+
+}  // namespace MipChain
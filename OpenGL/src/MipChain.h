@@ -0,0 +1,23 @@
+#pragma once
+
+// Mip chain helpers for images on the CPU.
+namespace MipChain {
+
+// levels down to 1x1
+unsigned int CountLevels(unsigned int width, unsigned int height);
+
+inline unsigned int LevelSize(unsigned int size, unsigned int level) {
+  unsigned int reduced = size >> level;
+  return reduced > 0 ? reduced : 1;
+}
+
+// 2x2 box filter into a max(1, width / 2) x max(1, height / 2) image, the
+// odd last row / column folds into the one before
+void Downsample(const unsigned char* source, unsigned int width,
+                unsigned int height, unsigned char* destination);
+// the same for `channels` components of GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT
+// or GL_FLOAT, as stb_image decodes them
+void Downsample(const void* source, unsigned int width, unsigned int height,
+                unsigned int channels, unsigned int type, void* destination);
+
+}  // namespace MipChain
@@ -0,0 +1,359 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "Frustum.h"
+#include "FrustumCuller.h"
+#include "Log.h"
+#include "Simd.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+
+typedef std::chrono::high_resolution_clock Clock;
+
+float Milliseconds(Clock::time_point start) {
+  return std::chrono::duration<float, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// clip space w below this counts as behind the camera
+const float kMinW = 1e-4f;
+
+}  // namespace
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+    : m_Width((width + kTileSize - 1) / kTileSize * kTileSize),
+      m_Height((height + kTileSize - 1) / kTileSize * kTileSize),
+      m_TilesX(m_Width / kTileSize),
+      m_TilesY(m_Height / kTileSize),
+      m_Depth(m_Width * m_Height, 1.0f),
+      m_TileMax(m_TilesX * m_TilesY, 1.0f),
+      m_ViewProjection(1.0f),
+      m_Stats() {}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjection) {
+  m_ViewProjection = viewProjection;
+  std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+  std::fill(m_TileMax.begin(), m_TileMax.end(), 1.0f);
+  m_Stats = OcclusionStats();
+}
+
+void OcclusionCuller::RenderOccluder(const float* positions,
+                                     unsigned int vertexCount,
+                                     unsigned int stride,
+                                     const unsigned int* indices,
+                                     unsigned int indexCount,
+                                     const glm::mat4& model) {
+  auto start = Clock::now();
+  glm::mat4 transform = m_ViewProjection * model;
+  m_Clip.resize(vertexCount);
+  for (unsigned int v = 0; v < vertexCount; v++) {
+    const float* p =
+        (const float*)((const unsigned char*)positions + v * stride);
+    m_Clip[v] = transform * glm::vec4(p[0], p[1], p[2], 1.0f);
+  }
+
+  for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+    const glm::vec4& v0 = m_Clip[indices[i]];
+    const glm::vec4& v1 = m_Clip[indices[i + 1]];
+    const glm::vec4& v2 = m_Clip[indices[i + 2]];
+    if (v0.w < kMinW || v1.w < kMinW || v2.w < kMinW) continue;
+    RasterizeTriangle(v0, v1, v2);
+  }
+  m_Stats.OccluderTriangles += indexCount / 3;
+  m_Stats.RasterMs += Milliseconds(start);
+}
+
+void OcclusionCuller::RasterizeTriangle(const glm::vec4& v0,
+                                        const glm::vec4& v1,
+                                        const glm::vec4& v2) {
+  glm::vec3 p[3];
+  const glm::vec4* clip[3] = {&v0, &v1, &v2};
+  for (int i = 0; i < 3; i++) {
+    float invW = 1.0f / clip[i]->w;
+    p[i].x = (clip[i]->x * invW * 0.5f + 0.5f) * m_Width;
+    p[i].y = (clip[i]->y * invW * 0.5f + 0.5f) * m_Height;
+    p[i].z = clip[i]->z * invW * 0.5f + 0.5f;
+  }
+
+  float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) -
+               (p[1].y - p[0].y) * (p[2].x - p[0].x);
+  if (std::fabs(area) < 1e-8f) return;
+  // occluders are rasterized two sided, make the winding counter clockwise
+  if (area < 0.0f) {
+    std::swap(p[1], p[2]);
+    area = -area;
+  }
+
+  float minX = std::min(p[0].x, std::min(p[1].x, p[2].x));
+  float maxX = std::max(p[0].x, std::max(p[1].x, p[2].x));
+  float minY = std::min(p[0].y, std::min(p[1].y, p[2].y));
+  float maxY = std::max(p[0].y, std::max(p[1].y, p[2].y));
+  int x0 = std::max(0, (int)std::floor(minX));
+  int x1 = std::min((int)m_Width - 1, (int)std::ceil(maxX));
+  int y0 = std::max(0, (int)std::floor(minY));
+  int y1 = std::min((int)m_Height - 1, (int)std::ceil(maxY));
+  if (x0 > x1 || y0 > y1) return;
+
+  // edge functions, edge i is opposite vertex i and positive inside
+  float a[3], b[3], c[3];
+  for (int i = 0; i < 3; i++) {
+    const glm::vec3& from = p[(i + 1) % 3];
+    const glm::vec3& to = p[(i + 2) % 3];
+    a[i] = from.y - to.y;
+    b[i] = to.x - from.x;
+    c[i] = from.x * to.y - from.y * to.x;
+  }
+  // depth as a plane over the screen
+  float invArea = 1.0f / area;
+  float za = (a[0] * p[0].z + a[1] * p[1].z + a[2] * p[2].z) * invArea;
+  float zb = (b[0] * p[0].z + b[1] * p[1].z + b[2] * p[2].z) * invArea;
+  float zc = (c[0] * p[0].z + c[1] * p[1].z + c[2] * p[2].z) * invArea;
+
+  x0 &= ~3;
+#if SIMD_SSE
+  __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  __m128 zero = _mm_setzero_ps();
+  __m128 ea[3], step[3];
+  for (int i = 0; i < 3; i++) {
+    ea[i] = _mm_set1_ps(a[i]);
+    step[i] = _mm_set1_ps(a[i] * 4.0f);
+  }
+  __m128 zStep = _mm_set1_ps(za * 4.0f);
+  for (int y = y0; y <= y1; y++) {
+    float py = y + 0.5f;
+    __m128 px = _mm_add_ps(_mm_set1_ps((float)x0), offsets);
+    __m128 e[3];
+    for (int i = 0; i < 3; i++)
+      e[i] = _mm_add_ps(_mm_mul_ps(ea[i], px), _mm_set1_ps(b[i] * py + c[i]));
+    __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px),
+                          _mm_set1_ps(zb * py + zc));
+    float* row = &m_Depth[y * m_Width];
+    for (int x = x0; x <= x1; x += 4) {
+      __m128 inside = _mm_and_ps(_mm_cmpge_ps(e[0], zero),
+                                 _mm_and_ps(_mm_cmpge_ps(e[1], zero),
+                                            _mm_cmpge_ps(e[2], zero)));
+      if (_mm_movemask_ps(inside)) {
+        __m128 depth = _mm_loadu_ps(row + x);
+        __m128 nearer = _mm_min_ps(depth, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer),
+                                         _mm_andnot_ps(inside, depth)));
+      }
+      for (int i = 0; i < 3; i++) e[i] = _mm_add_ps(e[i], step[i]);
+      z = _mm_add_ps(z, zStep);
+    }
+  }
+#else
+  for (int y = y0; y <= y1; y++) {
+    float py = y + 0.5f;
+    float* row = &m_Depth[y * m_Width];
+    for (int x = x0; x <= x1; x++) {
+      float px = x + 0.5f;
+      if (a[0] * px + b[0] * py + c[0] < 0.0f ||
+          a[1] * px + b[1] * py + c[1] < 0.0f ||
+          a[2] * px + b[2] * py + c[2] < 0.0f)
+        continue;
+      row[x] = std::min(row[x], za * px + zb * py + zc);
+    }
+  }
+#endif
+}
+
+void OcclusionCuller::Finish() {
+  auto start = Clock::now();
+  for (unsigned int ty = 0; ty < m_TilesY; ty++) {
+    for (unsigned int tx = 0; tx < m_TilesX; tx++) {
+      float farthest = 0.0f;
+      for (unsigned int y = 0; y < kTileSize; y++) {
+        const float* row =
+            &m_Depth[(ty * kTileSize + y) * m_Width + tx * kTileSize];
+        for (unsigned int x = 0; x < kTileSize; x++)
+          farthest = std::max(farthest, row[x]);
+      }
+      m_TileMax[ty * m_TilesX + tx] = farthest;
+    }
+  }
+  m_Stats.RasterMs += Milliseconds(start);
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& min, const glm::vec3& max) {
+  m_Stats.Tested++;
+
+  // screen rectangle and nearest depth of the projected corners, which are
+  // the min corner plus any of the three edge vectors
+  float minX, minY, maxX, maxY, nearest;
+  glm::vec4 base = m_ViewProjection * glm::vec4(min, 1.0f);
+  glm::vec3 size = max - min;
+  glm::vec4 edge[3] = {m_ViewProjection[0] * size.x,
+                       m_ViewProjection[1] * size.y,
+                       m_ViewProjection[2] * size.z};
+#if SIMD_SSE
+  // corners 0-3 in the low group, 4-7 (+ edge[2]) in the high group
+  __m128 clip[4][2];
+  for (int c = 0; c < 4; c++) {
+    clip[c][0] = _mm_add_ps(
+        _mm_set1_ps(base[c]),
+        _mm_setr_ps(0.0f, edge[0][c], edge[1][c], edge[0][c] + edge[1][c]));
+    clip[c][1] = _mm_add_ps(clip[c][0], _mm_set1_ps(edge[2][c]));
+  }
+  __m128 minW = _mm_set1_ps(kMinW);
+  // straddles the camera plane, nothing can be said
+  if (_mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(clip[3][0], minW),
+                                _mm_cmplt_ps(clip[3][1], minW))))
+    return true;
+  __m128 half = _mm_set1_ps(0.5f);
+  __m128 lo[3], hi[3];
+  for (int g = 0; g < 2; g++) {
+    __m128 invW = _mm_div_ps(half, clip[3][g]);
+    for (int c = 0; c < 3; c++) {
+      __m128 v = _mm_add_ps(_mm_mul_ps(clip[c][g], invW), half);
+      lo[c] = g ? _mm_min_ps(lo[c], v) : v;
+      hi[c] = g ? _mm_max_ps(hi[c], v) : v;
+    }
+  }
+  float lows[3][4], highs[2][4];
+  for (int c = 0; c < 3; c++) _mm_storeu_ps(lows[c], lo[c]);
+  for (int c = 0; c < 2; c++) _mm_storeu_ps(highs[c], hi[c]);
+  minX = std::min(std::min(lows[0][0], lows[0][1]),
+                  std::min(lows[0][2], lows[0][3])) * m_Width;
+  minY = std::min(std::min(lows[1][0], lows[1][1]),
+                  std::min(lows[1][2], lows[1][3])) * m_Height;
+  nearest = std::min(std::min(lows[2][0], lows[2][1]),
+                     std::min(lows[2][2], lows[2][3]));
+  maxX = std::max(std::max(highs[0][0], highs[0][1]),
+                  std::max(highs[0][2], highs[0][3])) * m_Width;
+  maxY = std::max(std::max(highs[1][0], highs[1][1]),
+                  std::max(highs[1][2], highs[1][3])) * m_Height;
+#else
+  minX = minY = nearest = 1e30f;
+  maxX = maxY = -1e30f;
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec4 clip = base;
+    if (corner & 1) clip += edge[0];
+    if (corner & 2) clip += edge[1];
+    if (corner & 4) clip += edge[2];
+    // straddles the camera plane, nothing can be said
+    if (clip.w < kMinW) return true;
+    float invW = 1.0f / clip.w;
+    float x = (clip.x * invW * 0.5f + 0.5f) * m_Width;
+    float y = (clip.y * invW * 0.5f + 0.5f) * m_Height;
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
+    nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+  }
+#endif
+  if (nearest <= 0.0f) return true;
+
+  int x0 = std::max(0, (int)std::floor(minX));
+  int x1 = std::min((int)m_Width - 1, (int)std::floor(maxX));
+  int y0 = std::max(0, (int)std::floor(minY));
+  int y1 = std::min((int)m_Height - 1, (int)std::floor(maxY));
+  if (x0 > x1 || y0 > y1) {
+    m_Stats.Culled++;  // off screen
+    return false;
+  }
+
+  for (int ty = y0 / (int)kTileSize; ty <= y1 / (int)kTileSize; ty++) {
+    for (int tx = x0 / (int)kTileSize; tx <= x1 / (int)kTileSize; tx++) {
+      // the whole tile is nearer than the box
+      if (m_TileMax[ty * m_TilesX + tx] < nearest) continue;
+
+      int px0 = std::max(x0, tx * (int)kTileSize);
+      int px1 = std::min(x1, (tx + 1) * (int)kTileSize - 1);
+      int py0 = std::max(y0, ty * (int)kTileSize);
+      int py1 = std::min(y1, (ty + 1) * (int)kTileSize - 1);
+      for (int y = py0; y <= py1; y++) {
+        const float* row = &m_Depth[y * m_Width];
+        for (int x = px0; x <= px1; x++)
+          if (row[x] >= nearest) return true;
+      }
+    }
+  }
+  m_Stats.Culled++;
+  return false;
+}
+
+void OcclusionCuller::Cull(const glm::vec3* mins, const glm::vec3* maxs,
+                           std::vector<unsigned int>& visible) {
+  auto start = Clock::now();
+  unsigned int kept = 0;
+  for (unsigned int object : visible)
+    if (IsVisible(mins[object], maxs[object])) visible[kept++] = object;
+  visible.resize(kept);
+  m_Stats.TestMs += Milliseconds(start);
+}
+
+void OcclusionCuller::Benchmark() {
+  // a city block grid of buildings as occluders, small props as occludees
+  const float box[] = {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0,
+                       0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1};
+  const unsigned int boxIndices[] = {0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6,
+                                     0, 4, 5, 0, 5, 1, 3, 2, 6, 3, 6, 7,
+                                     0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2};
+  const int kBlocks = 20;
+  const float kSpacing = 24.0f, kBuilding = 16.0f;
+
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> height(10.0f, 60.0f);
+  std::vector<glm::mat4> buildings;
+  for (int z = 0; z < kBlocks; z++)
+    for (int x = 0; x < kBlocks; x++)
+      buildings.push_back(glm::scale(
+          glm::translate(glm::mat4(1.0f),
+                         glm::vec3((x - kBlocks / 2) * kSpacing, 0.0f,
+                                   z * kSpacing)),
+          glm::vec3(kBuilding, height(random), kBuilding)));
+
+  const unsigned int kObjects = 100000;
+  std::uniform_real_distribution<float> spread(-kBlocks / 2 * kSpacing,
+                                               kBlocks / 2 * kSpacing);
+  std::uniform_real_distribution<float> depth(0.0f, kBlocks * kSpacing);
+  std::vector<glm::vec3> mins(kObjects), maxs(kObjects);
+  FrustumCuller frustumCuller;
+  frustumCuller.Reserve(kObjects);
+  for (unsigned int i = 0; i < kObjects; i++) {
+    glm::vec3 position(spread(random), 0.0f, depth(random));
+    mins[i] = position;
+    maxs[i] = position + glm::vec3(1.0f, 2.0f, 1.0f);
+    frustumCuller.AddBox(mins[i], maxs[i]);
+  }
+
+  // standing in a street looking down the grid
+  glm::vec3 eye(kBuilding + (kSpacing - kBuilding) * 0.5f, 1.7f, -5.0f);
+  glm::mat4 viewProjection =
+      glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+      glm::lookAt(eye, eye + glm::vec3(0.15f, 0.0f, 1.0f),
+                  glm::vec3(0.0f, 1.0f, 0.0f));
+
+  OcclusionCuller culler;
+  std::vector<unsigned int> visible;
+  const int kFrames = 20;
+  OcclusionStats total = OcclusionStats();
+  unsigned int frustumVisible = 0;
+  for (int frame = 0; frame < kFrames; frame++) {
+    frustumCuller.Cull(Frustum::FromMatrix(viewProjection), visible, 1);
+    frustumVisible = (unsigned int)visible.size();
+    culler.Begin(viewProjection);
+    for (const glm::mat4& model : buildings)
+      culler.RenderOccluder(box, 8, 3 * sizeof(float), boxIndices, 36, model);
+    culler.Finish();
+    culler.Cull(mins.data(), maxs.data(), visible);
+    total.RasterMs += culler.GetStats().RasterMs;
+    total.TestMs += culler.GetStats().TestMs;
+  }
+
+  const OcclusionStats& stats = culler.GetStats();
+  std::cout << "[OcclusionCuller] " << stats.OccluderTriangles
+            << " occluder triangles: raster " << total.RasterMs / kFrames
+            << " ms, " << stats.Tested << " occludees: test "
+            << total.TestMs / kFrames << " ms, culled " << stats.CulledPercent()
+            << "% (" << frustumVisible << " -> " << visible.size()
+            << " visible)" << std::endl;
+}
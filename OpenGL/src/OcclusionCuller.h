@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+
+#include "glm/glm.hpp"
+
+struct OcclusionStats {
+  unsigned int OccluderTriangles;
+  unsigned int Tested;
+  unsigned int Culled;
+  float RasterMs;
+  float TestMs;
+
+  inline float CulledPercent() const {
+    return Tested ? 100.0f * Culled / Tested : 0.0f;
+  }
+};
+
+// Software occlusion culling: a few large occluders are rasterized on the
+// CPU into a small depth buffer, then the screen rectangles of occludee
+// boxes are tested against it. Each 8x8 tile also keeps its farthest depth,
+// so most occludees are rejected (or accepted) without touching pixels.
+// Depth is window space z in [0, 1], smaller is nearer, like GL_LESS.
+class OcclusionCuller {
+ private:
+  unsigned int m_Width, m_Height;  // multiples of kTileSize
+  unsigned int m_TilesX, m_TilesY;
+  std::vector<float> m_Depth;
+  std::vector<float> m_TileMax;
+  std::vector<glm::vec4> m_Clip;  // scratch for transformed occluders
+  glm::mat4 m_ViewProjection;
+  OcclusionStats m_Stats;
+
+ public:
+  static const unsigned int kTileSize = 8;
+
+  OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+
+  // clear the depth buffer and statistics for a new frame
+  void Begin(const glm::mat4& viewProjection);
+  // Rasterize an indexed triangle list, positions are 3 floats every
+  // `stride` bytes. Triangles crossing the near plane are skipped, which
+  // only ever makes the buffer less occluding.
+  void RenderOccluder(const float* positions, unsigned int vertexCount,
+                      unsigned int stride, const unsigned int* indices,
+                      unsigned int indexCount, const glm::mat4& model);
+  // build the tile hierarchy, call after the last occluder
+  void Finish();
+
+  bool IsVisible(const glm::vec3& min, const glm::vec3& max);
+  // Remove the occluded objects from `visible` (e.g. FrustumCuller output),
+  // boxes are indexed by its entries.
+  void Cull(const glm::vec3* mins, const glm::vec3* maxs,
+            std::vector<unsigned int>& visible);
+
+  inline const OcclusionStats& GetStats() const { return m_Stats; }
+  inline const std::vector<float>& GetDepth() const { return m_Depth; }
+
+  static void Benchmark();
+
+ private:
+  void RasterizeTriangle(const glm::vec4& v0, const glm::vec4& v1,
+                         const glm::vec4& v2);
+};
@@ -0,0 +1,163 @@
+#include "OcclusionQueries.h"
+
+#include "DeletionQueue.h"
+#include "GL/glew.h"
+#include "Log.h"
+#include "VertexBufferLayout.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+QueryPool::~QueryPool() {
+  // results of this frame may still be on their way
+  for (unsigned int query : m_All)
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Query, query);
+}
+
+unsigned int QueryPool::Acquire() {
+  if (m_Free.empty()) {
+    // grow in batches, query names are cheap but glGen calls are not free
+    const unsigned int kBatch = 64;
+    size_t first = m_All.size();
+    m_All.resize(first + kBatch);
+    GLCall(glGenQueries(kBatch, &m_All[first]));
+    m_Free.insert(m_Free.end(), m_All.begin() + first, m_All.end());
+  }
+  unsigned int query = m_Free.back();
+  m_Free.pop_back();
+  return query;
+}
+
+void QueryPool::Release(unsigned int query) { m_Free.push_back(query); }
+
+OcclusionQueries::OcclusionQueries()
+    : m_Target(GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility
+                   ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+                   : GL_ANY_SAMPLES_PASSED),
+      m_ViewProjection(1.0f),
+      m_Eye(0.0f),
+      m_Stats() {
+  // unit cube, scaled and moved onto each box
+  const float vertices[] = {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0,
+                            0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1};
+  const unsigned int indices[] = {0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6,
+                                  0, 4, 5, 0, 5, 1, 3, 2, 6, 3, 6, 7,
+                                  0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2};
+  m_BoxVertices.reset(new VertexBuffer(vertices, sizeof(vertices)));
+  m_BoxIndices.reset(new IndexBuffer(indices, 36));
+  VertexBufferLayout layout;
+  layout.Push<float>(3);
+  m_BoxVAO.reset(new VertexArray());
+  m_BoxVAO->AddBuffer(*m_BoxVertices, *m_BoxIndices, layout);
+  m_BoxShader.reset(new Shader("res/shaders/BoundingBox.shader"));
+}
+
+OcclusionQueries::~OcclusionQueries() {
+  // pending queries are deleted with the pool
+}
+
+unsigned int OcclusionQueries::Add(const glm::vec3& min,
+                                   const glm::vec3& max) {
+  Object object;
+  object.Min = min;
+  object.Max = max;
+  object.Query = 0;
+  object.Visible = true;
+  m_Objects.push_back(object);
+  return (unsigned int)m_Objects.size() - 1;
+}
+
+void OcclusionQueries::SetBounds(unsigned int object, const glm::vec3& min,
+                                 const glm::vec3& max) {
+  m_Objects[object].Min = min;
+  m_Objects[object].Max = max;
+}
+
+bool OcclusionQueries::ContainsEye(const Object& object) const {
+  // a box around the camera gets clipped by the near plane and would report
+  // occluded, keep a small margin for the near distance
+  const float kMargin = 0.1f;
+  return glm::all(glm::greaterThanEqual(m_Eye, object.Min - kMargin)) &&
+         glm::all(glm::lessThanEqual(m_Eye, object.Max + kMargin));
+}
+
+void OcclusionQueries::Begin(const glm::mat4& viewProjection,
+                             const glm::vec3& eye) {
+  m_ViewProjection = viewProjection;
+  m_Eye = eye;
+  m_Stats = OcclusionQueryStats();
+  m_Stats.Objects = (unsigned int)m_Objects.size();
+
+  for (Object& object : m_Objects) {
+    if (object.Query) {
+      GLuint available = 0;
+      GLCall(glGetQueryObjectuiv(object.Query, GL_QUERY_RESULT_AVAILABLE,
+                                 &available));
+      if (available) {
+        GLuint passed = 0;
+        GLCall(glGetQueryObjectuiv(object.Query, GL_QUERY_RESULT, &passed));
+        object.Visible = passed != 0;
+        m_Pool.Release(object.Query);
+        object.Query = 0;
+      }
+    }
+    m_Stats.Occluded += !object.Visible;
+  }
+}
+
+void OcclusionQueries::BeginBoxes() {
+  GLCall(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+  GLCall(glDepthMask(GL_FALSE));
+  m_BoxShader->Bind();
+  m_BoxVAO->Bind();
+  m_BoxIndices->Bind();
+}
+
+void OcclusionQueries::DrawBox(Object& object) {
+  object.Query = m_Pool.Acquire();
+  glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), object.Min),
+                               object.Max - object.Min);
+  m_BoxShader->SetUniformMat4f("u_MVP", m_ViewProjection * model);
+  GLCall(glBeginQuery(m_Target, object.Query));
+  GLCall(glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr));
+  GLCall(glEndQuery(m_Target));
+  m_Stats.Issued++;
+}
+
+void OcclusionQueries::EndBoxes() {
+  GLCall(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+  GLCall(glDepthMask(GL_TRUE));
+}
+
+void OcclusionQueries::Draw(unsigned int index,
+                            const std::function<void()>& draw) {
+  Object& object = m_Objects[index];
+  if (ContainsEye(object)) object.Visible = true;
+  if (object.Visible) {
+    draw();
+    return;
+  }
+
+  // last seen occluded: let the GPU decide on a fresh (or still pending)
+  // box query, GL_QUERY_WAIT only waits on the GPU timeline
+  if (!object.Query) {
+    BeginBoxes();
+    DrawBox(object);
+    EndBoxes();
+  }
+  GLCall(glBeginConditionalRender(object.Query, GL_QUERY_WAIT));
+  draw();
+  GLCall(glEndConditionalRender());
+  m_Stats.Conditional++;
+}
+
+void OcclusionQueries::End() {
+  bool started = false;
+  for (Object& object : m_Objects) {
+    if (!object.Visible || object.Query || ContainsEye(object)) continue;
+    if (!started) {
+      BeginBoxes();
+      started = true;
+    }
+    DrawBox(object);
+  }
+  if (started) EndBoxes();
+}
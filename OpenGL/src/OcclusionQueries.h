@@ -0,0 +1,92 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "IndexBuffer.h"
+#include "Shader.h"
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+#include "glm/glm.hpp"
+
+// Recycles GL query objects instead of generating and deleting them every
+// frame.
+class QueryPool {
+ private:
+  std::vector<unsigned int> m_Free;
+  std::vector<unsigned int> m_All;
+
+ public:
+  QueryPool() {}
+  ~QueryPool();
+  QueryPool(const QueryPool&) = delete;
+  QueryPool& operator=(const QueryPool&) = delete;
+
+  unsigned int Acquire();
+  void Release(unsigned int query);
+  inline unsigned int GetCount() const { return (unsigned int)m_All.size(); }
+};
+
+struct OcclusionQueryStats {
+  unsigned int Objects;
+  unsigned int Issued;
+  unsigned int Conditional;  // drawn under glBeginConditionalRender
+  unsigned int Occluded;     // last known results
+};
+
+// Hardware occlusion culling with bounding box queries. Results are polled
+// without stalling, so they arrive one or two frames late:
+//  - objects last seen visible are drawn normally, and their boxes are
+//    queried against the finished depth buffer in End();
+//  - objects last seen occluded have their box queried first and are drawn
+//    inside a conditional render on that query, so the GPU skips them
+//    without the CPU waiting for the result.
+// Uses GL_ANY_SAMPLES_PASSED_CONSERVATIVE where available (GL 4.3 or
+// ARB_ES3_compatibility), GL_ANY_SAMPLES_PASSED otherwise.
+class OcclusionQueries {
+ private:
+  struct Object {
+    glm::vec3 Min, Max;
+    unsigned int Query;  // 0 when none is pending
+    bool Visible;
+  };
+
+  std::vector<Object> m_Objects;
+  QueryPool m_Pool;
+  unsigned int m_Target;
+  glm::mat4 m_ViewProjection;
+  glm::vec3 m_Eye;
+  OcclusionQueryStats m_Stats;
+
+  std::unique_ptr<VertexBuffer> m_BoxVertices;
+  std::unique_ptr<IndexBuffer> m_BoxIndices;
+  std::unique_ptr<VertexArray> m_BoxVAO;
+  std::unique_ptr<Shader> m_BoxShader;
+
+ public:
+  OcclusionQueries();
+  ~OcclusionQueries();
+
+  unsigned int Add(const glm::vec3& min, const glm::vec3& max);
+  void SetBounds(unsigned int object, const glm::vec3& min,
+                 const glm::vec3& max);
+
+  // collect the results that are ready
+  void Begin(const glm::mat4& viewProjection, const glm::vec3& eye);
+  // draw an object through `draw`, which must not change the depth state
+  void Draw(unsigned int object, const std::function<void()>& draw);
+  // query the visible objects against the frame's depth
+  void End();
+
+  inline bool IsVisible(unsigned int object) const {
+    return m_Objects[object].Visible;
+  }
+  inline const OcclusionQueryStats& GetStats() const { return m_Stats; }
+  inline unsigned int GetPoolSize() const { return m_Pool.GetCount(); }
+
+ private:
+  bool ContainsEye(const Object& object) const;
+  void BeginBoxes();
+  void DrawBox(Object& object);
+  void EndBoxes();
+};
@@ -0,0 +1,447 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "DeletionQueue.h"
+#include "GL/glew.h"
+#include "Log.h"
+#include "TextureFormat.h"
+
+unsigned int RenderGraphContext::GetTexture(
+    RenderGraphResource resource) const {
+  return m_Graph.m_Resources[resource].Texture;
+}
+
+const RenderGraphTextureDesc& RenderGraphContext::GetDesc(
+    RenderGraphResource resource) const {
+  return m_Graph.m_Resources[resource].Desc;
+}
+
+RenderGraphResource RenderGraph::Builder::Create(
+    const std::string& name, const RenderGraphTextureDesc& desc,
+    Access access) {
+  Resource resource;
+  resource.Name = name;
+  resource.Desc = desc;
+  resource.Imported = false;
+  resource.Texture = 0;
+  resource.Producer = -1;
+  resource.ReadCount = 0;
+  resource.FirstUse = resource.LastUse = -1;
+  resource.LastWrite = Access::RenderTarget;
+  m_Graph.m_Resources.push_back(resource);
+  RenderGraphResource handle =
+      (RenderGraphResource)m_Graph.m_Resources.size() - 1;
+  Write(handle, access);
+  return handle;
+}
+
+void RenderGraph::Builder::Read(RenderGraphResource resource) {
+  Pass& pass = m_Graph.m_Passes[m_Pass];
+  if (std::find(pass.Reads.begin(), pass.Reads.end(), resource) !=
+      pass.Reads.end())
+    return;
+  pass.Reads.push_back(resource);
+  m_Graph.m_Resources[resource].ReadCount++;
+}
+
+void RenderGraph::Builder::Write(RenderGraphResource resource,
+                                 Access access) {
+  Pass& pass = m_Graph.m_Passes[m_Pass];
+  Resource& target = m_Graph.m_Resources[resource];
+  // writing over an earlier pass's output keeps that pass alive
+  if (target.Producer >= 0 && target.Producer != (int)m_Pass) Read(resource);
+  if (target.Imported) pass.SideEffect = true;
+  target.Producer = (int)m_Pass;
+  pass.Writes.push_back(resource);
+  pass.WriteAccess.push_back(access);
+}
+
+void RenderGraph::Builder::SideEffect() {
+  m_Graph.m_Passes[m_Pass].SideEffect = true;
+}
+
+RenderGraph::RenderGraph(RenderTargetPool* pool)
+    : m_Framebuffer(0), m_Pool(pool), m_Compiled(false), m_Stats() {
+  if (!m_Pool) {
+    m_OwnPool.reset(new RenderTargetPool());
+    m_Pool = m_OwnPool.get();
+  }
+}
+
+RenderGraph::~RenderGraph() {
+  for (const Physical& physical : m_Physical)
+    if (physical.Texture)
+      m_Pool->Release(physical.Texture, GetTargetDesc(physical.Desc));
+  DeletionQueue::Get().Delete(DeletionQueue::Type::Framebuffer, m_Framebuffer);
+}
+
+RenderGraphResource RenderGraph::Import(const std::string& name,
+                                        unsigned int texture,
+                                        const RenderGraphTextureDesc& desc) {
+  Resource resource;
+  resource.Name = name;
+  resource.Desc = desc;
+  resource.Imported = true;
+  resource.Texture = texture;
+  resource.Producer = -1;
+  resource.ReadCount = 0;
+  resource.FirstUse = resource.LastUse = -1;
+  resource.LastWrite = Access::RenderTarget;
+  m_Resources.push_back(resource);
+  return (RenderGraphResource)m_Resources.size() - 1;
+}
+
+void RenderGraph::AddPass(
+    const std::string& name, const std::function<void(Builder&)>& setup,
+    const std::function<void(const RenderGraphContext&)>& execute) {
+  Pass pass;
+  pass.Name = name;
+  pass.Execute = execute;
+  pass.SideEffect = false;
+  pass.RefCount = 0;
+  pass.Culled = false;
+  pass.Barrier = false;
+  m_Passes.push_back(pass);
+  Builder builder(*this, (unsigned int)m_Passes.size() - 1);
+  setup(builder);
+  m_Compiled = false;
+}
+
+void RenderGraph::Compile() {
+  m_Stats = RenderGraphStats();
+  m_Stats.Passes = (unsigned int)m_Passes.size();
+
+  // producers of every resource, the last writer is not enough once passes
+  // write over each other's output
+  std::vector<std::vector<unsigned int>> producers(m_Resources.size());
+  for (unsigned int p = 0; p < m_Passes.size(); p++) {
+    // a recompile starts over, passes culled last time may be needed now
+    m_Passes[p].Culled = false;
+    m_Passes[p].RefCount = (unsigned int)m_Passes[p].Writes.size();
+    for (RenderGraphResource resource : m_Passes[p].Writes)
+      producers[resource].push_back(p);
+  }
+
+  // cull: flood back from the resources nobody reads
+  std::vector<unsigned int> readCount(m_Resources.size());
+  std::vector<RenderGraphResource> unread;
+  for (unsigned int r = 0; r < m_Resources.size(); r++) {
+    readCount[r] = m_Resources[r].ReadCount;
+    if (readCount[r] == 0 && !m_Resources[r].Imported) unread.push_back(r);
+  }
+  while (!unread.empty()) {
+    RenderGraphResource resource = unread.back();
+    unread.pop_back();
+    for (unsigned int p : producers[resource]) {
+      Pass& pass = m_Passes[p];
+      if (pass.Culled || pass.SideEffect || --pass.RefCount > 0) continue;
+      pass.Culled = true;
+      m_Stats.CulledPasses++;
+      for (RenderGraphResource read : pass.Reads)
+        if (--readCount[read] == 0 && !m_Resources[read].Imported)
+          unread.push_back(read);
+    }
+  }
+
+  // lifetimes and barriers over the passes that run, in declaration order
+  for (Resource& resource : m_Resources) {
+    resource.FirstUse = resource.LastUse = -1;
+    resource.LastWrite = Access::RenderTarget;
+  }
+  for (unsigned int p = 0; p < m_Passes.size(); p++) {
+    Pass& pass = m_Passes[p];
+    if (pass.Culled) continue;
+    pass.Barrier = false;
+    for (RenderGraphResource read : pass.Reads) {
+      Resource& resource = m_Resources[read];
+      if (resource.LastWrite == Access::Storage) pass.Barrier = true;
+      if (resource.FirstUse < 0) resource.FirstUse = (int)p;
+      resource.LastUse = (int)p;
+    }
+    for (unsigned int w = 0; w < pass.Writes.size(); w++) {
+      Resource& resource = m_Resources[pass.Writes[w]];
+      resource.LastWrite = pass.WriteAccess[w];
+      if (resource.FirstUse < 0) resource.FirstUse = (int)p;
+      resource.LastUse = (int)p;
+    }
+    m_Stats.Barriers += pass.Barrier;
+  }
+
+  // alias: first fit onto a physical texture of the same description that
+  // is free again, GL can't alias memory across formats
+  std::vector<RenderGraphResource> transients;
+  for (unsigned int r = 0; r < m_Resources.size(); r++)
+    if (!m_Resources[r].Imported && m_Resources[r].FirstUse >= 0)
+      transients.push_back(r);
+  std::sort(transients.begin(), transients.end(),
+            [this](RenderGraphResource a, RenderGraphResource b) {
+              return m_Resources[a].FirstUse < m_Resources[b].FirstUse;
+            });
+
+  for (Physical& physical : m_Physical) physical.LastUse = -2;
+  m_Assignment.assign(m_Resources.size(), ~0u);
+  for (RenderGraphResource r : transients) {
+    Resource& resource = m_Resources[r];
+    m_Stats.RequestedBytes += GetTextureBytes(resource.Desc);
+    unsigned int chosen = ~0u;
+    for (unsigned int i = 0; i < m_Physical.size(); i++) {
+      if (m_Physical[i].Desc == resource.Desc &&
+          m_Physical[i].LastUse < resource.FirstUse) {
+        chosen = i;
+        break;
+      }
+    }
+    if (chosen == ~0u) {
+      m_Physical.push_back(Physical{resource.Desc, 0, -2});
+      chosen = (unsigned int)m_Physical.size() - 1;
+    }
+    if (m_Physical[chosen].LastUse == -2)
+      m_Stats.AllocatedBytes += GetTextureBytes(resource.Desc);
+    m_Physical[chosen].LastUse = resource.LastUse;
+    m_Assignment[r] = chosen;
+  }
+  m_Stats.TransientTextures = (unsigned int)transients.size();
+
+  // textures no pass needed this frame go back to the pool
+  std::vector<unsigned int> remap(m_Physical.size(), ~0u);
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < m_Physical.size(); i++) {
+    if (m_Physical[i].LastUse == -2) {
+      const Physical& physical = m_Physical[i];
+      if (physical.Texture)
+        m_Pool->Release(physical.Texture, GetTargetDesc(physical.Desc));
+      continue;
+    }
+    remap[i] = kept;
+    m_Physical[kept++] = m_Physical[i];
+  }
+  m_Physical.resize(kept);
+  for (unsigned int& assignment : m_Assignment)
+    if (assignment != ~0u) assignment = remap[assignment];
+  m_Stats.PhysicalTextures = kept;
+
+  m_Compiled = true;
+}
+
+RenderTargetDesc RenderGraph::GetTargetDesc(
+    const RenderGraphTextureDesc& desc) {
+  return RenderTargetDesc{desc.Width, desc.Height, desc.InternalFormat, 1,
+                          false};
+}
+
+void RenderGraph::Realize() {
+  for (Physical& physical : m_Physical)
+    if (!physical.Texture)
+      physical.Texture = m_Pool->Acquire(GetTargetDesc(physical.Desc));
+  for (unsigned int r = 0; r < m_Resources.size(); r++)
+    if (m_Assignment[r] != ~0u)
+      m_Resources[r].Texture = m_Physical[m_Assignment[r]].Texture;
+}
+
+void RenderGraph::Execute() {
+  if (!m_Compiled) Compile();
+  Realize();
+
+  RenderGraphContext context(*this);
+  unsigned int attachedColors = 0;
+  for (const Pass& pass : m_Passes) {
+    if (pass.Culled) continue;
+    if (pass.Barrier && GLEW_VERSION_4_2) {
+      GLCall(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                             GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                             GL_FRAMEBUFFER_BARRIER_BIT));
+    }
+
+    std::vector<GLenum> drawBuffers;
+    const Resource* depth = nullptr;
+    const Resource* size = nullptr;
+    bool toDefault = false;
+    for (unsigned int w = 0; w < pass.Writes.size(); w++) {
+      if (pass.WriteAccess[w] != Access::RenderTarget) continue;
+      const Resource& resource = m_Resources[pass.Writes[w]];
+      size = &resource;
+      if (resource.Imported && resource.Texture == 0) {
+        toDefault = true;
+      } else if (TextureFormat::IsDepth(resource.Desc.InternalFormat)) {
+        depth = &resource;
+      } else {
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 +
+                              (GLenum)drawBuffers.size());
+      }
+    }
+
+    if (toDefault) {
+      GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    } else if (size) {
+      if (!m_Framebuffer) {
+        GLCall(glGenFramebuffers(1, &m_Framebuffer));
+      }
+      GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer));
+      unsigned int color = 0;
+      for (unsigned int w = 0; w < pass.Writes.size(); w++) {
+        const Resource& resource = m_Resources[pass.Writes[w]];
+        if (pass.WriteAccess[w] != Access::RenderTarget ||
+            TextureFormat::IsDepth(resource.Desc.InternalFormat))
+          continue;
+        GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER,
+                                      GL_COLOR_ATTACHMENT0 + color++,
+                                      GL_TEXTURE_2D, resource.Texture, 0));
+      }
+      // detach what the previous pass left behind
+      for (unsigned int i = color; i < attachedColors; i++) {
+        GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                                      GL_TEXTURE_2D, 0, 0));
+      }
+      attachedColors = color;
+      GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                                    GL_TEXTURE_2D, 0, 0));
+      if (depth) {
+        GLenum attachment =
+            TextureFormat::HasStencil(depth->Desc.InternalFormat)
+                ? GL_DEPTH_STENCIL_ATTACHMENT
+                : GL_DEPTH_ATTACHMENT;
+        GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+                                      depth->Texture, 0));
+      }
+      if (drawBuffers.empty()) {
+        GLCall(glDrawBuffer(GL_NONE));
+      } else {
+        GLCall(glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data()));
+      }
+    }
+    if (size) {
+      GLCall(glViewport(0, 0, size->Desc.Width, size->Desc.Height));
+    }
+
+    pass.Execute(context);
+  }
+  GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+void RenderGraph::Reset() {
+  m_Passes.clear();
+  m_Resources.clear();
+  m_Assignment.clear();
+  m_Compiled = false;
+  if (m_OwnPool) m_OwnPool->EndFrame();
+}
+
+size_t RenderGraph::GetTextureBytes(const RenderGraphTextureDesc& desc) {
+  return TextureFormat::GetBytesPerPixel(desc.InternalFormat) * desc.Width *
+         desc.Height;
+}
+
+void RenderGraph::PrintStats() const {
+  const double mb = 1.0 / (1024.0 * 1024.0);
+  std::cout << "[RenderGraph] passes " << m_Stats.Passes - m_Stats.CulledPasses
+            << " / " << m_Stats.Passes << " (" << m_Stats.CulledPasses
+            << " culled), barriers " << m_Stats.Barriers << ", transients "
+            << m_Stats.TransientTextures << " on "
+            << m_Stats.PhysicalTextures << " textures, "
+            << m_Stats.RequestedBytes * mb << " MB -> "
+            << m_Stats.AllocatedBytes * mb << " MB (saved "
+            << (m_Stats.RequestedBytes - m_Stats.AllocatedBytes) * mb
+            << " MB)" << std::endl;
+}
+
+void RenderGraph::Report(unsigned int width, unsigned int height) {
+  RenderGraph graph;
+  auto nothing = [](const RenderGraphContext&) {};
+  RenderGraphTextureDesc full = {width, height, GL_RGBA8};
+  RenderGraphTextureDesc half = {width / 2, height / 2, GL_RGBA16F};
+
+  RenderGraphResource backbuffer = graph.Import("Backbuffer", 0, full);
+  RenderGraphResource albedo, normal, depth, ao, aoBlur, hdr, luminance,
+      bright, blurH, blurV, bloomed, ldr;
+  graph.AddPass("GBuffer",
+                [&](Builder& builder) {
+                  albedo = builder.Create("Albedo", {width, height, GL_RGBA8});
+                  normal =
+                      builder.Create("Normal", {width, height, GL_RGBA16F});
+                  depth = builder.Create(
+                      "Depth", {width, height, GL_DEPTH24_STENCIL8});
+                },
+                nothing);
+  graph.AddPass("SSAO",
+                [&](Builder& builder) {
+                  builder.Read(normal);
+                  builder.Read(depth);
+                  ao = builder.Create("AO", {width, height, GL_R8});
+                },
+                nothing);
+  graph.AddPass("SSAOBlur",
+                [&](Builder& builder) {
+                  builder.Read(ao);
+                  aoBlur = builder.Create("AOBlur", {width, height, GL_R8});
+                },
+                nothing);
+  graph.AddPass("Lighting",
+                [&](Builder& builder) {
+                  builder.Read(albedo);
+                  builder.Read(normal);
+                  builder.Read(depth);
+                  builder.Read(aoBlur);
+                  hdr = builder.Create("HDR", {width, height, GL_RGBA16F});
+                },
+                nothing);
+  graph.AddPass("Luminance",
+                [&](Builder& builder) {
+                  builder.Read(hdr);
+                  // written by image store, Tonemap needs a barrier
+                  luminance = builder.Create("Luminance", {1, 1, GL_R32F},
+                                             Access::Storage);
+                },
+                nothing);
+  graph.AddPass("BloomBright",
+                [&](Builder& builder) {
+                  builder.Read(hdr);
+                  bright = builder.Create("Bright", half);
+                },
+                nothing);
+  graph.AddPass("BloomBlurH",
+                [&](Builder& builder) {
+                  builder.Read(bright);
+                  blurH = builder.Create("BlurH", half);
+                },
+                nothing);
+  graph.AddPass("BloomBlurV",
+                [&](Builder& builder) {
+                  builder.Read(blurH);
+                  blurV = builder.Create("BlurV", half);
+                },
+                nothing);
+  graph.AddPass("DebugNormals",
+                [&](Builder& builder) {
+                  builder.Read(normal);
+                  builder.Create("NormalView", full);
+                },
+                nothing);
+  graph.AddPass("BloomComposite",
+                [&](Builder& builder) {
+                  builder.Read(hdr);
+                  builder.Read(blurV);
+                  bloomed =
+                      builder.Create("HDRBloom", {width, height, GL_RGBA16F});
+                },
+                nothing);
+  graph.AddPass("Tonemap",
+                [&](Builder& builder) {
+                  builder.Read(bloomed);
+                  builder.Read(luminance);
+                  ldr = builder.Create("LDR", full);
+                },
+                nothing);
+  graph.AddPass("FXAA",
+                [&](Builder& builder) {
+                  builder.Read(ldr);
+                  builder.Write(backbuffer);
+                },
+                nothing);
+
+  graph.Compile();
+  std::cout << "[RenderGraph] deferred pipeline at " << width << "x" << height
+            << std::endl;
+  graph.PrintStats();
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+struct RenderGraphTextureDesc {
+  unsigned int Width;
+  unsigned int Height;
+  unsigned int InternalFormat;  // GL_RGBA8, GL_RGBA16F, GL_DEPTH24_STENCIL8...
+
+  inline bool operator==(const RenderGraphTextureDesc& other) const {
+    return Width == other.Width && Height == other.Height &&
+           InternalFormat == other.InternalFormat;
+  }
+};
+
+typedef unsigned int RenderGraphResource;
+
+struct RenderGraphStats {
+  unsigned int Passes;
+  unsigned int CulledPasses;
+  unsigned int Barriers;
+  unsigned int TransientTextures;
+  unsigned int PhysicalTextures;
+  size_t RequestedBytes;  // every transient with its own texture
+  size_t AllocatedBytes;  // after aliasing
+};
+
+class RenderGraph;
+
+// what a pass's execute callback can look up
+class RenderGraphContext {
+ private:
+  const RenderGraph& m_Graph;
+
+ public:
+  RenderGraphContext(const RenderGraph& graph) : m_Graph(graph) {}
+  // GL texture name backing a resource this frame
+  unsigned int GetTexture(RenderGraphResource resource) const;
+  const RenderGraphTextureDesc& GetDesc(RenderGraphResource resource) const;
+};
+
+// Frame graph: passes declare the textures they create, read and write,
+// then Compile() culls passes whose output nobody reads, works out where
+// storage writes need a barrier and assigns transient textures with
+// disjoint lifetimes to the same GL texture. Execute() binds each pass's
+// outputs as its framebuffer and runs it. Physical textures are kept
+// between frames, passes and resources are rebuilt every frame; textures a
+// frame stops using go back to the RenderTargetPool.
+class RenderGraph {
+ public:
+  enum class Access { RenderTarget, Storage };
+
+  class Builder {
+   private:
+    RenderGraph& m_Graph;
+    unsigned int m_Pass;
+
+   public:
+    Builder(RenderGraph& graph, unsigned int pass)
+        : m_Graph(graph), m_Pass(pass) {}
+
+    // transient texture written by this pass
+    RenderGraphResource Create(const std::string& name,
+                               const RenderGraphTextureDesc& desc,
+                               Access access = Access::RenderTarget);
+    void Read(RenderGraphResource resource);
+    void Write(RenderGraphResource resource,
+               Access access = Access::RenderTarget);
+    // never cull this pass, e.g. it uploads or reads back
+    void SideEffect();
+  };
+
+ private:
+  struct Resource {
+    std::string Name;
+    RenderGraphTextureDesc Desc;
+    bool Imported;
+    unsigned int Texture;  // imported name, or physical after compile
+    int Producer;          // last pass writing it
+    unsigned int ReadCount;
+    int FirstUse, LastUse;
+    Access LastWrite;
+  };
+
+  struct Pass {
+    std::string Name;
+    std::function<void(const RenderGraphContext&)> Execute;
+    std::vector<RenderGraphResource> Reads;
+    std::vector<RenderGraphResource> Writes;
+    std::vector<Access> WriteAccess;
+    bool SideEffect;
+    unsigned int RefCount;
+    bool Culled;
+    bool Barrier;  // reads something last written by storage access
+  };
+
+  struct Physical {
+    RenderGraphTextureDesc Desc;
+    unsigned int Texture;  // 0 until first executed
+    int LastUse;           // during aliasing
+  };
+
+  std::vector<Resource> m_Resources;
+  std::vector<Pass> m_Passes;
+  std::vector<Physical> m_Physical;
+  std::vector<unsigned int> m_Assignment;  // transient -> physical
+  unsigned int m_Framebuffer;
+  RenderTargetPool* m_Pool;
+  std::unique_ptr<RenderTargetPool> m_OwnPool;  // when none is shared
+  bool m_Compiled;
+  RenderGraphStats m_Stats;
+
+  friend class RenderGraphContext;
+
+ public:
+  // pool = nullptr keeps a private one, aged in Reset()
+  explicit RenderGraph(RenderTargetPool* pool = nullptr);
+  ~RenderGraph();
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+
+  // texture owned elsewhere, 0 is the default framebuffer. Passes writing
+  // imported resources are never culled.
+  RenderGraphResource Import(const std::string& name, unsigned int texture,
+                             const RenderGraphTextureDesc& desc);
+  void AddPass(const std::string& name,
+               const std::function<void(Builder&)>& setup,
+               const std::function<void(const RenderGraphContext&)>& execute);
+
+  void Compile();
+  void Execute();
+  // drop this frame's passes and resources, keep the physical textures
+  void Reset();
+
+  inline const RenderGraphStats& GetStats() const { return m_Stats; }
+  void PrintStats() const;
+
+  static size_t GetTextureBytes(const RenderGraphTextureDesc& desc);
+  // compile a deferred pipeline (without GL) and print the aliasing savings
+  static void Report(unsigned int width = 1920, unsigned int height = 1080);
+
+ private:
+  void Realize();
+  static RenderTargetDesc GetTargetDesc(const RenderGraphTextureDesc& desc);
+};
@@ -0,0 +1,129 @@
+#include "GL/glew.h"
+#include "RenderGraph.h"
+#include "SelfTest.h"
+
+namespace {
+
+const RenderGraphTextureDesc kColor = {64, 64, GL_RGBA8};
+const RenderGraphTextureDesc kHdr = {64, 64, GL_RGBA16F};
+
+void Nothing(const RenderGraphContext&) {}
+
+}  // namespace
+
+void SelfTest::RenderGraphTests() {
+  typedef RenderGraph::Builder Builder;
+
+  // a -> b -> c -> backbuffer: a is dead once b is written, c takes its
+  // texture
+  {
+    RenderGraph graph;
+    RenderGraphResource backbuffer = graph.Import("Backbuffer", 0, kColor);
+    RenderGraphResource a = 0, b = 0, c = 0;
+    graph.AddPass("A",
+                  [&](Builder& builder) { a = builder.Create("a", kColor); },
+                  Nothing);
+    graph.AddPass("B",
+                  [&](Builder& builder) {
+                    builder.Read(a);
+                    b = builder.Create("b", kColor);
+                  },
+                  Nothing);
+    graph.AddPass("C",
+                  [&](Builder& builder) {
+                    builder.Read(b);
+                    c = builder.Create("c", kColor);
+                  },
+                  Nothing);
+    graph.AddPass("Present",
+                  [&](Builder& builder) {
+                    builder.Read(c);
+                    builder.Write(backbuffer);
+                  },
+                  Nothing);
+    graph.Compile();
+    const RenderGraphStats& stats = graph.GetStats();
+    EXPECT(stats.CulledPasses == 0);
+    EXPECT(stats.TransientTextures == 3);
+    EXPECT(stats.PhysicalTextures == 2);
+    EXPECT(stats.RequestedBytes == 3 * RenderGraph::GetTextureBytes(kColor));
+    EXPECT(stats.AllocatedBytes == 2 * RenderGraph::GetTextureBytes(kColor));
+  }
+
+  // the same chain in two formats never shares a texture across them
+  {
+    RenderGraph graph;
+    RenderGraphResource backbuffer = graph.Import("Backbuffer", 0, kColor);
+    RenderGraphResource a = 0, b = 0;
+    graph.AddPass("A",
+                  [&](Builder& builder) { a = builder.Create("a", kHdr); },
+                  Nothing);
+    graph.AddPass("B",
+                  [&](Builder& builder) {
+                    builder.Read(a);
+                    b = builder.Create("b", kColor);
+                  },
+                  Nothing);
+    graph.AddPass("Present",
+                  [&](Builder& builder) {
+                    builder.Read(b);
+                    builder.Write(backbuffer);
+                  },
+                  Nothing);
+    graph.Compile();
+    EXPECT(graph.GetStats().PhysicalTextures == 2);
+  }
+
+  // x feeds y, which nobody reads: both passes go, the one with a side
+  // effect stays
+  {
+    RenderGraph graph;
+    RenderGraphResource backbuffer = graph.Import("Backbuffer", 0, kColor);
+    RenderGraphResource x = 0;
+    graph.AddPass("X",
+                  [&](Builder& builder) { x = builder.Create("x", kColor); },
+                  Nothing);
+    graph.AddPass("Y",
+                  [&](Builder& builder) {
+                    builder.Read(x);
+                    builder.Create("y", kColor);
+                  },
+                  Nothing);
+    graph.AddPass("Readback",
+                  [&](Builder& builder) {
+                    builder.Create("z", kColor);
+                    builder.SideEffect();
+                  },
+                  Nothing);
+    graph.AddPass("Present",
+                  [&](Builder& builder) { builder.Write(backbuffer); },
+                  Nothing);
+    graph.Compile();
+    const RenderGraphStats& stats = graph.GetStats();
+    EXPECT(stats.CulledPasses == 2);
+    EXPECT(stats.TransientTextures == 1);
+    EXPECT(stats.PhysicalTextures == 1);
+  }
+
+  // a storage write read by a later pass needs a barrier before it
+  {
+    RenderGraph graph;
+    RenderGraphResource backbuffer = graph.Import("Backbuffer", 0, kColor);
+    RenderGraphResource s = 0;
+    graph.AddPass("Compute",
+                  [&](Builder& builder) {
+                    s = builder.Create("s", kColor,
+                                       RenderGraph::Access::Storage);
+                  },
+                  Nothing);
+    graph.AddPass("Present",
+                  [&](Builder& builder) {
+                    builder.Read(s);
+                    builder.Write(backbuffer);
+                  },
+                  Nothing);
+    graph.Compile();
+    EXPECT(graph.GetStats().Barriers == 1);
+    EXPECT(graph.GetStats().CulledPasses == 0);
+  }
+}
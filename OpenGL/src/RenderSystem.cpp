@@ -0,0 +1,186 @@
+#include "RenderSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include "JobSystem.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+namespace {
+
+// Arvo: transform the center, the extent goes through |M|
+void TransformBounds(const glm::mat4& m, const glm::vec3& min,
+                     const glm::vec3& max, glm::vec3& outMin,
+                     glm::vec3& outMax) {
+  glm::vec3 center = (min + max) * 0.5f;
+  glm::vec3 extent = (max - min) * 0.5f;
+  glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+  glm::vec3 worldExtent = glm::abs(glm::vec3(m[0])) * extent.x +
+                          glm::abs(glm::vec3(m[1])) * extent.y +
+                          glm::abs(glm::vec3(m[2])) * extent.z;
+  outMin = worldCenter - worldExtent;
+  outMax = worldCenter + worldExtent;
+}
+
+bool Intersects(const Frustum& frustum, const glm::vec3& min,
+                const glm::vec3& max) {
+  glm::vec3 center = (min + max) * 0.5f;
+  glm::vec3 extent = (max - min) * 0.5f;
+  for (const glm::vec4& plane : frustum.Planes) {
+    float d = glm::dot(glm::vec3(plane), center) + plane.w;
+    float r = glm::dot(glm::abs(glm::vec3(plane)), extent);
+    if (d + r < 0.0f) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+namespace RenderSystem {
+
+void UpdateBounds(World& world, unsigned int threads) {
+  world.ParallelForEachChunk<Transform, LocalBounds, WorldBounds>(
+      [](unsigned int count, const Entity*, Transform* transforms,
+         LocalBounds* local, WorldBounds* bounds) {
+        for (unsigned int i = 0; i < count; i++)
+          TransformBounds(transforms[i].World, local[i].Min, local[i].Max,
+                          bounds[i].Min, bounds[i].Max);
+      },
+      threads);
+}
+
+void CollectVisible(World& world, const Frustum& frustum,
+                    std::vector<DrawItem>& items) {
+  items.clear();
+  world.ForEachChunk<Transform, WorldBounds, MeshRef, MaterialRef>(
+      [&](unsigned int count, const Entity*, Transform* transforms,
+          WorldBounds* bounds, MeshRef* meshes, MaterialRef* materials) {
+        for (unsigned int i = 0; i < count; i++) {
+          if (!Intersects(frustum, bounds[i].Min, bounds[i].Max)) continue;
+          DrawItem item;
+          item.Key = (uint64_t)materials[i].Material.Value << 32 |
+                     meshes[i].Mesh.Value;
+          item.World = &transforms[i].World;
+          items.push_back(item);
+        }
+      });
+  std::sort(items.begin(), items.end(),
+            [](const DrawItem& a, const DrawItem& b) { return a.Key < b.Key; });
+}
+
+void Draw(const Renderer& renderer, const std::vector<DrawItem>& items,
+          GpuResources& resources, const glm::mat4& viewProjection) {
+  // items come sorted, so materials and meshes are looked up once per run
+  uint64_t materialKey = ~0ull, meshKey = ~0ull;
+  Shader* shader = nullptr;
+  const VertexArray* va = nullptr;
+  const IndexBuffer* ib = nullptr;
+  for (const DrawItem& item : items) {
+    if (item.Key >> 32 != materialKey) {
+      materialKey = item.Key >> 32;
+      shader = resources.Shaders.Get(
+          ShaderHandle::FromValue((uint32_t)materialKey));
+      if (shader) shader->Bind();
+    }
+    if ((item.Key & 0xFFFFFFFF) != meshKey) {
+      meshKey = item.Key & 0xFFFFFFFF;
+      const RenderMesh* mesh =
+          resources.Meshes.Get(MeshHandle::FromValue((uint32_t)meshKey));
+      va = mesh ? resources.VertexArrays.Get(mesh->VAO) : nullptr;
+      ib = mesh ? resources.IndexBuffers.Get(mesh->Indices) : nullptr;
+    }
+    if (!shader || !va || !ib) continue;
+    shader->SetUniformMat4f("u_MVP", viewProjection * *item.World);
+    renderer.Draw(*va, *ib, *shader);
+  }
+}
+
+void Benchmark(unsigned int entityCount) {
+  typedef std::chrono::high_resolution_clock Clock;
+  auto ms = [](Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  };
+
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::vector<glm::mat4> transforms(entityCount);
+  for (glm::mat4& transform : transforms)
+    transform = glm::translate(
+        glm::mat4(1.0f),
+        glm::vec3(position(random), position(random), position(random)));
+  LocalBounds local = {glm::vec3(-1.0f), glm::vec3(1.0f)};
+
+  World world;
+  auto start = Clock::now();
+  for (unsigned int i = 0; i < entityCount; i++)
+    world.Create(Transform{transforms[i]}, local, WorldBounds(),
+                 MeshRef{MeshHandle(i % 16, 1)},
+                 MaterialRef{ShaderHandle(i % 4, 1)});
+  double create = ms(start);
+
+  // the scattered layout being replaced: one heap object per renderable
+  // with its transform allocated separately, visited in creation order
+  struct Renderable {
+    std::unique_ptr<glm::mat4> World;
+    LocalBounds Local;
+    WorldBounds Bounds;
+    MeshHandle Mesh;
+    ShaderHandle Material;
+  };
+  std::vector<std::unique_ptr<Renderable>> objects(entityCount);
+  std::vector<std::unique_ptr<char[]>> noise;
+  for (unsigned int i = 0; i < entityCount; i++) {
+    objects[i].reset(new Renderable());
+    objects[i]->World.reset(new glm::mat4(transforms[i]));
+    objects[i]->Local = local;
+    objects[i]->Mesh = MeshHandle(i % 16, 1);
+    objects[i]->Material = ShaderHandle(i % 4, 1);
+    // interleave other allocations like a running program would
+    noise.emplace_back(new char[16 + random() % 256]);
+  }
+
+  Frustum frustum = Frustum::FromMatrix(
+      glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f) *
+      glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+                  glm::vec3(0.0f, 1.0f, 0.0f)));
+
+  start = Clock::now();
+  std::vector<DrawItem> scattered;
+  for (const auto& object : objects) {
+    TransformBounds(*object->World, object->Local.Min, object->Local.Max,
+                    object->Bounds.Min, object->Bounds.Max);
+    if (!Intersects(frustum, object->Bounds.Min, object->Bounds.Max)) continue;
+    DrawItem item;
+    item.Key = (uint64_t)object->Material.Value << 32 | object->Mesh.Value;
+    item.World = object->World.get();
+    scattered.push_back(item);
+  }
+  std::sort(scattered.begin(), scattered.end(),
+            [](const DrawItem& a, const DrawItem& b) { return a.Key < b.Key; });
+  double baseline = ms(start);
+
+  std::vector<DrawItem> items;
+  unsigned int hardware = JobSystem::Get().GetWorkerCount();
+  std::cout << "[Ecs] " << entityCount << " entities in "
+            << world.GetChunkCount() << " chunks, created in " << create
+            << " ms; heap objects: " << baseline << " ms" << std::endl;
+  for (unsigned int threads : {1u, hardware}) {
+    start = Clock::now();
+    UpdateBounds(world, threads);
+    double update = ms(start);
+    start = Clock::now();
+    CollectVisible(world, frustum, items);
+    double collect = ms(start);
+    std::cout << "[Ecs] " << threads << " threads: bounds " << update
+              << " ms, collect " << collect << " ms, " << items.size()
+              << " visible (heap objects " << scattered.size() << ")"
+              << std::endl;
+    if (hardware == 1) break;
+  }
+}
+
+}  // namespace RenderSystem
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Ecs.h"
+#include "Frustum.h"
+#include "GpuResources.h"
+#include "Renderer.h"
+#include "glm/glm.hpp"
+
+// components of a renderable entity
+struct Transform {
+  glm::mat4 World;
+};
+struct LocalBounds {
+  glm::vec3 Min, Max;
+};
+struct WorldBounds {
+  glm::vec3 Min, Max;
+};
+// handles into the GpuResources handed to RenderSystem::Draw
+struct MeshRef {
+  MeshHandle Mesh;
+};
+struct MaterialRef {
+  ShaderHandle Material;
+};
+
+// sorted by material then mesh (the handle values), World points into chunk
+// memory and stays valid until the next structural change
+struct DrawItem {
+  uint64_t Key;
+  const glm::mat4* World;
+};
+
+namespace RenderSystem {
+
+// WorldBounds = LocalBounds transformed by Transform, parallel over chunks
+void UpdateBounds(World& world, unsigned int threads = 0);
+
+// replace `items` with the entities whose WorldBounds touch the frustum
+void CollectVisible(World& world, const Frustum& frustum,
+                    std::vector<DrawItem>& items);
+
+// shaders get u_MVP = viewProjection * World per item; items whose mesh or
+// material was destroyed are skipped
+void Draw(const Renderer& renderer, const std::vector<DrawItem>& items,
+          GpuResources& resources, const glm::mat4& viewProjection);
+
+// ECS chunks against one heap object per renderable
+void Benchmark(unsigned int entityCount = 1000000);
+
+}  // namespace RenderSystem
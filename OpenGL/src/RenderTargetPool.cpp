@@ -0,0 +1,141 @@
+#include "RenderTargetPool.h"
+
+#include "DeletionQueue.h"
+#include "GL/glew.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "TextureFormat.h"
+
+const unsigned int RenderTargetPool::kMaxIdleFrames;
+
+namespace {
+
+size_t GetBytes(const RenderTargetDesc& desc) {
+  return (size_t)TextureFormat::GetBytesPerPixel(desc.InternalFormat) *
+         desc.Width * desc.Height * (desc.Samples > 1 ? desc.Samples : 1);
+}
+
+}  // namespace
+
+RenderTargetPool::RenderTargetPool() : m_Frame(0), m_Stats() {}
+
+RenderTargetPool::~RenderTargetPool() {
+  for (const Entry& entry : m_Entries) Destroy(entry);
+}
+
+unsigned int RenderTargetPool::Acquire(const RenderTargetDesc& desc) {
+  RenderTargetDesc key = Normalize(desc);
+
+  for (Entry& entry : m_Entries) {
+    if (!entry.InUse && entry.Desc == key) {
+      entry.InUse = true;
+      m_Stats.Reuses++;
+      m_Stats.Live++;
+      m_Stats.Pooled--;
+      return entry.ID;
+    }
+  }
+
+  Entry entry{key, Create(key), true, m_Frame};
+  m_Entries.push_back(entry);
+  m_Stats.Allocations++;
+  m_Stats.Live++;
+  m_Stats.Bytes += GetBytes(key);
+  GpuMemory::Get().Allocate(GpuMemoryCategory::RenderTarget, GetBytes(key));
+  return entry.ID;
+}
+
+void RenderTargetPool::Release(unsigned int id,
+                               const RenderTargetDesc& desc) {
+  RenderTargetDesc key = Normalize(desc);
+  for (Entry& entry : m_Entries) {
+    if (entry.ID == id && entry.InUse && entry.Desc == key) {
+      entry.InUse = false;
+      entry.LastFrame = m_Frame;
+      m_Stats.Live--;
+      m_Stats.Pooled++;
+      return;
+    }
+  }
+  ASSERT(false);  // not from this pool
+}
+
+void RenderTargetPool::EndFrame() {
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < m_Entries.size(); i++) {
+    const Entry& entry = m_Entries[i];
+    if (!entry.InUse && m_Frame - entry.LastFrame >= kMaxIdleFrames) {
+      Destroy(entry);
+      m_Stats.Frees++;
+      m_Stats.Pooled--;
+      m_Stats.Bytes -= GetBytes(entry.Desc);
+      continue;
+    }
+    m_Entries[kept++] = entry;
+  }
+  m_Entries.resize(kept);
+  m_Frame++;
+  m_Stats.Allocations = m_Stats.Frees = m_Stats.Reuses = 0;
+}
+
+void RenderTargetPool::Trim() {
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < m_Entries.size(); i++) {
+    const Entry& entry = m_Entries[i];
+    if (!entry.InUse) {
+      Destroy(entry);
+      m_Stats.Pooled--;
+      m_Stats.Bytes -= GetBytes(entry.Desc);
+      continue;
+    }
+    m_Entries[kept++] = entry;
+  }
+  m_Entries.resize(kept);
+}
+
+RenderTargetDesc RenderTargetPool::Normalize(const RenderTargetDesc& desc) {
+  RenderTargetDesc key = desc;
+  if (key.Samples == 0) key.Samples = 1;
+  if (key.Samples > 1) key.Renderbuffer = true;
+  return key;
+}
+
+unsigned int RenderTargetPool::Create(const RenderTargetDesc& desc) {
+  unsigned int id;
+  if (desc.Renderbuffer) {
+    GLCall(glGenRenderbuffers(1, &id));
+    GLCall(glBindRenderbuffer(GL_RENDERBUFFER, id));
+    if (desc.Samples > 1) {
+      GLCall(glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.Samples,
+                                              desc.InternalFormat, desc.Width,
+                                              desc.Height));
+    } else {
+      GLCall(glRenderbufferStorage(GL_RENDERBUFFER, desc.InternalFormat,
+                                   desc.Width, desc.Height));
+    }
+    GLCall(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+    return id;
+  }
+
+  unsigned int format, type;
+  TextureFormat::GetUploadFormat(desc.InternalFormat, format, type);
+  GLCall(glGenTextures(1, &id));
+  GLCall(glBindTexture(GL_TEXTURE_2D, id));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  GLCall(glTexImage2D(GL_TEXTURE_2D, 0, desc.InternalFormat, desc.Width,
+                      desc.Height, 0, format, type, nullptr));
+  GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+  return id;
+}
+
+void RenderTargetPool::Destroy(const Entry& entry) {
+  GpuMemory::Get().Free(GpuMemoryCategory::RenderTarget, GetBytes(entry.Desc));
+  // a pass of the current frame may still render into it
+  DeletionQueue::Get().Delete(entry.Desc.Renderbuffer
+                                  ? DeletionQueue::Type::Renderbuffer
+                                  : DeletionQueue::Type::Texture,
+                              entry.ID);
+}
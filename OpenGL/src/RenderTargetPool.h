@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+struct RenderTargetDesc {
+  unsigned int Width;
+  unsigned int Height;
+  unsigned int InternalFormat;
+  unsigned int Samples;  // > 1 is always a renderbuffer
+  bool Renderbuffer;     // can't be sampled, only drawn to and blitted
+
+  inline bool operator==(const RenderTargetDesc& other) const {
+    return Width == other.Width && Height == other.Height &&
+           InternalFormat == other.InternalFormat &&
+           Samples == other.Samples && Renderbuffer == other.Renderbuffer;
+  }
+};
+
+struct RenderTargetPoolStats {
+  unsigned int Allocations;  // GL objects created this frame
+  unsigned int Frees;        // deleted after sitting unused
+  unsigned int Reuses;       // acquires served from the pool
+  unsigned int Live;         // handed out right now
+  unsigned int Pooled;       // waiting to be reused
+  size_t Bytes;              // live and pooled
+};
+
+// Recycles render target textures and renderbuffers by (size, format,
+// samples) so passes and framebuffers that come and go every frame stop
+// creating and deleting GL objects. A released target stays in the pool
+// for kMaxIdleFrames frames before it goes back to GL.
+class RenderTargetPool {
+ private:
+  struct Entry {
+    RenderTargetDesc Desc;
+    unsigned int ID;
+    bool InUse;
+    unsigned int LastFrame;  // frame it was released in
+  };
+
+  std::vector<Entry> m_Entries;
+  unsigned int m_Frame;
+  RenderTargetPoolStats m_Stats;
+
+ public:
+  static const unsigned int kMaxIdleFrames = 3;
+
+  RenderTargetPool();
+  ~RenderTargetPool();
+  RenderTargetPool(const RenderTargetPool&) = delete;
+  RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+  // texture or renderbuffer name matching desc, uncleared
+  unsigned int Acquire(const RenderTargetDesc& desc);
+  // id and desc as passed to Acquire, texture and renderbuffer names can
+  // be equal
+  void Release(unsigned int id, const RenderTargetDesc& desc);
+  // free what has been idle too long, reset the per frame counters
+  void EndFrame();
+  // delete everything that is not in use
+  void Trim();
+
+  inline const RenderTargetPoolStats& GetStats() const { return m_Stats; }
+
+ private:
+  static RenderTargetDesc Normalize(const RenderTargetDesc& desc);
+  static unsigned int Create(const RenderTargetDesc& desc);
+  static void Destroy(const Entry& entry);
+};
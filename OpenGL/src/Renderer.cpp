@@ -15,4 +15,42 @@ void Renderer::Draw(const VertexArray& va, const Shader& shader,
   va.Bind();
 
   GLCall(glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, nullptr));
-}
\ No newline at end of file
+}
+
+// The element buffer binding is VAO state, so `ib` stays bound to `va`
+// afterwards. Callers pass the index buffer with every draw, so the previous
+// binding isn't restored.
+void Renderer::Draw(const VertexArray& va, const IndexBuffer& ib,
+                    const Shader& shader) const {
+  shader.Bind();
+  va.Bind();
+  ib.Bind();
+
+  GLCall(glDrawElements(GL_TRIANGLES, ib.GetCount(), ib.GetType(), nullptr));
+}
+
+void Renderer::Draw(const VertexArray& va, const IndexBuffer& ib,
+                    const Shader& shader, unsigned int first,
+                    unsigned int count) const {
+  shader.Bind();
+  va.Bind();
+  ib.Bind();
+
+  size_t indexSize = ib.GetType() == GL_UNSIGNED_INT     ? 4
+                     : ib.GetType() == GL_UNSIGNED_SHORT ? 2
+                                                         : 1;
+  GLCall(glDrawElements(GL_TRIANGLES, count, ib.GetType(),
+                        (const void*)(first * indexSize)));
+}
+
+void Renderer::Draw(const VertexArray& va, const IndexBuffer& ib,
+                    const Shader& shader, const MultiDrawBatch& batch) const {
+  if (batch.Counts.empty()) return;
+  shader.Bind();
+  va.Bind();
+  ib.Bind();
+
+  GLCall(glMultiDrawElements(GL_TRIANGLES, batch.Counts.data(), ib.GetType(),
+                             batch.Offsets.data(),
+                             (int)batch.Counts.size()));
+}
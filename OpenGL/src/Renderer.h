@@ -1,11 +1,33 @@
 #pragma once
 
+#include <vector>
+
 #include "Shader.h"
 #include "VertexArray.h"
 
+// index ranges of one index buffer submitted with a single
+// glMultiDrawElements
+struct MultiDrawBatch {
+  std::vector<int> Counts;
+  std::vector<const void*> Offsets;  // byte offsets into the index buffer
+
+  inline void Clear() {
+    Counts.clear();
+    Offsets.clear();
+  }
+};
+
 class Renderer {
  private:
  public:
   void Clear() const;
   void Draw(const VertexArray& va, const Shader& shader, int count) const;
+  // draw `va` with another index buffer, e.g. a MeshLod level
+  void Draw(const VertexArray& va, const IndexBuffer& ib,
+            const Shader& shader) const;
+  // draw `count` indices of ib starting at index `first`
+  void Draw(const VertexArray& va, const IndexBuffer& ib, const Shader& shader,
+            unsigned int first, unsigned int count) const;
+  void Draw(const VertexArray& va, const IndexBuffer& ib, const Shader& shader,
+            const MultiDrawBatch& batch) const;
 };
\ No newline at end of file
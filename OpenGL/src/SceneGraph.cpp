@@ -0,0 +1,300 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "JobSystem.h"
+#include "Log.h"
+#include "Simd.h"
+
+namespace {
+
+// below this many nodes the job overhead outweighs the work
+const unsigned int kParallelNodes = 16384;
+// levels narrower than this are done on the calling thread
+const unsigned int kParallelLevelNodes = 1024;
+
+// translate * rotate * scale without going through three full products
+glm::mat4 ComposeTRS(const glm::vec3& t, const glm::quat& q,
+                     const glm::vec3& s) {
+  float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+  glm::mat4 m;
+  m[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy),
+                   0.0f) * s.x;
+  m[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx),
+                   0.0f) * s.y;
+  m[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy),
+                   0.0f) * s.z;
+  m[3] = glm::vec4(t, 1.0f);
+  return m;
+}
+
+// out = a * b, column major; out must not alias a or b
+inline void Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#if SIMD_SSE
+  const float* pa = &a[0][0];
+  const float* pb = &b[0][0];
+  float* po = &out[0][0];
+  __m128 a0 = _mm_loadu_ps(pa + 0);
+  __m128 a1 = _mm_loadu_ps(pa + 4);
+  __m128 a2 = _mm_loadu_ps(pa + 8);
+  __m128 a3 = _mm_loadu_ps(pa + 12);
+  // column i of the result is a * b[i]
+  for (int i = 0; i < 4; i++) {
+    __m128 column = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(pb[i * 4 + 0])),
+                   _mm_mul_ps(a1, _mm_set1_ps(pb[i * 4 + 1]))),
+        _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(pb[i * 4 + 2])),
+                   _mm_mul_ps(a3, _mm_set1_ps(pb[i * 4 + 3]))));
+    _mm_storeu_ps(po + i * 4, column);
+  }
+#else
+  out = a * b;
+#endif
+}
+
+#if SIMD_AVX2
+// two independent products at once, one per 128-bit lane
+inline void Multiply2(const glm::mat4& a0, const glm::mat4& b0,
+                      glm::mat4& out0, const glm::mat4& a1,
+                      const glm::mat4& b1, glm::mat4& out1) {
+  __m256 a[4];
+  for (int c = 0; c < 4; c++)
+    a[c] = _mm256_set_m128(_mm_loadu_ps(&a1[c][0]), _mm_loadu_ps(&a0[c][0]));
+  for (int i = 0; i < 4; i++) {
+    __m256 column = _mm256_setzero_ps();
+    for (int k = 0; k < 4; k++) {
+      __m256 scale =
+          _mm256_set_m128(_mm_set1_ps(b1[i][k]), _mm_set1_ps(b0[i][k]));
+#if SIMD_FMA
+      column = _mm256_fmadd_ps(a[k], scale, column);
+#else
+      column = _mm256_add_ps(_mm256_mul_ps(a[k], scale), column);
+#endif
+    }
+    _mm_storeu_ps(&out0[i][0], _mm256_castps256_ps128(column));
+    _mm_storeu_ps(&out1[i][0], _mm256_extractf128_ps(column, 1));
+  }
+}
+#endif
+
+}  // namespace
+
+void SceneGraph::Reserve(unsigned int count) {
+  m_Parent.reserve(count);
+  m_Translation.reserve(count);
+  m_Rotation.reserve(count);
+  m_Scale.reserve(count);
+  m_World.reserve(count);
+  m_Dirty.reserve(count);
+}
+
+unsigned int SceneGraph::AddNode(int parent) {
+  unsigned int node = (unsigned int)m_Parent.size();
+  ASSERT(parent < (int)node);
+  m_Parent.push_back(parent);
+  m_Translation.push_back(glm::vec3(0.0f));
+  m_Rotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  m_Scale.push_back(glm::vec3(1.0f));
+  m_World.push_back(glm::mat4(1.0f));
+  m_Dirty.push_back(0);
+  m_LevelsValid = false;
+  MarkDirty(node);
+  return node;
+}
+
+void SceneGraph::SetTranslation(unsigned int node,
+                                const glm::vec3& translation) {
+  m_Translation[node] = translation;
+  MarkDirty(node);
+}
+
+void SceneGraph::SetRotation(unsigned int node, const glm::quat& rotation) {
+  m_Rotation[node] = rotation;
+  MarkDirty(node);
+}
+
+void SceneGraph::SetScale(unsigned int node, const glm::vec3& scale) {
+  m_Scale[node] = scale;
+  MarkDirty(node);
+}
+
+unsigned int SceneGraph::Update() {
+  if (m_DirtyCount == 0) return 0;
+  unsigned int count = (unsigned int)m_Parent.size();
+  JobSystem& jobs = JobSystem::Get();
+  if (count < kParallelNodes || jobs.GetWorkerCount() == 1)
+    return UpdateSerial();
+
+  if (!m_LevelsValid) BuildLevels();
+  // flags first, a cheap front to back pass; after it every node of a
+  // dirty subtree is marked and the levels can go in any order
+  unsigned int updated = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    int parent = m_Parent[i];
+    if (parent >= 0) m_Dirty[i] |= m_Dirty[parent];
+    updated += m_Dirty[i];
+  }
+
+  // a level only reads the one above, which is complete
+  for (unsigned int level = 0; level + 1 < m_LevelStart.size(); level++) {
+    const unsigned int* nodes = m_LevelOrder.data() + m_LevelStart[level];
+    unsigned int width = m_LevelStart[level + 1] - m_LevelStart[level];
+    if (width < kParallelLevelNodes) {
+      UpdateNodes(nodes, width);
+      continue;
+    }
+    jobs.ParallelFor(width, [this, nodes](unsigned int begin,
+                                          unsigned int end) {
+      UpdateNodes(nodes + begin, end - begin);
+    });
+  }
+
+  std::fill(m_Dirty.begin(), m_Dirty.end(), 0);
+  m_DirtyCount = 0;
+  return updated;
+}
+
+// counting sort of the nodes by depth, stable so levels keep memory order
+void SceneGraph::BuildLevels() {
+  unsigned int count = (unsigned int)m_Parent.size();
+  std::vector<unsigned int> depth(count);
+  unsigned int levels = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    depth[i] = m_Parent[i] < 0 ? 0 : depth[m_Parent[i]] + 1;
+    levels = std::max(levels, depth[i] + 1);
+  }
+  m_LevelStart.assign(levels + 1, 0);
+  for (unsigned int i = 0; i < count; i++) m_LevelStart[depth[i] + 1]++;
+  for (unsigned int level = 0; level < levels; level++)
+    m_LevelStart[level + 1] += m_LevelStart[level];
+  std::vector<unsigned int> fill(m_LevelStart.begin(), m_LevelStart.end() - 1);
+  m_LevelOrder.resize(count);
+  for (unsigned int i = 0; i < count; i++) m_LevelOrder[fill[depth[i]]++] = i;
+  m_LevelsValid = true;
+}
+
+void SceneGraph::UpdateNodes(const unsigned int* nodes, unsigned int count) {
+  // nodes of one level are never each other's parent, so any two pair up
+  int pending = -1;
+  glm::mat4 pendingLocal;
+  for (unsigned int n = 0; n < count; n++) {
+    unsigned int i = nodes[n];
+    if (!m_Dirty[i]) continue;
+    glm::mat4 local = ComposeTRS(m_Translation[i], m_Rotation[i], m_Scale[i]);
+    int parent = m_Parent[i];
+    if (parent < 0) {
+      m_World[i] = local;
+      continue;
+    }
+#if SIMD_AVX2
+    if (pending >= 0) {
+      Multiply2(m_World[m_Parent[pending]], pendingLocal, m_World[pending],
+                m_World[parent], local, m_World[i]);
+      pending = -1;
+      continue;
+    }
+    pending = i;
+    pendingLocal = local;
+#else
+    Multiply(m_World[parent], local, m_World[i]);
+#endif
+  }
+  if (pending >= 0)
+    Multiply(m_World[m_Parent[pending]], pendingLocal, m_World[pending]);
+}
+
+unsigned int SceneGraph::UpdateSerial() {
+  unsigned int count = (unsigned int)m_Parent.size();
+  unsigned int updated = 0;
+  // nodes computed but not stored yet, waiting for a partner (AVX2 only)
+  int pending = -1;
+  glm::mat4 pendingLocal;
+
+  for (unsigned int i = 0; i < count; i++) {
+    int parent = m_Parent[i];
+    // parents come first, so their flag is final by the time we get here
+    if (parent >= 0) m_Dirty[i] |= m_Dirty[parent];
+    if (!m_Dirty[i]) continue;
+    updated++;
+
+    glm::mat4 local = ComposeTRS(m_Translation[i], m_Rotation[i], m_Scale[i]);
+    if (parent < 0) {
+      m_World[i] = local;
+      continue;
+    }
+
+#if SIMD_AVX2
+    // pair up consecutive dirty nodes unless one is the other's parent
+    if (pending >= 0 && parent != pending) {
+      Multiply2(m_World[m_Parent[pending]], pendingLocal, m_World[pending],
+                m_World[parent], local, m_World[i]);
+      pending = -1;
+      continue;
+    }
+    if (pending >= 0) {
+      Multiply(m_World[m_Parent[pending]], pendingLocal, m_World[pending]);
+      pending = -1;
+    }
+    pending = i;
+    pendingLocal = local;
+#else
+    Multiply(m_World[parent], local, m_World[i]);
+#endif
+  }
+  if (pending >= 0)
+    Multiply(m_World[m_Parent[pending]], pendingLocal, m_World[pending]);
+
+  std::fill(m_Dirty.begin(), m_Dirty.end(), 0);
+  m_DirtyCount = 0;
+  return updated;
+}
+
+void SceneGraph::Benchmark(unsigned int nodeCount) {
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+  // breadth first 8-ary tree, about 7 levels deep for a million nodes
+  SceneGraph graph;
+  graph.Reserve(nodeCount);
+  for (unsigned int i = 0; i < nodeCount; i++) {
+    int parent = i == 0 ? -1 : (int)((i - 1) / 8);
+    unsigned int node = graph.AddNode(parent);
+    graph.SetTranslation(node, glm::vec3(unit(random), unit(random), 0.0f));
+    graph.SetRotation(node, glm::angleAxis(unit(random), glm::vec3(0, 0, 1)));
+  }
+
+  typedef std::chrono::high_resolution_clock Clock;
+  unsigned int workers = JobSystem::Get().GetWorkerCount();
+  for (bool parallel : {false, true}) {
+    if (parallel && workers == 1) break;
+    for (unsigned int i = 0; i < nodeCount; i++) graph.MarkDirty(i);
+    auto start = Clock::now();
+    unsigned int updated = parallel ? graph.Update() : graph.UpdateSerial();
+    double full =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+
+    // move 0.1% of the nodes, their subtrees follow
+    for (unsigned int i = 0; i < nodeCount / 1000; i++)
+      graph.SetTranslation(random() % nodeCount,
+                           glm::vec3(unit(random), unit(random), 0.0f));
+    start = Clock::now();
+    unsigned int partialUpdated =
+        parallel ? graph.Update() : graph.UpdateSerial();
+    double partial =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+
+    std::cout << "[SceneGraph] " << nodeCount << " nodes, "
+              << (parallel ? workers : 1) << " workers: full update "
+              << updated << " nodes in " << full << " ms, partial update "
+              << partialUpdated << " nodes in " << partial << " ms"
+              << std::endl;
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+// Transform hierarchy stored as structure of arrays. Nodes are only ever
+// appended after their parent, so a single front to back pass sees every
+// parent before its children and can propagate world matrices in one sweep.
+// Only nodes whose local transform changed, and their subtrees, are
+// recomputed. Large graphs are updated one depth level at a time with the
+// nodes of a level spread over the JobSystem.
+class SceneGraph {
+ private:
+  std::vector<int> m_Parent;  // -1 for roots
+  std::vector<glm::vec3> m_Translation;
+  std::vector<glm::quat> m_Rotation;
+  std::vector<glm::vec3> m_Scale;
+  std::vector<glm::mat4> m_World;
+  std::vector<unsigned char> m_Dirty;
+  unsigned int m_DirtyCount;
+  // nodes sorted by depth, level d is [m_LevelStart[d], m_LevelStart[d + 1])
+  std::vector<unsigned int> m_LevelOrder;
+  std::vector<unsigned int> m_LevelStart;
+  bool m_LevelsValid;
+
+ public:
+  SceneGraph() : m_DirtyCount(0), m_LevelsValid(false) {}
+
+  void Reserve(unsigned int count);
+  // parent must already exist (or be -1), returns the new node
+  unsigned int AddNode(int parent);
+
+  void SetTranslation(unsigned int node, const glm::vec3& translation);
+  void SetRotation(unsigned int node, const glm::quat& rotation);
+  void SetScale(unsigned int node, const glm::vec3& scale);
+
+  // recompute the world matrices of dirty subtrees, returns how many nodes
+  // were updated
+  unsigned int Update();
+
+  inline unsigned int GetNodeCount() const {
+    return (unsigned int)m_Parent.size();
+  }
+  inline int GetParent(unsigned int node) const { return m_Parent[node]; }
+  inline const glm::mat4& GetWorld(unsigned int node) const {
+    return m_World[node];
+  }
+  inline const glm::mat4* GetWorldMatrices() const { return m_World.data(); }
+
+  // time full and partial updates of a random nodeCount hierarchy, on one
+  // thread and on the JobSystem
+  static void Benchmark(unsigned int nodeCount = 1000000);
+
+ private:
+  inline void MarkDirty(unsigned int node) {
+    m_DirtyCount += !m_Dirty[node];
+    m_Dirty[node] = 1;
+  }
+  unsigned int UpdateSerial();
+  void BuildLevels();
+  // world matrices of the dirty ones of `count` nodes of one level
+  void UpdateNodes(const unsigned int* nodes, unsigned int count);
+};
@@ -0,0 +1,75 @@
+#include "SelfTest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* const kDirectory = "res/selftest";
+
+unsigned int g_Checks = 0;
+unsigned int g_Failures = 0;
+std::vector<std::string> g_Files;
+
+}  // namespace
+
+bool SelfTest::Check(bool condition, const char* expression, const char* file,
+                     int line) {
+  g_Checks++;
+  if (!condition) {
+    g_Failures++;
+    std::cout << "[SelfTest] " << file << ":" << line << " failed: "
+              << expression << std::endl;
+  }
+  return condition;
+}
+
+std::string SelfTest::WriteFile(const std::string& name, const void* data,
+                                size_t size) {
+#ifdef _WIN32
+  _mkdir(kDirectory);
+#else
+  mkdir(kDirectory, 0755);
+#endif
+  std::string path = std::string(kDirectory) + "/" + name;
+  std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  stream.write((const char*)data, (std::streamsize)size);
+  g_Files.push_back(path);
+  return path;
+}
+
+std::string SelfTest::WriteFile(const std::string& name,
+                                const std::string& text) {
+  return WriteFile(name, text.data(), text.size());
+}
+
+unsigned int SelfTest::Run() {
+  g_Checks = g_Failures = 0;
+  JsonTests();
+  GltfLoaderTests();
+  CookedMeshTests();
+  RenderGraphTests();
+  VirtualTextureTests();
+  AtlasTests();
+  TextureCacheTests();
+
+  for (const std::string& path : g_Files) std::remove(path.c_str());
+  g_Files.clear();
+#ifdef _WIN32
+  _rmdir(kDirectory);
+#else
+  rmdir(kDirectory);
+#endif
+  std::cout << "[SelfTest] " << g_Checks - g_Failures << " / " << g_Checks
+            << " checks passed" << std::endl;
+  return g_Failures;
+}
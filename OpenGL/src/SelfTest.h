@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Checks run by `OpenGL --self-test` with a GL context current, mostly
+// loaders fed files that are truncated, malformed or lie about their
+// contents. Inputs are written under res/selftest and removed afterwards.
+namespace SelfTest {
+
+// prints the failed expression and where it is, and counts it
+bool Check(bool condition, const char* expression, const char* file,
+           int line);
+
+// a scratch file under res/selftest, returns its path
+std::string WriteFile(const std::string& name, const void* data, size_t size);
+std::string WriteFile(const std::string& name, const std::string& text);
+
+// one suite per module
+void JsonTests();
+void GltfLoaderTests();
+void CookedMeshTests();
+void RenderGraphTests();
+void VirtualTextureTests();
+void AtlasTests();
+void TextureCacheTests();
+
+// every suite, returns the number of failed checks
+unsigned int Run();
+
+}  // namespace SelfTest
+
+#define EXPECT(condition) \
+  SelfTest::Check((condition), #condition, __FILE__, __LINE__)
@@ -4,7 +4,9 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
 
+#include "DeletionQueue.h"
 #include "GL/glew.h"
 #include "Log.h"
 
@@ -17,7 +19,23 @@ Shader::Shader(const std::string& filepath)
   m_RendererID = program;
 }
 
-Shader::~Shader() { GLCall(glDeleteProgram(m_RendererID)); }
+Shader::~Shader() {
+  DeletionQueue::Get().Delete(DeletionQueue::Type::Program, m_RendererID);
+}
+
+Shader::Shader(Shader&& other) noexcept
+    : m_Filepath(std::move(other.m_Filepath)),
+      m_RendererID(other.m_RendererID),
+      m_UniformLocationCache(std::move(other.m_UniformLocationCache)) {
+  other.m_RendererID = 0;
+}
+
+Shader& Shader::operator=(Shader&& other) noexcept {
+  std::swap(m_Filepath, other.m_Filepath);
+  std::swap(m_RendererID, other.m_RendererID);
+  std::swap(m_UniformLocationCache, other.m_UniformLocationCache);
+  return *this;
+}
 
 void Shader::Bind() const { GLCall(glUseProgram(m_RendererID)); }
 
@@ -39,6 +57,18 @@ void Shader::SetUniformMat4f(const std::string& name, const glm::mat4& matrix) {
   GLCall(glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]));
 }
 
+void Shader::SetUniformBlockBinding(const std::string& name,
+                                    unsigned int binding) {
+  GLCall(unsigned int index =
+             glGetUniformBlockIndex(m_RendererID, name.c_str()));
+  if (index == GL_INVALID_INDEX) {
+    std::cout << "Warning: uniform block '" << name << "' doesn't exist!"
+              << std::endl;
+    return;
+  }
+  GLCall(glUniformBlockBinding(m_RendererID, index, binding));
+}
+
 int Shader::GetUniformLocation(const std::string& name) {
   if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end()) {
     return m_UniformLocationCache[name];
@@ -17,6 +17,10 @@ class Shader {
  public:
   Shader(const std::string& filepath);
   ~Shader();
+  Shader(const Shader&) = delete;
+  Shader& operator=(const Shader&) = delete;
+  Shader(Shader&& other) noexcept;
+  Shader& operator=(Shader&& other) noexcept;
 
   void Bind() const;
   void Unbind() const;
@@ -26,6 +30,10 @@ class Shader {
                     float v3);
   void SetUniform1i(const std::string& name, int value);
   void SetUniformMat4f(const std::string& name, const glm::mat4& matrix);
+  // uniform block `name` reads the buffer bound to `binding`
+  void SetUniformBlockBinding(const std::string& name, unsigned int binding);
+
+  inline unsigned int GetRendererID() const { return m_RendererID; }
 
  private:
   int GetUniformLocation(const std::string& name);
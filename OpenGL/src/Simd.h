@@ -0,0 +1,27 @@
+#pragma once
+
+// SSE is part of the x64 and (with the default /arch:SSE2) x86 baselines, so
+// it needs no runtime dispatch. AVX2 paths are only compiled when the build
+// enables them (/arch:AVX2 or -mavx2).
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+    defined(__SSE2__)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE 0
+#endif
+
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#else
+#define SIMD_AVX2 0
+#endif
+
+// FMA3 came with AVX2 on every CPU that has it; MSVC's /arch:AVX2 allows
+// it without defining __FMA__
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define SIMD_FMA 1
+#else
+#define SIMD_FMA 0
+#endif
@@ -1,41 +1,222 @@
 #include "Texture.h"
 
+#include <utility>
+
+#include "DeletionQueue.h"
 #include "GL/glew.h"
+#include "GpuMemory.h"
+#include "TextureCache.h"
+#include "TextureFormat.h"
 #include "stb_image/stb_image.h"
 
-Texture::Texture(const std::string& path)
+Texture::Texture(const std::string& path, bool srgb)
     : m_RendererID(0),
       m_FilePath(path),
-      m_LocalBuffer(nullptr),
       m_Width(0),
       m_Height(0),
-      m_BPP(0) {
-  GLCall(glGenTextures(1, &m_RendererID));
+      m_BPP(0),
+      m_InternalFormat(GL_RGBA8),
+      m_Levels(1),
+      m_Srgb(srgb),
+      m_Evictable(~0u) {
+  Load();
+  // file backed, so it can always be read again
+  if (m_Width > 0) {
+    m_Evictable = GpuMemory::Get().RegisterEvictable(
+        GpuMemoryCategory::Texture,
+        GpuMemory::GetTextureBytes(m_Width, m_Height, m_InternalFormat,
+                                   m_Levels),
+        [this]() { Unload(); }, [this]() { Load(); });
+  }
+}
+
+Texture::~Texture() {
+  if (m_Evictable != ~0u) GpuMemory::Get().UnregisterEvictable(m_Evictable);
+  Unload();
+}
+
+Texture::Texture(Texture&& other) noexcept
+    : m_RendererID(other.m_RendererID),
+      m_FilePath(std::move(other.m_FilePath)),
+      m_Width(other.m_Width),
+      m_Height(other.m_Height),
+      m_BPP(other.m_BPP),
+      m_InternalFormat(other.m_InternalFormat),
+      m_Levels(other.m_Levels),
+      m_Srgb(other.m_Srgb),
+      m_Evictable(other.m_Evictable) {
+  other.m_RendererID = 0;
+  other.m_Evictable = ~0u;
+  RebindEvictable();
+}
+
+Texture& Texture::operator=(Texture&& other) noexcept {
+  std::swap(m_RendererID, other.m_RendererID);
+  std::swap(m_FilePath, other.m_FilePath);
+  std::swap(m_Width, other.m_Width);
+  std::swap(m_Height, other.m_Height);
+  std::swap(m_BPP, other.m_BPP);
+  std::swap(m_InternalFormat, other.m_InternalFormat);
+  std::swap(m_Levels, other.m_Levels);
+  std::swap(m_Srgb, other.m_Srgb);
+  std::swap(m_Evictable, other.m_Evictable);
+  RebindEvictable();
+  other.RebindEvictable();
+  return *this;
+}
+
+// the callbacks point at the object that owns the registration
+void Texture::RebindEvictable() {
+  if (m_Evictable == ~0u) return;
+  GpuMemory::Get().UpdateEvictable(
+      m_Evictable, [this]() { Unload(); }, [this]() { Load(); });
+}
+
+namespace {
+
+// the sized format Load picks for a file, from its header
+bool ReadFormat(const std::string& path, bool srgb, int& width, int& height,
+                int& channels, unsigned int& internalFormat) {
+  if (!stbi_info(path.c_str(), &width, &height, &channels)) return false;
+  unsigned int type = stbi_is_hdr(path.c_str())      ? GL_FLOAT
+                      : stbi_is_16_bit(path.c_str()) ? GL_UNSIGNED_SHORT
+                                                     : GL_UNSIGNED_BYTE;
+  internalFormat = TextureFormat::FromChannels(channels, type, srgb);
+  return true;
+}
+
+// largest of 8/4/2/1 dividing the row, tightly packed rows need not be
+// 4 byte aligned
+int GetUnpackAlignment(size_t rowBytes) {
+  for (int alignment = 8; alignment > 1; alignment /= 2)
+    if (rowBytes % alignment == 0) return alignment;
+  return 1;
+}
+
+}  // namespace
+
+void Texture::Load() {
+  // decoded, mipped and maybe compressed; mapped from the cache after the
+  // first run
+  TextureImportSettings settings = {m_Srgb, true,
+                                    TextureCache::Get().IsCompressing()};
+  TextureImage image;
+  bool loaded = TextureCache::Get().Load(m_FilePath, settings, image);
+  if (loaded) {
+    m_Width = image.Header.Width;
+    m_Height = image.Header.Height;
+    m_BPP = image.Header.Channels;
+    m_InternalFormat = image.Header.InternalFormat;
+    m_Levels = image.Header.LevelCount;
+  }
+
+  // a retired texture of the same size skips the allocation
+  if (loaded)
+    m_RendererID = DeletionQueue::Get().AcquireTexture(
+        m_Width, m_Height, m_InternalFormat, m_Levels);
+  bool recycled = m_RendererID != 0;
+  if (!recycled) {
+    GLCall(glGenTextures(1, &m_RendererID));
+  }
   GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererID));
 
   GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
   GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                         m_Levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
   GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_Levels - 1));
 
-  stbi_set_flip_vertically_on_load(1);
-  m_LocalBuffer = stbi_load(path.c_str(), &m_Width, &m_Height, &m_BPP, 0);
-
-  if (m_LocalBuffer) {
-    GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0,
-                        GL_RGBA, GL_UNSIGNED_BYTE, m_LocalBuffer));
+  if (loaded) {
+    // grey is read back as grey, not red; set every time since a recycled
+    // texture keeps the swizzle of its last owner
+    GLint swizzle[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+    if (m_BPP == 1 || m_BPP == 2) {
+      swizzle[0] = swizzle[1] = swizzle[2] = GL_RED;
+      swizzle[3] = m_BPP == 2 ? GL_GREEN : GL_ONE;
+    }
+    GLCall(glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle));
 
-    stbi_image_free(m_LocalBuffer);
+    // a recycled texture already has these levels, they are updated in
+    // place. Uncompressed levels are in the decoded type, GL converts
+    // floats to half floats
+    bool compressed = TextureFormat::IsCompressed(m_InternalFormat);
+    unsigned int format = image.Header.Format, type = image.Header.Type;
+    for (unsigned int level = 0; level < m_Levels; level++) {
+      const TextureCacheLevel& entry = image.Levels[level];
+      const unsigned char* data = image.GetLevel(level);
+      if (compressed && recycled) {
+        GLCall(glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0,
+                                         entry.Width, entry.Height,
+                                         m_InternalFormat,
+                                         (GLsizei)entry.Size, data));
+      } else if (compressed) {
+        GLCall(glCompressedTexImage2D(GL_TEXTURE_2D, level, m_InternalFormat,
+                                      entry.Width, entry.Height, 0,
+                                      (GLsizei)entry.Size, data));
+      } else {
+        GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT,
+                             GetUnpackAlignment(entry.Size / entry.Height)));
+        if (recycled) {
+          GLCall(glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, entry.Width,
+                                 entry.Height, format, type, data));
+        } else {
+          GLCall(glTexImage2D(GL_TEXTURE_2D, level, m_InternalFormat,
+                              entry.Width, entry.Height, 0, format, type,
+                              data));
+        }
+      }
+    }
+    GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    GpuMemory::Get().Allocate(GpuMemoryCategory::Texture,
+                              GpuMemory::GetTextureBytes(
+                                  m_Width, m_Height, m_InternalFormat,
+                                  m_Levels));
   } else {
     std::cout << "Failed to load texture" << std::endl;
   }
 }
 
-Texture::~Texture() { GLCall(glDeleteTextures(1, &m_RendererID)); }
+// only recycled when something was uploaded, width 0 deletes it
+void Texture::Unload() {
+  if (m_RendererID && m_Width > 0)
+    GpuMemory::Get().Free(
+        GpuMemoryCategory::Texture,
+        GpuMemory::GetTextureBytes(m_Width, m_Height, m_InternalFormat,
+                                   m_Levels));
+  DeletionQueue::Get().DeleteTexture(m_RendererID, m_Width, m_Height,
+                                     m_InternalFormat, m_Levels);
+  m_RendererID = 0;
+}
 
 void Texture::Bind(unsigned int slot) const {
+  // counts as a use, and brings it back if it was evicted
+  if (m_Evictable != ~0u) GpuMemory::Get().Touch(m_Evictable);
   GLCall(glActiveTexture(GL_TEXTURE0 + slot));
   GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererID));
 }
 
-void Texture::Unbind() { GLCall(glBindTexture(GL_TEXTURE_2D, 0)); }
\ No newline at end of file
+void Texture::Unbind() { GLCall(glBindTexture(GL_TEXTURE_2D, 0)); }
+
+void Texture::ReportMemory(const std::vector<std::string>& paths) {
+  size_t total = 0, expanded = 0;
+  for (const std::string& path : paths) {
+    int width, height, channels;
+    unsigned int internalFormat;
+    if (!ReadFormat(path, false, width, height, channels, internalFormat)) {
+      std::cout << "[Texture] can't read " << path << std::endl;
+      continue;
+    }
+    size_t bytes = GpuMemory::GetTextureBytes(width, height, internalFormat);
+    size_t rgba8 = GpuMemory::GetTextureBytes(width, height, GL_RGBA8);
+    total += bytes;
+    expanded += rgba8;
+    std::cout << "[Texture] " << path << " " << width << "x" << height << "x"
+              << channels << " -> " << TextureFormat::GetName(internalFormat)
+              << ", " << bytes / 1024 << " KB (RGBA8 " << rgba8 / 1024
+              << " KB)" << std::endl;
+  }
+  std::cout << "[Texture] " << paths.size() << " textures, " << total / 1024
+            << " KB instead of " << expanded / 1024 << " KB, "
+            << (expanded - total) / 1024 << " KB saved" << std::endl;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "Log.h"
 
@@ -9,16 +11,36 @@ class Texture {
   unsigned int m_RendererID;
   std::string m_FilePath;
 
-  unsigned char* m_LocalBuffer;
-  int m_Width, m_Height, m_BPP; // bytes per pixel, rgba -> 4byte
+  int m_Width, m_Height, m_BPP; // channels in the file, grey -> 1
+  unsigned int m_InternalFormat;  // from the file's channels and depth
+  unsigned int m_Levels;          // mips uploaded, down to 1x1
+  bool m_Srgb;  // colour channels are sRGB encoded
+  unsigned int m_Evictable;  // GpuMemory id, ~0u if not registered
 
  public:
-  Texture(const std::string& path);
+  explicit Texture(const std::string& path, bool srgb = false);
   ~Texture();
+  Texture(const Texture&) = delete;
+  Texture& operator=(const Texture&) = delete;
+  Texture(Texture&& other) noexcept;
+  Texture& operator=(Texture&& other) noexcept;
 
   void Bind(unsigned int slot = 0) const;
   void Unbind();
 
   inline int GetWidth() const { return m_Width; }
   inline int GetHeight() const { return m_Height; }
+  inline unsigned int GetRendererID() const { return m_RendererID; }
+  inline unsigned int GetInternalFormat() const { return m_InternalFormat; }
+
+  // the formats the files would be uploaded in and the memory that saves
+  // over expanding every texture to RGBA8, from the headers only
+  static void ReportMemory(const std::vector<std::string>& paths);
+
+ private:
+  // read the file (or its TextureCache entry) and upload it, again after
+  // an eviction
+  void Load();
+  void Unload();
+  void RebindEvictable();
 };
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "AtlasFile.h"
+#include "DeletionQueue.h"
+#include "GL/glew.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "MipChain.h"
+#include "stb_image/stb_image.h"
+
+const unsigned int TextureAtlas::kDefaultSize;
+const unsigned int TextureAtlas::kDefaultLevels;
+
+namespace {
+
+// gutter that keeps `levels` mips apart, at least `padding` wide
+unsigned int GutterFor(unsigned int levels, unsigned int padding) {
+  return std::max(padding, 1u << (std::max(levels, 1u) - 1));
+}
+
+// image plus gutter, rounded up to the mip alignment (== the gutter's
+// power of two part)
+unsigned int BlockSize(unsigned int size, unsigned int gutter,
+                       unsigned int levels) {
+  unsigned int alignment = 1u << (std::max(levels, 1u) - 1);
+  return (size + 2 * gutter + alignment - 1) / alignment * alignment;
+}
+
+// the image at (gutter, gutter) of a blockWidth x blockHeight block at
+// `destination`, the rest of the block repeating its nearest edge texel
+void CopyWithGutter(const unsigned char* pixels, unsigned int width,
+                    unsigned int height, unsigned int gutter,
+                    unsigned int blockWidth, unsigned int blockHeight,
+                    unsigned char* destination, size_t destinationStride) {
+  for (unsigned int y = 0; y < blockHeight; y++) {
+    int sy = std::min(std::max((int)y - (int)gutter, 0), (int)height - 1);
+    unsigned char* row = destination + y * destinationStride;
+    for (unsigned int x = 0; x < blockWidth; x++) {
+      int sx = std::min(std::max((int)x - (int)gutter, 0), (int)width - 1);
+      std::memcpy(row + x * 4, pixels + ((size_t)sy * width + sx) * 4, 4);
+    }
+  }
+}
+
+}  // namespace
+
+TextureAtlas::TextureAtlas(unsigned int size, unsigned int levels,
+                           unsigned int padding)
+    : m_Size(size),
+      m_Levels(std::max(1u, levels)),
+      m_Gutter(GutterFor(levels, padding)) {}
+
+TextureAtlas::~TextureAtlas() {
+  for (Page& page : m_Pages) {
+    GpuMemory::Get().Free(GpuMemoryCategory::Texture,
+                          GpuMemory::GetTextureBytes(
+                              page.Packer.GetWidth(), page.Packer.GetHeight(),
+                              GL_RGBA8, m_Levels));
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Texture,
+                                page.RendererID);
+  }
+}
+
+unsigned int TextureAtlas::CreatePage(unsigned int width, unsigned int height,
+                                      bool isStatic) {
+  Page page{0, AtlasPacker(width, height), isStatic, false};
+  GLCall(glGenTextures(1, &page.RendererID));
+  GLCall(glBindTexture(GL_TEXTURE_2D, page.RendererID));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                         GL_LINEAR_MIPMAP_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  // coarser levels would mix neighbouring images
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_Levels - 1));
+  if (!isStatic) {
+    // cleared, so mips of the empty part stay transparent
+    std::vector<unsigned char> zeros((size_t)width * height * 4, 0);
+    for (unsigned int level = 0; level < m_Levels; level++) {
+      GLCall(glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8,
+                          MipChain::LevelSize(width, level),
+                          MipChain::LevelSize(height, level), 0, GL_RGBA,
+                          GL_UNSIGNED_BYTE, zeros.data()));
+    }
+  }
+  GpuMemory::Get().Allocate(
+      GpuMemoryCategory::Texture,
+      GpuMemory::GetTextureBytes(width, height, GL_RGBA8, m_Levels));
+  m_Pages.push_back(page);
+  return (unsigned int)m_Pages.size() - 1;
+}
+
+AtlasRegion TextureAtlas::Add(const std::string& path) {
+  auto found = m_Regions.find(path);
+  if (found != m_Regions.end()) return found->second;
+
+  stbi_set_flip_vertically_on_load(1);
+  int width, height, channels;
+  unsigned char* pixels =
+      stbi_load(path.c_str(), &width, &height, &channels, 4);
+  if (!pixels) {
+    std::cout << "[TextureAtlas] failed to load " << path << std::endl;
+    return AtlasRegion{~0u, glm::vec2(0.0f), glm::vec2(0.0f)};
+  }
+  AtlasRegion region = Add(path, pixels, width, height);
+  stbi_image_free(pixels);
+  return region;
+}
+
+AtlasRegion TextureAtlas::Add(const std::string& name,
+                              const unsigned char* pixels, unsigned int width,
+                              unsigned int height) {
+  AtlasRegion region{~0u, glm::vec2(0.0f), glm::vec2(0.0f)};
+  unsigned int blockWidth = BlockSize(width, m_Gutter, m_Levels);
+  unsigned int blockHeight = BlockSize(height, m_Gutter, m_Levels);
+  if (width == 0 || height == 0 || blockWidth > m_Size ||
+      blockHeight > m_Size) {
+    std::cout << "[TextureAtlas] " << name << " (" << width << "x" << height
+              << ") doesn't fit a " << m_Size << " page" << std::endl;
+    return region;
+  }
+
+  // first page with room, a new one when none has any
+  unsigned int x = 0, y = 0, page = 0;
+  for (; page < m_Pages.size(); page++)
+    if (!m_Pages[page].Static &&
+        m_Pages[page].Packer.Insert(blockWidth, blockHeight, x, y))
+      break;
+  if (page == m_Pages.size()) {
+    page = CreatePage(m_Size, m_Size, false);
+    m_Pages[page].Packer.Insert(blockWidth, blockHeight, x, y);
+  }
+
+  std::vector<unsigned char> block((size_t)blockWidth * blockHeight * 4);
+  CopyWithGutter(pixels, width, height, m_Gutter, blockWidth, blockHeight,
+                 block.data(), (size_t)blockWidth * 4);
+  Page& target = m_Pages[page];
+  GLCall(glBindTexture(GL_TEXTURE_2D, target.RendererID));
+  GLCall(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, blockWidth, blockHeight,
+                         GL_RGBA, GL_UNSIGNED_BYTE, block.data()));
+  target.Dirty = true;
+
+  glm::vec2 size((float)target.Packer.GetWidth(),
+                 (float)target.Packer.GetHeight());
+  region.Page = page;
+  region.UVMin = glm::vec2((float)(x + m_Gutter), (float)(y + m_Gutter)) /
+                 size;
+  region.UVMax = glm::vec2((float)(x + m_Gutter + width),
+                           (float)(y + m_Gutter + height)) /
+                 size;
+  m_Regions[name] = region;
+  return region;
+}
+
+AtlasRegion TextureAtlas::Find(const std::string& name) const {
+  auto found = m_Regions.find(name);
+  if (found == m_Regions.end())
+    return AtlasRegion{~0u, glm::vec2(0.0f), glm::vec2(0.0f)};
+  return found->second;
+}
+
+bool TextureAtlas::Load(const std::string& path) {
+  MappedFile file(path);
+  const unsigned char* data = file.GetData();
+  const AtlasFileHeader* header = (const AtlasFileHeader*)data;
+  if (!file.IsValid() || file.GetSize() < sizeof(AtlasFileHeader) ||
+      std::memcmp(header->Magic, kAtlasFileMagic, 4) != 0 ||
+      header->Version != kAtlasFileVersion) {
+    std::cout << "[TextureAtlas] not an atlas: " << path << std::endl;
+    return false;
+  }
+  // 64 bit sums and sizes capped at 64k, nothing here can wrap
+  uint64_t size = file.GetSize();
+  uint64_t tables = sizeof(AtlasFileHeader) +
+                    (uint64_t)header->EntryCount * sizeof(AtlasFileEntry) +
+                    header->NameBytes;
+  if (tables > size || header->PixelOffset > size ||
+      header->PixelBytes > size - header->PixelOffset ||
+      header->Levels != m_Levels) {
+    std::cout << "[TextureAtlas] truncated or built for other mip levels: "
+              << path << std::endl;
+    return false;
+  }
+  const AtlasFileEntry* entries =
+      (const AtlasFileEntry*)(data + sizeof(AtlasFileHeader));
+  const char* names =
+      (const char*)(entries + header->EntryCount);
+  // every level is uploaded straight from the pixel block
+  bool valid = header->Width > 0 && header->Width <= 65536 &&
+               header->Height > 0 && header->Height <= 65536 &&
+               header->Levels <=
+                   MipChain::CountLevels(header->Width, header->Height) &&
+               header->PixelBytes ==
+                   GpuMemory::GetTextureBytes(header->Width, header->Height,
+                                              GL_RGBA8, header->Levels);
+  for (unsigned int i = 0; i < header->EntryCount && valid; i++)
+    valid = (uint64_t)entries[i].NameOffset + entries[i].NameLength <=
+            header->NameBytes;
+  if (!valid) {
+    std::cout << "[TextureAtlas] invalid atlas: " << path << std::endl;
+    return false;
+  }
+
+  unsigned int page = CreatePage(header->Width, header->Height, true);
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_Pages[page].RendererID));
+  const unsigned char* pixels = data + header->PixelOffset;
+  for (unsigned int level = 0; level < header->Levels; level++) {
+    unsigned int w = MipChain::LevelSize(header->Width, level);
+    unsigned int h = MipChain::LevelSize(header->Height, level);
+    GLCall(glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, w, h, 0, GL_RGBA,
+                        GL_UNSIGNED_BYTE, pixels));
+    pixels += (size_t)w * h * 4;
+  }
+  for (unsigned int i = 0; i < header->EntryCount; i++) {
+    const AtlasFileEntry& entry = entries[i];
+    m_Regions[std::string(names + entry.NameOffset, entry.NameLength)] =
+        AtlasRegion{page, glm::vec2(entry.UVMin[0], entry.UVMin[1]),
+                    glm::vec2(entry.UVMax[0], entry.UVMax[1])};
+  }
+  return true;
+}
+
+void TextureAtlas::Bind(unsigned int page, unsigned int slot) {
+  Page& target = m_Pages[page];
+  GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+  GLCall(glBindTexture(GL_TEXTURE_2D, target.RendererID));
+  if (target.Dirty) {
+    GLCall(glGenerateMipmap(GL_TEXTURE_2D));
+    target.Dirty = false;
+  }
+}
+
+void TextureAtlas::RemapTexCoords(const AtlasRegion& region, float* vertices,
+                                  unsigned int vertexCount,
+                                  unsigned int stride,
+                                  unsigned int uvOffset) {
+  for (unsigned int i = 0; i < vertexCount; i++) {
+    float* uv = vertices + (size_t)i * stride + uvOffset;
+    glm::vec2 remapped = region.Remap(glm::vec2(uv[0], uv[1]));
+    uv[0] = remapped.x;
+    uv[1] = remapped.y;
+  }
+}
+
+void TextureAtlas::PrintStats() const {
+  std::cout << "[TextureAtlas] " << m_Regions.size() << " images in "
+            << m_Pages.size() << " pages";
+  for (const Page& page : m_Pages) {
+    if (page.Static)
+      std::cout << ", prebuilt";
+    else
+      std::cout << ", " << page.Packer.GetOccupancy() * 100.0f << "% full";
+  }
+  std::cout << std::endl;
+}
+
+bool TextureAtlas::Build(const std::vector<std::string>& images,
+                         const std::string& destination, unsigned int maxSize,
+                         unsigned int levels, unsigned int padding) {
+  struct Image {
+    std::string Path;
+    unsigned char* Pixels;
+    unsigned int Width, Height;
+    unsigned int BlockWidth, BlockHeight;
+    unsigned int X, Y;
+  };
+  levels = std::max(levels, 1u);
+  unsigned int gutter = GutterFor(levels, padding);
+  std::vector<Image> decoded;
+  bool ok = true;
+  stbi_set_flip_vertically_on_load(1);
+  for (const std::string& path : images) {
+    int width, height, channels;
+    unsigned char* pixels =
+        stbi_load(path.c_str(), &width, &height, &channels, 4);
+    if (!pixels) {
+      std::cout << "[TextureAtlas] failed to load " << path << std::endl;
+      ok = false;
+      break;
+    }
+    decoded.push_back(Image{path, pixels, (unsigned int)width,
+                            (unsigned int)height,
+                            BlockSize(width, gutter, levels),
+                            BlockSize(height, gutter, levels), 0, 0});
+  }
+
+  // tallest first packs tightest, then grow the page until all fit
+  std::vector<Image*> order;
+  for (Image& image : decoded) order.push_back(&image);
+  std::stable_sort(order.begin(), order.end(),
+                   [](const Image* a, const Image* b) {
+                     return a->BlockHeight > b->BlockHeight;
+                   });
+  unsigned int size = 0;
+  for (unsigned int candidate = 64; ok && candidate <= maxSize;
+       candidate *= 2) {
+    AtlasPacker packer(candidate, candidate);
+    bool fits = true;
+    for (Image* image : order)
+      if (!packer.Insert(image->BlockWidth, image->BlockHeight, image->X,
+                         image->Y)) {
+        fits = false;
+        break;
+      }
+    if (fits) {
+      size = candidate;
+      break;
+    }
+  }
+  if (ok && size == 0) {
+    std::cout << "[TextureAtlas] images don't fit a " << maxSize << " atlas"
+              << std::endl;
+    ok = false;
+  }
+
+  std::ofstream stream;
+  if (ok) {
+    stream.open(destination, std::ios::binary);
+    if (!stream) {
+      std::cout << "[TextureAtlas] can't write " << destination << std::endl;
+      ok = false;
+    }
+  }
+  if (!ok) {
+    for (Image& image : decoded) stbi_image_free(image.Pixels);
+    return false;
+  }
+
+  // level 0, then each mip from the one before
+  std::vector<unsigned char> pixels((size_t)size * size * 4, 0);
+  for (const Image& image : decoded)
+    CopyWithGutter(image.Pixels, image.Width, image.Height, gutter,
+                   image.BlockWidth, image.BlockHeight,
+                   &pixels[((size_t)image.Y * size + image.X) * 4],
+                   (size_t)size * 4);
+  size_t levelOffset = 0;
+  for (unsigned int level = 1; level < levels; level++) {
+    unsigned int w = MipChain::LevelSize(size, level - 1);
+    size_t next = levelOffset + (size_t)w * w * 4;
+    pixels.resize(next + (size_t)MipChain::LevelSize(size, level) *
+                             MipChain::LevelSize(size, level) * 4);
+    MipChain::Downsample(&pixels[levelOffset], w, w, &pixels[next]);
+    levelOffset = next;
+  }
+
+  std::vector<AtlasFileEntry> entries;
+  std::string names;
+  for (const Image& image : decoded) {
+    AtlasFileEntry entry = {};
+    entry.NameOffset = (uint32_t)names.size();
+    entry.NameLength = (uint32_t)image.Path.size();
+    entry.X = image.X + gutter;
+    entry.Y = image.Y + gutter;
+    entry.Width = image.Width;
+    entry.Height = image.Height;
+    entry.UVMin[0] = (float)entry.X / size;
+    entry.UVMin[1] = (float)entry.Y / size;
+    entry.UVMax[0] = (float)(entry.X + entry.Width) / size;
+    entry.UVMax[1] = (float)(entry.Y + entry.Height) / size;
+    entries.push_back(entry);
+    names += image.Path;
+    stbi_image_free(image.Pixels);
+  }
+
+  AtlasFileHeader header = {};
+  std::memcpy(header.Magic, kAtlasFileMagic, 4);
+  header.Version = kAtlasFileVersion;
+  header.Width = header.Height = size;
+  header.Levels = levels;
+  header.Gutter = gutter;
+  header.EntryCount = (uint32_t)entries.size();
+  header.NameBytes = (uint32_t)names.size();
+  uint64_t tableEnd = sizeof(header) +
+                      entries.size() * sizeof(AtlasFileEntry) + names.size();
+  header.PixelOffset = (tableEnd + kAtlasFileAlignment - 1) /
+                       kAtlasFileAlignment * kAtlasFileAlignment;
+  header.PixelBytes = pixels.size();
+
+  stream.write((const char*)&header, sizeof(header));
+  stream.write((const char*)entries.data(),
+               entries.size() * sizeof(AtlasFileEntry));
+  stream.write(names.data(), names.size());
+  const char zeros[kAtlasFileAlignment] = {};
+  stream.write(zeros, (std::streamsize)(header.PixelOffset - tableEnd));
+  stream.write((const char*)pixels.data(), pixels.size());
+  if (!stream) {
+    std::cout << "[TextureAtlas] failed writing " << destination << std::endl;
+    return false;
+  }
+
+  // the UV lookup table, also in the file
+  std::cout << "[TextureAtlas] " << decoded.size() << " images -> "
+            << destination << " (" << size << "x" << size << ", " << levels
+            << " levels, gutter " << gutter << ")" << std::endl;
+  for (unsigned int i = 0; i < entries.size(); i++)
+    std::cout << "  " << decoded[i].Path << " uv (" << entries[i].UVMin[0]
+              << ", " << entries[i].UVMin[1] << ") - (" << entries[i].UVMax[0]
+              << ", " << entries[i].UVMax[1] << ")" << std::endl;
+  return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AtlasPacker.h"
+#include "glm/glm.hpp"
+
+// where an image ended up, Page = ~0u when it couldn't be added
+struct AtlasRegion {
+  unsigned int Page;
+  glm::vec2 UVMin, UVMax;
+
+  inline bool IsValid() const { return Page != ~0u; }
+  // a texture coordinate of the image to the same point in the atlas
+  inline glm::vec2 Remap(const glm::vec2& uv) const {
+    return UVMin + uv * (UVMax - UVMin);
+  }
+};
+
+// Packs many small images into a few large textures, so sprites drawn
+// together share one bind and one batch. Images are placed with
+// AtlasPacker and surrounded by a gutter repeating their edge texels;
+// every placement is aligned to 2^(levels - 1) texels and the gutter is at
+// least that wide, so none of the first `levels` mip levels filters one
+// image into the next. Add() inserts images at runtime, opening another
+// page when the current ones are full; Load() brings in an atlas built
+// offline by Build(). Vertices written for the whole image are moved into
+// the atlas with AtlasRegion::Remap or RemapTexCoords.
+class TextureAtlas {
+ public:
+  static const unsigned int kDefaultSize = 2048;
+  static const unsigned int kDefaultLevels = 4;
+
+ private:
+  struct Page {
+    unsigned int RendererID;
+    AtlasPacker Packer;
+    bool Static;  // loaded from a file, nothing more goes in
+    bool Dirty;   // mips are stale
+  };
+
+  std::vector<Page> m_Pages;
+  std::unordered_map<std::string, AtlasRegion> m_Regions;
+  unsigned int m_Size, m_Levels, m_Gutter;
+
+ public:
+  // size x size pages, padding = minimum gutter in texels
+  explicit TextureAtlas(unsigned int size = kDefaultSize,
+                        unsigned int levels = kDefaultLevels,
+                        unsigned int padding = 1);
+  ~TextureAtlas();
+  TextureAtlas(const TextureAtlas&) = delete;
+  TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+  // decodes the file the first time, later calls return the same region
+  AtlasRegion Add(const std::string& path);
+  // 8 bit RGBA, rows bottom up
+  AtlasRegion Add(const std::string& name, const unsigned char* pixels,
+                  unsigned int width, unsigned int height);
+  // invalid region when there is none
+  AtlasRegion Find(const std::string& name) const;
+
+  // a prebuilt .atlas as a page of its own, its entries become regions
+  bool Load(const std::string& path);
+
+  // regenerates the mips of a page images went into since its last bind
+  void Bind(unsigned int page, unsigned int slot = 0);
+  inline unsigned int GetPageCount() const {
+    return (unsigned int)m_Pages.size();
+  }
+  inline unsigned int GetRendererID(unsigned int page) const {
+    return m_Pages[page].RendererID;
+  }
+  void PrintStats() const;
+
+  // rewrite the texture coordinates at `uvOffset` floats into every
+  // `stride` floats of an interleaved vertex array
+  static void RemapTexCoords(const AtlasRegion& region, float* vertices,
+                             unsigned int vertexCount, unsigned int stride,
+                             unsigned int uvOffset);
+
+  // pack `images` into the smallest square power of two page up to
+  // maxSize that holds them all, and write it with its mips and UV table
+  static bool Build(const std::vector<std::string>& images,
+                    const std::string& destination,
+                    unsigned int maxSize = 4096,
+                    unsigned int levels = kDefaultLevels,
+                    unsigned int padding = 1);
+
+ private:
+  unsigned int CreatePage(unsigned int width, unsigned int height,
+                          bool isStatic);
+};
@@ -0,0 +1,368 @@
+#include "TextureCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "BlockCompression.h"
+#include "GL/glew.h"
+#include "MipChain.h"
+#include "TextureFormat.h"
+#include "stb_image/stb_image.h"
+
+namespace {
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+inline uint64_t Rotate(uint64_t value, unsigned int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// one xxHash64 style lane over 8 byte words, several GB/s so hashing the
+// source stays cheap next to reading it
+uint64_t Hash(const unsigned char* data, size_t size, uint64_t seed) {
+  uint64_t hash = seed + kPrime1 + size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    hash = Rotate(hash ^ Rotate(word * kPrime2, 31) * kPrime1, 27) * kPrime1;
+  }
+  for (; i < size; i++) hash = Rotate(hash ^ data[i] * kPrime1, 11) * kPrime2;
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  return hash;
+}
+
+inline uint64_t AlignUp(uint64_t offset) {
+  const uint64_t mask = kTextureCacheAlignment - 1;
+  return (offset + mask) & ~mask;
+}
+
+// whether Import could have written this format combination, and this
+// context can still upload it
+bool IsImportFormat(const TextureCacheHeader& header) {
+  if (header.Channels < 1 || header.Channels > 4) return false;
+  for (unsigned int type : {GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_FLOAT}) {
+    for (bool srgb : {false, true}) {
+      unsigned int internalFormat =
+          TextureFormat::FromChannels(header.Channels, type, srgb);
+      unsigned int format, uploadType;
+      TextureFormat::GetUploadFormat(internalFormat, format, uploadType);
+      if (header.InternalFormat == internalFormat &&
+          header.Format == format && header.Type == uploadType)
+        return true;
+      if (type == GL_UNSIGNED_BYTE && header.Format == 0 &&
+          header.Type == 0 && header.InternalFormat != 0 &&
+          header.InternalFormat ==
+              BlockCompression::GetCompressedFormat(internalFormat))
+        return true;
+    }
+  }
+  return false;
+}
+
+double Elapsed(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+TextureCache::TextureCache()
+    : m_Directory("res/cache"),
+      m_Enabled(true),
+      m_Compress(false),
+      m_Stats() {}
+
+TextureCache& TextureCache::Get() {
+  static TextureCache cache;
+  return cache;
+}
+
+uint64_t TextureCache::ComputeKey(const unsigned char* data, size_t size,
+                                  const TextureImportSettings& settings) {
+  // what compression would produce depends on the GL too
+  uint64_t seed = kTextureCacheVersion;
+  seed = seed * 31 + settings.Srgb;
+  seed = seed * 31 + settings.Mips;
+  seed = seed * 31 +
+         (settings.Compress
+              ? BlockCompression::GetCompressedFormat(GL_RGBA8) + 1
+              : 0);
+  return Hash(data, size, seed);
+}
+
+bool TextureCache::Import(const unsigned char* data, size_t size,
+                          const TextureImportSettings& settings,
+                          TextureImage& image) {
+  // as many channels as the file has, 16 bit and HDR files keep their depth
+  stbi_set_flip_vertically_on_load(1);
+  int length = (int)size, width, height, channels;
+  unsigned int type = GL_UNSIGNED_BYTE;
+  size_t componentBytes = 1;
+  void* pixels = nullptr;
+  if (stbi_is_hdr_from_memory(data, length)) {
+    type = GL_FLOAT;
+    componentBytes = sizeof(float);
+    pixels =
+        stbi_loadf_from_memory(data, length, &width, &height, &channels, 0);
+  } else if (stbi_is_16_bit_from_memory(data, length)) {
+    type = GL_UNSIGNED_SHORT;
+    componentBytes = 2;
+    pixels =
+        stbi_load_16_from_memory(data, length, &width, &height, &channels, 0);
+  } else {
+    pixels = stbi_load_from_memory(data, length, &width, &height, &channels, 0);
+  }
+  if (!pixels) return false;
+
+  TextureCacheHeader& header = image.Header;
+  std::memcpy(header.Magic, kTextureCacheMagic, 4);
+  header.Version = kTextureCacheVersion;
+  header.Key = 0;
+  header.Width = width;
+  header.Height = height;
+  header.Channels = channels;
+  header.InternalFormat =
+      TextureFormat::FromChannels(channels, type, settings.Srgb);
+  TextureFormat::GetUploadFormat(header.InternalFormat, header.Format,
+                                 header.Type);
+  // only 8 bit images have a BCn format here
+  unsigned int compressed =
+      settings.Compress && type == GL_UNSIGNED_BYTE
+          ? BlockCompression::GetCompressedFormat(header.InternalFormat)
+          : 0;
+  if (compressed) {
+    header.InternalFormat = compressed;
+    header.Format = header.Type = 0;
+  }
+  header.LevelCount = settings.Mips ? MipChain::CountLevels(width, height) : 1;
+  header.Reserved = 0;
+
+  image.Levels.resize(header.LevelCount);
+  uint64_t offset = 0;
+  for (unsigned int level = 0; level < header.LevelCount; level++) {
+    TextureCacheLevel& entry = image.Levels[level];
+    entry.Width = MipChain::LevelSize(width, level);
+    entry.Height = MipChain::LevelSize(height, level);
+    entry.Offset = offset;
+    entry.Size = TextureFormat::GetImageBytes(entry.Width, entry.Height,
+                                              header.InternalFormat);
+    offset = AlignUp(offset + entry.Size);
+  }
+  header.DataOffset =
+      AlignUp(sizeof(TextureCacheHeader) +
+              sizeof(TextureCacheLevel) * header.LevelCount);
+  header.DataSize = offset;
+  image.Storage.assign((size_t)offset, 0);
+  image.Data = image.Storage.data();
+  image.File.reset();
+
+  // each level from the one before, uncompressed
+  size_t texelBytes = channels * componentBytes;
+  std::vector<unsigned char> current((unsigned char*)pixels,
+                                     (unsigned char*)pixels +
+                                         (size_t)width * height * texelBytes);
+  stbi_image_free(pixels);
+  std::vector<unsigned char> next;
+  for (unsigned int level = 0; level < header.LevelCount; level++) {
+    const TextureCacheLevel& entry = image.Levels[level];
+    unsigned char* destination = image.Storage.data() + entry.Offset;
+    if (compressed)
+      BlockCompression::Compress(current.data(), entry.Width, entry.Height,
+                                 channels, compressed, destination);
+    else
+      std::memcpy(destination, current.data(), (size_t)entry.Size);
+    if (level + 1 == header.LevelCount) break;
+    next.resize((size_t)MipChain::LevelSize(entry.Width, 1) *
+                MipChain::LevelSize(entry.Height, 1) * texelBytes);
+    MipChain::Downsample(current.data(), entry.Width, entry.Height, channels,
+                         type, next.data());
+    current.swap(next);
+  }
+  return true;
+}
+
+std::string TextureCache::GetEntryPath(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.texcache",
+                (unsigned long long)key);
+  return m_Directory + "/" + name;
+}
+
+bool TextureCache::Load(const std::string& path,
+                        const TextureImportSettings& settings,
+                        TextureImage& image) {
+  MappedFile source(path);
+  if (!source.IsValid()) return false;
+  uint64_t key = ComputeKey(source.GetData(), source.GetSize(), settings);
+  std::string entry = GetEntryPath(key);
+  if (m_Enabled && Read(entry, key, image)) {
+    m_Stats.Hits++;
+    return true;
+  }
+
+  m_Stats.Misses++;
+  if (!Import(source.GetData(), source.GetSize(), settings, image)) {
+    std::cout << "[TextureCache] failed to decode " << path << std::endl;
+    return false;
+  }
+  image.Header.Key = key;
+  if (m_Enabled) Write(entry, image);
+  return true;
+}
+
+bool TextureCache::Read(const std::string& path, uint64_t key,
+                        TextureImage& image) {
+  // a miss is the normal case, don't let MappedFile complain about it
+  if (!std::ifstream(path, std::ios::binary).good()) return false;
+  std::unique_ptr<MappedFile> file(new MappedFile(path));
+  if (!file->IsValid() || file->GetSize() < sizeof(TextureCacheHeader))
+    return false;
+
+  // anything that doesn't add up is treated as a miss and rewritten. Sizes
+  // stay below 2^24 like stb_image's, so no product or sum here can wrap
+  TextureCacheHeader header;
+  std::memcpy(&header, file->GetData(), sizeof(header));
+  uint64_t size = file->GetSize();
+  uint64_t levelsEnd = sizeof(TextureCacheHeader) +
+                       (uint64_t)header.LevelCount * sizeof(TextureCacheLevel);
+  if (std::memcmp(header.Magic, kTextureCacheMagic, 4) != 0 ||
+      header.Version != kTextureCacheVersion || header.Key != key ||
+      header.Width == 0 || header.Width > (1u << 24) || header.Height == 0 ||
+      header.Height > (1u << 24) || header.LevelCount == 0 ||
+      header.LevelCount > MipChain::CountLevels(header.Width, header.Height) ||
+      levelsEnd > header.DataOffset || header.DataOffset > size ||
+      header.DataSize > size - header.DataOffset || !IsImportFormat(header))
+    return false;
+  image.Levels.resize(header.LevelCount);
+  std::memcpy(image.Levels.data(),
+              file->GetData() + sizeof(TextureCacheHeader),
+              header.LevelCount * sizeof(TextureCacheLevel));
+  // levels are uploaded straight from the data block, so each has to be
+  // exactly the size GL will read for it
+  for (unsigned int i = 0; i < header.LevelCount; i++) {
+    const TextureCacheLevel& level = image.Levels[i];
+    if (level.Width != MipChain::LevelSize(header.Width, i) ||
+        level.Height != MipChain::LevelSize(header.Height, i) ||
+        level.Size != TextureFormat::GetImageBytes(level.Width, level.Height,
+                                                   header.InternalFormat) ||
+        level.Offset > header.DataSize ||
+        level.Size > header.DataSize - level.Offset)
+      return false;
+  }
+
+  image.Header = header;
+  image.Data = file->GetData() + header.DataOffset;
+  image.Storage.clear();
+  image.File = std::move(file);
+  m_Stats.BytesRead += image.File->GetSize();
+  return true;
+}
+
+bool TextureCache::Write(const std::string& path, const TextureImage& image) {
+#ifdef _WIN32
+  _mkdir(m_Directory.c_str());
+#else
+  mkdir(m_Directory.c_str(), 0755);
+#endif
+  // written aside and renamed, a crash never leaves a torn entry behind
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream stream(temporary, std::ios::binary);
+    if (!stream) {
+      std::cout << "[TextureCache] can't write " << temporary << std::endl;
+      return false;
+    }
+    const TextureCacheHeader& header = image.Header;
+    stream.write((const char*)&header, sizeof(header));
+    stream.write((const char*)image.Levels.data(),
+                 image.Levels.size() * sizeof(TextureCacheLevel));
+    static const char kZeros[kTextureCacheAlignment] = {};
+    stream.write(kZeros, header.DataOffset - sizeof(header) -
+                             image.Levels.size() * sizeof(TextureCacheLevel));
+    stream.write((const char*)image.Data, header.DataSize);
+    if (!stream) {
+      std::cout << "[TextureCache] can't write " << temporary << std::endl;
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  std::remove(path.c_str());
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  m_Stats.Writes++;
+  m_Stats.BytesWritten += image.Header.DataOffset + image.Header.DataSize;
+  return true;
+}
+
+void TextureCache::PrintStats() const {
+  std::cout << "[TextureCache] " << m_Stats.Hits << " hits, "
+            << m_Stats.Misses << " misses, " << m_Stats.Writes
+            << " written, " << m_Stats.BytesRead / 1024 << " KB read, "
+            << m_Stats.BytesWritten / 1024 << " KB written" << std::endl;
+}
+
+void TextureCache::Benchmark() {
+  typedef std::chrono::high_resolution_clock Clock;
+  const char* files[] = {"res/textures/container.jpg",
+                         "res/textures/desktop.png", "res/textures/icon.png"};
+
+  TextureCache& cache = Get();
+  for (bool compress : {false, true}) {
+    TextureImportSettings settings = {false, true, compress};
+    std::cout << "[TextureCache] "
+              << (compress ? "BCn where available" : "uncompressed")
+              << ", mipped" << std::endl;
+    for (const char* path : files) {
+      // a cold load is a miss: decode, mips, compression and the write
+      {
+        MappedFile source(path);
+        if (!source.IsValid()) continue;
+        std::remove(cache
+                        .GetEntryPath(ComputeKey(source.GetData(),
+                                                 source.GetSize(), settings))
+                        .c_str());
+      }
+      TextureImage image;
+      auto start = Clock::now();
+      if (!cache.Load(path, settings, image)) continue;
+      double cold = Elapsed(start);
+
+      // a warm one reads the source to hash it and maps the entry; the
+      // loop touches every page as the upload would
+      TextureImage cached;
+      start = Clock::now();
+      if (!cache.Load(path, settings, cached) || !cached.File) {
+        std::cout << "  " << path << ": no cache entry" << std::endl;
+        continue;
+      }
+      volatile unsigned int sum = 0;
+      for (size_t i = 0; i < cached.Header.DataSize; i += 4096)
+        sum += cached.Data[i];
+      double warm = Elapsed(start);
+
+      std::cout << "  " << path << " "
+                << TextureFormat::GetName(cached.Header.InternalFormat) << " "
+                << cached.Header.LevelCount << " levels, "
+                << cached.File->GetSize() / 1024 << " KB: cold " << cold
+                << " ms, warm " << warm << " ms (x" << cold / warm << ")"
+                << std::endl;
+    }
+  }
+  cache.PrintStats();
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureCacheFile.h"
+
+// how a source image becomes a texture, part of the cache key
+struct TextureImportSettings {
+  bool Srgb;      // colour channels are sRGB encoded
+  bool Mips;      // the full chain down to 1x1, box filtered
+  bool Compress;  // BCn where BlockCompression has a format for it
+};
+
+// A texture as it is uploaded, either still in its mapped cache file or
+// just imported into Storage.
+struct TextureImage {
+  TextureCacheHeader Header;
+  std::vector<TextureCacheLevel> Levels;
+  const unsigned char* Data;  // the data block
+  std::vector<unsigned char> Storage;
+  std::unique_ptr<MappedFile> File;
+
+  TextureImage() : Header(), Data(nullptr) {}
+
+  inline const unsigned char* GetLevel(unsigned int level) const {
+    return Data + Levels[level].Offset;
+  }
+};
+
+// Content addressed cache of imported textures on disk. An entry is named
+// after a hash of the source file's bytes and the import settings, so an
+// edited source or different settings miss and are imported again; the
+// stale entry is simply never looked up. A hit maps the entry and hands
+// the decoded, mipped and possibly compressed levels to the upload, so a
+// warm start only reads files.
+class TextureCache {
+ public:
+  struct Stats {
+    unsigned int Hits;
+    unsigned int Misses;
+    unsigned int Writes;
+    size_t BytesRead;  // of cache entries
+    size_t BytesWritten;
+  };
+
+ private:
+  std::string m_Directory;
+  bool m_Enabled;
+  bool m_Compress;
+  Stats m_Stats;
+
+ public:
+  TextureCache();
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+
+  static TextureCache& Get();
+
+  // relative to the working directory, "res/cache" by default
+  inline void SetDirectory(const std::string& directory) {
+    m_Directory = directory;
+  }
+  inline const std::string& GetDirectory() const { return m_Directory; }
+  // disabled, every load imports and nothing is written
+  inline void SetEnabled(bool enabled) { m_Enabled = enabled; }
+  inline bool IsEnabled() const { return m_Enabled; }
+  // whether Texture asks for BCn, off by default as it is lossy
+  inline void SetCompression(bool compress) { m_Compress = compress; }
+  inline bool IsCompressing() const { return m_Compress; }
+  inline const Stats& GetStats() const { return m_Stats; }
+
+  // from the cache, or imported and stored; on the GL thread only, the
+  // stats aren't synchronised
+  bool Load(const std::string& path, const TextureImportSettings& settings,
+            TextureImage& image);
+
+  static uint64_t ComputeKey(const unsigned char* data, size_t size,
+                             const TextureImportSettings& settings);
+  // decode, build the mips and compress them
+  static bool Import(const unsigned char* data, size_t size,
+                     const TextureImportSettings& settings,
+                     TextureImage& image);
+
+  void PrintStats() const;
+  // cold (import and write) against warm (mapped entry) loads of the
+  // res/textures images, with and without compression
+  static void Benchmark();
+
+ private:
+  std::string GetEntryPath(uint64_t key) const;
+  bool Read(const std::string& path, uint64_t key, TextureImage& image);
+  bool Write(const std::string& path, const TextureImage& image);
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+
+// Decoded texture cache entry (.texcache), written and read by
+// TextureCache. Named after its key, little endian, laid out as
+//
+//   TextureCacheHeader
+//   TextureCacheLevel[LevelCount]
+//   data block (DataOffset, 16-byte aligned), every level back to back as
+//   glTexImage2D / glCompressedTexImage2D take it, level 0 first
+//
+// so the mapped file can be uploaded without copying.
+
+const char kTextureCacheMagic[4] = {'T', 'X', 'C', 'H'};
+const uint32_t kTextureCacheVersion = 1;
+const uint32_t kTextureCacheAlignment = 16;
+
+struct TextureCacheHeader {
+  char Magic[4];
+  uint32_t Version;
+  uint64_t Key;  // hash of the source bytes and import settings
+  uint32_t Width;
+  uint32_t Height;
+  uint32_t Channels;        // in the source file
+  uint32_t InternalFormat;  // GL sized or compressed format
+  uint32_t Format;          // upload format and type, 0 when compressed
+  uint32_t Type;
+  uint32_t LevelCount;
+  uint32_t Reserved;
+  uint64_t DataOffset;
+  uint64_t DataSize;
+};
+
+struct TextureCacheLevel {
+  uint32_t Width;
+  uint32_t Height;
+  uint64_t Offset;  // into the data block
+  uint64_t Size;
+};
+
+static_assert(sizeof(TextureCacheHeader) == 64,
+              "TextureCacheHeader layout changed");
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "SelfTest.h"
+#include "TextureCache.h"
+#include "TextureCacheFile.h"
+
+namespace {
+
+// a 4x4 RGB image, mipped and uncompressed: a three level entry
+const TextureImportSettings kSettings = {false, true, false};
+
+std::string MakeImage() {
+  std::string ppm = "P6\n4 4\n255\n";
+  for (unsigned int i = 0; i < 4 * 4 * 3; i++) ppm += (char)(i * 5);
+  return ppm;
+}
+
+// write `good` as the entry after `change`, cut to `size` bytes, and
+// whether the next load maps it instead of importing again
+bool Hits(TextureCache& cache, const std::string& source,
+          const std::string& entry, const std::vector<unsigned char>& good,
+          const std::function<void(TextureCacheHeader&,
+                                   TextureCacheLevel*)>& change,
+          size_t size = ~(size_t)0) {
+  std::vector<unsigned char> bytes = good;
+  change(*(TextureCacheHeader*)bytes.data(),
+         (TextureCacheLevel*)(bytes.data() + sizeof(TextureCacheHeader)));
+  SelfTest::WriteFile(entry, bytes.data(), std::min(size, bytes.size()));
+  unsigned int hits = cache.GetStats().Hits;
+  TextureImage image;
+  // a rejected entry is only a miss, the image is still there
+  return cache.Load(source, kSettings, image) && image.Levels.size() == 3 &&
+         cache.GetStats().Hits > hits;
+}
+
+}  // namespace
+
+void SelfTest::TextureCacheTests() {
+  std::string image = MakeImage();
+  std::string source = WriteFile("image.ppm", image);
+  TextureCache cache;
+  cache.SetDirectory("res/selftest");
+
+  // the first load imports and writes the entry, the second maps it
+  char entry[32];
+  std::snprintf(entry, sizeof(entry), "%016llx.texcache",
+                (unsigned long long)TextureCache::ComputeKey(
+                    (const unsigned char*)image.data(), image.size(),
+                    kSettings));
+  std::vector<unsigned char> good;
+  {
+    TextureImage imported, mapped;
+    EXPECT(cache.Load(source, kSettings, imported) &&
+           cache.GetStats().Misses == 1 && cache.GetStats().Writes == 1);
+    EXPECT(cache.Load(source, kSettings, mapped) && mapped.File &&
+           cache.GetStats().Hits == 1);
+    if (!mapped.File) return;
+    good.assign(mapped.File->GetData(),
+                mapped.File->GetData() + mapped.File->GetSize());
+  }
+  // WriteFile takes the entry over, so it is removed afterwards
+  auto keep = [](TextureCacheHeader&, TextureCacheLevel*) {};
+  EXPECT(Hits(cache, source, entry, good, keep));
+
+  // torn writes, or not an entry of this version
+  EXPECT(!Hits(cache, source, entry, good, keep, 0));
+  EXPECT(!Hits(cache, source, entry, good, keep, 40));
+  EXPECT(!Hits(cache, source, entry, good, keep, good.size() - 4));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.Magic[0] = 'X';
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.Version = 2;
+               }));
+  // an entry of another source or other settings under this name
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) { h.Key ^= 1; }));
+
+  // a header that doesn't add up
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) { h.Width = 0; }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.Height = 1u << 25;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.LevelCount = 0;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.LevelCount = 0xFFFFFFFF;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.Channels = 5;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.InternalFormat = 0;
+               }));
+
+  // a data block outside the file or over the level table
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.DataOffset = 1ull << 62;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.DataOffset = sizeof(TextureCacheHeader);
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel*) {
+                 h.DataSize = ~0ull - 8;
+               }));
+
+  // levels GL would read past, or read as the wrong size
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader&, TextureCacheLevel* l) {
+                 l[1].Width = 4;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader&, TextureCacheLevel* l) {
+                 l[0].Size += 4;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader& h, TextureCacheLevel* l) {
+                 l[2].Offset = h.DataSize;
+               }));
+  EXPECT(!Hits(cache, source, entry, good,
+               [](TextureCacheHeader&, TextureCacheLevel* l) {
+                 l[2].Offset = ~0ull - 2;
+               }));
+
+  // every miss wrote the entry again
+  EXPECT(cache.GetStats().Writes == cache.GetStats().Misses);
+}
@@ -0,0 +1,199 @@
+#include "TextureFormat.h"
+
+#include "GL/glew.h"
+
+namespace TextureFormat {
+
+bool IsDepth(unsigned int internalFormat) {
+  return internalFormat == GL_DEPTH_COMPONENT16 ||
+         internalFormat == GL_DEPTH_COMPONENT24 ||
+         internalFormat == GL_DEPTH_COMPONENT32F ||
+         internalFormat == GL_DEPTH24_STENCIL8 ||
+         internalFormat == GL_DEPTH32F_STENCIL8;
+}
+
+bool HasStencil(unsigned int internalFormat) {
+  return internalFormat == GL_DEPTH24_STENCIL8 ||
+         internalFormat == GL_DEPTH32F_STENCIL8;
+}
+
+void GetUploadFormat(unsigned int internalFormat, unsigned int& format,
+                     unsigned int& type) {
+  switch (internalFormat) {
+    case GL_DEPTH24_STENCIL8:
+      format = GL_DEPTH_STENCIL;
+      type = GL_UNSIGNED_INT_24_8;
+      return;
+    case GL_DEPTH32F_STENCIL8:
+      format = GL_DEPTH_STENCIL;
+      type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+      return;
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+      format = GL_DEPTH_COMPONENT;
+      type = GL_FLOAT;
+      return;
+    case GL_R32UI:
+      format = GL_RED_INTEGER;
+      type = GL_UNSIGNED_INT;
+      return;
+    case GL_RGBA16UI:
+      format = GL_RGBA_INTEGER;
+      type = GL_UNSIGNED_SHORT;
+      return;
+    case GL_R8:
+    case GL_R16:
+    case GL_R16F:
+    case GL_R32F:
+      format = GL_RED;
+      break;
+    case GL_RG8:
+    case GL_RG16:
+    case GL_RG16F:
+    case GL_RG32F:
+      format = GL_RG;
+      break;
+    case GL_RGB8:
+    case GL_SRGB8:
+    case GL_RGB16:
+    case GL_RGB16F:
+    case GL_RGB32F:
+    case GL_R11F_G11F_B10F:
+      format = GL_RGB;
+      break;
+    default:
+      format = GL_RGBA;
+      break;
+  }
+  bool floating = internalFormat == GL_R16F || internalFormat == GL_R32F ||
+                  internalFormat == GL_RG16F || internalFormat == GL_RG32F ||
+                  internalFormat == GL_R11F_G11F_B10F ||
+                  internalFormat == GL_RGB16F || internalFormat == GL_RGB32F ||
+                  internalFormat == GL_RGBA16F || internalFormat == GL_RGBA32F;
+  bool sixteen = internalFormat == GL_R16 || internalFormat == GL_RG16 ||
+                 internalFormat == GL_RGB16 || internalFormat == GL_RGBA16;
+  type = floating ? GL_FLOAT : sixteen ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+}
+
+bool IsCompressed(unsigned int internalFormat) {
+  switch (internalFormat) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+      return true;
+    default:
+      return false;
+  }
+}
+
+size_t GetImageBytes(unsigned int width, unsigned int height,
+                     unsigned int internalFormat) {
+  if (!IsCompressed(internalFormat))
+    return (size_t)width * height * GetBytesPerPixel(internalFormat);
+  // 8 bytes per block for BC1 / BC4, 16 for BC3 / BC5
+  bool eightBytes = internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ||
+                    internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ||
+                    internalFormat == GL_COMPRESSED_RED_RGTC1;
+  size_t blockBytes = eightBytes ? 8 : 16;
+  return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+unsigned int FromChannels(unsigned int channels, unsigned int type,
+                          bool srgb) {
+  static const unsigned int kUnorm8[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+  static const unsigned int kUnorm16[] = {GL_R16, GL_RG16, GL_RGB16,
+                                          GL_RGBA16};
+  static const unsigned int kHalf[] = {GL_R16F, GL_RG16F, GL_RGB16F,
+                                       GL_RGBA16F};
+  unsigned int index = (channels < 1 ? 4 : channels > 4 ? 4 : channels) - 1;
+  if (type == GL_FLOAT) return kHalf[index];
+  if (type == GL_UNSIGNED_SHORT) return kUnorm16[index];
+  // only colour is encoded, alpha and single channels are linear
+  if (srgb && index == 2) return GL_SRGB8;
+  if (srgb && index == 3) return GL_SRGB8_ALPHA8;
+  return kUnorm8[index];
+}
+
+const char* GetName(unsigned int internalFormat) {
+  switch (internalFormat) {
+    case GL_R8:
+      return "R8";
+    case GL_RG8:
+      return "RG8";
+    case GL_RGB8:
+      return "RGB8";
+    case GL_RGBA8:
+      return "RGBA8";
+    case GL_SRGB8:
+      return "SRGB8";
+    case GL_SRGB8_ALPHA8:
+      return "SRGB8_ALPHA8";
+    case GL_R16:
+      return "R16";
+    case GL_RG16:
+      return "RG16";
+    case GL_RGB16:
+      return "RGB16";
+    case GL_RGBA16:
+      return "RGBA16";
+    case GL_R16F:
+      return "R16F";
+    case GL_RG16F:
+      return "RG16F";
+    case GL_RGB16F:
+      return "RGB16F";
+    case GL_RGBA16F:
+      return "RGBA16F";
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+      return "BC1";
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+      return "BC1 sRGB";
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+      return "BC3";
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+      return "BC3 sRGB";
+    case GL_COMPRESSED_RED_RGTC1:
+      return "BC4";
+    case GL_COMPRESSED_RG_RGTC2:
+      return "BC5";
+    default:
+      return "other";
+  }
+}
+
+size_t GetBytesPerPixel(unsigned int internalFormat) {
+  switch (internalFormat) {
+    case GL_R8:
+      return 1;
+    case GL_R16:
+    case GL_R16F:
+    case GL_RG8:
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGB8:
+    case GL_SRGB8:
+      return 3;
+    case GL_RGB16:
+    case GL_RGB16F:
+      return 6;
+    case GL_RGBA16:
+    case GL_RGBA16F:
+    case GL_RGBA16UI:
+    case GL_RG32F:
+    case GL_DEPTH32F_STENCIL8:
+      return 8;
+    case GL_RGB32F:
+      return 12;
+    case GL_RGBA32F:
+      return 16;
+    default:  // RGBA8, SRGB8_ALPHA8, RG16, RG16F, R32F, R32UI,
+              // R11F_G11F_B10F, depth
+      return 4;
+  }
+}
+
+}  // namespace TextureFormat
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+
+// Facts about GL sized internal formats shared by everything that
+// allocates textures or renderbuffers.
+namespace TextureFormat {
+
+bool IsDepth(unsigned int internalFormat);
+bool HasStencil(unsigned int internalFormat);
+// client format and type glTexImage2D accepts for the internal format
+void GetUploadFormat(unsigned int internalFormat, unsigned int& format,
+                     unsigned int& type);
+size_t GetBytesPerPixel(unsigned int internalFormat);
+// BC1..BC5, stored in 4x4 blocks
+bool IsCompressed(unsigned int internalFormat);
+// bytes of one width x height image, whole blocks when compressed
+size_t GetImageBytes(unsigned int width, unsigned int height,
+                     unsigned int internalFormat);
+// sized format keeping an image's channels, type = GL_UNSIGNED_BYTE,
+// GL_UNSIGNED_SHORT (16 bit) or GL_FLOAT (HDR, stored as half floats)
+unsigned int FromChannels(unsigned int channels, unsigned int type,
+                          bool srgb = false);
+// "RGBA8", "R16F"... for reports
+const char* GetName(unsigned int internalFormat);
+
+}  // namespace TextureFormat
@@ -0,0 +1,384 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "DeletionQueue.h"
+#include "GL/glew.h"
+#include "GpuMemory.h"
+#include "ImageDecoder.h"
+#include "Log.h"
+#include "MipChain.h"
+#include "stb_image/stb_image.h"
+
+const unsigned int TextureStreamer::kTailSize;
+const unsigned int TextureStreamer::kDropFrames;
+const size_t TextureStreamer::kUploadBytesPerFrame;
+
+namespace {
+
+using MipChain::CountLevels;
+using MipChain::Downsample;
+using MipChain::LevelSize;
+
+// decode and build the chain, keeping the levels from `top` down. The
+// decoders only produce full resolution images, so even a tail costs a
+// full decode; every level comes out of that one decode by downsampling.
+std::vector<std::vector<unsigned char>> DecodeChain(const std::string& path,
+                                                    unsigned int width,
+                                                    unsigned int height,
+                                                    unsigned int levels,
+                                                    unsigned int top) {
+  std::vector<std::vector<unsigned char>> pixels(levels);
+  ImageDecodeRequest request(path, 4);
+  if (!ImageDecoder::Get().Decode(request) || request.Info.Width != width ||
+      request.Info.Height != height) {
+    // keep streaming with black rather than stall on a broken file
+    std::cout << "[TextureStreamer] failed to decode " << path << std::endl;
+    for (unsigned int level = top; level < levels; level++)
+      pixels[level].assign((size_t)LevelSize(width, level) *
+                               LevelSize(height, level) * 4,
+                           0);
+    return pixels;
+  }
+
+  std::vector<unsigned char> scratch[2];
+  const unsigned char* source = request.Pixels.data();
+  for (unsigned int level = 0; level < levels; level++) {
+    unsigned int lw = LevelSize(width, level), lh = LevelSize(height, level);
+    if (level >= top)
+      pixels[level].assign(source, source + (size_t)lw * lh * 4);
+    if (level + 1 == levels) break;
+    std::vector<unsigned char>& next = scratch[level & 1];
+    next.resize((size_t)LevelSize(width, level + 1) *
+                LevelSize(height, level + 1) * 4);
+    Downsample(source, lw, lh, next.data());
+    source = next.data();
+  }
+  return pixels;
+}
+
+}  // namespace
+
+TextureStreamer::TextureStreamer(size_t budget)
+    : m_Budget(budget), m_Frame(0), m_Stats() {}
+
+TextureStreamer::~TextureStreamer() {
+  JobSystem::Get().Wait(m_Jobs);
+  for (Entry& entry : m_Textures) {
+    Release(entry, entry.Current);
+    Release(entry, entry.Pending);
+  }
+}
+
+TextureStreamer::TextureID TextureStreamer::Add(const std::string& path) {
+  int width = 1, height = 1, channels;
+  if (!stbi_info(path.c_str(), &width, &height, &channels)) {
+    std::cout << "[TextureStreamer] can't read " << path << std::endl;
+    width = height = 1;
+  }
+
+  Entry entry;
+  entry.Path = path;
+  entry.Width = width;
+  entry.Height = height;
+  entry.Levels = CountLevels(width, height);
+  entry.Tail = 0;
+  while (std::max(LevelSize(width, entry.Tail), LevelSize(height, entry.Tail)) >
+         kTailSize)
+    entry.Tail++;
+  entry.Requested = entry.Levels;
+  entry.Required = entry.Target = entry.Tail;
+  entry.LastRequested = m_Frame;
+  entry.Current = entry.Pending = Residency{0, entry.Levels, entry.Levels};
+  entry.Pixels.resize(entry.Levels);
+  entry.DecodedTop = entry.Levels;
+  entry.Decoding = false;
+  m_Textures.push_back(std::move(entry));
+  return (TextureID)m_Textures.size() - 1;
+}
+
+void TextureStreamer::Request(TextureID texture, unsigned int level) {
+  Entry& entry = m_Textures[texture];
+  entry.Requested = std::min(entry.Requested, level);
+}
+
+void TextureStreamer::Update() {
+  m_Stats.UploadedBytes = 0;
+
+  // finished decodes
+  std::vector<Decoded> decoded;
+  {
+    std::lock_guard<std::mutex> lock(m_DecodedMutex);
+    decoded.swap(m_Decoded);
+  }
+  for (Decoded& result : decoded) {
+    Entry& entry = m_Textures[result.Texture];
+    entry.Decoding = false;
+    for (unsigned int level = result.Top; level < entry.Levels; level++)
+      if (entry.Pixels[level].empty())
+        entry.Pixels[level].swap(result.Pixels[level]);
+    entry.DecodedTop = std::min(entry.DecodedTop, result.Top);
+  }
+
+  // what every texture needs, held for a while after the last request
+  for (Entry& entry : m_Textures) {
+    if (entry.Requested < entry.Levels) {
+      entry.Required = std::min(entry.Requested, entry.Tail);
+      entry.LastRequested = m_Frame;
+    } else if (m_Frame - entry.LastRequested >= kDropFrames) {
+      entry.Required = entry.Tail;
+    }
+    entry.Requested = entry.Levels;
+  }
+  ApplyBudget();
+
+  size_t uploadBudget = kUploadBytesPerFrame;
+  for (Entry& entry : m_Textures) {
+    Stream(entry);
+    if (entry.Pending.ID) {
+      Upload(entry, entry.Pending, uploadBudget);
+      // swap once the new texture is no blurrier than the old one
+      const Residency& pending = entry.Pending;
+      if (pending.UploadedTop == pending.StorageTop ||
+          (entry.Current.ID &&
+           pending.UploadedTop <= entry.Current.UploadedTop) ||
+          (!entry.Current.ID && pending.UploadedTop < entry.Levels)) {
+        Release(entry, entry.Current);
+        entry.Current = entry.Pending;
+        entry.Pending = Residency{0, entry.Levels, entry.Levels};
+        // the CPU keeps only what the GPU holds
+        for (unsigned int level = 0; level < entry.Current.StorageTop;
+             level++)
+          std::vector<unsigned char>().swap(entry.Pixels[level]);
+        entry.DecodedTop = std::max(entry.DecodedTop, entry.Current.StorageTop);
+      }
+    }
+    if (entry.Current.ID) Upload(entry, entry.Current, uploadBudget);
+  }
+
+  // a single worker is this thread, which only runs jobs while waiting
+  JobSystem& jobs = JobSystem::Get();
+  unsigned int dispatched = 0;
+  for (; dispatched < m_DecodeQueue.size(); dispatched++) {
+    TextureID texture = m_DecodeQueue[dispatched].first;
+    const Entry& entry = m_Textures[texture];
+    // the target may have moved on while this waited, the decode is the
+    // same either way so keep what it wants now too
+    unsigned int top = std::min(m_DecodeQueue[dispatched].second,
+                                entry.Target);
+    std::string path = entry.Path;
+    unsigned int width = entry.Width, height = entry.Height;
+    unsigned int levels = entry.Levels;
+    auto work = [this, texture, top, path, width, height, levels]() {
+      Decoded result{texture, top,
+                     DecodeChain(path, width, height, levels, top)};
+      std::lock_guard<std::mutex> lock(m_DecodedMutex);
+      m_Decoded.push_back(std::move(result));
+    };
+    if (jobs.GetWorkerCount() > 1) {
+      jobs.Run(work, &m_Jobs);
+    } else if (dispatched == 0) {
+      work();
+    } else {
+      break;
+    }
+  }
+  m_DecodeQueue.erase(m_DecodeQueue.begin(),
+                      m_DecodeQueue.begin() + dispatched);
+
+  m_Stats.Textures = (unsigned int)m_Textures.size();
+  m_Stats.Decoding = m_Stats.PendingUploads = 0;
+  m_Stats.ResidentBytes = 0;
+  for (const Entry& entry : m_Textures) {
+    m_Stats.Decoding += entry.Decoding;
+    m_Stats.PendingUploads +=
+        entry.Pending.ID != 0 ||
+        entry.Current.UploadedTop > entry.Current.StorageTop;
+    if (entry.Current.ID)
+      m_Stats.ResidentBytes += GetChainBytes(entry, entry.Current.StorageTop);
+    if (entry.Pending.ID)
+      m_Stats.ResidentBytes += GetChainBytes(entry, entry.Pending.StorageTop);
+  }
+  m_Frame++;
+}
+
+void TextureStreamer::ApplyBudget() {
+  size_t total = 0;
+  for (Entry& entry : m_Textures) {
+    entry.Target = entry.Required;
+    total += GetChainBytes(entry, entry.Target);
+  }
+  // over budget: take a level off whichever texture has the largest top
+  // level until it fits, the tails always stay
+  while (m_Budget && total > m_Budget) {
+    Entry* largest = nullptr;
+    size_t largestBytes = 0;
+    for (Entry& entry : m_Textures) {
+      if (entry.Target >= entry.Tail) continue;
+      size_t bytes = GetChainBytes(entry, entry.Target) -
+                     GetChainBytes(entry, entry.Target + 1);
+      if (bytes > largestBytes) {
+        largest = &entry;
+        largestBytes = bytes;
+      }
+    }
+    if (!largest) break;
+    largest->Target++;
+    total -= largestBytes;
+  }
+  m_Stats.TargetBytes = total;
+}
+
+void TextureStreamer::Stream(Entry& entry) {
+  unsigned int wanted = entry.Target;
+  // decode what is missing, meanwhile stream what we have
+  if (wanted < entry.DecodedTop) {
+    if (!entry.Decoding) {
+      entry.Decoding = true;
+      m_DecodeQueue.push_back(std::make_pair(
+          (TextureID)(&entry - m_Textures.data()), wanted));
+    }
+    wanted = entry.DecodedTop;
+    if (wanted == entry.Levels) return;
+  }
+
+  unsigned int current = entry.Current.ID ? entry.Current.StorageTop
+                                          : entry.Levels;
+  if (entry.Pending.ID) {
+    // a finer target replaces the pending texture, going back to what is
+    // already current cancels it
+    if (wanted < entry.Pending.StorageTop) {
+      Release(entry, entry.Pending);
+      Allocate(entry, entry.Pending, wanted);
+    } else if (wanted == current) {
+      Release(entry, entry.Pending);
+    }
+    return;
+  }
+  // one level of hysteresis before dropping
+  if (wanted < current || wanted > current + 1)
+    Allocate(entry, entry.Pending, wanted);
+}
+
+void TextureStreamer::Upload(Entry& entry, Residency& residency,
+                             size_t& budget) {
+  bool bound = false;
+  while (residency.UploadedTop > residency.StorageTop) {
+    unsigned int level = residency.UploadedTop - 1;
+    const std::vector<unsigned char>& pixels = entry.Pixels[level];
+    if (pixels.empty() || budget == 0) break;
+    // a level larger than the whole budget still goes, alone
+    if (pixels.size() > budget && budget < kUploadBytesPerFrame) break;
+
+    if (!bound) {
+      GLCall(glBindTexture(GL_TEXTURE_2D, residency.ID));
+      bound = true;
+    }
+    GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    GLCall(glTexSubImage2D(
+        GL_TEXTURE_2D, level - residency.StorageTop, 0, 0,
+        LevelSize(entry.Width, level), LevelSize(entry.Height, level),
+        GL_RGBA, GL_UNSIGNED_BYTE, pixels.data()));
+    residency.UploadedTop = level;
+    budget -= std::min(budget, pixels.size());
+    m_Stats.UploadedBytes += pixels.size();
+  }
+  if (bound) {
+    // sample only what has arrived
+    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,
+                           residency.UploadedTop - residency.StorageTop));
+    GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+  }
+}
+
+void TextureStreamer::Allocate(Entry& entry, Residency& residency,
+                               unsigned int top) {
+  unsigned int width = LevelSize(entry.Width, top);
+  unsigned int height = LevelSize(entry.Height, top);
+  unsigned int levels = entry.Levels - top;
+  residency = Residency{0, top, entry.Levels};
+  GLCall(glGenTextures(1, &residency.ID));
+  GLCall(glBindTexture(GL_TEXTURE_2D, residency.ID));
+  if (GLEW_ARB_texture_storage) {
+    GLCall(glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height));
+  } else {
+    for (unsigned int level = 0; level < levels; level++) {
+      GLCall(glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8,
+                          LevelSize(width, level), LevelSize(height, level),
+                          0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+    }
+  }
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                         GL_LINEAR_MIPMAP_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1));
+  GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+  GpuMemory::Get().Allocate(GpuMemoryCategory::Texture,
+                            GetChainBytes(entry, top));
+}
+
+void TextureStreamer::Release(Entry& entry, Residency& residency) {
+  if (residency.ID) {
+    GpuMemory::Get().Free(GpuMemoryCategory::Texture,
+                          GetChainBytes(entry, residency.StorageTop));
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Texture, residency.ID);
+  }
+  residency = Residency{0, entry.Levels, entry.Levels};
+}
+
+size_t TextureStreamer::GetChainBytes(const Entry& entry,
+                                      unsigned int top) const {
+  if (top >= entry.Levels) return 0;
+  return GpuMemory::GetTextureBytes(LevelSize(entry.Width, top),
+                                    LevelSize(entry.Height, top), GL_RGBA8,
+                                    entry.Levels - top);
+}
+
+void TextureStreamer::Bind(TextureID texture, unsigned int slot) const {
+  GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_Textures[texture].Current.ID));
+}
+
+unsigned int TextureStreamer::ComputeLevel(TextureID texture,
+                                           float screenPixels,
+                                           float uvScale) const {
+  const Entry& entry = m_Textures[texture];
+  if (screenPixels < 1.0f) return entry.Levels - 1;
+  float texels = std::max(entry.Width, entry.Height) * uvScale;
+  float level = std::floor(std::log2(texels / screenPixels));
+  return (unsigned int)std::min(std::max(level, 0.0f),
+                                (float)entry.Levels - 1.0f);
+}
+
+float TextureStreamer::ProjectedSize(const glm::vec3& min, const glm::vec3& max,
+                                     const glm::mat4& viewProjection,
+                                     float viewportHeight) {
+  glm::vec2 lo(1e30f), hi(-1e30f);
+  for (int corner = 0; corner < 8; corner++) {
+    glm::vec4 clip =
+        viewProjection * glm::vec4(corner & 1 ? max.x : min.x,
+                                   corner & 2 ? max.y : min.y,
+                                   corner & 4 ? max.z : min.z, 1.0f);
+    if (clip.w <= 0.0f) return viewportHeight;
+    glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+    lo = glm::min(lo, ndc);
+    hi = glm::max(hi, ndc);
+  }
+  glm::vec2 extent = hi - lo;
+  return std::max(extent.x, extent.y) * 0.5f * viewportHeight;
+}
+
+void TextureStreamer::PrintStats() const {
+  const double mb = 1.0 / (1024.0 * 1024.0);
+  std::cout << "[TextureStreamer] " << m_Stats.Textures << " textures, "
+            << m_Stats.ResidentBytes * mb << " MB resident, "
+            << m_Stats.TargetBytes * mb << " MB wanted";
+  if (m_Budget) std::cout << " of " << m_Budget * mb << " MB budget";
+  std::cout << ", " << m_Stats.Decoding << " decoding, "
+            << m_Stats.PendingUploads << " uploading" << std::endl;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+#include "glm/glm.hpp"
+
+struct TextureStreamerStats {
+  unsigned int Textures;
+  unsigned int Decoding;        // files being decoded on workers
+  unsigned int PendingUploads;  // textures with levels still to upload
+  size_t ResidentBytes;         // GPU storage of every streamed texture
+  size_t TargetBytes;           // what the wanted levels would take
+  size_t UploadedBytes;         // this Update()
+};
+
+// Streams the mip levels of 8 bit RGBA textures. Every frame callers
+// Request() the finest level each texture needs, e.g. from the projected
+// size of the objects using it, and Update() fits those levels into the
+// memory budget, decodes files on JobSystem workers, builds the chains
+// there and uploads a bounded number of bytes per frame. A texture starts
+// out with only its small tail mips. Streaming in allocates immutable
+// storage (glTexStorage2D) for the larger chain and fills it coarse to
+// fine, GL_TEXTURE_BASE_LEVEL hiding the levels not there yet; the old
+// texture stays bound until the new one has caught up. Textures nobody
+// requests for a while drop back to the tail.
+class TextureStreamer {
+ public:
+  typedef unsigned int TextureID;
+
+  static const unsigned int kTailSize = 64;         // largest tail level
+  static const unsigned int kDropFrames = 60;       // unrequested frames
+  static const size_t kUploadBytesPerFrame = 8 << 20;
+
+ private:
+  // a GL texture holding the levels [StorageTop, Levels)
+  struct Residency {
+    unsigned int ID;
+    unsigned int StorageTop;
+    unsigned int UploadedTop;  // finest level uploaded, == Levels for none
+  };
+
+  struct Entry {
+    std::string Path;
+    unsigned int Width, Height, Levels;
+    unsigned int Tail;       // finest level of the tail
+    unsigned int Requested;  // finest requested this frame, Levels = none
+    unsigned int Required;   // held since the last request
+    unsigned int Target;     // after the budget
+    unsigned int LastRequested;
+    Residency Current, Pending;
+    // decoded levels the GPU holds or is about to, finer ones are dropped
+    std::vector<std::vector<unsigned char>> Pixels;
+    unsigned int DecodedTop;  // finest level in Pixels, Levels for none
+    bool Decoding;
+  };
+
+  struct Decoded {
+    TextureID Texture;
+    unsigned int Top;
+    std::vector<std::vector<unsigned char>> Pixels;
+  };
+
+  std::vector<Entry> m_Textures;
+  std::vector<std::pair<TextureID, unsigned int>> m_DecodeQueue;
+  std::mutex m_DecodedMutex;
+  std::vector<Decoded> m_Decoded;
+  JobCounter m_Jobs;
+  size_t m_Budget;
+  unsigned int m_Frame;
+  TextureStreamerStats m_Stats;
+
+ public:
+  // budget in bytes of GPU storage, 0 = unlimited
+  explicit TextureStreamer(size_t budget = 256 << 20);
+  ~TextureStreamer();
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  // reads only the header, the tail is decoded on a worker
+  TextureID Add(const std::string& path);
+
+  // the texture needs `level` or finer this frame
+  void Request(TextureID texture, unsigned int level);
+  inline void SetBudget(size_t bytes) { m_Budget = bytes; }
+
+  // on the GL thread once per frame, after the requests
+  void Update();
+
+  // binds 0 until the tail has arrived
+  void Bind(TextureID texture, unsigned int slot = 0) const;
+  inline unsigned int GetRendererID(TextureID texture) const {
+    return m_Textures[texture].Current.ID;
+  }
+  // finest level that can be sampled right now
+  inline unsigned int GetResidentLevel(TextureID texture) const {
+    return m_Textures[texture].Current.UploadedTop;
+  }
+  inline unsigned int GetLevelCount(TextureID texture) const {
+    return m_Textures[texture].Levels;
+  }
+  inline const TextureStreamerStats& GetStats() const { return m_Stats; }
+  void PrintStats() const;
+
+  // level whose texels come closest to one per pixel for a surface
+  // `screenPixels` across showing the texture `uvScale` times
+  unsigned int ComputeLevel(TextureID texture, float screenPixels,
+                            float uvScale = 1.0f) const;
+  // pixels the box spans on screen along its longer side, the full
+  // viewport when it reaches behind the camera
+  static float ProjectedSize(const glm::vec3& min, const glm::vec3& max,
+                             const glm::mat4& viewProjection,
+                             float viewportHeight);
+
+ private:
+  void ApplyBudget();
+  void Stream(Entry& entry);
+  void Upload(Entry& entry, Residency& residency, size_t& budget);
+  void Allocate(Entry& entry, Residency& residency, unsigned int top);
+  void Release(Entry& entry, Residency& residency);
+  size_t GetChainBytes(const Entry& entry, unsigned int top) const;
+};
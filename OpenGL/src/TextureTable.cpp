@@ -0,0 +1,229 @@
+#include "TextureTable.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "DeletionQueue.h"
+#include "GL/glew.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "MipChain.h"
+#include "stb_image/stb_image.h"
+
+const unsigned int TextureTable::kMaxHandles;
+const unsigned int TextureTable::kInitialLayers;
+const unsigned int TextureTable::kHandleBinding;
+
+// the index varies within a draw, so the handle is not dynamically uniform;
+// only NV_gpu_shader5 allows sampling through such a handle
+TextureTable::TextureTable(bool allowBindless)
+    : m_Bindless(allowBindless && GLEW_ARB_bindless_texture &&
+                 GLEW_NV_gpu_shader5),
+      m_MaxLayers(256),
+      m_HandleBuffer(0),
+      m_HandlesDirty(false),
+      m_BindlessBytes(0) {
+  GLint maxLayers = 0;
+  GLCall(glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers));
+  if (maxLayers > 0) m_MaxLayers = (unsigned int)maxLayers;
+  if (m_Bindless) {
+    GLCall(glGenBuffers(1, &m_HandleBuffer));
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_HandleBuffer));
+    GLCall(glBufferData(GL_UNIFORM_BUFFER, kMaxHandles * sizeof(uint64_t),
+                        nullptr, GL_DYNAMIC_DRAW));
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+  }
+}
+
+TextureTable::~TextureTable() {
+  for (const Entry& entry : m_Entries) {
+    if (!entry.Texture) continue;
+    // a resident handle keeps the texture alive, drop it first
+    GLCall(glMakeTextureHandleNonResidentARB(entry.Handle));
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Texture, entry.Texture);
+  }
+  if (m_BindlessBytes)
+    GpuMemory::Get().Free(GpuMemoryCategory::Texture, m_BindlessBytes);
+  for (const Group& group : m_Groups) {
+    if (m_Bindless) continue;
+    GpuMemory::Get().Free(
+        GpuMemoryCategory::Texture,
+        GpuMemory::GetTextureBytes(group.Width, group.Height, GL_RGBA8,
+                                   MipChain::CountLevels(group.Width,
+                                                         group.Height)) *
+            group.Capacity);
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Texture,
+                                group.RendererID);
+  }
+  if (m_HandleBuffer)
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Buffer, m_HandleBuffer);
+}
+
+TextureTable::TextureIndex TextureTable::Add(const std::string& path) {
+  stbi_set_flip_vertically_on_load(1);
+  int width, height, channels;
+  unsigned char* pixels =
+      stbi_load(path.c_str(), &width, &height, &channels, 4);
+  if (!pixels) {
+    std::cout << "[TextureTable] failed to load " << path << std::endl;
+    return ~0u;
+  }
+  TextureIndex texture = Add(pixels, width, height);
+  stbi_image_free(pixels);
+  return texture;
+}
+
+TextureTable::TextureIndex TextureTable::Add(const unsigned char* pixels,
+                                             unsigned int width,
+                                             unsigned int height) {
+  return m_Bindless ? AddBindless(pixels, width, height)
+                    : AddLayer(pixels, width, height);
+}
+
+TextureTable::TextureIndex TextureTable::AddBindless(
+    const unsigned char* pixels, unsigned int width, unsigned int height) {
+  if (m_Handles.size() == kMaxHandles) {
+    std::cout << "[TextureTable] handle table full" << std::endl;
+    return ~0u;
+  }
+  if (m_Groups.empty()) m_Groups.push_back(Group{0, 0, 0, 0, 0, false});
+
+  // parameters have to be final before the handle is taken
+  unsigned int id;
+  GLCall(glGenTextures(1, &id));
+  GLCall(glBindTexture(GL_TEXTURE_2D, id));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                         GL_LINEAR_MIPMAP_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                      GL_UNSIGNED_BYTE, pixels));
+  GLCall(glGenerateMipmap(GL_TEXTURE_2D));
+  GLCall(uint64_t handle = glGetTextureHandleARB(id));
+  GLCall(glMakeTextureHandleResidentARB(handle));
+  size_t bytes = GpuMemory::GetTextureBytes(
+      width, height, GL_RGBA8, MipChain::CountLevels(width, height));
+  GpuMemory::Get().Allocate(GpuMemoryCategory::Texture, bytes);
+  m_BindlessBytes += bytes;
+
+  m_Entries.push_back(Entry{0, (unsigned int)m_Handles.size(), id, handle});
+  m_Handles.push_back(handle);
+  m_HandlesDirty = true;
+  return (TextureIndex)m_Entries.size() - 1;
+}
+
+TextureTable::TextureIndex TextureTable::AddLayer(const unsigned char* pixels,
+                                                  unsigned int width,
+                                                  unsigned int height) {
+  // the array for this size with room left, a new one otherwise
+  unsigned int index = 0;
+  for (; index < m_Groups.size(); index++) {
+    const Group& group = m_Groups[index];
+    if (group.Width == width && group.Height == height &&
+        group.Layers < m_MaxLayers)
+      break;
+  }
+  if (index == m_Groups.size()) {
+    m_Groups.push_back(Group{width, height, 0, 0, 0, false});
+    AllocateArray(m_Groups.back(),
+                  std::min(kInitialLayers, m_MaxLayers));
+  }
+  Group& group = m_Groups[index];
+  if (group.Layers == group.Capacity)
+    AllocateArray(group, std::min(group.Capacity * 2, m_MaxLayers));
+
+  GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, group.RendererID));
+  GLCall(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, group.Layers, width,
+                         height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+  group.Dirty = true;
+  m_Entries.push_back(Entry{index, group.Layers, 0, 0});
+  group.Layers++;
+  return (TextureIndex)m_Entries.size() - 1;
+}
+
+// (re)allocate with room for `capacity` layers, copying the layers so far
+void TextureTable::AllocateArray(Group& group, unsigned int capacity) {
+  unsigned int levels = MipChain::CountLevels(group.Width, group.Height);
+  size_t layerBytes =
+      GpuMemory::GetTextureBytes(group.Width, group.Height, GL_RGBA8, levels);
+  unsigned int id;
+  GLCall(glGenTextures(1, &id));
+  GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, id));
+  GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                         GL_LINEAR_MIPMAP_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER,
+                         GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,
+                         GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,
+                         GL_CLAMP_TO_EDGE));
+  for (unsigned int level = 0; level < levels; level++) {
+    GLCall(glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8,
+                        MipChain::LevelSize(group.Width, level),
+                        MipChain::LevelSize(group.Height, level), capacity, 0,
+                        GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+  }
+  GpuMemory::Get().Allocate(GpuMemoryCategory::Texture,
+                            layerBytes * capacity);
+
+  if (group.RendererID) {
+    // level 0 layer by layer through a read framebuffer, mips follow
+    unsigned int framebuffer;
+    GLCall(glGenFramebuffers(1, &framebuffer));
+    GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer));
+    for (unsigned int layer = 0; layer < group.Layers; layer++) {
+      GLCall(glFramebufferTextureLayer(GL_READ_FRAMEBUFFER,
+                                       GL_COLOR_ATTACHMENT0, group.RendererID,
+                                       0, layer));
+      GLCall(glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 0, 0,
+                                 group.Width, group.Height));
+    }
+    GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, 0));
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Framebuffer,
+                                framebuffer);
+    GpuMemory::Get().Free(GpuMemoryCategory::Texture,
+                          layerBytes * group.Capacity);
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Texture,
+                                group.RendererID);
+    group.Dirty = true;
+  }
+  group.RendererID = id;
+  group.Capacity = capacity;
+}
+
+void TextureTable::Bind(Shader& shader, unsigned int group,
+                        unsigned int slot) {
+  if (m_Bindless) {
+    GLCall(glBindBufferBase(GL_UNIFORM_BUFFER, kHandleBinding,
+                            m_HandleBuffer));
+    if (m_HandlesDirty) {
+      GLCall(glBufferSubData(GL_UNIFORM_BUFFER, 0,
+                             m_Handles.size() * sizeof(uint64_t),
+                             m_Handles.data()));
+      m_HandlesDirty = false;
+    }
+    shader.SetUniformBlockBinding("TextureHandles", kHandleBinding);
+    return;
+  }
+  if (group >= m_Groups.size()) return;
+  Group& target = m_Groups[group];
+  GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+  GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, target.RendererID));
+  if (target.Dirty) {
+    GLCall(glGenerateMipmap(GL_TEXTURE_2D_ARRAY));
+    target.Dirty = false;
+  }
+  shader.SetUniform1i("u_Textures", slot);
+}
+
+void TextureTable::PrintStats() const {
+  std::cout << "[TextureTable] " << m_Entries.size() << " textures, "
+            << (m_Bindless ? "bindless" : "texture arrays") << ", "
+            << GetGroupCount() << " binds per pass";
+  if (!m_Bindless)
+    for (const Group& group : m_Groups)
+      std::cout << ", " << group.Width << "x" << group.Height << " "
+                << group.Layers << "/" << group.Capacity << " layers";
+  std::cout << std::endl;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+// Textures addressed by an index in the vertex or instance data instead of a
+// texture unit, so draws using different textures don't have to be split. With
+// ARB_bindless_texture and NV_gpu_shader5 (for handles that differ within a
+// draw) every texture's handle is made resident and stored in a uniform buffer
+// the TextureTable shader indexes (uniform block "TextureHandles"); all
+// textures are one group. Without them textures of the same size go into layers
+// of a GL_TEXTURE_2D_ARRAY and the TextureArray shader samples the layer; draws
+// only split between groups, i.e. between sizes, and should be sorted by
+// GetGroup(). Both shaders read the index from a float attribute at location 2.
+class TextureTable {
+ public:
+  typedef unsigned int TextureIndex;
+
+  static const unsigned int kMaxHandles = 1024;  // 16 KB of UBO at most
+  static const unsigned int kInitialLayers = 8;
+  static const unsigned int kHandleBinding = 0;  // uniform buffer binding
+
+ private:
+  struct Entry {
+    unsigned int Group;
+    unsigned int Index;    // handle slot or array layer
+    unsigned int Texture;  // bindless only, the array is the group's
+    uint64_t Handle;
+  };
+
+  // same size textures sharing an array, the handle table when bindless
+  struct Group {
+    unsigned int Width, Height;
+    unsigned int RendererID;
+    unsigned int Layers, Capacity;
+    bool Dirty;  // mips are stale
+  };
+
+  bool m_Bindless;
+  std::vector<Entry> m_Entries;
+  std::vector<Group> m_Groups;
+  unsigned int m_MaxLayers;
+  unsigned int m_HandleBuffer;
+  std::vector<uint64_t> m_Handles;
+  bool m_HandlesDirty;
+  size_t m_BindlessBytes;
+
+ public:
+  // allowBindless = false forces the texture array path
+  explicit TextureTable(bool allowBindless = true);
+  ~TextureTable();
+  TextureTable(const TextureTable&) = delete;
+  TextureTable& operator=(const TextureTable&) = delete;
+
+  // ~0u when the file can't be read or the table is full
+  TextureIndex Add(const std::string& path);
+  // 8 bit RGBA, rows bottom up
+  TextureIndex Add(const unsigned char* pixels, unsigned int width,
+                   unsigned int height);
+
+  inline bool IsBindless() const { return m_Bindless; }
+  inline const char* GetShaderPath() const {
+    return m_Bindless ? "res/shaders/TextureTable.shader"
+                      : "res/shaders/TextureArray.shader";
+  }
+  // draws of one group need no rebinding in between
+  inline unsigned int GetGroupCount() const {
+    return m_Bindless ? 1 : (unsigned int)m_Groups.size();
+  }
+  inline unsigned int GetGroup(TextureIndex texture) const {
+    return m_Entries[texture].Group;
+  }
+  // the value of the texture index attribute
+  inline float GetShaderIndex(TextureIndex texture) const {
+    return (float)m_Entries[texture].Index;
+  }
+
+  // bindless: the handle buffer, group is ignored; otherwise the group's
+  // array at `slot`
+  void Bind(Shader& shader, unsigned int group = 0, unsigned int slot = 0);
+  void PrintStats() const;
+
+ private:
+  TextureIndex AddBindless(const unsigned char* pixels, unsigned int width,
+                           unsigned int height);
+  TextureIndex AddLayer(const unsigned char* pixels, unsigned int width,
+                        unsigned int height);
+  void AllocateArray(Group& group, unsigned int capacity);
+};
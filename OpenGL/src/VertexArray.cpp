@@ -1,23 +1,44 @@
 #include "VertexArray.h"
 
+#include <utility>
+
+#include "DeletionQueue.h"
 #include "GL/glew.h"
 #include "IndexBuffer.h"
 #include "Log.h"
 
 VertexArray::VertexArray() { GLCall(glGenVertexArrays(1, &m_RendererID)); }
 
-VertexArray::~VertexArray() { GLCall(glDeleteVertexArrays(1, &m_RendererID)); }
+VertexArray::~VertexArray() {
+  DeletionQueue::Get().Delete(DeletionQueue::Type::VertexArray, m_RendererID);
+}
+
+VertexArray::VertexArray(VertexArray&& other) noexcept
+    : m_RendererID(other.m_RendererID) {
+  other.m_RendererID = 0;
+}
+
+VertexArray& VertexArray::operator=(VertexArray&& other) noexcept {
+  std::swap(m_RendererID, other.m_RendererID);
+  return *this;
+}
 
 void VertexArray::AddBuffer(const VertexBuffer& vb, const IndexBuffer& ib,
                             const VertexBufferLayout& layout) {
+  AddBuffer(vb, layout, 0);
+  ib.Bind();
+}
+
+void VertexArray::AddBuffer(const VertexBuffer& vb,
+                            const VertexBufferLayout& layout,
+                            unsigned int firstLocation) {
   Bind();
   vb.Bind();
-  ib.Bind();
 
   const auto& elements = layout.GetElements();
-  unsigned int offset = 0;
   for (unsigned int i = 0; i < elements.size(); i++) {
-    GLCall(glEnableVertexAttribArray(i));
+    unsigned int location = firstLocation + i;
+    GLCall(glEnableVertexAttribArray(location));
     // index: index of this attribute
     // size: the number of components of this attribute
     // stride: byte offset between two attributes
@@ -27,14 +48,18 @@ void VertexArray::AddBuffer(const VertexBuffer& vb, const IndexBuffer& ib,
     // ʾԵһֵ͵ڶֵ֮ļ 0
     // ʾԵһֵݣpositionsеλ
     // Ҳʹ VBO  VAO 
-    GLCall(glVertexAttribPointer(i, elements[i].count, elements[i].type,
-                                 elements[i].normalized, layout.GetStride(),
-                                 (const void*)offset));
-    offset += elements[i].count *
-              VertexBufferElement::GetSizeOfType(elements[i].type);
+    GLCall(glVertexAttribPointer(location, elements[i].count,
+                                 elements[i].type, elements[i].normalized,
+                                 layout.GetStride(),
+                                 (const void*)(size_t)elements[i].offset));
   }
 }
 
+void VertexArray::SetIndexBuffer(const IndexBuffer& ib) {
+  Bind();
+  ib.Bind();
+}
+
 void VertexArray::Bind() const { GLCall(glBindVertexArray(m_RendererID)); }
 
 void VertexArray::Unbind() const { GLCall(glBindVertexArray(0)); }
@@ -10,10 +10,21 @@ class VertexArray {
  public:
   VertexArray();
   ~VertexArray();
+  VertexArray(const VertexArray&) = delete;
+  VertexArray& operator=(const VertexArray&) = delete;
+  VertexArray(VertexArray&& other) noexcept;
+  VertexArray& operator=(VertexArray&& other) noexcept;
 
   void AddBuffer(const VertexBuffer& vb, const IndexBuffer& ib,
                  const VertexBufferLayout& layout);
+  // attach the elements of `layout` to consecutive attribute locations
+  // starting at firstLocation, so several buffers can feed one VAO
+  void AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& layout,
+                 unsigned int firstLocation);
+  void SetIndexBuffer(const IndexBuffer& ib);
 
   void Bind() const;
   void Unbind() const;
+
+  inline unsigned int GetRendererID() const { return m_RendererID; }
 };
\ No newline at end of file
@@ -1,15 +1,47 @@
 #include "VertexBuffer.h"
 
+#include <utility>
+
+#include "DeletionQueue.h"
 #include "GL/glew.h"
+#include "GpuMemory.h"
 #include "Log.h"
 
-VertexBuffer::VertexBuffer(const void* data, unsigned int size) {
+VertexBuffer::VertexBuffer(const void* data, unsigned int size)
+    : m_Size(size) {
+  GpuMemory::Get().Allocate(GpuMemoryCategory::VertexBuffer, size);
+  // a retired buffer of the same size only needs new contents
+  m_RendererID = DeletionQueue::Get().AcquireBuffer(size);
+  if (m_RendererID) {
+    GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_RendererID));
+    if (data) {
+      GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, size, data));
+    }
+    return;
+  }
   GLCall(glGenBuffers(1, &m_RendererID));
   GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_RendererID));
   GLCall(glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW));
 }
 
-VertexBuffer::~VertexBuffer() { GLCall(glDeleteBuffers(1, &m_RendererID)); }
+// the GPU may still be reading it, the queue deletes it once it is done
+VertexBuffer::~VertexBuffer() {
+  if (m_RendererID)
+    GpuMemory::Get().Free(GpuMemoryCategory::VertexBuffer, m_Size);
+  DeletionQueue::Get().DeleteBuffer(m_RendererID, m_Size);
+}
+
+VertexBuffer::VertexBuffer(VertexBuffer&& other) noexcept
+    : m_RendererID(other.m_RendererID), m_Size(other.m_Size) {
+  other.m_RendererID = 0;
+}
+
+VertexBuffer& VertexBuffer::operator=(VertexBuffer&& other) noexcept {
+  // other deletes what we held
+  std::swap(m_RendererID, other.m_RendererID);
+  std::swap(m_Size, other.m_Size);
+  return *this;
+}
 
 void VertexBuffer::Bind() const {
   GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_RendererID));
@@ -3,12 +3,21 @@
 class VertexBuffer {
  private:
   unsigned int m_RendererID;
+  unsigned int m_Size;
 
  public:
   VertexBuffer(const void* data, unsigned int size);
 
   ~VertexBuffer();
+  // owns the GL buffer, so it moves but never copies
+  VertexBuffer(const VertexBuffer&) = delete;
+  VertexBuffer& operator=(const VertexBuffer&) = delete;
+  VertexBuffer(VertexBuffer&& other) noexcept;
+  VertexBuffer& operator=(VertexBuffer&& other) noexcept;
 
   void Bind() const;
   void Unbind() const;
+
+  inline unsigned int GetRendererID() const { return m_RendererID; }
+  inline unsigned int GetSize() const { return m_Size; }
 };
\ No newline at end of file
@@ -8,6 +8,7 @@ struct VertexBufferElement {
   unsigned int type;
   unsigned int count;
   unsigned char normalized;
+  unsigned int offset;  // byte offset inside one vertex
 
   static unsigned int GetSizeOfType(unsigned int type) {
     switch (type) {
@@ -17,7 +18,12 @@ struct VertexBufferElement {
       case GL_UNSIGNED_INT:
         return 4;
         break;
+      case GL_UNSIGNED_SHORT:
+      case GL_SHORT:
+        return 2;
+        break;
       case GL_UNSIGNED_BYTE:
+      case GL_BYTE:
         return 1;
         break;
     }
@@ -39,22 +45,35 @@ class VertexBufferLayout {
 
   template <>
   void Push<float>(unsigned int count) {
-    m_Elements.push_back({GL_FLOAT, count, GL_FALSE});
+    m_Elements.push_back({GL_FLOAT, count, GL_FALSE, m_Stride});
     m_Stride += VertexBufferElement::GetSizeOfType(GL_FLOAT) * count;
   }
 
   template <>
   void Push<unsigned int>(unsigned int count) {
-    m_Elements.push_back({GL_UNSIGNED_INT, count, GL_FALSE});
+    m_Elements.push_back({GL_UNSIGNED_INT, count, GL_FALSE, m_Stride});
     m_Stride += VertexBufferElement::GetSizeOfType(GL_UNSIGNED_INT) * count;
   }
 
   template <>
   void Push<unsigned char>(unsigned int count) {
-    m_Elements.push_back({GL_UNSIGNED_BYTE, count, GL_TRUE});
+    m_Elements.push_back({GL_UNSIGNED_BYTE, count, GL_TRUE, m_Stride});
     m_Stride += VertexBufferElement::GetSizeOfType(GL_UNSIGNED_BYTE) * count;
   }
 
+  // element at an explicit byte offset, for data laid out by someone else
+  // (e.g. glTF accessors); the stride grows to cover it unless set with
+  // SetStride
+  void Push(unsigned int type, unsigned int count, unsigned char normalized,
+            unsigned int offset) {
+    m_Elements.push_back({type, count, normalized, offset});
+    unsigned int end =
+        offset + VertexBufferElement::GetSizeOfType(type) * count;
+    if (end > m_Stride) m_Stride = end;
+  }
+
+  inline void SetStride(unsigned int stride) { m_Stride = stride; }
+
   inline std::vector<VertexBufferElement> GetElements() const {
     return m_Elements;
   }
@@ -0,0 +1,612 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "DeletionQueue.h"
+#include "FrameAllocator.h"
+#include "GL/glew.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "MipChain.h"
+#include "VirtualTextureFile.h"
+#include "stb_image/stb_image.h"
+
+const unsigned int VirtualTexture::kPageSize;
+const unsigned int VirtualTexture::kBorder;
+const unsigned int VirtualTexture::kFeedbackDivisor;
+const unsigned int VirtualTexture::kUploadsPerFrame;
+const unsigned int VirtualTexture::kMaxLoading;
+const unsigned int VirtualTexture::kPagesPerJob;
+const uint64_t VirtualTexture::kNoPage;
+
+namespace {
+
+unsigned int NextPowerOfTwo(unsigned int value) {
+  unsigned int result = 1;
+  while (result < value) result *= 2;
+  return result;
+}
+
+// the level table Build() writes for a width x height image, down to the
+// level that fits in a single page
+std::vector<VirtualTextureFileLevel> MakeLevels(unsigned int width,
+                                                unsigned int height,
+                                                unsigned int pageSize,
+                                                uint64_t& pageCount) {
+  std::vector<VirtualTextureFileLevel> levels;
+  pageCount = 0;
+  for (unsigned int level = 0;; level++) {
+    unsigned int lw = MipChain::LevelSize(width, level);
+    unsigned int lh = MipChain::LevelSize(height, level);
+    VirtualTextureFileLevel info = {(lw - 1) / pageSize + 1,
+                                    (lh - 1) / pageSize + 1,
+                                    (uint32_t)pageCount, 0};
+    levels.push_back(info);
+    pageCount += (uint64_t)info.PagesX * info.PagesY;
+    if (lw <= pageSize && lh <= pageSize) break;
+  }
+  return levels;
+}
+
+}  // namespace
+
+VirtualTexture::VirtualTexture(const std::string& path,
+                               unsigned int cachePages)
+    : m_Path(path),
+      m_Width(0),
+      m_Height(0),
+      m_PageSize(0),
+      m_Border(0),
+      m_PhysicalPageSize(0),
+      m_PageOffset(0),
+      m_PageBytes(0),
+      m_CacheTexture(0),
+      m_CachePages(0),
+      m_IndirectionTexture(0),
+      m_IndirectionWidth(0),
+      m_IndirectionHeight(0),
+      m_IndirectionDirty(true),
+      m_ReadbackBuffers(),
+      m_ReadbackWidth(),
+      m_ReadbackHeight(),
+      m_ViewportWidth(0),
+      m_ViewportHeight(0),
+      m_Frame(0),
+      m_Stats() {
+  std::ifstream stream(path, std::ios::binary);
+  VirtualTextureFileHeader header;
+  if (!stream.read((char*)&header, sizeof(header)) ||
+      std::memcmp(header.Magic, kVirtualTextureMagic, 4) != 0 ||
+      header.Version != kVirtualTextureVersion || header.Width == 0 ||
+      header.Height == 0 || header.PageSize == 0) {
+    std::cout << "[VirtualTexture] not a virtual texture: " << path
+              << std::endl;
+    return;
+  }
+  // the table has to be the one Build() writes for this size, pages are
+  // looked up from it without further checks
+  uint64_t pageCount = 0;
+  std::vector<VirtualTextureFileLevel> expected =
+      MakeLevels(header.Width, header.Height, header.PageSize, pageCount);
+  std::vector<VirtualTextureFileLevel> levels(expected.size());
+  if (header.LevelCount != levels.size() ||
+      !stream.read((char*)levels.data(),
+                   levels.size() * sizeof(VirtualTextureFileLevel))) {
+    std::cout << "[VirtualTexture] bad level table: " << path << std::endl;
+    return;
+  }
+  for (unsigned int i = 0; i < levels.size(); i++) {
+    if (levels[i].PagesX != expected[i].PagesX ||
+        levels[i].PagesY != expected[i].PagesY ||
+        levels[i].FirstPage != expected[i].FirstPage) {
+      std::cout << "[VirtualTexture] level " << i << " doesn't match a "
+                << header.Width << "x" << header.Height
+                << " image: " << path << std::endl;
+      return;
+    }
+  }
+  // pages are uploaded as physical x physical RGBA8, nothing else fits
+  uint64_t physical = (uint64_t)header.PageSize + 2 * (uint64_t)header.Border;
+  if (header.PageBytes != physical * physical * 4) {
+    std::cout << "[VirtualTexture] page size " << physical << " doesn't match "
+              << header.PageBytes << " bytes per page: " << path << std::endl;
+    return;
+  }
+  // every page inside the file, so a read never runs off its end
+  stream.seekg(0, std::ios::end);
+  uint64_t fileSize = (uint64_t)(std::streamoff)stream.tellg();
+  uint64_t tableEnd =
+      sizeof(header) + levels.size() * sizeof(VirtualTextureFileLevel);
+  if (header.PageOffset < tableEnd || header.PageOffset > fileSize ||
+      pageCount > (fileSize - header.PageOffset) / header.PageBytes) {
+    std::cout << "[VirtualTexture] " << pageCount << " pages don't fit in "
+              << fileSize << " bytes: " << path << std::endl;
+    return;
+  }
+  m_Width = header.Width;
+  m_Height = header.Height;
+  m_PageSize = header.PageSize;
+  m_Border = header.Border;
+  m_PhysicalPageSize = m_PageSize + 2 * m_Border;
+  m_PageOffset = header.PageOffset;
+  m_PageBytes = header.PageBytes;
+
+  // page cache, slot coordinates have to fit the indirection's 8 bits
+  GLint maxSize = 0;
+  GLCall(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize));
+  m_CachePages = std::min(cachePages, 255u);
+  if (maxSize > 0)
+    m_CachePages =
+        std::min(m_CachePages, (unsigned int)maxSize / m_PhysicalPageSize);
+  m_CachePages = std::max(m_CachePages, 2u);
+  m_Slots.assign(m_CachePages * m_CachePages, Slot{kNoPage, 0, false});
+  unsigned int cacheSize = m_CachePages * m_PhysicalPageSize;
+  GLCall(glGenTextures(1, &m_CacheTexture));
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_CacheTexture));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+  GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSize, cacheSize, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+
+  // indirection, power of two so level n has room for the pages of level n
+  m_Levels.resize(levels.size());
+  for (unsigned int i = 0; i < levels.size(); i++)
+    m_Levels[i] = Level{levels[i].PagesX, levels[i].PagesY,
+                        levels[i].FirstPage};
+  m_IndirectionWidth = NextPowerOfTwo(m_Levels[0].PagesX);
+  m_IndirectionHeight = NextPowerOfTwo(m_Levels[0].PagesY);
+  m_Indirection.resize(m_Levels.size());
+  GLCall(glGenTextures(1, &m_IndirectionTexture));
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_IndirectionTexture));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                         GL_NEAREST_MIPMAP_NEAREST));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+  GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                         (GLint)m_Levels.size() - 1));
+  for (unsigned int level = 0; level < m_Levels.size(); level++) {
+    unsigned int w = MipChain::LevelSize(m_IndirectionWidth, level);
+    unsigned int h = MipChain::LevelSize(m_IndirectionHeight, level);
+    m_Indirection[level].assign((size_t)w * h * 4, 0);
+    GLCall(glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, w, h, 0, GL_RGBA,
+                        GL_UNSIGNED_BYTE, nullptr));
+  }
+  m_Stats.CacheBytes =
+      GpuMemory::GetTextureBytes(cacheSize, cacheSize, GL_RGBA8) +
+      GpuMemory::GetTextureBytes(m_IndirectionWidth, m_IndirectionHeight,
+                                 GL_RGBA8, (unsigned int)m_Levels.size());
+  GpuMemory::Get().Allocate(GpuMemoryCategory::Texture, m_Stats.CacheBytes);
+
+  // the coarsest level is one page, pinned as the fallback for all others
+  LoadedPage top{PageKey((unsigned int)m_Levels.size() - 1, 0, 0), {}};
+  if (!ReadPage(stream, top.Page, top.Pixels))
+    std::cout << "[VirtualTexture] failed to read the top page of " << path
+              << std::endl;
+  m_Uploads.push_back(std::move(top));
+  UploadPages();
+  m_Slots[m_Resident.begin()->second].Pinned = true;
+  UpdateIndirection();
+}
+
+VirtualTexture::~VirtualTexture() {
+  JobSystem::Get().Wait(m_Jobs);
+  if (m_CacheTexture) {
+    unsigned int cacheSize = m_CachePages * m_PhysicalPageSize;
+    GpuMemory::Get().Free(GpuMemoryCategory::Texture, m_Stats.CacheBytes);
+    DeletionQueue::Get().DeleteTexture(m_CacheTexture, cacheSize, cacheSize,
+                                       GL_RGBA8);
+  }
+  if (m_IndirectionTexture)
+    DeletionQueue::Get().Delete(DeletionQueue::Type::Texture,
+                                m_IndirectionTexture);
+  for (unsigned int i = 0; i < 2; i++)
+    if (m_ReadbackBuffers[i])
+      DeletionQueue::Get().Delete(DeletionQueue::Type::Buffer,
+                                  m_ReadbackBuffers[i]);
+}
+
+unsigned int VirtualTexture::GetFeedbackSize(unsigned int viewportSize) {
+  return std::max(1u, viewportSize / kFeedbackDivisor);
+}
+
+void VirtualTexture::BeginFeedback(unsigned int width, unsigned int height) {
+  m_ViewportWidth = width;
+  m_ViewportHeight = height;
+  unsigned int w = GetFeedbackSize(width), h = GetFeedbackSize(height);
+  if (!m_Feedback) {
+    FramebufferSpec spec;
+    spec.Width = w;
+    spec.Height = h;
+    spec.ColorFormats = {GL_RGBA16UI};
+    spec.DepthFormat = GL_DEPTH_COMPONENT24;
+    m_Feedback.reset(new Framebuffer(spec));
+  } else {
+    m_Feedback->Resize(w, h);
+  }
+  m_Feedback->Bind();
+  ClearFeedback();
+}
+
+void VirtualTexture::ClearFeedback() const {
+  // alpha 0 marks pixels that sample no page
+  const GLuint none[4] = {0, 0, 0, 0};
+  GLCall(glClearBufferuiv(GL_COLOR, 0, none));
+  GLCall(glClear(GL_DEPTH_BUFFER_BIT));
+}
+
+void VirtualTexture::SetFeedbackUniforms(Shader& shader) const {
+  // the target is kFeedbackDivisor times smaller, its derivatives as much
+  // larger
+  SetUniforms(shader, -std::log2((float)kFeedbackDivisor));
+}
+
+void VirtualTexture::EndFeedback(FrameArena& arena) {
+  ReadFeedback(m_Feedback->GetSpec().Width, m_Feedback->GetSpec().Height,
+               arena);
+  m_Feedback->Unbind();
+  GLCall(glViewport(0, 0, m_ViewportWidth, m_ViewportHeight));
+}
+
+void VirtualTexture::ReadFeedback(unsigned int w, unsigned int h,
+                                  FrameArena& arena) {
+  unsigned int write = m_Frame & 1, read = write ^ 1;
+  if (!m_ReadbackBuffers[write]) {
+    GLCall(glGenBuffers(1, &m_ReadbackBuffers[write]));
+  }
+  GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, m_ReadbackBuffers[write]));
+  if (m_ReadbackWidth[write] != w || m_ReadbackHeight[write] != h) {
+    GLCall(glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)w * h * 8, nullptr,
+                        GL_STREAM_READ));
+    m_ReadbackWidth[write] = w;
+    m_ReadbackHeight[write] = h;
+  }
+  GLCall(glReadBuffer(GL_COLOR_ATTACHMENT0));
+  GLCall(glReadPixels(0, 0, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT,
+                      nullptr));
+
+  // last frame's copy has had a frame to finish
+  if (m_ReadbackBuffers[read]) {
+    unsigned int count = m_ReadbackWidth[read] * m_ReadbackHeight[read];
+    GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, m_ReadbackBuffers[read]));
+    const uint16_t* texels = (const uint16_t*)glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)count * 8, GL_MAP_READ_BIT);
+    if (texels) {
+      ProcessFeedback(texels, count, arena);
+      GLCall(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+    }
+  }
+  GLCall(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+}
+
+void VirtualTexture::ProcessFeedback(const uint16_t* texels,
+                                     unsigned int count, FrameArena& arena) {
+  if (!IsValid()) return;
+  // one entry per feedback texel before the dedup, rebuilt every frame
+  FrameVector<uint64_t> pages{FrameStlAllocator<uint64_t>(arena)};
+  pages.reserve(count);
+  unsigned int levelCount = (unsigned int)m_Levels.size();
+  for (unsigned int i = 0; i < count; i++) {
+    const uint16_t* texel = texels + i * 4;
+    if (!texel[3]) continue;
+    unsigned int level = std::min((unsigned int)texel[2], levelCount - 1);
+    const Level& info = m_Levels[level];
+    pages.push_back(PageKey(level, std::min((unsigned int)texel[0],
+                                            info.PagesX - 1),
+                            std::min((unsigned int)texel[1],
+                                     info.PagesY - 1)));
+  }
+  std::sort(pages.begin(), pages.end());
+  pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+  m_Stats.Requested = (unsigned int)pages.size();
+  m_Stats.Missing = 0;
+  for (uint64_t page : pages) m_Stats.Missing += !m_Resident.count(page);
+
+  // the pages above a wanted one are its fallback while it loads
+  size_t requested = pages.size();
+  for (size_t i = 0; i < requested; i++) {
+    uint64_t page = pages[i];
+    for (unsigned int level = PageLevel(page) + 1; level < levelCount;
+         level++) {
+      const Level& info = m_Levels[level];
+      page = PageKey(level, std::min(PageX(page) / 2, info.PagesX - 1),
+                     std::min(PageY(page) / 2, info.PagesY - 1));
+      pages.push_back(page);
+    }
+  }
+  std::sort(pages.begin(), pages.end());
+  pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+  m_Wanted.clear();
+  for (uint64_t page : pages) {
+    auto resident = m_Resident.find(page);
+    if (resident != m_Resident.end())
+      m_Slots[resident->second].LastUsed = m_Frame;
+    else
+      m_Wanted.push_back(page);
+  }
+  // coarse pages first, they cover the most screen
+  std::stable_sort(m_Wanted.begin(), m_Wanted.end(),
+                   [](uint64_t a, uint64_t b) {
+                     return PageLevel(a) > PageLevel(b);
+                   });
+}
+
+void VirtualTexture::Update() {
+  if (!IsValid()) return;
+  m_Stats.Uploaded = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_LoadedMutex);
+    for (LoadedPage& page : m_Loaded) m_Uploads.push_back(std::move(page));
+    m_Loaded.clear();
+  }
+  UploadPages();
+  Dispatch();
+  if (m_IndirectionDirty) UpdateIndirection();
+
+  m_Stats.Resident = (unsigned int)m_Resident.size();
+  m_Stats.Loading = (unsigned int)m_Loading.size();
+  m_Frame++;
+}
+
+void VirtualTexture::Dispatch() {
+  // reads stay bounded however much the feedback asks for
+  std::vector<uint64_t> batch;
+  std::vector<std::vector<uint64_t>> batches;
+  for (uint64_t page : m_Wanted) {
+    if (m_Loading.size() >= kMaxLoading) break;
+    if (m_Resident.count(page) || m_Loading.count(page)) continue;
+    m_Loading.insert(page);
+    batch.push_back(page);
+    if (batch.size() == kPagesPerJob) {
+      batches.push_back(std::move(batch));
+      batch.clear();
+    }
+  }
+  if (!batch.empty()) batches.push_back(std::move(batch));
+  m_Wanted.clear();
+
+  // a single worker is this thread, which only runs jobs while waiting
+  JobSystem& jobs = JobSystem::Get();
+  for (std::vector<uint64_t>& pages : batches) {
+    auto work = [this, pages]() {
+      std::ifstream stream(m_Path, std::ios::binary);
+      std::vector<LoadedPage> loaded(pages.size());
+      for (size_t i = 0; i < pages.size(); i++) {
+        loaded[i].Page = pages[i];
+        if (!ReadPage(stream, pages[i], loaded[i].Pixels))
+          std::cout << "[VirtualTexture] failed to read a page of " << m_Path
+                    << std::endl;
+      }
+      std::lock_guard<std::mutex> lock(m_LoadedMutex);
+      for (LoadedPage& page : loaded) m_Loaded.push_back(std::move(page));
+    };
+    if (jobs.GetWorkerCount() > 1) {
+      jobs.Run(work, &m_Jobs);
+    } else {
+      work();
+      break;
+    }
+  }
+  // pages of batches a single worker didn't get to are wanted again
+  if (jobs.GetWorkerCount() <= 1)
+    for (size_t i = 1; i < batches.size(); i++)
+      for (uint64_t page : batches[i]) m_Loading.erase(page);
+}
+
+// a black page when the file is broken, so it isn't asked for forever
+bool VirtualTexture::ReadPage(std::ifstream& stream, uint64_t page,
+                              std::vector<unsigned char>& pixels) const {
+  pixels.resize((size_t)m_PageBytes);
+  const Level& level = m_Levels[PageLevel(page)];
+  uint64_t index =
+      level.FirstPage + (uint64_t)PageY(page) * level.PagesX + PageX(page);
+  stream.clear();
+  stream.seekg((std::streamoff)(m_PageOffset + index * m_PageBytes));
+  if (!stream.read((char*)pixels.data(), (std::streamsize)m_PageBytes)) {
+    std::fill(pixels.begin(), pixels.end(), (unsigned char)0);
+    return false;
+  }
+  return true;
+}
+
+void VirtualTexture::UploadPages() {
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_CacheTexture));
+  unsigned int uploaded = 0;
+  for (; uploaded < m_Uploads.size() && uploaded < kUploadsPerFrame;
+       uploaded++) {
+    LoadedPage& page = m_Uploads[uploaded];
+    m_Loading.erase(page.Page);
+    if (m_Resident.count(page.Page)) continue;
+    unsigned int slot = AllocateSlot();
+    // everything is on screen this frame, it'll be asked for again
+    if (slot == ~0u) continue;
+    m_Slots[slot] = Slot{page.Page, m_Frame, false};
+    m_Resident[page.Page] = slot;
+    unsigned int x = slot % m_CachePages, y = slot / m_CachePages;
+    GLCall(glTexSubImage2D(GL_TEXTURE_2D, 0, x * m_PhysicalPageSize,
+                           y * m_PhysicalPageSize, m_PhysicalPageSize,
+                           m_PhysicalPageSize, GL_RGBA, GL_UNSIGNED_BYTE,
+                           page.Pixels.data()));
+    m_Stats.Uploaded++;
+    m_IndirectionDirty = true;
+  }
+  m_Uploads.erase(m_Uploads.begin(), m_Uploads.begin() + uploaded);
+}
+
+// a free slot, else the least recently used page not seen this frame
+unsigned int VirtualTexture::AllocateSlot() {
+  unsigned int victim = ~0u;
+  for (unsigned int i = 0; i < m_Slots.size(); i++) {
+    const Slot& slot = m_Slots[i];
+    if (slot.Page == kNoPage) return i;
+    if (slot.Pinned || slot.LastUsed == m_Frame) continue;
+    if (victim == ~0u || slot.LastUsed < m_Slots[victim].LastUsed) victim = i;
+  }
+  if (victim != ~0u) {
+    m_Resident.erase(m_Slots[victim].Page);
+    m_Slots[victim].Page = kNoPage;
+    m_Stats.Evicted++;
+  }
+  return victim;
+}
+
+// coarse to fine, a page that isn't resident inherits its parent's entry
+void VirtualTexture::UpdateIndirection() {
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_IndirectionTexture));
+  for (unsigned int level = (unsigned int)m_Levels.size(); level-- > 0;) {
+    const Level& info = m_Levels[level];
+    unsigned int width = MipChain::LevelSize(m_IndirectionWidth, level);
+    unsigned int parentWidth =
+        MipChain::LevelSize(m_IndirectionWidth, level + 1);
+    std::vector<unsigned char>& entries = m_Indirection[level];
+    for (unsigned int y = 0; y < info.PagesY; y++) {
+      for (unsigned int x = 0; x < info.PagesX; x++) {
+        unsigned char* entry = &entries[((size_t)y * width + x) * 4];
+        auto resident = m_Resident.find(PageKey(level, x, y));
+        if (resident != m_Resident.end()) {
+          entry[0] = (unsigned char)(resident->second % m_CachePages);
+          entry[1] = (unsigned char)(resident->second / m_CachePages);
+          entry[2] = (unsigned char)level;
+          entry[3] = 255;
+        } else if (level + 1 < m_Levels.size()) {
+          // an odd sized level's last page folds into the parent's last
+          const Level& parentInfo = m_Levels[level + 1];
+          unsigned int parentX = std::min(x / 2, parentInfo.PagesX - 1);
+          unsigned int parentY = std::min(y / 2, parentInfo.PagesY - 1);
+          std::memcpy(entry,
+                      &m_Indirection[level + 1]
+                                    [((size_t)parentY * parentWidth +
+                                      parentX) * 4],
+                      4);
+        }
+      }
+    }
+    GLCall(glTexSubImage2D(
+        GL_TEXTURE_2D, level, 0, 0, width,
+        MipChain::LevelSize(m_IndirectionHeight, level), GL_RGBA,
+        GL_UNSIGNED_BYTE, entries.data()));
+  }
+  m_IndirectionDirty = false;
+}
+
+void VirtualTexture::SetUniforms(Shader& shader, float lodBias) const {
+  shader.SetUniform4f("u_VirtualSize", (float)m_Width, (float)m_Height,
+                      (float)m_PageSize, (float)(m_Levels.size() - 1));
+  shader.SetUniform4f("u_CacheParams", (float)m_Border,
+                      (float)m_PhysicalPageSize,
+                      (float)(m_CachePages * m_PhysicalPageSize), lodBias);
+}
+
+void VirtualTexture::Bind(Shader& shader, unsigned int slot) const {
+  GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_IndirectionTexture));
+  GLCall(glActiveTexture(GL_TEXTURE0 + slot + 1));
+  GLCall(glBindTexture(GL_TEXTURE_2D, m_CacheTexture));
+  shader.SetUniform1i("u_Indirection", slot);
+  shader.SetUniform1i("u_Cache", slot + 1);
+  SetUniforms(shader, 0.0f);
+}
+
+void VirtualTexture::PrintStats() const {
+  std::cout << "[VirtualTexture] " << m_Path << " " << m_Width << "x"
+            << m_Height << ", " << m_Levels.size() << " levels, pages "
+            << m_Stats.Resident << " / " << m_Slots.size()
+            << " resident, last feedback " << m_Stats.Requested
+            << " requested " << m_Stats.Missing << " missing, "
+            << m_Stats.Evicted << " evicted, GPU "
+            << m_Stats.CacheBytes / 1024 << " KB" << std::endl;
+}
+
+bool VirtualTexture::Build(const std::string& source,
+                           const std::string& destination,
+                           unsigned int pageSize, unsigned int border) {
+  stbi_set_flip_vertically_on_load(1);
+  int w, h, channels;
+  unsigned char* data = stbi_load(source.c_str(), &w, &h, &channels, 4);
+  if (!data || pageSize == 0) {
+    std::cout << "[VirtualTexture] failed to load " << source << std::endl;
+    if (data) stbi_image_free(data);
+    return false;
+  }
+  unsigned int width = (unsigned int)w, height = (unsigned int)h;
+
+  uint64_t pageCount = 0;
+  std::vector<VirtualTextureFileLevel> levels =
+      MakeLevels(width, height, pageSize, pageCount);
+
+  unsigned int physical = pageSize + 2 * border;
+  VirtualTextureFileHeader header = {};
+  std::memcpy(header.Magic, kVirtualTextureMagic, 4);
+  header.Version = kVirtualTextureVersion;
+  header.Width = width;
+  header.Height = height;
+  header.PageSize = pageSize;
+  header.Border = border;
+  header.LevelCount = (uint32_t)levels.size();
+  uint64_t tableEnd = sizeof(header) +
+                      levels.size() * sizeof(VirtualTextureFileLevel);
+  header.PageOffset = (tableEnd + kVirtualTextureAlignment - 1) /
+                      kVirtualTextureAlignment * kVirtualTextureAlignment;
+  header.PageBytes = (uint64_t)physical * physical * 4;
+
+  std::ofstream stream(destination, std::ios::binary);
+  if (!stream) {
+    std::cout << "[VirtualTexture] can't write " << destination << std::endl;
+    stbi_image_free(data);
+    return false;
+  }
+  stream.write((const char*)&header, sizeof(header));
+  stream.write((const char*)levels.data(),
+               levels.size() * sizeof(VirtualTextureFileLevel));
+  const char zeros[kVirtualTextureAlignment] = {};
+  stream.write(zeros, (std::streamsize)(header.PageOffset - tableEnd));
+
+  std::vector<unsigned char> page((size_t)header.PageBytes);
+  std::vector<unsigned char> scratch[2];
+  const unsigned char* pixels = data;
+  for (unsigned int level = 0; level < levels.size(); level++) {
+    int lw = (int)MipChain::LevelSize(width, level);
+    int lh = (int)MipChain::LevelSize(height, level);
+    for (unsigned int py = 0; py < levels[level].PagesY; py++) {
+      for (unsigned int px = 0; px < levels[level].PagesX; px++) {
+        // the border and the part past the image repeat the edge texels
+        int originX = (int)(px * pageSize) - (int)border;
+        int originY = (int)(py * pageSize) - (int)border;
+        for (unsigned int y = 0; y < physical; y++) {
+          int sy = std::min(std::max(originY + (int)y, 0), lh - 1);
+          for (unsigned int x = 0; x < physical; x++) {
+            int sx = std::min(std::max(originX + (int)x, 0), lw - 1);
+            std::memcpy(&page[((size_t)y * physical + x) * 4],
+                        &pixels[((size_t)sy * lw + sx) * 4], 4);
+          }
+        }
+        stream.write((const char*)page.data(), page.size());
+      }
+    }
+    if (level + 1 == levels.size()) break;
+    std::vector<unsigned char>& next = scratch[level & 1];
+    next.resize((size_t)MipChain::LevelSize(width, level + 1) *
+                MipChain::LevelSize(height, level + 1) * 4);
+    MipChain::Downsample(pixels, lw, lh, next.data());
+    pixels = next.data();
+  }
+  stbi_image_free(data);
+
+  if (!stream) {
+    std::cout << "[VirtualTexture] failed writing " << destination
+              << std::endl;
+    return false;
+  }
+  std::cout << "[VirtualTexture] " << source << " " << width << "x" << height
+            << " -> " << destination << ": " << levels.size() << " levels, "
+            << pageCount << " pages of " << physical << "x" << physical
+            << ", " << (header.PageOffset + pageCount * header.PageBytes) /
+                           (1024 * 1024)
+            << " MB" << std::endl;
+  return true;
+}
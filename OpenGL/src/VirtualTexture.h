@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Framebuffer.h"
+#include "JobSystem.h"
+#include "Shader.h"
+
+class FrameArena;
+
+struct VirtualTextureStats {
+  unsigned int Requested;  // distinct pages in the last feedback
+  unsigned int Missing;    // of those, shown from a coarser page
+  unsigned int Resident;   // pages in the cache
+  unsigned int Loading;    // being read on workers or waiting to upload
+  unsigned int Uploaded;   // this Update()
+  unsigned int Evicted;    // since the start
+  size_t CacheBytes;       // page cache + indirection texture
+};
+
+// Virtual texturing for images too large to keep on the GPU. Build() cuts
+// an image and its mip chain offline into bordered pages (a .vtex file,
+// see VirtualTextureFile.h). At runtime the GPU holds a fixed page cache
+// texture and an indirection texture with one texel per page and one mip
+// per level, pointing every virtual page at the finest resident page that
+// covers it. Each frame the scene is drawn into a small feedback target
+// with the VirtualTextureFeedback shader, which writes the page and level
+// every pixel samples; its readback (a frame late, through a PBO) decides
+// which pages are loaded on JobSystem workers. Loaded pages replace the
+// least recently used ones. The coarsest page is pinned, so something is
+// always there to sample. Memory is bounded by the cache size, however
+// large the image is.
+class VirtualTexture {
+ public:
+  static const unsigned int kPageSize = 128;  // texels, without the border
+  static const unsigned int kBorder = 4;      // enough for bilinear + 4x aniso
+  static const unsigned int kFeedbackDivisor = 8;  // of the viewport size
+  static const unsigned int kUploadsPerFrame = 16;
+  static const unsigned int kMaxLoading = 64;  // pages read but not uploaded
+  static const unsigned int kPagesPerJob = 8;
+
+ private:
+  struct Level {
+    unsigned int PagesX, PagesY;
+    unsigned int FirstPage;
+  };
+
+  struct Slot {
+    uint64_t Page;  // kNoPage when free
+    unsigned int LastUsed;
+    bool Pinned;
+  };
+
+  struct LoadedPage {
+    uint64_t Page;
+    std::vector<unsigned char> Pixels;
+  };
+
+  static const uint64_t kNoPage = ~0ull;
+
+  std::string m_Path;
+  unsigned int m_Width, m_Height;
+  unsigned int m_PageSize, m_Border, m_PhysicalPageSize;
+  uint64_t m_PageOffset, m_PageBytes;
+  std::vector<Level> m_Levels;
+
+  // page cache, m_CachePages x m_CachePages slots
+  unsigned int m_CacheTexture;
+  unsigned int m_CachePages;
+  std::vector<Slot> m_Slots;
+  std::unordered_map<uint64_t, unsigned int> m_Resident;  // page -> slot
+
+  // RGBA8: slot x, slot y, level of the page used, 255 when set
+  unsigned int m_IndirectionTexture;
+  unsigned int m_IndirectionWidth, m_IndirectionHeight;
+  std::vector<std::vector<unsigned char>> m_Indirection;  // per level
+  bool m_IndirectionDirty;
+
+  // missing pages from the last feedback, coarse first
+  std::vector<uint64_t> m_Wanted;
+  std::unordered_set<uint64_t> m_Loading;
+  std::vector<LoadedPage> m_Uploads;
+  std::mutex m_LoadedMutex;
+  std::vector<LoadedPage> m_Loaded;
+  JobCounter m_Jobs;
+
+  std::unique_ptr<Framebuffer> m_Feedback;
+  unsigned int m_ReadbackBuffers[2];
+  unsigned int m_ReadbackWidth[2], m_ReadbackHeight[2];
+  unsigned int m_ViewportWidth, m_ViewportHeight;
+
+  unsigned int m_Frame;
+  VirtualTextureStats m_Stats;
+
+ public:
+  // cachePages^2 pages of GPU memory, clamped to GL_MAX_TEXTURE_SIZE
+  explicit VirtualTexture(const std::string& path,
+                          unsigned int cachePages = 16);
+  ~VirtualTexture();
+  VirtualTexture(const VirtualTexture&) = delete;
+  VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+  inline bool IsValid() const { return !m_Levels.empty(); }
+  inline unsigned int GetWidth() const { return m_Width; }
+  inline unsigned int GetHeight() const { return m_Height; }
+  inline unsigned int GetLevelCount() const {
+    return (unsigned int)m_Levels.size();
+  }
+
+  // Feedback pass: bind the feedback target for a viewport of width x
+  // height, draw what uses the texture with a shader set up by
+  // SetFeedbackUniforms(), then EndFeedback() starts the readback,
+  // restores the default framebuffer and consumes last frame's readback,
+  // sorting the pages it asks for in `arena`.
+  void BeginFeedback(unsigned int width, unsigned int height);
+  void SetFeedbackUniforms(Shader& shader) const;
+  void EndFeedback(FrameArena& arena);
+
+  // The same into a target the caller binds, e.g. a render graph pass:
+  // GL_RGBA16UI color attachment 0 and a depth buffer, GetFeedbackSize()
+  // of the viewport. ClearFeedback() before drawing, ReadFeedback() after.
+  static unsigned int GetFeedbackSize(unsigned int viewportSize);
+  void ClearFeedback() const;
+  void ReadFeedback(unsigned int width, unsigned int height,
+                    FrameArena& arena);
+
+  // on the GL thread once per frame, after EndFeedback()
+  void Update();
+
+  // the indirection texture goes to `slot`, the page cache to slot + 1
+  void Bind(Shader& shader, unsigned int slot = 0) const;
+
+  inline const VirtualTextureStats& GetStats() const { return m_Stats; }
+  void PrintStats() const;
+
+  // cut `source` into a .vtex file
+  static bool Build(const std::string& source, const std::string& destination,
+                    unsigned int pageSize = kPageSize,
+                    unsigned int border = kBorder);
+
+ private:
+  void ProcessFeedback(const uint16_t* texels, unsigned int count,
+                       FrameArena& arena);
+  void Dispatch();
+  void UploadPages();
+  void UpdateIndirection();
+  bool ReadPage(std::ifstream& stream, uint64_t page,
+                std::vector<unsigned char>& pixels) const;
+  unsigned int AllocateSlot();
+  void SetUniforms(Shader& shader, float lodBias) const;
+
+  static inline uint64_t PageKey(unsigned int level, unsigned int x,
+                                 unsigned int y) {
+    return ((uint64_t)level << 48) | ((uint64_t)y << 24) | x;
+  }
+  static inline unsigned int PageLevel(uint64_t page) {
+    return (unsigned int)(page >> 48);
+  }
+  static inline unsigned int PageY(uint64_t page) {
+    return (unsigned int)(page >> 24) & 0xffffff;
+  }
+  static inline unsigned int PageX(uint64_t page) {
+    return (unsigned int)page & 0xffffff;
+  }
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+// Pre-tiled virtual texture (.vtex), written by VirtualTexture::Build and
+// paged in by VirtualTexture. Little endian, laid out as
+//
+//   VirtualTextureFileHeader
+//   VirtualTextureFileLevel[LevelCount], finest first
+//   page block (PageOffset, 16-byte aligned), PageBytes per page, the
+//   pages of every level back to back, rows bottom up like GL
+//
+// A page is (PageSize + 2 * Border)^2 RGBA8 texels: PageSize texels of its
+// level plus a border copied from its neighbours (edge clamped), so
+// bilinear filtering never reads another page in the cache. Page (x, y)
+// of a level is at PageOffset + (FirstPage + y * PagesX + x) * PageBytes,
+// one seek and one read. The coarsest level is a single page.
+
+const char kVirtualTextureMagic[4] = {'V', 'T', 'E', 'X'};
+const uint32_t kVirtualTextureVersion = 1;
+const uint32_t kVirtualTextureAlignment = 16;
+
+struct VirtualTextureFileHeader {
+  char Magic[4];
+  uint32_t Version;
+  uint32_t Width;  // level 0 in texels
+  uint32_t Height;
+  uint32_t PageSize;
+  uint32_t Border;
+  uint32_t LevelCount;
+  uint32_t Reserved;
+  uint64_t PageOffset;
+  uint64_t PageBytes;
+};
+
+struct VirtualTextureFileLevel {
+  uint32_t PagesX;
+  uint32_t PagesY;
+  uint32_t FirstPage;  // index of page (0, 0) in the page block
+  uint32_t Reserved;
+};
@@ -0,0 +1,92 @@
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "SelfTest.h"
+#include "VirtualTexture.h"
+#include "VirtualTextureFile.h"
+
+namespace {
+
+// an 8x8 image in 4 texel pages without a border: 2x2 pages, then the
+// 4x4 level in one
+struct TestTexture {
+  VirtualTextureFileHeader Header;
+  VirtualTextureFileLevel Levels[2];
+  unsigned char Pages[5][4 * 4 * 4];
+};
+
+TestTexture MakeTexture() {
+  static_assert(offsetof(TestTexture, Pages) % kVirtualTextureAlignment == 0,
+                "page block must be aligned");
+  TestTexture texture;
+  memset(&texture, 0, sizeof(texture));
+  VirtualTextureFileHeader& header = texture.Header;
+  memcpy(header.Magic, kVirtualTextureMagic, 4);
+  header.Version = kVirtualTextureVersion;
+  header.Width = 8;
+  header.Height = 8;
+  header.PageSize = 4;
+  header.Border = 0;
+  header.LevelCount = 2;
+  header.PageOffset = offsetof(TestTexture, Pages);
+  header.PageBytes = sizeof(texture.Pages[0]);
+  texture.Levels[0] = VirtualTextureFileLevel{2, 2, 0, 0};
+  texture.Levels[1] = VirtualTextureFileLevel{1, 1, 4, 0};
+  memset(texture.Pages, 0xff, sizeof(texture.Pages));
+  return texture;
+}
+
+// write the test texture after `change` and open it
+bool Opens(const std::string& name,
+           const std::function<void(TestTexture&)>& change,
+           size_t size = sizeof(TestTexture)) {
+  TestTexture texture = MakeTexture();
+  change(texture);
+  VirtualTexture opened(SelfTest::WriteFile(name + ".vtex", &texture, size));
+  return opened.IsValid();
+}
+
+}  // namespace
+
+void SelfTest::VirtualTextureTests() {
+  EXPECT(Opens("good", [](TestTexture&) {}));
+  {
+    TestTexture texture = MakeTexture();
+    VirtualTexture opened(WriteFile("levels.vtex", &texture, sizeof(texture)));
+    EXPECT(opened.IsValid() && opened.GetLevelCount() == 2 &&
+           opened.GetWidth() == 8 && opened.GetHeight() == 8);
+  }
+
+  // not a virtual texture, or not one of this version
+  EXPECT(!Opens("empty", [](TestTexture&) {}, 0));
+  EXPECT(!Opens("short_header", [](TestTexture&) {}, 20));
+  EXPECT(!Opens("magic", [](TestTexture& t) { t.Header.Magic[0] = 'X'; }));
+  EXPECT(!Opens("version", [](TestTexture& t) { t.Header.Version = 2; }));
+  EXPECT(!Opens("no_size", [](TestTexture& t) { t.Header.Width = 0; }));
+  EXPECT(!Opens("no_page_size", [](TestTexture& t) { t.Header.PageSize = 0; }));
+  EXPECT(!Opens("page_bytes", [](TestTexture& t) { t.Header.PageBytes = 4; }));
+
+  // a level table that isn't the one for the image
+  EXPECT(!Opens("short_table", [](TestTexture&) {},
+                sizeof(VirtualTextureFileHeader) + 8));
+  EXPECT(!Opens("level_count",
+                [](TestTexture& t) { t.Header.LevelCount = 0xFFFFFFFF; }));
+  EXPECT(!Opens("extra_level",
+                [](TestTexture& t) { t.Header.LevelCount = 3; }));
+  EXPECT(!Opens("pages_x", [](TestTexture& t) { t.Levels[0].PagesX = 3; }));
+  EXPECT(!Opens("pages_y", [](TestTexture& t) { t.Levels[1].PagesY = 0; }));
+  EXPECT(!Opens("first_page",
+                [](TestTexture& t) { t.Levels[1].FirstPage = 0x7FFFFFFF; }));
+  EXPECT(!Opens("image_size", [](TestTexture& t) { t.Header.Width = 9; }));
+
+  // pages past the end of the file
+  EXPECT(!Opens("truncated", [](TestTexture&) {}, sizeof(TestTexture) - 4));
+  EXPECT(!Opens("page_offset",
+                [](TestTexture& t) { t.Header.PageOffset += 16; }));
+  EXPECT(!Opens("huge_offset",
+                [](TestTexture& t) { t.Header.PageOffset = 1ull << 62; }));
+  EXPECT(!Opens("offset_in_table",
+                [](TestTexture& t) { t.Header.PageOffset = 16; }));
+}